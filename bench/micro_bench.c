@@ -0,0 +1,571 @@
+/*
+ * Microbenchmarks of the list, hash and cache primitives with hardware
+ * counters, results are printed as JSON on stdout.
+ *
+ * Build from the repository root:
+ *   gcc -O2 -Iinclude -DCACHE_NO_MAIN bench/micro_bench.c src/cache.c \
+ *       src/cache_space.c src/cache_policy.c src/cache_write_back.c \
+ *       src/dlist.c src/ilist.c src/hash_t.c src/lf_hash.c src/read_buf.c \
+ *       src/epoch.c src/topk.c src/slab.c src/ring.c -lpthread \
+ *       -o micro_bench
+ * Run:
+ *   ./micro_bench [size ...] > bench_output.json
+ *
+ * Counters come from perf_event_open(2), they are reported as null when the
+ * kernel does not allow it (see /proc/sys/kernel/perf_event_paranoid).
+ * They are opened as one group, so when the kernel has to multiplex them
+ * they all count the same share of the run, scaled up to all of it.
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <string.h>		/* memset			*/
+#include <stdint.h>		/* uint64_t			*/
+#include <time.h>		/* clock_gettime	*/
+#include <unistd.h>		/* syscall, read	*/
+#include <sys/ioctl.h>	/* ioctl			*/
+#include <sys/syscall.h>	/* SYS_perf_event_open */
+#include <linux/perf_event.h>
+
+#include "aux_funcs.h" /*is_match_t , action_func*/
+#include "dlist.h"
+#include "ilist.h"
+#include "hash_t.h"
+#include "cache.h"
+
+#define HW_CACHE(cache, op, result) \
+	((cache) | ((op) << 8) | ((result) << 16))
+
+enum{
+	CYCLES,
+	INSTRUCTIONS,
+	L1D_MISSES,
+	LLC_MISSES,
+	BRANCH_MISSES,
+	DTLB_MISSES,
+	N_COUNTERS
+};
+
+typedef struct counter_def
+{
+	const char *name;
+	uint32_t type;
+	uint64_t config;
+}counter_def_t;
+
+static const counter_def_t counter_defs[N_COUNTERS] = {
+	{"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"l1d_misses", PERF_TYPE_HW_CACHE, HW_CACHE(PERF_COUNT_HW_CACHE_L1D,
+			PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"dtlb_misses", PERF_TYPE_HW_CACHE, HW_CACHE(PERF_COUNT_HW_CACHE_DTLB,
+			PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)}
+};
+
+/* one fd per counter, -1 when the kernel refused it */
+static int fds[N_COUNTERS];
+/* the first counter opened leads the group, -1 if none */
+static int leader = -1;
+/* where each counter comes in a read of the group */
+static size_t slots[N_COUNTERS];
+
+typedef struct sample
+{
+	uint64_t ns;
+	uint64_t counts[N_COUNTERS];
+}sample_t;
+
+typedef struct bench
+{
+	const char *name;
+	/* untimed setup, the timed loop and untimed cleanup for 'n' elements */
+	void (*setup)(size_t n);
+	void (*run)(size_t n);
+	void (*teardown)(size_t n);
+}bench_t;
+
+
+static int *keys = NULL;
+static size_t *order = NULL;	/* random permutation of 0..n-1 */
+static dlist_t *dlist = NULL;
+static ditr_t *ditrs = NULL;
+static ilist_t *ilist = NULL;
+static iitr_t *iitrs = NULL;
+static hash_t *hash = NULL;
+static cache_t *cache = NULL;
+static volatile size_t sink = 0;
+
+
+static void OpenCounters(void)
+{
+	size_t n_open = 0;
+	int i = 0;
+
+	for(i = 0 ; i < N_COUNTERS ; i++)
+	{
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = counter_defs[i].type;
+		attr.config = counter_defs[i].config;
+		/*members follow the leader*/
+		attr.disabled = -1 == leader;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP |
+				PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+		if(fds[i] >= 0)
+		{
+			leader = -1 == leader ? fds[i] : leader;
+			slots[i] = n_open++;
+		}
+	}
+}
+
+static void CloseCounters(void)
+{
+	int i = 0;
+
+	for(i = 0 ; i < N_COUNTERS ; i++)
+	{
+		if(fds[i] >= 0)
+		{
+			close(fds[i]);
+		}
+	}
+	leader = -1;
+}
+
+static uint64_t Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Stops the group and reads it at once: the number of counters, the time
+ * it was enabled and the time it ran, then the counts. Counts are scaled
+ * by enabled / running, 0 if the group never got on the PMU.
+ */
+static void ReadCounters(uint64_t counts[N_COUNTERS])
+{
+	uint64_t group[3 + N_COUNTERS];
+	ssize_t len = 0;
+	int i = 0;
+
+	memset(counts, 0, N_COUNTERS * sizeof(uint64_t));
+	if(leader < 0)
+	{
+		return;
+	}
+
+	ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	len = read(leader, group, sizeof(group));
+	if(len < (ssize_t)(3 * sizeof(uint64_t)) || 0 == group[2] ||
+				(size_t)len < (3 + group[0]) * sizeof(uint64_t))
+	{
+		return;
+	}
+
+	for(i = 0 ; i < N_COUNTERS ; i++)
+	{
+		if(fds[i] >= 0 && slots[i] < group[0])
+		{
+			counts[i] = (uint64_t)((double)group[3 + slots[i]] *
+										(double)group[1] / (double)group[2]);
+		}
+	}
+}
+
+static void Measure(const bench_t *bench, size_t n, sample_t *sample)
+{
+	uint64_t start = 0;
+
+	bench->setup(n);
+
+	if(leader >= 0)
+	{
+		ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+	start = Now();
+
+	bench->run(n);
+
+	sample->ns = Now() - start;
+	ReadCounters(sample->counts);
+
+	bench->teardown(n);
+}
+
+
+static size_t HashKey(const void *key)
+{
+	size_t k = (size_t)*(const int*)key;
+
+	return k * (size_t)0x9e3779b97f4a7c15ULL >> 16;
+}
+
+static int MatchKey(const void *a, const void *b)
+{
+	return *(const int*)a == *(const int*)b;
+}
+
+static void Shuffle(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		order[i] = i;
+	}
+	for(i = n ; i > 1 ; i--)
+	{
+		size_t j = (size_t)rand() % i;
+		size_t tmp = order[i - 1];
+
+		order[i - 1] = order[j];
+		order[j] = tmp;
+	}
+}
+
+/* dlist */
+static void DListSetupEmpty(size_t n)
+{
+	(void)n;
+	dlist = DListCreate();
+}
+
+static void DListSetupFull(size_t n)
+{
+	size_t i = 0;
+
+	dlist = DListCreate();
+	for(i = 0 ; i < n ; i++)
+	{
+		ditrs[i] = DListPushBack(dlist, &keys[i]);
+	}
+	Shuffle(n);
+}
+
+static void DListTeardown(size_t n)
+{
+	(void)n;
+	DListDestroy(dlist);
+}
+
+static void DListRunPushBack(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		DListPushBack(dlist, &keys[i]);
+	}
+}
+
+static void DListRunRemove(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		DListRemove(ditrs[order[i]]);
+	}
+}
+
+/* moves random nodes to the back, as a cache hit promotion does */
+static void DListRunSplice(size_t n)
+{
+	ditr_t end = DListIterEnd(dlist);
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		DListSplice(end, ditrs[order[i]], ditrs[order[i]]);
+	}
+}
+
+
+/* ilist, same patterns for comparing the node layouts */
+static void IListSetupEmpty(size_t n)
+{
+	ilist = IListCreate(n);
+}
+
+static void IListSetupFull(size_t n)
+{
+	size_t i = 0;
+
+	ilist = IListCreate(n);
+	for(i = 0 ; i < n ; i++)
+	{
+		iitrs[i] = IListPushBack(ilist, &keys[i]);
+	}
+	Shuffle(n);
+}
+
+static void IListTeardown(size_t n)
+{
+	(void)n;
+	IListDestroy(ilist);
+}
+
+static void IListRunPushBack(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		IListPushBack(ilist, &keys[i]);
+	}
+}
+
+static void IListRunRemove(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		IListRemove(ilist, iitrs[order[i]]);
+	}
+}
+
+static void IListRunSplice(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		IListSplice(ilist, ILIST_END, iitrs[order[i]], iitrs[order[i]]);
+	}
+}
+
+
+/* hash_t, sized like the cache sizes its index */
+static void HashSetupEmpty(size_t n)
+{
+	hash = HashCreate(n * 2, HashKey, MatchKey);
+	Shuffle(n);
+}
+
+static void HashSetupFull(size_t n)
+{
+	size_t i = 0;
+
+	hash = HashCreate(n * 2, HashKey, MatchKey);
+	for(i = 0 ; i < n ; i++)
+	{
+		HashInsert(hash, &keys[i], &keys[i]);
+	}
+	Shuffle(n);
+}
+
+static void HashTeardown(size_t n)
+{
+	(void)n;
+	HashDestroy(hash);
+}
+
+static void HashRunInsert(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		HashInsert(hash, &keys[order[i]], &keys[order[i]]);
+	}
+}
+
+static void HashRunFind(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		sink += (size_t)HashFind(hash, &keys[order[i]]);
+	}
+}
+
+static void HashRunRemove(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		HashRemove(hash, &keys[order[i]]);
+	}
+}
+
+
+/* cache_t, keys [n, 2n) are never stored */
+static void CacheSetupFull(size_t n)
+{
+	size_t i = 0;
+
+	cache = CacheCreate(n, HashKey, MatchKey);
+	for(i = 0 ; i < n ; i++)
+	{
+		CacheSet(cache, &keys[i], &keys[i]);
+	}
+	Shuffle(n);
+}
+
+static void CacheTeardown(size_t n)
+{
+	(void)n;
+	CacheDestroy(cache);
+}
+
+static void CacheRunGetHit(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		sink += (size_t)CacheGet(cache, &keys[order[i]]);
+	}
+}
+
+static void CacheRunGetMiss(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		sink += (size_t)CacheGet(cache, &keys[n + order[i]]);
+	}
+}
+
+static void CacheRunSetEvict(size_t n)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		CacheSet(cache, &keys[n + order[i]], &keys[n + order[i]]);
+	}
+}
+
+
+static const bench_t benches[] = {
+	{"dlist_push_back", DListSetupEmpty, DListRunPushBack, DListTeardown},
+	{"dlist_remove", DListSetupFull, DListRunRemove, DListTeardown},
+	{"dlist_splice", DListSetupFull, DListRunSplice, DListTeardown},
+	{"ilist_push_back", IListSetupEmpty, IListRunPushBack, IListTeardown},
+	{"ilist_remove", IListSetupFull, IListRunRemove, IListTeardown},
+	{"ilist_splice", IListSetupFull, IListRunSplice, IListTeardown},
+	{"hash_insert", HashSetupEmpty, HashRunInsert, HashTeardown},
+	{"hash_find", HashSetupFull, HashRunFind, HashTeardown},
+	{"hash_remove", HashSetupFull, HashRunRemove, HashTeardown},
+	{"cache_get_hit", CacheSetupFull, CacheRunGetHit, CacheTeardown},
+	{"cache_get_miss", CacheSetupFull, CacheRunGetMiss, CacheTeardown},
+	{"cache_set_evict", CacheSetupFull, CacheRunSetEvict, CacheTeardown}
+};
+
+static const size_t default_sizes[] = {1 << 10, 1 << 14, 1 << 18, 1 << 20};
+
+
+static void PrintSample(const bench_t *bench, size_t n, const sample_t *sample,
+																	int first)
+{
+	int i = 0;
+
+	printf("%s    {\"name\": \"%s\", \"size\": %zu, \"ops\": %zu, "
+			"\"ns_per_op\": %.3f", first ? "" : ",\n", bench->name, n, n,
+									(double)sample->ns / (double)n);
+
+	for(i = 0 ; i < N_COUNTERS ; i++)
+	{
+		if(fds[i] >= 0)
+		{
+			printf(", \"%s\": %.3f", counter_defs[i].name,
+								(double)sample->counts[i] / (double)n);
+		}
+		else
+		{
+			printf(", \"%s\": null", counter_defs[i].name);
+		}
+	}
+
+	printf("}");
+}
+
+int main(int argc, char *argv[])
+{
+	size_t sizes[32];
+	size_t n_sizes = 0;
+	size_t max = 0;
+	size_t i = 0;
+	size_t b = 0;
+	int first = 1;
+
+	for(i = 1 ; i < (size_t)argc && n_sizes < 32 ; i++)
+	{
+		sizes[n_sizes] = strtoul(argv[i], NULL, 0);
+		if(0 != sizes[n_sizes])
+		{
+			++n_sizes;
+		}
+	}
+	if(0 == n_sizes)
+	{
+		n_sizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+		memcpy(sizes, default_sizes, sizeof(default_sizes));
+	}
+
+	for(i = 0 ; i < n_sizes ; i++)
+	{
+		max = sizes[i] > max ? sizes[i] : max;
+	}
+
+	keys = (int*)malloc(2 * max * sizeof(int));
+	order = (size_t*)malloc(max * sizeof(size_t));
+	ditrs = (ditr_t*)malloc(max * sizeof(ditr_t));
+	iitrs = (iitr_t*)malloc(max * sizeof(iitr_t));
+	if(NULL == keys || NULL == order || NULL == ditrs || NULL == iitrs)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for(i = 0 ; i < 2 * max ; i++)
+	{
+		keys[i] = (int)i;
+	}
+
+	srand(1);
+	OpenCounters();
+
+	printf("{\n  \"counters\": %s,\n  \"benchmarks\": [\n",
+								leader >= 0 ? "true" : "false");
+
+	for(i = 0 ; i < n_sizes ; i++)
+	{
+		for(b = 0 ; b < sizeof(benches) / sizeof(benches[0]) ; b++)
+		{
+			sample_t sample;
+
+			Measure(&benches[b], sizes[i], &sample);
+			PrintSample(&benches[b], sizes[i], &sample, first);
+			first = 0;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	CloseCounters();
+	free(keys);
+	free(order);
+	free(ditrs);
+	free(iitrs);
+
+	return 0;
+}
@@ -1,20 +1,623 @@
-
 #ifndef __CACHE_H__
 #define __CACHE_H__
 
 #include <stdlib.h>    /* size_t        */
+#include <stdint.h>    /* uint64_t      */
 
 #include "aux_funcs.h" /* action_func_t */
+#include "hash_t.h"    /* hash_func_t   */
+#include "ctier.h"     /* size_func_t   */
+#include "topk.h"      /* topk_entry_t  */
 
 
 typedef struct cache cache_t;
 
+/* pins the data of an entry, see "CacheAcquire()" */
+typedef struct cache_handle cache_handle_t;
+
+
+/******************************************************************************
+Description:     	Stores a copy of an entry evicted from the cache in a
+					secondary tier. 'key' and 'data' stay owned by the cache.
+Return value:    	0 in case of success otherwise 1 (entry dropped).
+*******************************************************************************/
+typedef int (*tier_put_func_t)(void *tier, const void *key, const void *data);
+
+
+/******************************************************************************
+Description:     	Removes 'key' from a secondary tier. '*stored_key' gets a
+					malloc'd copy of the key, the returned data is malloc'd too.
+Return value:    	Pointer to data in case of hit, otherwise NULL.
+*******************************************************************************/
+typedef void *(*tier_take_func_t)(void *tier, const void *key,
+												void **stored_key);
+
+
+/******************************************************************************
+Description:     	Called by "CacheScan()" for every entry, non zero stops
+					the scan. Also called by "CacheVisit()" on a hit.
+*******************************************************************************/
+typedef int (*cache_scan_func_t)(const void *key, void *data,
+														void *user_params);
+
+
+/******************************************************************************
+Description:     	Called once the cache lets go of a key and its data. Either
+					of them is NULL when only the other one is let go (a key
+					passed to "CacheSet()" for an entry that already has one,
+					or data replaced under a key that stays).
+*******************************************************************************/
+typedef void (*cache_release_func_t)(void *key, void *data,
+														void *user_params);
+
+
+/******************************************************************************
+Description:     	Returns the namespace of 'key' (see "CacheAddNamespace()"),
+					0 or an unknown one for the default namespace.
+*******************************************************************************/
+typedef size_t (*cache_ns_func_t)(const void *key);
+
+
+/******************************************************************************
+Description:     	Writes 'n' entries to the backing store in one batch, see
+					"CacheSetWriteBack()". 'keys' and 'data' stay owned by the
+					cache.
+Return value:    	0 in case of success otherwise 1 (the whole batch is
+					retried by a later flush).
+*******************************************************************************/
+typedef int (*cache_flush_func_t)(void *const *keys, void *const *data,
+											size_t n, void *user_params);
+
+
+/* statistics of a namespace, see "CacheNamespaceStats()" */
+typedef struct cache_ns_stats
+{
+	size_t entries;
+	size_t reserved;
+	size_t quota;
+	size_t hits;
+	size_t misses;
+	size_t sets;		/* of new entries */
+	size_t evictions;
+}cache_ns_stats_t;
+
+/* what happened to a key, see "CacheEnableEvents()" */
+typedef enum cache_event_op
+{
+	CACHE_EVENT_INSERT,
+	CACHE_EVENT_UPDATE,
+	CACHE_EVENT_EVICT,
+	CACHE_EVENT_REMOVE,
+	CACHE_EVENT_EXPIRE,
+	CACHE_EVENT_INVALIDATE	/* by "CacheInvalidateTag()" */
+}cache_event_op_t;
+
+typedef struct cache_event
+{
+	cache_event_op_t op;
+	size_t key_hash;	/* by the cache's "hash_func" */
+	const void *key;	/* only a reference, it may be released already */
+	size_t size;		/* of the data, 0 without a "data_size" function */
+	uint64_t time_ms;	/* CLOCK_MONOTONIC */
+}cache_event_t;
+
+/* which entries make room for new ones, see "CacheSetPolicy()" */
+typedef enum cache_policy
+{
+	CACHE_POLICY_LRU,
+	CACHE_POLICY_ARC,
+	CACHE_POLICY_GDSF
+}cache_policy_t;
+
+
+/******************************************************************************
+Description:     	Creates an LRU cache of 'capacity' entries indexed according
+					to "hash_func" and "match".
+Return value:    	Pointer to cache in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+Note:            	Should call "CacheDestroy()" at end of use.
+					All functions may be called concurrently from any thread.
+******************************************************************************/
+cache_t *CacheCreate(size_t capacity, hash_func_t hash_func,
+												is_match_func_t match);
+
+
+/******************************************************************************
+Description:     	Deletes a cache pointed to by "cache" from memory.
+					Keys and data are owned by the caller and are not freed,
+					unless the cache owns them (see "CacheSetRelease()").
+Time Complexity: 	O(n).
+Notes:           	Undefined behaviour if cache is NULL.
+*******************************************************************************/
+void CacheDestroy(cache_t *cache);
+
+
+/*******************************************************************************
+Description:     	Turns the per-thread front cache of "cache" on (non zero
+					'enable') or off. Every thread then keeps a small 4-way
+					set associative copy of the entries it hit recently and
+					serves repeated hits from it without touching shared
+					state, as long as the key's entry did not change since.
+Time Complexity: 	O(1).
+Notes: 			 	Keys must stay valid while they are cached (as for
+					"CacheSet()"), the front cache compares them with "match".
+*******************************************************************************/
+void CacheSetFrontCache(cache_t *cache, int enable);
+
+
+/*******************************************************************************
+Description:     	Backs "cache" with a secondary tier: evicted entries are
+					copied into 'tier' with "put" and misses are looked up with
+					"take", a hit there is moved back into the cache unless
+					the key was set meanwhile. Setting or removing a key takes
+					its stale copy out of the tier.
+Time Complexity: 	O(1).
+Notes: 			 	Call before the cache is shared between threads.
+					From then on keys and data must be allocated with malloc()
+					and are owned by the cache, which frees them once they are
+					evicted or replaced and in "CacheDestroy()" (unless another
+					release hook is set with "CacheSetRelease()"). Data
+					returned by "CacheGet()" is then only valid until the entry
+					can be evicted, i.e. until the next "CacheSet()" of any
+					thread, use "CacheAcquire()" to read it safely.
+*******************************************************************************/
+void CacheAttachTier(cache_t *cache, tier_put_func_t put,
+										tier_take_func_t take, void *tier);
+
+
+/*******************************************************************************
+Description:     	Turns on tracking of the 'k' hottest keys of "cache": keys
+					passed to "CacheGet()", "CacheVisit()" and "CacheSet()"
+					feed a Space-Saving top-k tracker, one call in 'sample'
+					per thread is counted. Counts halve every 10 seconds, so
+					the tracker follows keys heating up and cooling down.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(k).
+Notes: 			 	Call before the cache is shared between threads.
+					Keys are copied with 'key_size' bytes, they must be flat.
+					See "TopKCreate()".
+*******************************************************************************/
+int CacheTrackHotKeys(cache_t *cache, size_t k, size_t sample,
+													size_func_t key_size);
+
+
+/*******************************************************************************
+Description:     	Fills 'entries' with up to 'n' of the hottest keys of
+					"cache" and their estimated rates (accesses per second),
+					hottest first. Meant for replicating or pinning hot keys
+					and for debugging an imbalance.
+Return value:    	Number of entries filled, 0 if tracking is off.
+Time Complexity: 	O(k log k).
+Notes: 			 	The caller releases every 'entries[i].key' with free().
+*******************************************************************************/
+size_t CacheHotKeys(cache_t *cache, topk_entry_t *entries, size_t n);
+
+
+/*******************************************************************************
+Description:     	Makes "cache" own the keys and data it is given: "release"
+					is called with them once they are evicted, replaced or
+					removed and no reader (or handle, for data) can still see
+					them, and for the entries left in "CacheDestroy()".
+Time Complexity: 	O(1).
+Notes: 			 	Call before the cache is shared between threads.
+					As with a tier, data returned by "CacheGet()" may be
+					released by any later write, see "CacheAcquire()".
+*******************************************************************************/
+void CacheSetRelease(cache_t *cache, cache_release_func_t release,
+														void *user_params);
+
+
+/*******************************************************************************
+Description:     	Tells "cache" which namespace every key belongs to. Keys of
+					all namespaces share the index and the capacity, so they
+					must differ across namespaces (e.g. carry a tenant
+					prefix), but each namespace keeps an LRU list of its own.
+Time Complexity: 	O(1).
+Notes: 			 	Call before the cache is shared between threads.
+					"ns_func" is called on every write and, to count misses,
+					on every miss.
+*******************************************************************************/
+void CacheSetNamespaceFunc(cache_t *cache, cache_ns_func_t ns_func);
+
+
+/*******************************************************************************
+Description:     	Adds a namespace to "cache". While the cache is full a new
+					entry evicts the least recently used entry of the
+					namespace most over its share: its reservation plus an
+					equal part of the capacity no namespace reserved. So an
+					idle namespace's room is used by the others, but a busy one
+					can't evict another below its share.
+					- 'reserved' entries of the namespace are never evicted to
+					  make room for other namespaces,
+					- with a non zero 'quota' the namespace never holds more
+					  entries, a new one evicts one of its own.
+Return value:    	Id of the namespace, 0 if there is no memory.
+Time Complexity: 	O(reserved).
+Notes: 			 	Call before the cache is shared between threads.
+					Evicting takes O(namespaces), meant for dozens of them.
+					Reservations beyond the capacity can't all be kept.
+*******************************************************************************/
+size_t CacheAddNamespace(cache_t *cache, size_t reserved, size_t quota);
+
+
+/*******************************************************************************
+Description:     	Fills 'stats' with the statistics of namespace 'ns' of
+					"cache". Hits and misses are only counted once a
+					namespace function is set.
+Return value:    	0 in case of success, 1 if there is no such namespace.
+Time Complexity: 	O(1).
+*******************************************************************************/
+int CacheNamespaceStats(cache_t *cache, size_t ns, cache_ns_stats_t *stats);
+
+
+/*******************************************************************************
+Description:     	Makes "cache" keep a copy of the data of every write in
+					memory of its own, at most 'memory' bytes (see
+					"SlabCreate()"), 'data_size' gives the bytes to copy. Each
+					slab class keeps an LRU list of its own: a value whose
+					class is out of chunks evicts the least recently used
+					entries of that class. The maintenance thread (see
+					"CacheStartMaintenance()") moves pages to the class that
+					runs out of chunks most often, from classes that don't, as
+					the mix of sizes shifts; the entries in a moved page are
+					evicted.
+Return value:    	0 in case of success, otherwise 1.
+Time Complexity: 	O(classes).
+Notes: 			 	Call on an empty cache before it is shared between
+					threads. Neither namespaces nor a tier can be added to it,
+					"CacheNamespaceStats()" reports slab class 'ns' instead.
+					The caller keeps the data it writes, data returned by
+					"CacheGet()" is the copy and its chunk is reused once the
+					entry is gone (see "CacheAcquire()"). The release hook
+					only gets keys. A value no class fits, or whose class
+					gets no chunk, is not stored and the old entry of its key
+					is removed.
+*******************************************************************************/
+int CacheUseSlabs(cache_t *cache, size_t memory, size_func_t data_size);
+
+
+/*******************************************************************************
+Description:     	Sets the number of entries "cache" may hold. Shrinking
+					evicts the least recently used entries in one batch: they
+					are spliced off the LRU list together and freed later by a
+					call of this function, once no reader can still see them.
+					Growing past the 'capacity' it was created with doubles
+					the index, its buckets are then moved over a few at a time
+					by the following "CacheSet()" calls (or by the maintenance
+					thread, see "CacheStartMaintenance()").
+Time Complexity: 	O(evicted entries).
+Notes: 			 	Meant to be called periodically by a memory monitor (see
+					"MemMonitorStart()"), each call also frees the batches of
+					previous calls that became safe to free.
+*******************************************************************************/
+void CacheSetCapacity(cache_t *cache, size_t capacity);
+
 
+/*******************************************************************************
+Description:     	Returns the number of entries "cache" may currently hold.
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t CacheGetCapacity(cache_t *cache);
+
+
+/*******************************************************************************
+Description:     	Starts a thread that does the housekeeping of "cache" every
+					'interval_ms' milliseconds, so writers only link and
+					unlink entries:
+					- keys and data released by writers are freed by it,
+					- once the cache holds more entries than its capacity it
+					  evicts down to 1/16 below it in one batch (writers only
+					  evict themselves 1/8 above the capacity),
+					- it deletes expired entries (see "CacheSetWithTTL()"),
+					  a few index buckets per round,
+					- it moves the buckets of a growing index.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(1) + system call complexity.
+Notes: 			 	Every cache gets a thread of its own. A writer crossing
+					the capacity wakes the thread up before its interval.
+					"CacheDestroy()" stops the thread if it still runs.
+*******************************************************************************/
+int CacheStartMaintenance(cache_t *cache, unsigned interval_ms);
+
+
+/*******************************************************************************
+Description:     	Stops the thread of "CacheStartMaintenance()", frees what
+					it did not free yet and evicts down to the capacity.
+Time Complexity: 	O(released entries) + wait for the thread.
+Notes: 			 	Does nothing if no thread maintains "cache".
+*******************************************************************************/
+void CacheStopMaintenance(cache_t *cache);
+
+
+/*******************************************************************************
+Description:     	Chooses how "cache" evicts. CACHE_POLICY_LRU, the default,
+					evicts the least recently used entry.
+					CACHE_POLICY_ARC (adaptive replacement) keeps keys hit
+					once and keys hit again in two LRU lists, and remembers
+					the hashes of as many keys recently evicted from each.
+					A miss on a remembered key grows the share of the list
+					it was evicted from, so the split between recency and
+					frequency follows the workload without tuning.
+					CACHE_POLICY_GDSF (GreedyDual-Size-Frequency) evicts the
+					entry of the lowest priority: the priority of the last
+					entry evicted when it was last used, plus its uses times
+					its cost per byte (see "CacheSetWithCost()"). Entries
+					that are cheap to recompute go first, and an entry that
+					is no longer used falls behind as evictions move the
+					clock forward.
+Return value:    	0 in case of success, otherwise 1.
+Time Complexity: 	O(1). Operations stay O(1) under LRU and ARC, a write,
+					a recorded hit or an eviction takes O(log n) under GDSF.
+Notes: 			 	Call before the cache is shared between threads, while it
+					is empty, not together with namespaces or
+					"CacheUseSlabs()".
+					Hits are buffered (see "CacheGet()"), a hit that is
+					dropped from the buffer counts for neither policy.
+					Dirty entries (see "CacheSetWriteBack()") are skipped.
+					Under GDSF they leave the heap until they are flushed,
+					then come back with a fresh priority, so the victim is
+					always the clean entry of the lowest priority.
+*******************************************************************************/
+int CacheSetPolicy(cache_t *cache, cache_policy_t policy);
+
+
+/*******************************************************************************
+Description:     	Makes "cache" absorb writes: every write marks its entry
+					dirty and dirty entries are written to the backing store
+					through "flush", in batches of up to 'batch' entries. An
+					entry set many times before a flush is written once, with
+					its latest data. The maintenance thread (see
+					"CacheStartMaintenance()") flushes once 'batch' entries
+					are dirty, once an entry has been dirty for 'interval_ms'
+					milliseconds, or when dirty entries hold the cache past
+					its capacity. Without the thread the writer that fills a
+					batch flushes it.
+Return value:    	0 in case of success, otherwise 1.
+Time Complexity: 	O(1).
+Notes: 			 	Call before the cache is shared between threads, not
+					together with "CacheUseSlabs()".
+					Dirty entries are never evicted, a cache full of them
+					grows past its capacity until they are flushed. Removed
+					or expired entries are dropped without being flushed.
+					"flush" is called by one thread at a time, without any
+					lock of "cache" held. "CacheDestroy()" flushes what is
+					left.
+*******************************************************************************/
+int CacheSetWriteBack(cache_t *cache, cache_flush_func_t flush, size_t batch,
+								unsigned interval_ms, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Flushes the entries of "cache" that are dirty when it is
+					called (see "CacheSetWriteBack()").
+Return value:    	0 in case of success, 1 if a batch failed (its entries
+					and the ones after it stay dirty) or there was no memory
+					to start (all entries stay dirty).
+Time Complexity: 	O(dirty entries) + "flush" calls.
+Notes: 			 	Returns 0 right away if writes are not flushed.
+*******************************************************************************/
+int CacheFlush(cache_t *cache);
+
+
+/*******************************************************************************
+Description:     	Makes "cache" record every insert, update, eviction,
+					removal, expiry and invalidation as a cache_event_t in a
+					lock-free ring of 'capacity' events, to be drained by
+					"CacheDrainEvents()" on the consumers' own threads.
+					"data_size" (may be NULL) gives the size of an event's
+					data.
+Return value:    	0 in case of success, otherwise 1.
+Time Complexity: 	O(capacity).
+Notes: 			 	Call before the cache is shared between threads.
+					Writers never wait for the consumers: an event that finds
+					the ring full is dropped and counted (see
+					"CacheDroppedEvents()").
+*******************************************************************************/
+int CacheEnableEvents(cache_t *cache, size_t capacity, size_func_t data_size);
+
+
+/*******************************************************************************
+Description:     	Moves up to 'n' of the oldest events of "cache" to
+					'events'.
+Return value:    	Number of events moved, 0 if events are not enabled.
+Time Complexity: 	O(n).
+Notes: 			 	Takes no lock of "cache", any number of threads may
+					drain at once (each event goes to one of them).
+*******************************************************************************/
+size_t CacheDrainEvents(cache_t *cache, cache_event_t *events, size_t n);
+
+
+/*******************************************************************************
+Description:     	Returns the number of events of "cache" dropped because
+					the ring was full.
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t CacheDroppedEvents(cache_t *cache);
+
+
+/*******************************************************************************
+Description:		Finds the data mapped to 'key' and makes it the most
+					recently used entry.
+Return value:       Pointer to data in case of hit, otherwise NULL.
+Time complexity:    O(1) average.
+Note:          		Hits take the cache lock shared only (no lock at all when
+					built with CACHE_LF_INDEX), the recency update is buffered
+					and applied in batches, so the LRU order is near-exact
+					rather than exact.
+*******************************************************************************/
 void *CacheGet(cache_t *cache, void *key);
 
+
+/*******************************************************************************
+Description:		Like "CacheGet()", '*version' also gets the version of the
+					entry (0 on a miss). Every write of any entry stamps it
+					with a new version, larger than all before.
+Return value:       Pointer to data in case of hit, otherwise NULL.
+Time complexity:    O(1) average.
+Note:          		Pass the version to "CacheCompareAndSet()" to update the
+					entry only if nobody else did meanwhile.
+*******************************************************************************/
+void *CacheGetVersioned(cache_t *cache, void *key, uint64_t *version);
+
+
+/*******************************************************************************
+Description:		Like "CacheGet()", but instead of returning the data of
+					'key' calls "visit_func" with the entry's key and data
+					while they are guaranteed not to be released, e.g. to take
+					a reference to owned data.
+Return value:       0 on hit, 1 on miss.
+Time complexity:    O(1) average.
+Note:          		"visit_func" runs outside the cache locks but must be
+					short, it holds back reclamation of retired entries. Its
+					return value is ignored.
+*******************************************************************************/
+int CacheVisit(cache_t *cache, void *key, cache_scan_func_t visit_func,
+														void *user_params);
+
+
+/*******************************************************************************
+Description:		Pins the data of 'key': while the returned handle is held
+					the data is not released, even if the entry is replaced,
+					evicted or removed meanwhile (it then leaves the index and
+					the LRU list right away, only its data stays until the
+					last handle is released). Lets a caller read a large value
+					straight from cache memory, without copies or locks.
+Return value:       Handle in case of hit, otherwise NULL.
+Time complexity:    O(1) average.
+Note:          		Every handle must be passed to "CacheRelease()", before
+					"CacheDestroy()" at the latest. A handle keeps the data it
+					pinned, a later "CacheSet()" of the key is not seen
+					through it.
+*******************************************************************************/
+cache_handle_t *CacheAcquire(cache_t *cache, void *key);
+
+
+/*******************************************************************************
+Description:		Returns the data pinned by 'handle'.
+Time complexity:    O(1).
+*******************************************************************************/
+void *CacheHandleData(const cache_handle_t *handle);
+
+
+/*******************************************************************************
+Description:		Drops 'handle'. The last handle of data that already left
+					the cache releases it (see "CacheSetRelease()").
+Time complexity:    O(1).
+Note:          		May be called from any thread.
+*******************************************************************************/
+void CacheRelease(cache_t *cache, cache_handle_t *handle);
+
+
+/*******************************************************************************
+Description:     	Calls "scan_func" on the entries of a bounded part of
+					"cache", about 'count' index buckets, starting at 'cursor'
+					(0 starts a new scan), until fail. Lets a dump or an audit
+					run in small steps between regular traffic.
+Return value:     	Cursor to pass to the next call, 0 once the scan is done
+					or failed.
+Time complexity:  	O(count) per call, empty buckets are skipped in bulk.
+Notes:            	Hits go on during a call, writers wait for it. Entries
+					present during the whole scan are visited at least once,
+					entries set or evicted meanwhile may or may not be. The
+					scan does not change the LRU order.
+					"scan_func" must not call back into "cache".
+*******************************************************************************/
+size_t CacheScan(cache_t *cache, size_t cursor, size_t count,
+							cache_scan_func_t scan_func, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Maps 'key' to 'data', replacing the data of an existing key.
+					When the cache is full the least recently used entry is
+					evicted.
+Time Complexity: 	O(1) average.
+Notes: 			 	Undefined behaviour if cache, key or data are invalid
+					pointers.
+*******************************************************************************/
 void CacheSet(cache_t *cache, void *key , void *data);
 
 
+/*******************************************************************************
+Description:     	Like "CacheSet()", the entry expires 'ttl_ms' milliseconds
+					later (0 never expires). An expired entry is a miss for
+					all functions, it is deleted by the maintenance thread
+					(see "CacheStartMaintenance()"), or otherwise stays until
+					it is evicted or set again.
+Time Complexity: 	O(1) average.
+Notes: 			 	Expiry is checked against a coarse clock, an entry may
+					live a few milliseconds longer.
+*******************************************************************************/
+void CacheSetWithTTL(cache_t *cache, void *key, void *data,
+												unsigned long ttl_ms);
+
+
+/*******************************************************************************
+Description:     	Like "CacheSet()", the entry is also tagged with the
+					'n_tags' ids of 'tags' (e.g. ids of the upstream objects
+					it is derived from) so "CacheInvalidateTag()" finds it.
+					The tags of a key are the ones of its last write, a plain
+					"CacheSet()" or "CacheSetWithTTL()" leaves it untagged,
+					"CacheCompareAndSet()" keeps its tags.
+Time Complexity: 	O(n_tags) average.
+Notes: 			 	An entry that can't be tagged for lack of memory is not
+					stored, it would outlive an invalidation. A tagged entry
+					does not go down to a tier when evicted.
+*******************************************************************************/
+void CacheSetTagged(cache_t *cache, void *key, void *data,
+									const size_t *tags, size_t n_tags);
+
+
+/*******************************************************************************
+Description:     	Like "CacheSet()", under CACHE_POLICY_GDSF the entry is
+					weighted by its 'cost' (e.g. the time it takes to compute
+					the data again) per byte of its 'size'. Plain writes cost
+					1 and have size 1, "CacheCompareAndSet()" keeps the
+					weight of the entry.
+Time Complexity: 	O(log n).
+Notes: 			 	'cost' and 'size' are ignored under the other policies.
+*******************************************************************************/
+void CacheSetWithCost(cache_t *cache, void *key, void *data, double cost,
+															size_t size);
+
+
+/*******************************************************************************
+Description:     	Removes every entry of "cache" tagged with 'tag' (see
+					"CacheSetTagged()"). Owned keys and data are released once
+					no reader can see them.
+Return value:    	Number of entries removed.
+Time Complexity: 	O(removed entries * their tags) average, an entry leaving
+					the cache in any way drops its tags in O(its tags).
+*******************************************************************************/
+size_t CacheInvalidateTag(cache_t *cache, size_t tag);
+
+
+/*******************************************************************************
+Description:     	Maps 'key' to 'new_data' only if the entry of 'key' still
+					has 'expected_version' (as read by "CacheGetVersioned()"),
+					or, with 0 'expected_version', only if there is no entry.
+					Check and update happen atomically, so read-modify-write
+					cycles of concurrent writers retry instead of taking an
+					external lock.
+Return value:    	0 if the data was replaced, otherwise 1 (the entry changed
+					or was evicted meanwhile, or no memory).
+Time Complexity: 	O(1) average.
+Notes: 			 	On failure 'key' and 'new_data' stay with the caller, even
+					when the cache owns its entries.
+*******************************************************************************/
+int CacheCompareAndSet(cache_t *cache, void *key, uint64_t expected_version,
+															void *new_data);
+
+
+/*******************************************************************************
+Description:     	Removes the entry of 'key' (from the tier too, if one is
+					attached). Owned key and data are released once no reader
+					can see them.
+Return value:    	0 if an entry was removed, otherwise 1.
+Time Complexity: 	O(1) average.
+*******************************************************************************/
+int CacheRemove(cache_t *cache, const void *key);
+
+
 
 
 
@@ -0,0 +1,103 @@
+#ifndef __CACHE_CLIENT_H__
+#define __CACHE_CLIENT_H__
+
+#include <stddef.h>    /* size_t        */
+
+
+typedef struct cache_client cache_client_t;
+
+
+/******************************************************************************
+Description:     	Creates a client for a fleet of cache servers speaking the
+					memcached text protocol over Unix sockets. Keys are spread
+					over the nodes with weighted rendezvous hashing: adding or
+					removing a node only moves the keys that node gains or
+					loses.
+Return value:    	Pointer to client in case of success, otherwise NULL.
+Time Complexity: 	O(1).
+Note:            	Should call "ClientDestroy()" at end of use.
+					A client is not thread safe, use one per thread.
+******************************************************************************/
+cache_client_t *ClientCreate(void);
+
+
+/******************************************************************************
+Description:     	Closes all connections and deletes "client" from memory.
+Time Complexity: 	O(nodes).
+Notes:           	Undefined behaviour if client is NULL.
+*******************************************************************************/
+void ClientDestroy(cache_client_t *client);
+
+
+/*******************************************************************************
+Description:     	Adds the server listening on the Unix socket 'path' with
+					'weight' (relative share of the keys, 0 is taken as 1).
+					The connection is opened on first use.
+Return value:    	0 in case of success otherwise 1 (already a node, path too
+					long or no memory).
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+int ClientAddNode(cache_client_t *client, const char *path, unsigned weight);
+
+
+/*******************************************************************************
+Description:     	Removes the node added with 'path', its keys move to the
+					remaining nodes.
+Return value:    	0 in case of success otherwise 1 (no such node).
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+int ClientRemoveNode(cache_client_t *client, const char *path);
+
+
+/*******************************************************************************
+Description:     	Returns the path of the node 'key' maps to, NULL if there
+					are no nodes.
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+const char *ClientNodeFor(const cache_client_t *client, const char *key);
+
+
+/*******************************************************************************
+Description:     	Stores 'len' bytes of 'val' under 'key' on its node.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(nodes) + one round trip.
+Notes: 			 	Keys are at most 250 bytes without spaces or control
+					characters, as in memcached.
+*******************************************************************************/
+int ClientSet(cache_client_t *client, const char *key, const void *val,
+																size_t len);
+
+
+/*******************************************************************************
+Description:     	Fetches the value of 'key' from its node, '*len' gets its
+					length.
+Return value:    	malloc'd copy of the value in case of hit, otherwise NULL.
+Time Complexity: 	O(nodes) + one round trip.
+Notes: 			 	The caller releases the value with free().
+*******************************************************************************/
+void *ClientGet(cache_client_t *client, const char *key, size_t *len);
+
+
+/*******************************************************************************
+Description:     	Fetches 'n' keys at once. Keys are grouped by node, one
+					request per node is sent to all nodes before any reply is
+					read, so the round trips overlap.
+					'vals[i]' and 'lens[i]' get the value of 'keys[i]' (NULL
+					and 0 on a miss).
+Return value:    	Number of hits.
+Time Complexity: 	O(n * nodes) + one round trip.
+Notes: 			 	The caller releases the values with free().
+*******************************************************************************/
+size_t ClientMultiGet(cache_client_t *client, const char **keys, size_t n,
+												void **vals, size_t *lens);
+
+
+/*******************************************************************************
+Description:     	Deletes 'key' from its node.
+Return value:    	0 if it was deleted, 1 if it was not found or on failure.
+Time Complexity: 	O(nodes) + one round trip.
+*******************************************************************************/
+int ClientDelete(cache_client_t *client, const char *key);
+
+
+#endif    /*__CACHE_CLIENT_H__*/
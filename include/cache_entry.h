@@ -0,0 +1,69 @@
+#ifndef __CACHE_ENTRY_H__
+#define __CACHE_ENTRY_H__
+
+#include <stddef.h>    /* size_t         */
+#include <stdint.h>    /* uint64_t       */
+
+#include "ilist.h"     /* iitr_t         */
+#include "cache.h"     /* cache_handle_t */
+
+/*
+ * The entry of a cache_t, shared by cache.c with the modules it is built of
+ * (cache_space.c, cache_policy.c, cache_write_back.c). Not part of the
+ * cache's interface.
+ */
+
+/*'dirty_pos' of an entry being flushed, 'heap_pos' of one out of the heap*/
+#define NOT_LISTED ((size_t)-1)
+
+
+/*
+ * The data of an entry, a handle of "CacheAcquire()" points to it. The entry
+ * holds one reference and every handle another one, the data is released
+ * with the last of them. New data gets a new value, handles keep the old one.
+ * 'stranded' links a replaced value the epoch had no room to retire.
+ */
+struct cache_handle
+{
+	void *data;
+	size_t refs;
+	struct cache_handle *stranded;
+};
+
+/*
+ * 'itr' is ILIST_END once the entry left the LRU list of 'space'. 'version'
+ * is stamped from the cache's 'last_version' by every write, it never
+ * repeats. 'expires' is a "NowMs()" time, 0 if the entry never expires.
+ * A 'dirty' entry is at 'dirty_pos' of the write back's list, or being
+ * flushed, it is not evicted either way. One deleted while it is flushed is
+ * retired by the flush. 'members' links it into the lists
+ * of its tags, they are only touched under both locks. A 'frequent' entry
+ * is in T2 of ARC rather than in the list of its namespace. Under GDSF the
+ * entry is in no list but at 'heap_pos' of the heap, NOT_LISTED once it
+ * left it, its 'priority' is the clock when it was last used plus 'uses'
+ * times 'weight', its cost per byte. 'stranded' links a deleted entry the
+ * epoch had no room to retire.
+ */
+typedef struct DataAndItr
+{
+	void *key;
+	cache_handle_t *value;
+	uint64_t version;
+	uint64_t expires;
+	struct space *space;
+	iitr_t itr;
+	int dirty;
+	int frequent;
+	size_t dirty_pos;
+	struct member *members;
+	size_t n_members;
+	struct DataAndItr *stranded;
+	double weight;
+	double priority;
+	size_t uses;
+	size_t heap_pos;
+
+}data_and_itr_t;
+
+
+#endif    /*__CACHE_ENTRY_H__*/
@@ -0,0 +1,138 @@
+#ifndef __CACHE_POLICY_H__
+#define __CACHE_POLICY_H__
+
+#include <stddef.h>      /* size_t           */
+
+#include "aux_funcs.h"   /* action_func_t    */
+#include "hash_t.h"      /* hash_func_t      */
+#include "cache.h"       /* cache_policy_t   */
+#include "cache_entry.h" /* data_and_itr_t   */
+#include "cache_space.h" /* space_t          */
+
+/*
+ * The eviction policy of a cache_t, see "CacheSetPolicy()": the order its
+ * entries are kept in and the victim it picks. Under LRU and ARC an entry is
+ * in the list of its namespace, under ARC the ones hit again are in T2
+ * instead. Under GDSF the entries are in a heap, but for the dirty ones,
+ * which wait outside it until they are flushed. Internal to the cache, all
+ * functions but "PolicyCreate()" are called under the lock of the lists.
+ */
+typedef struct policy policy_t;
+
+
+/*******************************************************************************
+Description:     	Creates a policy of kind 'kind' for a cache of 'capacity'
+					entries, ARC remembers evicted keys in an index of
+					'index_size' buckets, hashed by "hash_func".
+Return value:    	Pointer to policy in case of success, otherwise NULL.
+Time Complexity: 	O(capacity + index_size).
+Notes:           	Should call "PolicyDestroy()" at end of use.
+*******************************************************************************/
+policy_t *PolicyCreate(cache_policy_t kind, size_t capacity,
+								size_t index_size, hash_func_t hash_func);
+
+
+/*******************************************************************************
+Description:     	Deletes a policy, "free_entry" is called for the entries it
+					holds outside the lists of the namespaces (T2, the heap).
+Time Complexity: 	O(n).
+*******************************************************************************/
+void PolicyDestroy(policy_t *policy, action_func_t free_entry,
+															void *user_params);
+
+
+/*******************************************************************************
+Description:     	Returns the kind of "policy".
+Time Complexity: 	O(1).
+*******************************************************************************/
+cache_policy_t PolicyKind(const policy_t *policy);
+
+
+/*******************************************************************************
+Description:     	Makes room for one more entry, so "PolicyInsert()" never
+					fails halfway through a write.
+Return value:    	0 in case of success, 1 if there is no memory for it.
+Time Complexity: 	O(1) amortized.
+*******************************************************************************/
+int PolicyReserve(policy_t *policy);
+
+
+/*******************************************************************************
+Description:     	Records a hit on 'entry': it moves to the MRU end, under
+					ARC from T1 to T2 (it stays in T1 if T2 has no room for
+					it), under GDSF its priority rises.
+Time Complexity: 	O(1), O(log n) under GDSF.
+Notes:           	An entry that left the policy is left alone.
+*******************************************************************************/
+void PolicyHit(policy_t *policy, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Prepares a new 'entry' before a victim makes room for it.
+					Under ARC a ghost of its key moves the target of T1 towards
+					the list the key was evicted from, by more the smaller
+					that list's ghosts are, and 'entry' goes to T2.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void PolicyAdmit(policy_t *policy, data_and_itr_t *entry, size_t limit);
+
+
+/*******************************************************************************
+Description:     	Inserts a prepared 'entry' at the MRU end of its list, or
+					into the heap.
+Return value:    	0 in case of success, 1 if its list has no node for it.
+Time Complexity: 	O(1), O(log n) under GDSF.
+*******************************************************************************/
+int PolicyInsert(policy_t *policy, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Takes 'entry' out of its list or the heap.
+Time Complexity: 	O(1), O(log n) under GDSF.
+*******************************************************************************/
+void PolicyRemove(policy_t *policy, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Under GDSF takes an 'entry' just marked dirty out of the
+					heap, it can't be evicted until "PolicyClean()". Nothing
+					under LRU and ARC, or if it is out already.
+Time Complexity: 	O(1), O(log n) under GDSF.
+*******************************************************************************/
+void PolicyDirty(policy_t *policy, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Under GDSF puts an 'entry' flushed clean back into the
+					heap, with a priority counted from the clock of now.
+					Nothing under LRU and ARC.
+Time Complexity: 	O(1), O(log n) under GDSF.
+*******************************************************************************/
+void PolicyClean(policy_t *policy, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Takes the victim of 'space' out of its list or the heap:
+					its least recently used entry that is not dirty, from the
+					list ARC picks, or under GDSF the root of the heap, the
+					entry of the lowest priority. Dirty entries in the way of
+					a list go to the MRU end, they were just written anyway.
+					Under ARC the victim leaves a ghost.
+Return value:    	The victim, NULL if none was found within a few entries.
+Time Complexity: 	O(1), O(log n) under GDSF.
+Notes:           	The victim's eviction is counted in 'space', the entry
+					itself is left to the caller.
+*******************************************************************************/
+data_and_itr_t *PolicyPopVictim(policy_t *policy, space_t *space,
+																size_t limit);
+
+
+/*******************************************************************************
+Description:     	Under ARC, keeps T1 and B1 within 'limit', and all four
+					lists within twice 'limit'. Called once an entry came in.
+Time Complexity: 	O(ghosts dropped).
+*******************************************************************************/
+void PolicyTrim(policy_t *policy, const space_t *space, size_t limit);
+
+
+#endif    /*__CACHE_POLICY_H__*/
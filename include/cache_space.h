@@ -0,0 +1,72 @@
+#ifndef __CACHE_SPACE_H__
+#define __CACHE_SPACE_H__
+
+#include <stddef.h>    /* size_t           */
+
+#include "ilist.h"     /* ilist_t          */
+#include "cache.h"     /* cache_ns_stats_t */
+
+/*
+ * Namespaces of a cache_t, see "CacheAddNamespace()". Internal to the cache,
+ * callers hold its locks.
+ */
+
+/*
+ * Its entries share the index with all others but have an LRU list of their
+ * own. 'size' and the list are guarded like the cache's, the counters are
+ * updated with atomics.
+ */
+typedef struct space
+{
+	ilist_t *list;			/*LRU first, one array of 32-bit linked nodes*/
+	size_t size;
+	size_t reserved;		/*not evicted below it for other namespaces*/
+	size_t quota;			/*0 if only the cache's limit applies*/
+	size_t hits;
+	size_t misses;
+	size_t sets;
+	size_t evictions;
+
+}space_t;
+
+
+/*******************************************************************************
+Description:     	Creates an empty namespace whose list starts with room for
+					'capacity' entries.
+Return value:    	Pointer to namespace in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+Notes:           	Should call "SpaceDestroy()" at end of use.
+*******************************************************************************/
+space_t *SpaceCreate(size_t capacity, size_t reserved, size_t quota);
+
+
+/*******************************************************************************
+Description:     	Deletes a namespace, its entries are not freed.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void SpaceDestroy(space_t *space);
+
+
+/*******************************************************************************
+Description:     	Picks the namespace to evict from for 'space' (NULL if
+					none is inserted): 'space' itself once it reached its quota,
+					or while it has entries if 'own_first', otherwise the
+					namespace most over its share, i.e. its reservation plus an
+					equal part of what 'limit' leaves unreserved.
+Return value:    	The namespace to evict from.
+Time Complexity: 	O(n_spaces).
+Notes:           	Namespaces at their reservation are only taken if all are.
+*******************************************************************************/
+space_t *SpaceVictim(space_t *const *spaces, size_t n_spaces, size_t limit,
+							size_t reserved, space_t *space, int own_first);
+
+
+/*******************************************************************************
+Description:     	Fills 'stats' with the counters of "space".
+Time Complexity: 	O(1).
+Notes:           	'entries' is read as is, call under the lock of the lists.
+*******************************************************************************/
+void SpaceStats(const space_t *space, cache_ns_stats_t *stats);
+
+
+#endif    /*__CACHE_SPACE_H__*/
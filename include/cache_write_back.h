@@ -0,0 +1,144 @@
+#ifndef __CACHE_WRITE_BACK_H__
+#define __CACHE_WRITE_BACK_H__
+
+#include <stddef.h>      /* size_t             */
+
+#include "aux_funcs.h"   /* action_func_t      */
+#include "cache.h"       /* cache_flush_func_t */
+#include "cache_entry.h" /* data_and_itr_t     */
+
+/*
+ * The write-back state of a cache_t, see "CacheSetWriteBack()": the entries
+ * written since the last flush, and the flush in progress. Internal to the
+ * cache, the list is guarded by the cache's lock of the lists like the
+ * 'dirty' flags of the entries (set under both of its locks).
+ *
+ * A flush is a round of "WriteBackBegin()", "WriteBackTake()" (under the
+ * lock of the lists), "WriteBackWrite()" (under no lock), "WriteBackPut()"
+ * (under both locks) and "WriteBackEnd()", one round runs at a time.
+ */
+typedef struct write_back write_back_t;
+
+
+/*******************************************************************************
+Description:     	Creates the write-back state of a cache that writes its
+					entries through "flush" in batches of 'batch', at least
+					every 'interval_ms' milliseconds.
+Return value:    	Pointer to write_back in case of success, otherwise NULL.
+Time Complexity: 	O(1).
+Notes:           	Should call "WriteBackDestroy()" at end of use.
+*******************************************************************************/
+write_back_t *WriteBackCreate(cache_flush_func_t flush, size_t batch,
+								unsigned interval_ms, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Deletes "wb", entries still dirty are not flushed.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void WriteBackDestroy(write_back_t *wb);
+
+
+/*******************************************************************************
+Description:     	Makes room to list one more dirty entry, called before a
+					write changes anything. While a flush runs it also keeps
+					room for the entries it took, "WriteBackPut()" may list
+					them again.
+Return value:    	0 in case of success, 1 if there is no memory for it.
+Time Complexity: 	O(1) amortized.
+*******************************************************************************/
+int WriteBackReserve(write_back_t *wb);
+
+
+/*******************************************************************************
+Description:     	Lists a written 'entry' for the next flush, once however
+					often it is written.
+Return value:    	1 if the list just reached a full batch, otherwise 0.
+Time Complexity: 	O(1).
+Notes:           	"WriteBackReserve()" made room for it.
+*******************************************************************************/
+int WriteBackMark(write_back_t *wb, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Drops the write of a deleted 'entry', it is not flushed.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void WriteBackUnlist(write_back_t *wb, data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Hands a deleted 'entry' that is being flushed over to the
+					flush, "WriteBackPut()" retires it once it was written.
+Return value:    	1 if the flush took it, 0 if the caller retires it.
+Time Complexity: 	O(1).
+*******************************************************************************/
+int WriteBackOrphan(data_and_itr_t *entry);
+
+
+/*******************************************************************************
+Description:     	Returns 1 if a full batch is listed, otherwise 0.
+Time Complexity: 	O(1).
+*******************************************************************************/
+int WriteBackIsFull(const write_back_t *wb);
+
+
+/*******************************************************************************
+Description:     	Returns 1 if a flush is due: a full batch, a dirty entry
+					older than the interval, or dirty entries while
+					'over_limit'. Otherwise 0.
+Time Complexity: 	O(1).
+*******************************************************************************/
+int WriteBackIsDue(const write_back_t *wb, int over_limit);
+
+
+/*******************************************************************************
+Description:     	Starts a flush, waits for the one in progress to end.
+Time Complexity: 	O(1).
+Notes:           	Called before any lock of the cache is taken.
+*******************************************************************************/
+void WriteBackBegin(write_back_t *wb);
+
+
+/*******************************************************************************
+Description:     	Takes the listed entries over to the flush, pinning their
+					data like a handle. The list stays as it is on failure.
+Return value:    	0 in case of success, 1 if there is no memory for it.
+Time Complexity: 	O(n).
+*******************************************************************************/
+int WriteBackTake(write_back_t *wb);
+
+
+/*******************************************************************************
+Description:     	Writes the entries taken through the flush function, in
+					batches. A failed batch stops the flush, the backing store
+					is likely down.
+Return value:    	0 in case of success, 1 if a batch failed.
+Time Complexity: 	O(n).
+*******************************************************************************/
+int WriteBackWrite(write_back_t *wb);
+
+
+/*******************************************************************************
+Description:     	Clears the entries written and calls "clean" for them,
+					those set again meanwhile and those not written stay
+					listed. "retire" is called for the entries deleted
+					meanwhile.
+Time Complexity: 	O(n).
+Notes:           	Never fails and allocates nothing, no dirty entry is lost.
+*******************************************************************************/
+void WriteBackPut(write_back_t *wb, action_func_t retire, action_func_t clean,
+															void *user_params);
+
+
+/*******************************************************************************
+Description:     	Ends a flush, "unpin" is called for the data of every
+					entry taken (a cache_handle_t).
+Time Complexity: 	O(n).
+Notes:           	Called once the locks of the cache are let go, also after
+					a failed "WriteBackTake()".
+*******************************************************************************/
+void WriteBackEnd(write_back_t *wb, action_func_t unpin, void *user_params);
+
+
+#endif    /*__CACHE_WRITE_BACK_H__*/
@@ -0,0 +1,165 @@
+#ifndef __CORE_CACHE_H__
+#define __CORE_CACHE_H__
+
+#include <stddef.h>    /* size_t        */
+
+#include "aux_funcs.h" /* is_match_func_t */
+#include "hash_t.h"    /* hash_func_t   */
+
+
+typedef struct core_cache core_cache_t;
+
+
+/******************************************************************************
+Description:     	Completes a request of "CoreCacheGet()", "CoreCacheSet()"
+					or "CoreCacheRemove()": 'data' is the data found by a get
+					(NULL on a miss), the data stored by a set (NULL if it was
+					not stored) and NULL for a remove. 'data' stays valid until
+					"done" returns, even if the owner let the entry go
+					meanwhile.
+*******************************************************************************/
+typedef void (*core_done_func_t)(void *data, void *user_params);
+
+
+/******************************************************************************
+Description:     	Called on the owning core once the cache lets go of a key
+					and its data. Either of them is NULL when only the other
+					one is let go (a key set again, or data replaced).
+*******************************************************************************/
+typedef void (*core_release_func_t)(void *key, void *data, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Creates a shared-nothing LRU cache of 'capacity' entries run
+					by 'n_cores' threads. Each core owns the keys that hash to
+					it, with an index, an LRU list and an entry arena of its
+					own, and is the only thread that ever touches them. A core
+					asks the owner of any other key through a lock-free queue
+					it alone writes to, and gets the answer back the same way;
+					requests and answers travel in batches.
+					'queue_len' bounds the requests a core has in flight to
+					each other core.
+Return value:    	Pointer to cache in case of success, otherwise NULL.
+Time Complexity: 	O(n_cores^2).
+Note:            	Should call "CoreCacheDestroy()" at end of use.
+					Nothing of a core is allocated until its thread calls
+					"CoreCacheAttach()".
+*******************************************************************************/
+core_cache_t *CoreCacheCreate(size_t n_cores, size_t capacity,
+				hash_func_t hash_func, is_match_func_t match, size_t queue_len);
+
+
+/*******************************************************************************
+Description:     	Deletes a cache pointed to by "cache" from memory, requests
+					still queued are dropped without completing.
+Time Complexity: 	O(n).
+Notes:           	Call once every core thread stopped using it. Keys and
+					data are released if "CoreCacheSetRelease()" was called.
+*******************************************************************************/
+void CoreCacheDestroy(core_cache_t *cache);
+
+
+/*******************************************************************************
+Description:     	Makes "cache" own its keys and data: "release" is called
+					on the owning core when an entry is evicted, removed or
+					replaced, and by "CoreCacheDestroy()".
+Time Complexity: 	O(1).
+Notes: 			 	Call before any core attaches.
+					Data that was let go is released once every core
+					completed the answers the owner sent it until then, one
+					of which may carry the data: by a later request or
+					"CoreCachePoll()" of the owner, after a poll of each
+					of the other cores.
+*******************************************************************************/
+void CoreCacheSetRelease(core_cache_t *cache, core_release_func_t release,
+															void *user_params);
+
+
+/*******************************************************************************
+Description:     	Makes the calling thread core 'core' of "cache": the thread
+					is pinned to a CPU, when there are enough of them, and the
+					partition of the core is allocated by it, so that its
+					memory is placed on the thread's own NUMA node. Returns
+					once every core attached.
+Return value:    	0 in case of success, 1 if any core failed to allocate its
+					partition (every core gets 1 then).
+Time Complexity: 	O(capacity / n_cores + n_cores).
+Notes: 			 	Each of the 'n_cores' threads calls it exactly once,
+					requests may be made once it returned.
+*******************************************************************************/
+int CoreCacheAttach(core_cache_t *cache, size_t core);
+
+
+/*******************************************************************************
+Description:     	Returns the core that owns 'key'.
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t CoreCacheOwner(const core_cache_t *cache, const void *key);
+
+
+/*******************************************************************************
+Description:     	Finds the data mapped to 'key' and makes it the most
+					recently used of its core. "done" is called right away if
+					'core' owns 'key', otherwise by a later
+					"CoreCachePoll()" of 'core'.
+Return value:    	0 in case of success, 1 if 'core' already has 'queue_len'
+					requests in flight to the owner, or owns 'key' and has no
+					memory to defer a release (poll and try again).
+Time Complexity: 	O(1) average.
+Notes: 			 	Only called by the thread of 'core'.
+*******************************************************************************/
+int CoreCacheGet(core_cache_t *cache, size_t core, const void *key,
+									core_done_func_t done, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Maps 'key' to 'data' as the most recently used entry of its
+					core, evicting the core's least recently used entry if it
+					is full. "done" (may be NULL) is called as by
+					"CoreCacheGet()".
+Return value:    	0 in case of success, 1 if 'core' already has 'queue_len'
+					requests in flight to the owner, or owns 'key' and has no
+					memory to defer a release (poll and try again).
+Time Complexity: 	O(1) average.
+Notes: 			 	Only called by the thread of 'core'. 'key' and 'data' are
+					read by the owner, they must stay valid until then.
+*******************************************************************************/
+int CoreCacheSet(core_cache_t *cache, size_t core, void *key, void *data,
+									core_done_func_t done, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Removes 'key'. "done" (may be NULL) is called as by
+					"CoreCacheGet()".
+Return value:    	0 in case of success, 1 if 'core' already has 'queue_len'
+					requests in flight to the owner, or owns 'key' and has no
+					memory to defer a release (poll and try again).
+Time Complexity: 	O(1) average.
+Notes: 			 	Only called by the thread of 'core'.
+*******************************************************************************/
+int CoreCacheRemove(core_cache_t *cache, size_t core, const void *key,
+									core_done_func_t done, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Runs a round of core 'core': sends the requests it made
+					since the last round, serves the requests other cores sent
+					it and completes the answers it got back.
+Return value:    	Number of requests served and answers completed.
+Time Complexity: 	O(n_cores + requests and answers handled).
+Notes: 			 	Only called by the thread of 'core', regularly (e.g. once
+					per turn of its event loop): the other cores get no
+					answer from it in between.
+*******************************************************************************/
+size_t CoreCachePoll(core_cache_t *cache, size_t core);
+
+
+/*******************************************************************************
+Description:     	Returns the number of entries owned by core 'core'.
+Time Complexity: 	O(1).
+Notes: 			 	Only called by the thread of 'core'.
+*******************************************************************************/
+size_t CoreCacheSize(const core_cache_t *cache, size_t core);
+
+
+#endif    /*__CORE_CACHE_H__*/
@@ -0,0 +1,74 @@
+#ifndef __CTIER_H__
+#define __CTIER_H__
+
+#include <stddef.h>    /* size_t          */
+
+#include "aux_funcs.h" /* is_match_func_t */
+#include "hash_t.h"    /* hash_func_t     */
+
+
+typedef struct ctier ctier_t;
+
+
+/******************************************************************************
+Description:     	Returns the number of bytes of the flat object 'data'
+					(a key or a value), so it can be copied byte by byte.
+*******************************************************************************/
+typedef size_t (*size_func_t)(const void *data);
+
+
+/******************************************************************************
+Description:     	Creates a compressed in-memory tier of 'bytes' bytes.
+					Entries are compressed and packed back to back in a
+					circular area, the oldest entries are dropped when it
+					wraps around. Keys are indexed with "hash_func" and
+					"match", 'key_size' and 'val_size' give the length of
+					keys and values.
+Return value:    	Pointer to tier in case of success, otherwise NULL.
+Time Complexity: 	O(bytes) + system call complexity.
+Note:            	Should call "CTierDestroy()" at end of use.
+					Keys and values must be flat (no pointers inside).
+******************************************************************************/
+ctier_t *CTierCreate(size_t bytes, hash_func_t hash_func, is_match_func_t match,
+									size_func_t key_size, size_func_t val_size);
+
+
+/******************************************************************************
+Description:     	Deletes a tier pointed to by "tier" from memory.
+Time Complexity: 	O(n).
+Notes:           	Undefined behaviour if tier is NULL.
+*******************************************************************************/
+void CTierDestroy(ctier_t *tier);
+
+
+/*******************************************************************************
+Description:     	Compresses a copy of 'key' and 'data' into the tier,
+					replacing an older copy of 'key'. The caller keeps both.
+Return value:    	0 in case of success otherwise 1 (entry dropped).
+Time Complexity: 	O(key and value size) + O(dropped entries).
+Notes: 			 	Matches "tier_put_func_t" so it can back a cache_t.
+					Undefined behaviour if tier, key or data are invalid
+					pointers.
+*******************************************************************************/
+int CTierPut(void *tier, const void *key, const void *data);
+
+
+/*******************************************************************************
+Description:     	Removes 'key' from the tier and returns a decompressed copy
+					of its value. '*stored_key' gets a copy of the stored key.
+Return value:    	Pointer to value in case of hit, otherwise NULL.
+Time Complexity: 	O(key and value size).
+Notes: 			 	Matches "tier_take_func_t" so it can back a cache_t.
+					The caller owns both copies and releases them with free().
+*******************************************************************************/
+void *CTierTake(void *tier, const void *key, void **stored_key);
+
+
+/*******************************************************************************
+Description:     	Returns number of entries in "tier".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t CTierCount(ctier_t *tier);
+
+
+#endif    /*__CTIER_H__*/
@@ -0,0 +1,95 @@
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+#include <stddef.h>    /* size_t        */
+
+#include "aux_funcs.h" /* action_func_t */
+
+
+typedef struct epoch epoch_t;
+
+
+/*******************************************************************************
+Description:     	Creates an epoch based reclamation domain. Readers mark
+					their critical sections with "EpochEnter()"/"EpochExit()",
+					writers hand unlinked memory to "EpochRetire()" and it is
+					freed only after every reader that could still see it has
+					left its critical section.
+Return value:    	Pointer to domain in case of success, otherwise NULL.
+Time Complexity: 	O(1) + system call complexity.
+Note:            	Should call "EpochDestroy()" at end of use.
+*******************************************************************************/
+epoch_t *EpochCreate(void);
+
+
+/*******************************************************************************
+Description:     	Frees every retired pointer and deletes the domain.
+Time Complexity: 	O(retired + threads).
+Notes:           	Undefined behaviour if epoch is NULL or a thread is still
+					inside a critical section.
+*******************************************************************************/
+void EpochDestroy(epoch_t *epoch);
+
+
+/*******************************************************************************
+Description:     	Starts a read-side critical section of the calling thread.
+					Memory reachable at this point stays valid until the
+					matching "EpochExit()". Sections may nest.
+Time Complexity: 	O(1), never blocks (O(threads) the first time a thread
+					uses the domain, and when it alternates between more than
+					16 domains).
+Notes:           	Undefined behaviour if epoch is invalid pointer.
+					A thread that has no memory for its record enters on one
+					shared by such threads, under a lock. Until they all
+					left, nothing retired after the first of them entered is
+					freed.
+*******************************************************************************/
+void EpochEnter(epoch_t *epoch);
+
+
+/*******************************************************************************
+Description:     	Ends the read-side critical section of the calling thread.
+Time Complexity: 	O(1).
+Notes:           	Undefined behaviour without a matching "EpochEnter()".
+*******************************************************************************/
+void EpochExit(epoch_t *epoch);
+
+
+/*******************************************************************************
+Description:     	Schedules "free_func(ptr, user_params)" to run once no
+					reader can hold 'ptr'. 'ptr' must already be unreachable
+					for new readers.
+Return value:    	0 in case of success. Out of memory, and once a small
+					reserve kept by the domain ran out too: 1 if no reader
+					held the epoch back and 'ptr' was freed on the spot,
+					otherwise 2, 'ptr' was not retired and still belongs to
+					the caller.
+Time Complexity: 	O(1) + system call complexity, never waits for readers.
+Notes:           	Must not be called from inside a critical section.
+*******************************************************************************/
+int EpochRetire(epoch_t *epoch, void *ptr, action_func_t free_func,
+															void *user_params);
+
+
+/*******************************************************************************
+Description:     	Moves the global epoch forward if every thread inside a
+					critical section has observed the current one.
+Return value:    	0 if the epoch advanced, 1 if a reader holds it back.
+Time Complexity: 	O(threads).
+*******************************************************************************/
+int EpochAdvance(epoch_t *epoch);
+
+
+/*******************************************************************************
+Description:     	Frees the retired pointers that are two epochs old.
+Return value:    	Number of freed pointers.
+Time Complexity: 	O(freed).
+Notes:           	Callers that need to scrub references to retired memory
+					(for example buffered pointers) do so between
+					"EpochAdvance()" and "EpochReclaim()" while keeping other
+					advancers out.
+*******************************************************************************/
+size_t EpochReclaim(epoch_t *epoch);
+
+
+#endif    /*__EPOCH_H__*/
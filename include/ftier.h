@@ -0,0 +1,79 @@
+#ifndef __FTIER_H__
+#define __FTIER_H__
+
+#include <stddef.h>    /* size_t          */
+
+#include "aux_funcs.h" /* is_match_func_t */
+#include "hash_t.h"    /* hash_func_t     */
+#include "ctier.h"     /* size_func_t     */
+
+
+typedef struct ftier ftier_t;
+
+
+/******************************************************************************
+Description:     	Creates a tier of 'bytes' bytes in the file at 'path'
+					(typically on an SSD). The file is split into regions that
+					are filled in memory and written out whole by a background
+					thread, the oldest region is reclaimed when the log wraps.
+					Up to 'max_entries' keys are indexed in memory by their
+					hash and a hash of their bytes, each region has a Bloom
+					filter so misses do not touch the index or the disk.
+Return value:    	Pointer to tier in case of success, otherwise NULL.
+Time Complexity: 	O(max_entries) + system call complexity.
+Note:            	Should call "FTierDestroy()" at end of use.
+					'path' is created (or truncated) and unlinked right away,
+					its content does not outlive the tier.
+					Keys and values must be flat (no pointers inside).
+******************************************************************************/
+ftier_t *FTierCreate(const char *path, size_t bytes, size_t max_entries,
+						hash_func_t hash_func, is_match_func_t match,
+						size_func_t key_size, size_func_t val_size);
+
+
+/******************************************************************************
+Description:     	Waits for the pending region write, then deletes a tier
+					pointed to by "tier" from memory and closes its file.
+Time Complexity: 	O(1) + system call complexity.
+Notes:           	Undefined behaviour if tier is NULL.
+*******************************************************************************/
+void FTierDestroy(ftier_t *tier);
+
+
+/*******************************************************************************
+Description:     	Appends a copy of 'key' and 'data' to the current region,
+					replacing an older copy of 'key'. The caller keeps both.
+Return value:    	0 in case of success otherwise 1 (entry dropped, with
+					the older copy of 'key').
+Time Complexity: 	O(key and value size). Never waits for the disk: when the
+					current region is full while the previous one is still
+					being written, the entry is dropped. Opening a region
+					rebuilds the index (O(max_entries)) once entries of
+					reclaimed regions clutter it.
+Notes: 			 	Matches "tier_put_func_t" so it can back a cache_t.
+					Undefined behaviour if tier, key or data are invalid
+					pointers.
+*******************************************************************************/
+int FTierPut(void *tier, const void *key, const void *data);
+
+
+/*******************************************************************************
+Description:     	Removes 'key' from the tier and returns a copy of its value.
+					'*stored_key' gets a copy of the stored key.
+Return value:    	Pointer to value in case of hit, otherwise NULL.
+Time Complexity: 	O(key and value size) + one pread() on a hit of a written
+					region, the tier is not locked during the read.
+Notes: 			 	Matches "tier_take_func_t" so it can back a cache_t.
+					The caller owns both copies and releases them with free().
+*******************************************************************************/
+void *FTierTake(void *tier, const void *key, void **stored_key);
+
+
+/*******************************************************************************
+Description:     	Returns number of entries in "tier".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t FTierCount(ftier_t *tier);
+
+
+#endif    /*__FTIER_H__*/
@@ -92,4 +92,45 @@ Notes:            	Undefined behaviour if 'hash' is invalid pointer.
 *******************************************************************************/
 int HashForEach(hash_t *hash, action_func_t action_func, void *user_params);
 
+
+/*******************************************************************************
+Description:  	  	Resumable "HashForEach()": calls "action_func" on the
+					elements of up to 'count' non empty buckets, starting at
+					'cursor' (0 starts a new scan), until fail. Empty buckets
+					are skipped 64 at a time.
+Return value:     	Cursor to pass to the next call, 0 once the scan is done
+					or failed.
+Time complexity:  	O(count) + O(empty buckets / 64).
+Notes:            	The table may change between calls: an element present
+					during the whole scan is visited exactly once (at least
+					once if the table grew meanwhile), elements inserted or
+					removed meanwhile may or may not be.
+					Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+size_t HashScan(hash_t *hash, size_t cursor, size_t count,
+								action_func_t action_func, void *user_params);
+
+
+/*******************************************************************************
+Description:  	  	Starts doubling the number of buckets of "hash". The
+					elements are moved over in small steps by "HashMigrate()",
+					meanwhile all functions work on both tables.
+Return value:     	0 in case of success, otherwise 1 (no memory, or 'hash'
+					is still growing).
+Time complexity:  	O(1) + system call complexity.
+Notes:            	Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+int HashGrow(hash_t *hash);
+
+
+/*******************************************************************************
+Description:  	  	Moves the elements of up to 'buckets' old buckets of a
+					growing "hash" to the new table.
+Return value:     	Number of old buckets left to move, 0 once 'hash' does
+					not grow any more.
+Time complexity:  	O(buckets) average, elements are relinked, not copied.
+Notes:            	Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+size_t HashMigrate(hash_t *hash, size_t buckets);
+
 #endif    /*__HASH_H__*/
@@ -0,0 +1,142 @@
+#ifndef __ILIST_H__
+#define __ILIST_H__
+
+#include <stddef.h>  /* size_t */
+#include <stdint.h>  /* uint32_t */
+
+#include "aux_funcs.h" /* is_match_t,  action_func_t */
+
+typedef struct ilist ilist_t;
+
+/* index of a node in the list's array, only meaningful with its list */
+typedef uint32_t iitr_t;
+
+/* "IListIterEnd()" of every list, never refers to an element */
+#define ILIST_END ((iitr_t)0)
+
+
+/*******************************************************************************
+Description:     	Creates an empty doubly linked list whose nodes live in one
+					array and link to each other by 32-bit indices. Room for
+					'capacity' elements is allocated up front, the array grows
+					when it fills up.
+Return value:    	Pointer to list in case of success, otherwise NULL.
+Time Complexity: 	O(1) + system call complexity.
+Note:            	Should call "IListDestroy()" at end of use.
+					Holds at most UINT32_MAX - 1 elements.
+*******************************************************************************/
+ilist_t *IListCreate(size_t capacity);
+
+
+/*******************************************************************************
+Description:     	Deletes a list pointed by "list" from memory.
+Time Complexity: 	O(1) + system call complexity.
+Notes:           	Undefined behaviour if list is NULL.
+*******************************************************************************/
+void IListDestroy(ilist_t *list);
+
+
+/*******************************************************************************
+Description:     	Insert 'data' before 'where' in list pointed to by 'list'.
+Return value:    	Iterator to inserted data in success otherwise
+					IListIterEnd().
+Time Complexity: 	O(1), amortized when the array grows.
+Notes: 			 	Undefined behaviour if list is invalid pointer,
+          			Undefined behaviour if 'where' is out of list's range.
+*******************************************************************************/
+iitr_t IListInsertBefore(ilist_t *list, iitr_t where, void *data);
+
+
+/*******************************************************************************
+Description:     	Insert 'data' to the end / head of list pointed by 'list'.
+Return value:    	Iterator to inserted data in success otherwise
+					IListIterEnd().
+Time Complexity: 	O(1), amortized when the array grows.
+*******************************************************************************/
+iitr_t IListPushBack(ilist_t *list, void *data);
+iitr_t IListPushFront(ilist_t *list, void *data);
+
+
+/*******************************************************************************
+Description:     	Deletes the element from the list pointed to by "what", its
+					node is recycled by later inserts.
+Return value:    	Iterator to next element.
+Time Complexity: 	O(1).
+Notes:           	Undefined behaviour if "what" is out of lists range or
+                 	is IListIterEnd().
+*******************************************************************************/
+iitr_t IListRemove(ilist_t *list, iitr_t what);
+
+
+/*******************************************************************************
+Description:     	Removes the last / first element of "list".
+Return value:    	Its data.
+Time Complexity: 	O(1).
+Notes:           	Undefined behaviour if "list" is empty.
+*******************************************************************************/
+void *IListPopBack(ilist_t *list);
+void *IListPopFront(ilist_t *list);
+
+
+/*******************************************************************************
+Description:     	Returns number of elements in "list".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t IListSize(const ilist_t *list);
+
+
+/*******************************************************************************
+Description: 		Checks if "list" is empty.
+Return value:   	1 for true, 0 for false.
+Time complexity:  	O(1).
+*******************************************************************************/
+int IListIsEmpty(const ilist_t *list);
+
+
+/*******************************************************************************
+Description:  		Calls "action_func" on the elements in range [from, to)
+					until fail.
+Return value:     	0 for success, otherwise the status of the failed call.
+Time complexity:  	O(n).
+*******************************************************************************/
+int IListForEach(ilist_t *list, iitr_t from, iitr_t to,
+							action_func_t action_func, void *user_params);
+
+
+/*******************************************************************************
+Description:  		Moves the elements in range [src_first, src_last] of
+					"list" before "dest_where".
+Return value:     	Iterator to the last moved element.
+Time complexity:  	O(1).
+Notes:            	Undefined behaviour if "dest_where" is inside the range.
+*******************************************************************************/
+iitr_t IListSplice(ilist_t *list, iitr_t dest_where, iitr_t src_first,
+															iitr_t src_last);
+
+
+/*******************************************************************************
+Description:  		Iterators to the first element / past the last element.
+Time complexity:  	O(1).
+*******************************************************************************/
+iitr_t IListIterBegin(const ilist_t *list);
+iitr_t IListIterEnd(const ilist_t *list);
+
+
+/*******************************************************************************
+Description:  		Iterators to the next / previous element of "itr".
+Time complexity:  	O(1).
+*******************************************************************************/
+iitr_t IListIterNext(const ilist_t *list, iitr_t itr);
+iitr_t IListIterPrev(const ilist_t *list, iitr_t itr);
+
+
+/*******************************************************************************
+Description:  		Gets / sets the data of the element pointed by "itr".
+Time complexity:  	O(1).
+Notes:            	Undefined behaviour if "itr" is IListIterEnd().
+*******************************************************************************/
+void *IListGetData(const ilist_t *list, iitr_t itr);
+void IListSetData(ilist_t *list, iitr_t itr, void *data);
+
+
+#endif    /*__ILIST_H__*/
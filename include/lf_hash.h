@@ -0,0 +1,102 @@
+#ifndef __LF_HASH_H__
+#define __LF_HASH_H__
+
+#include <stdlib.h>    /* size_t        */
+
+#include "aux_funcs.h" /* is_match_func_t */
+#include "hash_t.h"    /* hash_func_t     */
+#include "epoch.h"     /* epoch_t         */
+
+
+typedef struct lf_hash lf_hash_t;
+
+
+/******************************************************************************
+Description:     	Creates a lock-free open addressing hash table for at least
+					'capacity' elements, hashed with "hash_func" and compared
+					with "match".
+Return value:    	Pointer to hash table in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+Note:            	Should call "LFHashDestroy()" at end of use.
+					Values must be at least 2 bytes aligned pointers, the
+					lowest bit is used internally.
+					"hash_func" may return any size_t, the table mixes and
+					masks it itself.
+******************************************************************************/
+lf_hash_t *LFHashCreate(size_t capacity, hash_func_t hash_func,
+												is_match_func_t match);
+
+
+/******************************************************************************
+Description:     	Deletes a hash table pointed to by "hash" from memory.
+Time Complexity: 	O(table size).
+Notes:           	Undefined behaviour if hash is NULL or still in use by
+					another thread.
+*******************************************************************************/
+void LFHashDestroy(lf_hash_t *hash);
+
+
+/*******************************************************************************
+Description:     	Hands tables replaced by a rebuild to "epoch" instead of
+					keeping them until "LFHashDestroy()". Readers must then call
+					"LFHashFind()" inside "EpochEnter()"/"EpochExit()".
+Time Complexity: 	O(1).
+Notes:           	Call before the table is shared between threads.
+*******************************************************************************/
+void LFHashSetEpoch(lf_hash_t *hash, epoch_t *epoch);
+
+
+/*******************************************************************************
+Description:     	Maps 'key' to 'val', replacing the value of an existing key.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(1) average, lock-free except while the table is being
+					rebuilt to drop removed keys.
+Notes: 			 	Undefined behaviour if hash, key or val are invalid pointers.
+*******************************************************************************/
+int LFHashInsert(lf_hash_t *hash, const void *key, void *val);
+
+
+/*******************************************************************************
+Description:     	Deletes the element related to 'key' from hash table.
+Return value:    	The removed value, NULL if 'key' was not found.
+Time Complexity: 	O(1) average.
+Notes               Undefined behaviour if hash or key are invalid pointers.
+*******************************************************************************/
+void *LFHashRemove(lf_hash_t *hash, const void *key);
+
+
+/*******************************************************************************
+Description:		Finds 'val' mapped to 'key'.
+Return value:       Pointer to val in case of success, otherwise NULL.
+Time complexity:    O(1) average, wait-free, never takes a lock.
+Note:          		Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+void *LFHashFind(const lf_hash_t *hash, const void *key);
+
+
+/*******************************************************************************
+Description:  	  	Resumable walk over the table: calls "action_func" on the
+					values of up to 'count' live slots, starting at 'cursor'
+					(0 starts a new scan), until fail.
+Return value:     	Cursor to pass to the next call, 0 once the scan is done
+					or failed.
+Time complexity:  	O(count) + O(dead slots skipped), never takes a lock.
+Notes:            	A rebuild between two calls restarts the walk, so values
+					may be visited more than once. A key present during the
+					whole scan is visited at least once.
+					Call inside "EpochEnter()"/"EpochExit()" when an epoch is
+					set (see "LFHashSetEpoch()").
+*******************************************************************************/
+size_t LFHashScan(const lf_hash_t *hash, size_t cursor, size_t count,
+								action_func_t action_func, void *user_params);
+
+
+/*******************************************************************************
+Description:     	Returns number of elements in "hash".
+Time Complexity: 	O(1).
+Notes:			 	The count may be stale while other threads modify 'hash'.
+*******************************************************************************/
+size_t LFHashSize(const lf_hash_t *hash);
+
+
+#endif    /*__LF_HASH_H__*/
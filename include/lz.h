@@ -0,0 +1,30 @@
+#ifndef __LZ_H__
+#define __LZ_H__
+
+#include <stddef.h>    /* size_t        */
+
+
+/*******************************************************************************
+Description:     	Compresses 'in_len' bytes of 'in' into 'out' with a fast
+					LZ77 (LZF style) coder.
+Return value:    	Number of bytes written to 'out', 0 if the result does not
+					fit in 'out_cap' bytes (the data does not compress).
+Time Complexity: 	O(in_len).
+Notes: 			 	Undefined behaviour if in or out are invalid pointers or
+					overlap.
+*******************************************************************************/
+size_t LZCompress(const void *in, size_t in_len, void *out, size_t out_cap);
+
+
+/*******************************************************************************
+Description:     	Decompresses 'in_len' bytes produced by "LZCompress()" into
+					'out'.
+Return value:    	Number of bytes written to 'out', 0 if 'in' is corrupt or
+					'out_cap' is too small.
+Time Complexity: 	O(output length).
+Notes: 			 	Undefined behaviour if in or out are invalid pointers.
+*******************************************************************************/
+size_t LZDecompress(const void *in, size_t in_len, void *out, size_t out_cap);
+
+
+#endif    /*__LZ_H__*/
@@ -0,0 +1,41 @@
+#ifndef __MEM_MONITOR_H__
+#define __MEM_MONITOR_H__
+
+#include <stddef.h>    /* size_t        */
+
+#include "cache.h"     /* cache_t       */
+
+
+typedef struct mem_monitor mem_monitor_t;
+
+
+/******************************************************************************
+Description:     	Starts a thread that checks memory pressure every
+					'interval_ms' milliseconds and adapts the capacity of
+					"cache" between 'min_capacity' and 'max_capacity'.
+					Pressure is read from the PSI file at 'psi_path' ("some
+					avg10" of /proc/pressure/memory or a cgroup's
+					memory.pressure), and/or from the process RSS compared to
+					'rss_limit' bytes. Under pressure the capacity shrinks by a
+					quarter per check, once pressure subsided for a few checks
+					it grows back gradually.
+Return value:    	Pointer to monitor in case of success, otherwise NULL.
+Time Complexity: 	O(1) + system call complexity.
+Note:            	Should call "MemMonitorStop()" before "CacheDestroy()".
+					Pass NULL 'psi_path' or 0 'rss_limit' to ignore a source.
+******************************************************************************/
+mem_monitor_t *MemMonitorStart(cache_t *cache, size_t min_capacity,
+								size_t max_capacity, const char *psi_path,
+								size_t rss_limit, unsigned interval_ms);
+
+
+/******************************************************************************
+Description:     	Stops and deletes a monitor pointed to by "monitor". The
+					cache keeps the capacity it had.
+Time Complexity: 	O(1) + wait for the monitor thread.
+Notes:           	Undefined behaviour if monitor is NULL.
+*******************************************************************************/
+void MemMonitorStop(mem_monitor_t *monitor);
+
+
+#endif    /*__MEM_MONITOR_H__*/
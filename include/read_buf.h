@@ -0,0 +1,60 @@
+#ifndef __READ_BUF_H__
+#define __READ_BUF_H__
+
+#include <stddef.h>    /* size_t        */
+
+#include "aux_funcs.h" /* action_func_t */
+
+
+typedef struct read_buf read_buf_t;
+
+
+/*******************************************************************************
+Description:     	Creates a striped, lossy buffer of recorded items.
+					Each thread records into one of 'stripes' rings of
+					'stripe_len' slots, so recording threads rarely share a
+					cache line. 0 'stripes' picks one stripe per online CPU.
+Return value:    	Pointer to buffer in case of success, otherwise NULL.
+Time Complexity: 	O(stripes * stripe_len).
+Note:            	Should call "ReadBufDestroy()" at end of use.
+					Both sizes are rounded up to a power of two.
+*******************************************************************************/
+read_buf_t *ReadBufCreate(size_t stripes, size_t stripe_len);
+
+
+/*******************************************************************************
+Description:     	Deletes a buffer pointed to by "buf" from memory.
+					Items that were not drained are dropped.
+Time Complexity: 	O(1) + system call complexity.
+Notes:           	Undefined behaviour if buf is NULL.
+*******************************************************************************/
+void ReadBufDestroy(read_buf_t *buf);
+
+
+/*******************************************************************************
+Description:     	Records 'item' in the stripe of the calling thread.
+					When the stripe is full the item is dropped.
+Return value:    	1 if the stripe is full and should be drained, otherwise 0.
+Time complexity:  	O(1), never blocks.
+Notes:            	Safe to call concurrently from any number of threads.
+					Undefined behaviour if item is NULL.
+*******************************************************************************/
+int ReadBufRecord(read_buf_t *buf, void *item);
+
+
+/*******************************************************************************
+Description:  	  	Calls "action_func" on every recorded item of every stripe,
+					oldest first, and removes them from the buffer.
+Return value:     	0 if every stripe was drained up to its last reserved slot,
+					1 if a slot that is still being recorded stopped a stripe
+					(items behind it stay for the next drain).
+Time complexity:  	O(number of recorded items).
+Notes:            	Only one thread may drain at a time, callers serialize
+					draining with their own lock (usually a try-lock).
+					Safe to run concurrently with "ReadBufRecord()".
+*******************************************************************************/
+int ReadBufDrain(read_buf_t *buf, action_func_t action_func,
+														void *user_params);
+
+
+#endif    /*__READ_BUF_H__*/
@@ -0,0 +1,63 @@
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stddef.h>    /* size_t */
+
+
+typedef struct ring ring_t;
+
+
+/*******************************************************************************
+Description:     	Creates a bounded queue of 'capacity' records of
+					'record_size' bytes each. Any number of threads may push
+					and pop at the same time without a lock: every slot
+					carries a sequence number telling producers and consumers
+					whose turn it is.
+Return value:    	Pointer to ring in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+Note:            	Should call "RingDestroy()" at end of use.
+					'capacity' is rounded up to a power of two.
+*******************************************************************************/
+ring_t *RingCreate(size_t capacity, size_t record_size);
+
+
+/*******************************************************************************
+Description:     	Deletes a ring pointed to by "ring" from memory, records
+					that were not popped are dropped.
+Time Complexity: 	O(1).
+Notes:           	Undefined behaviour if ring is NULL.
+*******************************************************************************/
+void RingDestroy(ring_t *ring);
+
+
+/*******************************************************************************
+Description:     	Copies 'record' into "ring". When the ring is full the
+					record is dropped and counted (see "RingDropped()").
+Return value:    	0 in case of success, 1 if the record was dropped.
+Time complexity:  	O(1), never blocks (a push retries only if another push
+					took its slot).
+Notes:            	Safe to call concurrently from any number of threads.
+*******************************************************************************/
+int RingPush(ring_t *ring, const void *record);
+
+
+/*******************************************************************************
+Description:     	Copies the oldest record of "ring" to 'record' and removes
+					it.
+Return value:    	0 in case of success, 1 if the ring is empty (or its
+					oldest record is still being pushed).
+Time complexity:  	O(1), never blocks.
+Notes:            	Safe to call concurrently from any number of threads.
+*******************************************************************************/
+int RingPop(ring_t *ring, void *record);
+
+
+/*******************************************************************************
+Description:     	Returns the number of records dropped because "ring" was
+					full.
+Time complexity:  	O(1).
+*******************************************************************************/
+size_t RingDropped(const ring_t *ring);
+
+
+#endif    /*__RING_H__*/
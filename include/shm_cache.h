@@ -0,0 +1,97 @@
+#ifndef __SHM_CACHE_H__
+#define __SHM_CACHE_H__
+
+#include <stddef.h>    /* size_t        */
+
+
+typedef struct shm_cache shm_cache_t;
+
+
+/*******************************************************************************
+Description:     	Opens (or creates) an LRU cache that lives in the POSIX
+					shared memory object "name" and is shared by every process
+					that opens the same name.
+					'capacity' entries of at most 'key_max' key bytes and
+					'val_max' value bytes are reserved when the segment is
+					created. When the segment already exists its own layout is
+					used and the size arguments are ignored, a zero 'capacity'
+					only attaches and never creates.
+Return value:    	Pointer to cache handle in case of success, otherwise NULL.
+Time Complexity: 	O(capacity) on creation, O(1) when attaching.
+Note:            	Should call "ShmCacheClose()" at end of use.
+					The segment outlives the processes using it, call
+					"ShmCacheUnlink()" to remove it from the system.
+					Once an owner died holding the lock of the segment, the
+					next process to take it repairs the segment. Should that
+					fail too, every call fails until the segment is unlinked
+					and created again.
+*******************************************************************************/
+shm_cache_t *ShmCacheOpen(const char *name, size_t capacity, size_t key_max,
+															size_t val_max);
+
+
+/*******************************************************************************
+Description:     	Detaches the calling process from the shared segment.
+					Cached entries stay in the segment.
+Time Complexity: 	Determined by system call complexity.
+Notes:           	Undefined behaviour if cache is NULL.
+*******************************************************************************/
+void ShmCacheClose(shm_cache_t *cache);
+
+
+/*******************************************************************************
+Description:     	Removes the shared memory object "name". Processes that are
+					still attached keep using it until "ShmCacheClose()".
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	Determined by system call complexity.
+*******************************************************************************/
+int ShmCacheUnlink(const char *name);
+
+
+/*******************************************************************************
+Description:     	Copies 'val_len' bytes of 'val' into the cache under the key
+					made of 'key_len' bytes of 'key'. An existing entry with
+					the same key is overwritten. When the cache is full the
+					least recently used entry is evicted.
+Return value:    	0 in case of success otherwise 1 (key or value too big).
+Time Complexity: 	O(1) average.
+Notes: 			 	Undefined behaviour if cache, key or val are invalid pointers.
+*******************************************************************************/
+int ShmCacheSet(shm_cache_t *cache, const void *key, size_t key_len,
+										const void *val, size_t val_len);
+
+
+/*******************************************************************************
+Description:     	Looks up the key made of 'key_len' bytes of 'key' and copies
+					its value into 'buf' which is '*val_len' bytes long.
+					On return '*val_len' holds the stored value length.
+					A hit makes the entry the most recently used.
+Return value:    	0 on hit, 1 on miss, 2 if 'buf' is too small (nothing is
+					copied and '*val_len' holds the needed size).
+Time Complexity: 	O(1) average.
+Notes: 			 	Undefined behaviour if cache, key, buf or val_len are
+					invalid pointers.
+*******************************************************************************/
+int ShmCacheGet(shm_cache_t *cache, const void *key, size_t key_len,
+											void *buf, size_t *val_len);
+
+
+/*******************************************************************************
+Description:     	Deletes the entry of the key made of 'key_len' bytes of 'key'.
+Return value:    	0 if an entry was removed, otherwise 1.
+Time Complexity: 	O(1) average.
+Notes: 			 	Undefined behaviour if cache or key are invalid pointers.
+*******************************************************************************/
+int ShmCacheRemove(shm_cache_t *cache, const void *key, size_t key_len);
+
+
+/*******************************************************************************
+Description:     	Returns number of entries in the shared cache (0 if the lock
+					of the segment cannot be recovered).
+Time Complexity: 	O(1).
+Notes:			 	Undefined behaviour if 'cache' is invalid pointer.
+*******************************************************************************/
+size_t ShmCacheSize(shm_cache_t *cache);
+
+
+#endif    /*__SHM_CACHE_H__*/
@@ -0,0 +1,123 @@
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <stddef.h>    /* size_t        */
+
+#include "aux_funcs.h" /* action_func_t */
+
+
+typedef struct slab slab_t;
+
+/* a size class, see "SlabClassStats()" */
+typedef struct slab_class_stats
+{
+	size_t chunk_size;	/* bytes a chunk of the class holds */
+	size_t pages;
+	size_t used;		/* chunks allocated and not freed yet */
+	size_t failures;	/* "SlabAlloc()" calls that found no chunk */
+}slab_class_stats_t;
+
+
+/******************************************************************************
+Description:     	Creates an allocator of up to 'memory' bytes, handed out in
+					pages of 1MB. Each page is cut into chunks of one size
+					class, the chunk sizes of consecutive classes grow by a
+					factor of 1.25, from 48 bytes to almost a page.
+Return value:    	Pointer to allocator in case of success, otherwise NULL.
+Time Complexity: 	O(classes).
+Note:            	Should call "SlabDestroy()" at end of use.
+					Pages are mapped when a class first needs them and never
+					given back, only moved between classes.
+******************************************************************************/
+slab_t *SlabCreate(size_t memory);
+
+
+/******************************************************************************
+Description:     	Deletes an allocator pointed to by "slab" from memory, with
+					every chunk still allocated.
+Time Complexity: 	O(pages) + system call complexity.
+Notes:           	Undefined behaviour if slab is NULL.
+*******************************************************************************/
+void SlabDestroy(slab_t *slab);
+
+
+/*******************************************************************************
+Description:     	Returns the number of size classes of "slab".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t SlabClasses(const slab_t *slab);
+
+
+/*******************************************************************************
+Description:     	Returns the smallest class whose chunks hold 'size' bytes.
+Return value:    	Id of the class, "SlabClasses()" if 'size' is larger than
+					the chunks of every class.
+Time Complexity: 	O(log classes).
+*******************************************************************************/
+size_t SlabClassFor(const slab_t *slab, size_t size);
+
+
+/*******************************************************************************
+Description:     	Allocates a chunk of class 'class_id', from a new page if
+					the pages of the class are full and "slab" still has
+					memory for one.
+Return value:    	Pointer to the chunk, NULL if the class is full (only
+					freeing its chunks, or moving a page to it, helps then).
+Time Complexity: 	O(1) + system call complexity for a new page.
+Notes: 			 	Safe to call concurrently from any thread, classes are
+					locked separately.
+*******************************************************************************/
+void *SlabAlloc(slab_t *slab, size_t class_id);
+
+
+/*******************************************************************************
+Description:     	Gives 'chunk' back to its class.
+Time Complexity: 	O(1).
+Notes: 			 	Safe to call concurrently from any thread. The owner of
+					'chunk' (see "SlabSetOwner()") must be cleared first.
+*******************************************************************************/
+void SlabFree(slab_t *slab, void *chunk);
+
+
+/*******************************************************************************
+Description:     	Returns the class of an allocated 'chunk'.
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t SlabClassOf(const void *chunk);
+
+
+/*******************************************************************************
+Description:     	Records 'owner' as the user of an allocated 'chunk', NULL
+					once it no longer needs to be told when the page of
+					'chunk' is moved (see "SlabMovePage()").
+Time Complexity: 	O(1).
+Notes: 			 	Not synchronized, owners must be set and cleared under
+					the same lock "SlabMovePage()" is called with.
+*******************************************************************************/
+void SlabSetOwner(void *chunk, void *owner);
+
+
+/*******************************************************************************
+Description:     	Moves a page from class 'from' to class 'to': the page of
+					'from' with the fewest allocated chunks stops serving
+					allocations, "evict" is called with the owner of each of
+					its chunks that has one, and the page joins 'to' once all
+					its chunks are freed.
+Return value:    	0 if the page is on its way, 1 if 'from' has less than two
+					pages or another page is still on its way.
+Time Complexity: 	O(pages + chunks per page).
+Notes: 			 	"evict" must eventually free the chunk of the owner it
+					is given, and clear the owner.
+*******************************************************************************/
+int SlabMovePage(slab_t *slab, size_t from, size_t to, action_func_t evict,
+															void *user_params);
+
+
+/*******************************************************************************
+Description:     	Fills 'stats' with the statistics of class 'class_id'.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void SlabClassStats(slab_t *slab, size_t class_id, slab_class_stats_t *stats);
+
+
+#endif    /*__SLAB_H__*/
@@ -0,0 +1,68 @@
+#ifndef __TOPK_H__
+#define __TOPK_H__
+
+#include <stddef.h>    /* size_t          */
+
+#include "aux_funcs.h" /* is_match_func_t */
+#include "hash_t.h"    /* hash_func_t     */
+#include "ctier.h"     /* size_func_t     */
+
+
+typedef struct topk topk_t;
+
+typedef struct topk_entry
+{
+	void *key;			/* malloc'd copy, released by the caller */
+	size_t count;		/* estimated occurrences, decayed over time */
+	size_t error;		/* 'count' overestimates by at most this much */
+	double rate;		/* estimated occurrences per second */
+}topk_entry_t;
+
+
+/******************************************************************************
+Description:     	Creates a tracker of the 'k' most frequent keys of a stream
+					with the Space-Saving algorithm: 'k' counters, a key that
+					is not counted takes over the smallest counter. Any key
+					seen more than 1/k of the time is guaranteed to be held.
+					Only every 'sample'th occurrence per thread is counted (as
+					'sample' occurrences), and counts halve every 'half_life'
+					seconds so keys that cool down leave the top.
+Return value:    	Pointer to tracker in case of success, otherwise NULL.
+Time Complexity: 	O(k).
+Note:            	Should call "TopKDestroy()" at end of use.
+					Keys are copied byte by byte, they must be flat.
+******************************************************************************/
+topk_t *TopKCreate(size_t k, size_t sample, double half_life,
+					hash_func_t hash_func, is_match_func_t match,
+					size_func_t key_size);
+
+
+/******************************************************************************
+Description:     	Deletes a tracker pointed to by "topk" from memory.
+Time Complexity: 	O(k).
+Notes:           	Undefined behaviour if topk is NULL.
+*******************************************************************************/
+void TopKDestroy(topk_t *topk);
+
+
+/*******************************************************************************
+Description:     	Counts one occurrence of 'key'.
+Time Complexity: 	O(1) when not sampled, O(log k) average otherwise.
+Notes: 			 	Safe to call concurrently from any thread and never
+					blocks: a sample that finds the tracker busy is dropped,
+					like an unsampled one.
+*******************************************************************************/
+void TopKAdd(topk_t *topk, const void *key);
+
+
+/*******************************************************************************
+Description:     	Fills 'entries' with up to 'n' of the hottest keys, hottest
+					first.
+Return value:    	Number of entries filled.
+Time Complexity: 	O(k log k).
+Notes: 			 	The caller releases every 'entries[i].key' with free().
+*******************************************************************************/
+size_t TopKList(topk_t *topk, topk_entry_t *entries, size_t n);
+
+
+#endif    /*__TOPK_H__*/
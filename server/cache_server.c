@@ -0,0 +1,942 @@
+/*
+ * Cache server speaking the memcached text protocol (get, gets, set, delete)
+ * over TCP and Unix sockets, on top of cache_t.
+ *
+ * Build from the repository root:
+ *   gcc -O2 -Iinclude -DCACHE_LF_INDEX -DCACHE_NO_MAIN server/cache_server.c \
+ *       src/cache.c src/cache_space.c src/cache_policy.c \
+ *       src/cache_write_back.c src/ilist.c src/dlist.c src/hash_t.c \
+ *       src/lf_hash.c src/read_buf.c src/epoch.c src/topk.c src/slab.c \
+ *       src/ring.c -lpthread -o cache_server
+ * Run:
+ *   ./cache_server [-l addr] [-p port] [-s unix_path] [-c entries] [-t threads]
+ *
+ * Every thread runs its own epoll loop over the listening sockets and the
+ * connections it accepted, a connection never changes thread. Requests are
+ * parsed as they arrive and their replies queued, so pipelined requests are
+ * answered with one writev(). Values are stored with their "VALUE" line and
+ * are sent straight from the cache, a queued reply pins them with a handle.
+ * A maintenance thread frees released values and deletes expired ones off
+ * the loops' path.
+ */
+#define _GNU_SOURCE		/* accept4			*/
+
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* snprintf			*/
+#include <string.h>		/* memcpy, strcmp	*/
+#include <stddef.h>		/* offsetof			*/
+#include <stdint.h>		/* uint64_t			*/
+#include <errno.h>		/* errno			*/
+#include <time.h>		/* time				*/
+#include <signal.h>		/* sigwait			*/
+#include <pthread.h>	/* pthread_create	*/
+#include <unistd.h>		/* read, close		*/
+#include <arpa/inet.h>	/* inet_pton		*/
+#include <netinet/in.h>	/* sockaddr_in		*/
+#include <netinet/tcp.h>	/* TCP_NODELAY	*/
+#include <sys/epoll.h>	/* epoll_wait		*/
+#include <sys/socket.h>	/* accept4			*/
+#include <sys/uio.h>	/* writev			*/
+#include <sys/un.h>		/* sockaddr_un		*/
+
+#include "aux_funcs.h" /*is_match_t , action_func*/
+#include "cache.h"
+
+enum{
+	MAX_KEY = 250,
+	MAX_VALUE = 1024 * 1024,
+	MAX_LINE = 64 * 1024,		/* a multi-get line carries many keys */
+	READ_CHUNK = 16 * 1024,
+	MAX_EVENTS = 64,
+	MAX_IOV = 256,
+	MAX_LISTENERS = 2,
+	MAINTENANCE_MS = 10,
+	MAX_RELATIVE_EXPTIME = 60 * 60 * 24 * 30	/* larger ones are unix times */
+};
+
+/*
+ * A stored value, the cache's data. 'buf' holds the whole reply of a "get":
+ * "VALUE <key> <flags> <bytes>\r\n<data>\r\n", "gets" inserts the cas after
+ * the first 'head_len' bytes.
+ */
+typedef struct item
+{
+	uint64_t cas;
+	size_t head_len;
+	size_t len;
+	char buf[1];
+}item_t;
+
+/*one segment of a queued reply, 'text' is used when 'base' is NULL*/
+typedef struct out
+{
+	const char *base;
+	size_t len;
+	cache_handle_t *handle;		/* released once sent */
+	char text[24];
+}out_t;
+
+typedef struct conn
+{
+	cache_t *cache;
+	int fd;
+	int is_listener;
+	int writing;				/* waiting for EPOLLOUT, input is not read */
+	int closing;
+	char *in;
+	size_t in_len;
+	size_t in_cap;
+	size_t swallow;				/* bytes of a rejected value still to skip */
+	item_t *pending;			/* "set" waiting for the rest of its data */
+	char *pending_key;
+	size_t pending_got;
+	int pending_noreply;
+	unsigned long pending_ttl_ms;
+	int pending_expired;
+	out_t *out;
+	size_t n_out;
+	size_t out_cap;
+	size_t sent_out;			/* segments fully written */
+	size_t sent_off;			/* bytes written of the next one */
+}conn_t;
+
+typedef struct server
+{
+	cache_t *cache;
+	conn_t listeners[MAX_LISTENERS];
+	size_t n_listeners;
+}server_t;
+
+static uint64_t next_cas = 0;
+
+
+static size_t HashKey(const void *key)
+{
+	const unsigned char *at = (const unsigned char*)key;
+	size_t hash = (size_t)0xcbf29ce484222325ULL;
+
+	while('\0' != *at)
+	{
+		hash ^= *at++;
+		hash *= (size_t)0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static int MatchKey(const void *data, const void *user_params)
+{
+	return 0 == strcmp((const char*)data, (const char*)user_params);
+}
+
+static void ReleaseKeyAndItem(void *key, void *data, void *user_params)
+{
+	(void)user_params;
+
+	free(key);
+	free(data);
+}
+
+
+/*queues a reply segment, returns 1 if there is no memory for it*/
+static int Push(conn_t *conn, const char *base, size_t len,
+													cache_handle_t *handle)
+{
+	out_t *out = NULL;
+
+	if(conn->n_out == conn->out_cap)
+	{
+		size_t cap = 0 == conn->out_cap ? 16 : conn->out_cap * 2;
+
+		out = (out_t*)realloc(conn->out, cap * sizeof(out_t));
+		if(NULL == out)
+		{
+			return 1;
+		}
+		conn->out = out;
+		conn->out_cap = cap;
+	}
+
+	out = &conn->out[conn->n_out++];
+	out->base = base;
+	out->len = len;
+	out->handle = handle;
+
+	return 0;
+}
+
+static int PushCas(conn_t *conn, uint64_t cas)
+{
+	out_t *out = NULL;
+
+	if(0 != Push(conn, NULL, 0, NULL))
+	{
+		return 1;
+	}
+
+	/*'base' stays NULL, the out array may still move*/
+	out = &conn->out[conn->n_out - 1];
+	out->len = (size_t)snprintf(out->text, sizeof(out->text), " %llu",
+													(unsigned long long)cas);
+
+	return 0;
+}
+
+#define PushStr(conn, str) Push(conn, str, sizeof(str) - 1, NULL)
+
+
+/*
+ * Returns -1 on a socket error, 1 if the socket is full and replies are
+ * still queued, 0 once all of them are written.
+ */
+static int Flush(conn_t *conn)
+{
+	while(conn->sent_out < conn->n_out)
+	{
+		struct iovec iov[MAX_IOV];
+		ssize_t done = 0;
+		size_t cnt = 0;
+		size_t i = 0;
+
+		for(i = conn->sent_out ; i < conn->n_out && cnt < MAX_IOV ; i++)
+		{
+			out_t *out = &conn->out[i];
+
+			iov[cnt].iov_base = (char*)(NULL != out->base ? out->base :
+																out->text);
+			iov[cnt].iov_len = out->len;
+			++cnt;
+		}
+		iov[0].iov_base = (char*)iov[0].iov_base + conn->sent_off;
+		iov[0].iov_len -= conn->sent_off;
+
+		done = writev(conn->fd, iov, (int)cnt);
+		if(done < 0 && EINTR == errno)
+		{
+			continue;
+		}
+		if(done < 0)
+		{
+			return EAGAIN == errno || EWOULDBLOCK == errno ? 1 : -1;
+		}
+
+		done += (ssize_t)conn->sent_off;
+		while(conn->sent_out < conn->n_out &&
+						(size_t)done >= conn->out[conn->sent_out].len)
+		{
+			out_t *out = &conn->out[conn->sent_out++];
+
+			done -= (ssize_t)out->len;
+			if(NULL != out->handle)
+			{
+				CacheRelease(conn->cache, out->handle);
+			}
+		}
+		conn->sent_off = (size_t)done;
+	}
+
+	conn->n_out = 0;
+	conn->sent_out = 0;
+	conn->sent_off = 0;
+
+	return 0;
+}
+
+
+/*cuts the next space separated token out of '*at'*/
+static char *NextToken(char **at)
+{
+	char *token = *at;
+
+	while(' ' == *token)
+	{
+		++token;
+	}
+	if('\0' == *token)
+	{
+		return NULL;
+	}
+
+	*at = token;
+	while('\0' != **at && ' ' != **at)
+	{
+		++*at;
+	}
+	if('\0' != **at)
+	{
+		*(*at)++ = '\0';
+	}
+
+	return token;
+}
+
+static int ParseNum(const char *token, unsigned long max, unsigned long *num)
+{
+	char *end = NULL;
+
+	if(NULL == token || '-' == *token)
+	{
+		return 1;
+	}
+
+	errno = 0;
+	*num = strtoul(token, &end, 10);
+
+	return 0 != errno || '\0' != *end || end == token || *num > max;
+}
+
+
+static int DoGet(server_t *server, conn_t *conn, char *args, int with_cas)
+{
+	char *key = NULL;
+
+	if(NULL == (key = NextToken(&args)))
+	{
+		return PushStr(conn, "ERROR\r\n");
+	}
+
+	do
+	{
+		cache_handle_t *handle = NULL;
+		item_t *item = NULL;
+		int failed = 0;
+
+		if(strlen(key) > MAX_KEY)
+		{
+			return PushStr(conn, "CLIENT_ERROR bad command line format\r\n");
+		}
+
+		handle = CacheAcquire(server->cache, key);
+		if(NULL == handle)
+		{
+			continue;
+		}
+
+		/*the last segment of the item holds the handle*/
+		item = (item_t*)CacheHandleData(handle);
+		if(with_cas)
+		{
+			failed = Push(conn, item->buf, item->head_len, NULL) ||
+					PushCas(conn, item->cas) ||
+					Push(conn, item->buf + item->head_len,
+										item->len - item->head_len, handle);
+		}
+		else
+		{
+			failed = Push(conn, item->buf, item->len, handle);
+		}
+
+		if(failed)
+		{
+			CacheRelease(server->cache, handle);
+			return 1;
+		}
+	}while(NULL != (key = NextToken(&args)));
+
+	return PushStr(conn, "END\r\n");
+}
+
+/*
+ * memcached's exptime: 0 never, seconds up to 30 days, else a unix time.
+ * Returns 1 if the value expired already, it is not stored then.
+ */
+static int TtlMs(unsigned long exptime, unsigned long *ttl_ms)
+{
+	time_t now = 0;
+
+	if(exptime <= MAX_RELATIVE_EXPTIME)
+	{
+		*ttl_ms = exptime * 1000;
+		return 0;
+	}
+
+	now = time(NULL);
+	*ttl_ms = (time_t)exptime > now ?
+							(unsigned long)((time_t)exptime - now) * 1000 : 0;
+
+	return 0 == *ttl_ms;
+}
+
+/*allocates the item, its data is copied in by "FeedPending()"*/
+static int DoSet(conn_t *conn, char *args)
+{
+	char *key = NextToken(&args);
+	char *noreply = NULL;
+	unsigned long flags = 0;
+	unsigned long exptime = 0;
+	unsigned long bytes = 0;
+	item_t *item = NULL;
+	size_t head_len = 0;
+
+	if(NULL == key || strlen(key) > MAX_KEY ||
+				0 != ParseNum(NextToken(&args), UINT32_MAX, &flags) ||
+				0 != ParseNum(NextToken(&args), UINT32_MAX, &exptime) ||
+				0 != ParseNum(NextToken(&args), SIZE_MAX / 2, &bytes))
+	{
+		return PushStr(conn, "CLIENT_ERROR bad command line format\r\n");
+	}
+
+	noreply = NextToken(&args);
+	conn->pending_noreply = NULL != noreply && 0 == strcmp(noreply, "noreply");
+
+	if(bytes > MAX_VALUE)
+	{
+		conn->swallow = bytes + 2;
+		return conn->pending_noreply ? 0 :
+					PushStr(conn, "SERVER_ERROR object too large for cache\r\n");
+	}
+
+	head_len = (size_t)snprintf(NULL, 0, "VALUE %s %lu %lu", key, flags,
+																	bytes);
+	item = (item_t*)malloc(offsetof(item_t, buf) + head_len + bytes + 5);
+	conn->pending_key = (char*)malloc(strlen(key) + 1);
+	if(NULL == item || NULL == conn->pending_key)
+	{
+		free(item);
+		free(conn->pending_key);
+		conn->pending_key = NULL;
+		conn->swallow = bytes + 2;
+
+		return conn->pending_noreply ? 0 :
+							PushStr(conn, "SERVER_ERROR out of memory\r\n");
+	}
+
+	item->head_len = head_len;
+	item->len = head_len + 2 + bytes + 2;
+	snprintf(item->buf, head_len + 1, "VALUE %s %lu %lu", key, flags, bytes);
+	memcpy(item->buf + head_len, "\r\n", 2);
+	strcpy(conn->pending_key, key);
+
+	conn->pending = item;
+	conn->pending_got = 0;
+	conn->pending_expired = TtlMs(exptime, &conn->pending_ttl_ms);
+
+	return 0;
+}
+
+/*
+ * Copies the data of the pending "set" straight into its item, the trailing
+ * "\r\n" of the request lands where the reply needs it.
+ */
+static size_t FeedPending(server_t *server, conn_t *conn, const char *data,
+																size_t len)
+{
+	item_t *item = conn->pending;
+	size_t offset = item->head_len + 2;
+	size_t need = item->len - offset - conn->pending_got;
+
+	len = len < need ? len : need;
+	memcpy(item->buf + offset + conn->pending_got, data, len);
+	conn->pending_got += len;
+
+	if(len == need)
+	{
+		conn->pending = NULL;
+
+		if(0 != memcmp(item->buf + item->len - 2, "\r\n", 2))
+		{
+			free(item);
+			free(conn->pending_key);
+			conn->pending_key = NULL;
+			PushStr(conn, "CLIENT_ERROR bad data chunk\r\n");
+
+			return len;
+		}
+
+		item->cas = __atomic_add_fetch(&next_cas, 1, __ATOMIC_RELAXED);
+		if(conn->pending_expired)
+		{
+			/*stored and expired at once, the old value goes too*/
+			CacheRemove(server->cache, conn->pending_key);
+			ReleaseKeyAndItem(conn->pending_key, item, NULL);
+		}
+		else
+		{
+			CacheSetWithTTL(server->cache, conn->pending_key, item,
+													conn->pending_ttl_ms);
+		}
+		conn->pending_key = NULL;
+
+		if(!conn->pending_noreply)
+		{
+			PushStr(conn, "STORED\r\n");
+		}
+	}
+
+	return len;
+}
+
+static int DoDelete(server_t *server, conn_t *conn, char *args)
+{
+	char *key = NextToken(&args);
+	char *token = NULL;
+	int noreply = 0;
+	int status = 0;
+
+	if(NULL == key || strlen(key) > MAX_KEY)
+	{
+		return PushStr(conn, "CLIENT_ERROR bad command line format\r\n");
+	}
+
+	/*an old client may still send a zero hold time*/
+	while(NULL != (token = NextToken(&args)))
+	{
+		noreply |= 0 == strcmp(token, "noreply");
+	}
+
+	status = CacheRemove(server->cache, key);
+	if(noreply)
+	{
+		return 0;
+	}
+
+	return 0 == status ? PushStr(conn, "DELETED\r\n") :
+											PushStr(conn, "NOT_FOUND\r\n");
+}
+
+
+/*
+ * Runs every complete request in the input buffer, returns 1 if the
+ * connection has to be closed.
+ */
+static int Process(server_t *server, conn_t *conn)
+{
+	size_t pos = 0;
+	int status = 0;
+
+	while(pos < conn->in_len && 0 == status && !conn->closing)
+	{
+		char *line = conn->in + pos;
+		char *eol = NULL;
+		char *cmd = NULL;
+
+		if(0 != conn->swallow)
+		{
+			size_t len = conn->in_len - pos;
+
+			len = len < conn->swallow ? len : conn->swallow;
+			conn->swallow -= len;
+			pos += len;
+			continue;
+		}
+
+		if(NULL != conn->pending)
+		{
+			pos += FeedPending(server, conn, line, conn->in_len - pos);
+			continue;
+		}
+
+		eol = (char*)memchr(line, '\n', conn->in_len - pos);
+		if(NULL == eol)
+		{
+			/*no command is that long, the client is broken*/
+			status = conn->in_len - pos > MAX_LINE;
+			break;
+		}
+
+		pos = (size_t)(eol + 1 - conn->in);
+		*eol = '\0';
+		if(eol > line && '\r' == eol[-1])
+		{
+			eol[-1] = '\0';
+		}
+
+		cmd = NextToken(&line);
+		if(NULL == cmd)
+		{
+			status = PushStr(conn, "ERROR\r\n");
+		}
+		else if(0 == strcmp(cmd, "get"))
+		{
+			status = DoGet(server, conn, line, 0);
+		}
+		else if(0 == strcmp(cmd, "gets"))
+		{
+			status = DoGet(server, conn, line, 1);
+		}
+		else if(0 == strcmp(cmd, "set"))
+		{
+			status = DoSet(conn, line);
+		}
+		else if(0 == strcmp(cmd, "delete"))
+		{
+			status = DoDelete(server, conn, line);
+		}
+		else if(0 == strcmp(cmd, "quit"))
+		{
+			conn->closing = 1;
+		}
+		else
+		{
+			status = PushStr(conn, "ERROR\r\n");
+		}
+	}
+
+	/*keep the unparsed tail, it is at most one line*/
+	memmove(conn->in, conn->in + pos, conn->in_len - pos);
+	conn->in_len -= pos;
+
+	return status;
+}
+
+
+static conn_t *ConnCreate(cache_t *cache, int fd)
+{
+	conn_t *conn = (conn_t*)calloc(1, sizeof(conn_t));
+
+	if(NULL == conn)
+	{
+		return NULL;
+	}
+
+	conn->cache = cache;
+	conn->fd = fd;
+	conn->in_cap = READ_CHUNK;
+	conn->in = (char*)malloc(conn->in_cap);
+	if(NULL == conn->in)
+	{
+		free(conn);
+		return NULL;
+	}
+
+	return conn;
+}
+
+static void ConnDestroy(conn_t *conn)
+{
+	size_t i = 0;
+
+	for(i = conn->sent_out ; i < conn->n_out ; i++)
+	{
+		if(NULL != conn->out[i].handle)
+		{
+			CacheRelease(conn->cache, conn->out[i].handle);
+		}
+	}
+
+	close(conn->fd);
+	free(conn->pending);
+	free(conn->pending_key);
+	free(conn->out);
+	free(conn->in);
+	free(conn);
+}
+
+static int Watch(int epfd, conn_t *conn, int writing)
+{
+	struct epoll_event event;
+
+	event.events = writing ? EPOLLOUT : EPOLLIN;
+	event.data.ptr = conn;
+	conn->writing = writing;
+
+	return epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+/*returns 1 if the connection has to be closed*/
+static int Serve(server_t *server, int epfd, conn_t *conn, unsigned events)
+{
+	int status = 0;
+
+	if(events & EPOLLIN)
+	{
+		ssize_t done = 0;
+
+		if(conn->in_cap - conn->in_len < READ_CHUNK)
+		{
+			char *in = (char*)realloc(conn->in, conn->in_len + READ_CHUNK);
+
+			if(NULL == in)
+			{
+				return 1;
+			}
+			conn->in = in;
+			conn->in_cap = conn->in_len + READ_CHUNK;
+		}
+
+		done = read(conn->fd, conn->in + conn->in_len,
+											conn->in_cap - conn->in_len);
+		if(0 == done)
+		{
+			return 1;
+		}
+		if(done < 0)
+		{
+			return EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno;
+		}
+
+		conn->in_len += (size_t)done;
+		if(0 != Process(server, conn))
+		{
+			return 1;
+		}
+	}
+	else if(!(events & EPOLLOUT))
+	{
+		return 1;
+	}
+
+	status = Flush(conn);
+	if(status < 0)
+	{
+		return 1;
+	}
+	if(0 == status && conn->closing)
+	{
+		return 1;
+	}
+
+	/*stop reading while replies back up, the client has to catch up first*/
+	if((1 == status) != conn->writing && 0 != Watch(epfd, conn, 1 == status))
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+static void Accept(server_t *server, int epfd, int listen_fd)
+{
+	int fd = -1;
+
+	while((fd = accept4(listen_fd, NULL, NULL,
+								SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+	{
+		struct epoll_event event;
+		conn_t *conn = ConnCreate(server->cache, fd);
+		int one = 1;
+
+		/*fails harmlessly on Unix sockets*/
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		event.events = EPOLLIN;
+		event.data.ptr = conn;
+		if(NULL == conn || 0 != epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event))
+		{
+			if(NULL != conn)
+			{
+				ConnDestroy(conn);
+			}
+			else
+			{
+				close(fd);
+			}
+		}
+	}
+}
+
+static void *Loop(void *arg)
+{
+	server_t *server = (server_t*)arg;
+	struct epoll_event events[MAX_EVENTS];
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	size_t i = 0;
+
+	if(epfd < 0)
+	{
+		perror("epoll_create1");
+		return NULL;
+	}
+
+	/*every loop waits on the listeners, only one of them is woken*/
+	for(i = 0 ; i < server->n_listeners ; i++)
+	{
+		struct epoll_event event;
+
+		event.events = EPOLLIN | EPOLLEXCLUSIVE;
+		event.data.ptr = &server->listeners[i];
+		if(0 != epoll_ctl(epfd, EPOLL_CTL_ADD, server->listeners[i].fd,
+																	&event))
+		{
+			perror("epoll_ctl");
+			close(epfd);
+			return NULL;
+		}
+	}
+
+	for(;;)
+	{
+		int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		int j = 0;
+
+		for(j = 0 ; j < n ; j++)
+		{
+			conn_t *conn = (conn_t*)events[j].data.ptr;
+
+			if(conn->is_listener)
+			{
+				Accept(server, epfd, conn->fd);
+			}
+			else if(0 != Serve(server, epfd, conn, events[j].events))
+			{
+				ConnDestroy(conn);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+static int ListenOn(int fd, struct sockaddr *addr, socklen_t addr_len)
+{
+	int one = 1;
+
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if(0 != bind(fd, addr, addr_len) || 0 != listen(fd, 1024))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int ListenTcp(const char *ip, unsigned port)
+{
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	if(1 != inet_pton(AF_INET, ip, &addr.sin_addr))
+	{
+		return -1;
+	}
+
+	return ListenOn(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK |
+									SOCK_CLOEXEC, 0),
+									(struct sockaddr*)&addr, sizeof(addr));
+}
+
+static int ListenUnix(const char *path)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path))
+	{
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	return ListenOn(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+									SOCK_CLOEXEC, 0),
+									(struct sockaddr*)&addr, sizeof(addr));
+}
+
+static void Usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-l addr] [-p port] [-s unix_path] "
+							"[-c entries] [-t threads]\n"
+					"  -p 0 disables TCP, defaults: -l 127.0.0.1 -p 11211 "
+							"-c 1000000 -t <cores>\n", name);
+}
+
+
+int main(int argc, char *argv[])
+{
+	server_t server;
+	const char *ip = "127.0.0.1";
+	const char *unix_path = NULL;
+	unsigned long port = 11211;
+	unsigned long capacity = 1000000;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t *loops = NULL;
+	sigset_t stop;
+	int sig = 0;
+	int opt = 0;
+	long i = 0;
+
+	while(-1 != (opt = getopt(argc, argv, "l:p:s:c:t:")))
+	{
+		switch(opt)
+		{
+			case 'l': ip = optarg; break;
+			case 'p': port = strtoul(optarg, NULL, 10); break;
+			case 's': unix_path = optarg; break;
+			case 'c': capacity = strtoul(optarg, NULL, 10); break;
+			case 't': threads = strtol(optarg, NULL, 10); break;
+			default: Usage(argv[0]); return 1;
+		}
+	}
+
+	if(port > 65535 || 0 == capacity || threads < 1 ||
+								(0 == port && NULL == unix_path))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	memset(&server, 0, sizeof(server));
+	server.cache = CacheCreate(capacity, HashKey, MatchKey);
+	if(NULL == server.cache)
+	{
+		fprintf(stderr, "no memory for %lu entries\n", capacity);
+		return 1;
+	}
+	CacheSetRelease(server.cache, ReleaseKeyAndItem, NULL);
+	if(0 != CacheStartMaintenance(server.cache, MAINTENANCE_MS))
+	{
+		fprintf(stderr, "cannot start the maintenance thread\n");
+		return 1;
+	}
+
+	if(0 != port)
+	{
+		server.listeners[server.n_listeners].is_listener = 1;
+		server.listeners[server.n_listeners++].fd = ListenTcp(ip,
+															(unsigned)port);
+	}
+	if(NULL != unix_path)
+	{
+		server.listeners[server.n_listeners].is_listener = 1;
+		server.listeners[server.n_listeners++].fd = ListenUnix(unix_path);
+	}
+	for(i = 0 ; i < (long)server.n_listeners ; i++)
+	{
+		if(server.listeners[i].fd < 0)
+		{
+			perror("listen");
+			return 1;
+		}
+	}
+
+	/*the loops run with these blocked, main waits for them below*/
+	sigemptyset(&stop);
+	sigaddset(&stop, SIGINT);
+	sigaddset(&stop, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	loops = (pthread_t*)malloc((size_t)threads * sizeof(pthread_t));
+	for(i = 0 ; NULL != loops && i < threads ; i++)
+	{
+		if(0 != pthread_create(&loops[i], NULL, Loop, &server))
+		{
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	if(NULL == loops)
+	{
+		return 1;
+	}
+
+	sigwait(&stop, &sig);
+
+	/*connections are dropped with the process, only the socket file stays*/
+	if(NULL != unix_path)
+	{
+		unlink(unix_path);
+	}
+
+	return 0;
+}
@@ -0,0 +1,378 @@
+/*
+ * Checks cache_client_t against a fleet of local cache servers: starts a few
+ * cache_server processes on Unix sockets, then checks rendezvous placement,
+ * the keys that move when a node is removed, multi-get fan-out, and that a
+ * node that died fails requests instead of killing the client. Prints one
+ * line per check and exits with 1 if any of them failed.
+ *
+ * Build from the repository root (cache_server as in cache_server.c):
+ *   gcc -O2 -Iinclude server/client_fleet.c src/cache_client.c -lm \
+ *       -o client_fleet
+ * Run:
+ *   ./client_fleet ./cache_server [nodes]
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <string.h>		/* memcmp, strcmp	*/
+#include <signal.h>		/* kill				*/
+#include <time.h>		/* nanosleep		*/
+#include <unistd.h>		/* fork, execl		*/
+#include <sys/wait.h>	/* waitpid			*/
+
+#include "cache_client.h"
+
+enum{
+	MAX_NODES = 8,
+	DEFAULT_NODES = 4,
+	KEYS = 2000,
+	START_TRIES = 500		/* 10 ms apart */
+};
+
+typedef struct fleet
+{
+	size_t n;
+	pid_t pids[MAX_NODES];
+	char paths[MAX_NODES][64];
+}fleet_t;
+
+static int failures = 0;
+
+
+static void Check(int ok, const char *what)
+{
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	failures += !ok;
+}
+
+static void Nap(void)
+{
+	struct timespec ts = {0, 10 * 1000000};
+
+	nanosleep(&ts, NULL);
+}
+
+static void KeyOf(size_t i, char *key)
+{
+	sprintf(key, "key:%lu", (unsigned long)i);
+}
+
+static void ValueOf(size_t i, char *val)
+{
+	sprintf(val, "value-of-%lu", (unsigned long)i);
+}
+
+/*a client that only knows 'path', to look at one node on its own*/
+static cache_client_t *Direct(const char *path)
+{
+	cache_client_t *client = ClientCreate();
+
+	if(NULL != client && 0 != ClientAddNode(client, path, 1))
+	{
+		ClientDestroy(client);
+		client = NULL;
+	}
+
+	return client;
+}
+
+static int Start(fleet_t *fleet, const char *server, size_t n)
+{
+	size_t i = 0;
+
+	fleet->n = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		cache_client_t *probe = NULL;
+		int tries = 0;
+		pid_t pid = 0;
+
+		sprintf(fleet->paths[i], "/tmp/client_fleet.%ld.%lu.sock",
+										(long)getpid(), (unsigned long)i);
+
+		pid = fork();
+		if(0 == pid)
+		{
+			execl(server, server, "-p", "0", "-s", fleet->paths[i],
+								"-c", "100000", "-t", "1", (char*)NULL);
+			_exit(127);
+		}
+		if(pid < 0)
+		{
+			return 1;
+		}
+		fleet->pids[fleet->n++] = pid;
+
+		/*a set goes through once the server listens*/
+		probe = Direct(fleet->paths[i]);
+		if(NULL == probe)
+		{
+			return 1;
+		}
+		while(0 != ClientSet(probe, "probe", "1", 1) && ++tries < START_TRIES)
+		{
+			Nap();
+		}
+		ClientDelete(probe, "probe");
+		ClientDestroy(probe);
+
+		if(tries == START_TRIES)
+		{
+			fprintf(stderr, "%s did not start on %s\n", server,
+															fleet->paths[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void Stop(fleet_t *fleet, size_t i)
+{
+	if(0 != fleet->pids[i])
+	{
+		kill(fleet->pids[i], SIGTERM);
+		waitpid(fleet->pids[i], NULL, 0);
+		unlink(fleet->paths[i]);
+		fleet->pids[i] = 0;
+	}
+}
+
+/*every key is stored on the node "ClientNodeFor()" names, and only there*/
+static void CheckPlacement(cache_client_t *client, const fleet_t *fleet)
+{
+	cache_client_t *direct[MAX_NODES];
+	size_t counts[MAX_NODES] = {0};
+	size_t misplaced = 0;
+	size_t i = 0;
+	size_t j = 0;
+	int spread = 1;
+
+	for(j = 0 ; j < fleet->n ; j++)
+	{
+		direct[j] = Direct(fleet->paths[j]);
+	}
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		char key[32];
+		const char *node = NULL;
+
+		KeyOf(i, key);
+		node = ClientNodeFor(client, key);
+
+		for(j = 0 ; j < fleet->n ; j++)
+		{
+			size_t len = 0;
+			void *val = NULL == direct[j] ? NULL :
+										ClientGet(direct[j], key, &len);
+			int owner = 0 == strcmp(node, fleet->paths[j]);
+
+			misplaced += owner != (NULL != val);
+			counts[j] += NULL != val;
+			free(val);
+		}
+	}
+
+	/*equal weights, each node holds about its share*/
+	for(j = 0 ; j < fleet->n ; j++)
+	{
+		spread &= counts[j] > KEYS / fleet->n / 2 &&
+									counts[j] < KEYS / fleet->n * 2;
+		ClientDestroy(direct[j]);
+	}
+
+	Check(0 == misplaced, "keys are on the node they map to");
+	Check(spread, "keys are spread over the nodes");
+}
+
+static void CheckMultiGet(cache_client_t *client, size_t first)
+{
+	static char names[KEYS + 2][32];
+	const char *keys[KEYS + 2];
+	void *vals[KEYS + 2];
+	size_t lens[KEYS + 2];
+	size_t hits = 0;
+	size_t wrong = 0;
+	size_t i = 0;
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		KeyOf(first + i, names[i]);
+		keys[i] = names[i];
+	}
+	/*a key twice and one that is not stored*/
+	strcpy(names[KEYS], names[0]);
+	keys[KEYS] = names[KEYS];
+	strcpy(names[KEYS + 1], "no-such-key");
+	keys[KEYS + 1] = names[KEYS + 1];
+
+	memset(vals, 0, sizeof(vals));
+	hits = ClientMultiGet(client, keys, KEYS + 2, vals, lens);
+
+	for(i = 0 ; i < KEYS + 2 ; i++)
+	{
+		char expected[32];
+
+		ValueOf(first + (i == KEYS ? 0 : i), expected);
+		if(i == KEYS + 1)
+		{
+			wrong += NULL != vals[i];
+		}
+		else
+		{
+			wrong += NULL == vals[i] || lens[i] != strlen(expected) ||
+									0 != memcmp(vals[i], expected, lens[i]);
+		}
+		free(vals[i]);
+	}
+
+	Check(KEYS + 1 == hits && 0 == wrong,
+								"multi-get fans out to every node");
+}
+
+/*
+ * Only the keys of the removed node move, the others keep their node and
+ * their value. The moved ones miss until they are set again.
+ */
+static void CheckRemoval(cache_client_t *client, fleet_t *fleet)
+{
+	char owners[KEYS][64];
+	const char *gone = fleet->paths[fleet->n - 1];
+	size_t moved_wrong = 0;
+	size_t kept_wrong = 0;
+	size_t moved = 0;
+	size_t i = 0;
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		char key[32];
+
+		KeyOf(i, key);
+		strcpy(owners[i], ClientNodeFor(client, key));
+	}
+
+	ClientRemoveNode(client, gone);
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		char key[32];
+		size_t len = 0;
+		void *val = NULL;
+
+		KeyOf(i, key);
+		val = ClientGet(client, key, &len);
+
+		if(0 == strcmp(owners[i], gone))
+		{
+			++moved;
+			moved_wrong += NULL != val ||
+							0 == strcmp(ClientNodeFor(client, key), gone);
+		}
+		else
+		{
+			kept_wrong += NULL == val ||
+						0 != strcmp(ClientNodeFor(client, key), owners[i]);
+		}
+		free(val);
+	}
+
+	Check(0 == kept_wrong, "other nodes keep their keys on removal");
+	Check(0 < moved && 0 == moved_wrong, "keys of a removed node move");
+}
+
+/*requests to a killed node fail, the client survives the broken pipe*/
+static void CheckDeadNode(cache_client_t *client, fleet_t *fleet)
+{
+	char key[32];
+	char big[64 * 1024];
+	size_t i = 0;
+	int failed = 1;
+
+	memset(big, 'x', sizeof(big));
+
+	/*a key of node 0, over a connection opened while it was up*/
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		KeyOf(i, key);
+		if(0 == strcmp(ClientNodeFor(client, key), fleet->paths[0]))
+		{
+			break;
+		}
+	}
+
+	Stop(fleet, 0);
+
+	for(i = 0 ; i < 4 ; i++)
+	{
+		failed &= 0 != ClientSet(client, key, big, sizeof(big));
+	}
+
+	Check(failed, "a dead node fails requests without SIGPIPE");
+}
+
+
+int main(int argc, char *argv[])
+{
+	cache_client_t *client = NULL;
+	fleet_t fleet;
+	size_t n = DEFAULT_NODES;
+	size_t i = 0;
+	int set_failed = 0;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s cache_server [nodes]\n", argv[0]);
+		return 1;
+	}
+	if(argc > 2)
+	{
+		n = strtoul(argv[2], NULL, 10);
+	}
+	if(n < 2 || n > MAX_NODES)
+	{
+		fprintf(stderr, "nodes must be 2 to %d\n", MAX_NODES);
+		return 1;
+	}
+
+	memset(&fleet, 0, sizeof(fleet));
+	client = ClientCreate();
+	if(NULL == client || 0 != Start(&fleet, argv[1], n))
+	{
+		for(i = 0 ; i < fleet.n ; i++)
+		{
+			Stop(&fleet, i);
+		}
+		return 1;
+	}
+
+	for(i = 0 ; i < fleet.n ; i++)
+	{
+		ClientAddNode(client, fleet.paths[i], 1);
+	}
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		char key[32];
+		char val[32];
+
+		KeyOf(i, key);
+		ValueOf(i, val);
+		set_failed |= ClientSet(client, key, val, strlen(val));
+	}
+	Check(0 == set_failed, "keys are stored");
+
+	CheckPlacement(client, &fleet);
+	CheckMultiGet(client, 0);
+	CheckRemoval(client, &fleet);
+	CheckDeadNode(client, &fleet);
+
+	ClientDestroy(client);
+	for(i = 0 ; i < fleet.n ; i++)
+	{
+		Stop(&fleet, i);
+	}
+
+	return 0 != failures;
+}
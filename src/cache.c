@@ -2,114 +2,2791 @@
 #include <assert.h>		/* assert		*/
 #include <stdio.h>		/*printf		*/
 #include <string.h>
+#include <stdint.h>		/* uint64_t */
+#include <pthread.h>	/* pthread_rwlock_t */
+#include <time.h>		/* clock_gettime */
 
 #include "aux_funcs.h" /*is_match_t , action_func*/
 
 #include "hash_t.h"
-#include "dlist.h" 		/* dlist_t */
+#include "lf_hash.h"
+#include "ilist.h" 		/* ilist_t */
+#include "read_buf.h"	/* read_buf_t */
+#include "epoch.h"		/* epoch_t */
+#include "topk.h"		/* topk_t */
+#include "slab.h"		/* slab_t */
+#include "ring.h"		/* ring_t */
 #include "cache.h"
+#include "cache_entry.h"		/* data_and_itr_t */
+#include "cache_space.h"		/* space_t */
+#include "cache_policy.h"		/* policy_t */
+#include "cache_write_back.h"	/* write_back_t */
+
+/*
+ * Build with -DCACHE_LF_INDEX to index entries with the lock-free table.
+ * Readers then never lock, the epoch critical section every CacheGet runs in
+ * is enough since evicted entries are retired to the epoch, not freed.
+ */
+#ifdef CACHE_LF_INDEX
+typedef lf_hash_t index_t;
+#define IndexCreate(size, hash_func, match) LFHashCreate(size, hash_func, match)
+#define IndexDestroy(index) LFHashDestroy(index)
+#define IndexFind(index, key) LFHashFind(index, key)
+#define IndexInsert(index, key, val) LFHashInsert(index, key, val)
+#define IndexRemove(index, key) ((void)LFHashRemove(index, key))
+#define IndexScan(index, cursor, count, action_func, user_params) \
+                LFHashScan(index, cursor, count, action_func, user_params)
+/*
+ * The lock-free table grows by itself when a writer finds it full: growing
+ * always succeeds with nothing to move, 'index_size' only follows 'limit'.
+ */
+#define IndexGrow(index) ((void)(index), 0)
+#define IndexMigrate(index, buckets) ((void)(index), (void)(buckets), (size_t)0)
+#define ReadLock(cache) ((void)(cache))
+#define ReadUnlock(cache) ((void)(cache))
+#else
+typedef hash_t index_t;
+#define IndexCreate(size, hash_func, match) HashCreate(size, hash_func, match)
+#define IndexDestroy(index) HashDestroy(index)
+#define IndexFind(index, key) HashFind(index, key)
+#define IndexInsert(index, key, val) HashInsert(index, key, val)
+#define IndexRemove(index, key) HashRemove(index, key)
+#define IndexScan(index, cursor, count, action_func, user_params) \
+                HashScan(index, cursor, count, action_func, user_params)
+#define IndexGrow(index) HashGrow(index)
+#define IndexMigrate(index, buckets) HashMigrate(index, buckets)
+#define ReadLock(cache) pthread_rwlock_rdlock(&(cache)->lock)
+#define ReadUnlock(cache) pthread_rwlock_unlock(&(cache)->lock)
+#endif
 
 enum{
-    FACTOR = 2
+    FACTOR = 2,
+    READ_BUF_STRIPE_LEN = 16,
+    FRONT_SETS = 256,       /*per-thread front cache, 4-way set associative*/
+    FRONT_WAYS = 4,
+    FRONT_SAMPLE = 16,      /*every 16th front hit refreshes the LRU*/
+    MIGRATE_STEP = 16,      /*index buckets moved by a writer while growing*/
+    MAINTENANCE_MIGRATE_STEP = 1024,    /*by the maintenance thread*/
+    SWEEP_STEP = 256,       /*index buckets checked for expiry per tick*/
+    ROOM_TRIES = 8,         /*rounds of a full slab class, see "CopyIn()"*/
+    ROOM_BATCH = 4,         /*entries a round evicts*/
+    QUIET_ROUNDS = 16       /*a slab class that ran out keeps its pages*/
+};
+
+#define HOT_KEYS_HALF_LIFE 10.0     /*seconds, see "CacheTrackHotKeys()"*/
+
+/*
+ * With a maintenance thread writers only evict above the hard limit, the
+ * thread evicts down to the low watermark once the limit is crossed.
+ */
+#define HARD_LIMIT(limit) ((limit) + (limit) / 8)
+#define LOW_WATERMARK(limit) ((limit) - (limit) / 16)
+
+
+/*entries evicted together, see "CacheSetCapacity()"*/
+typedef struct batch
+{
+    struct batch *next;
+    size_t count;
+    data_and_itr_t **entries;
+
+}batch_t;
+
+/*an entry or value released while the maintenance thread runs*/
+typedef struct dead
+{
+    void *ptr;
+    action_func_t free_func;
+
+}dead_t;
+
+/*what the maintenance thread saw of a slab class*/
+typedef struct demand
+{
+    size_t failures;        /*as of the last round*/
+    size_t quiet;           /*rounds since the class last ran out*/
+
+}demand_t;
+
+/*
+ * State of "CacheStartMaintenance()". 'dead' is guarded by the cache's
+ * 'lru_lock' (retired entries are reclaimed under it), the rest belongs to
+ * the maintenance thread, 'lock' only guards 'stop' and 'kicked'.
+ */
+typedef struct maintenance
+{
+    pthread_t thread;
+    unsigned interval_ms;
+    int stop;
+    int kicked;             /*the limit was crossed, evict before the tick*/
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    dead_t *dead;
+    size_t n_dead;
+    size_t dead_cap;
+    size_t sweep_cursor;
+    data_and_itr_t **expired;
+    size_t n_expired;
+    size_t expired_cap;
+    demand_t *demand;       /*of each slab class*/
+
+}maintenance_t;
+
+/*
+ * 'lock' guards the index and the entries, readers share it (writers only
+ * when CACHE_LF_INDEX lets readers go through 'epoch' instead).
+ * 'lru_lock' guards the LRU lists, hits never wait for it: they are recorded
+ * in 'read_buf' and replayed onto the lists in batches by whoever manages to
+ * take 'lru_lock' (or by the next writer).
+ */
+struct cache
+{
+	index_t *hash_table;
+    space_t **spaces;       /*namespace 0 holds the keys of no other one*/
+    size_t n_spaces;
+    size_t reserved;        /*by all namespaces*/
+    cache_ns_func_t ns_func;
+    size_t hash_capacity;   /*of 'versions', fixed*/
+    size_t index_size;      /*buckets of 'hash_table', doubles with 'limit'*/
+    int index_growing;      /*"HashMigrate()" has buckets left to move*/
+    size_t limit;
+    size_t size;
+    pthread_rwlock_t lock;
+    pthread_mutex_t lru_lock;
+    read_buf_t *read_buf;
+    epoch_t *epoch;
+    hash_func_t hash_func;
+    is_match_func_t match;
+    size_t id;
+    int front_enabled;
+    size_t *versions;       /*bumped on any change to a key of the bucket*/
+    tier_put_func_t tier_put;
+    tier_take_func_t tier_take;
+    void *tier;
+    cache_release_func_t release;   /*keys and data are owned if set*/
+    void *release_params;
+    batch_t *reaped;        /*evicted batches safe to free, pushed lock-free*/
+    data_and_itr_t *stranded;       /*retired while the epoch had no room,*/
+    cache_handle_t *stranded_values;/*retried by "ReclaimEntries()"*/
+    batch_t *stranded_batches;
+    topk_t *hot_keys;
+    uint64_t last_version;  /*of any entry, written under both locks*/
+    maintenance_t *maintenance;     /*NULL unless a thread maintains it*/
+    int has_ttl;            /*an entry was ever set with a TTL*/
+    slab_t *slab;           /*NULL unless the cache copies the data*/
+    size_func_t data_size;
+    write_back_t *write_back;       /*NULL unless writes are flushed*/
+    hash_t *tags;           /*tag_t by id, NULL until a key is tagged*/
+    size_t n_tags;
+    size_t tags_size;       /*buckets of 'tags'*/
+    int tags_growing;
+    ring_t *events;         /*NULL unless changes are recorded*/
+    size_func_t event_size;
+    policy_t *policy;       /*LRU unless "CacheSetPolicy()" chose another*/
 };
 
+/*
+ * A thread's front cache serves every cache_t, slots are tagged with the
+ * owner's id. A slot is valid while the version of its bucket is unchanged,
+ * so it never needs to be invalidated explicitly.
+ */
+typedef struct front_slot
+{
+    size_t cache_id;
+    size_t hash;
+    const void *key;
+    void *data;
+    size_t version;
+    uint64_t expires;
+    unsigned hits;
+}front_slot_t;
+
+typedef struct front_set
+{
+    front_slot_t ways[FRONT_WAYS];
+    unsigned next;
+}front_set_t;
+
+static __thread front_set_t front[FRONT_SETS];
+static size_t next_cache_id = 1;
+
+/*an entry in the list of one of its tags, see "CacheSetTagged()"*/
+typedef struct member
+{
+    struct member *prev;
+    struct member *next;
+    struct tag *tag;
+    data_and_itr_t *entry;
+
+}member_t;
+
+/*'members' is a sentinel, a tag is freed along with its last member*/
+typedef struct tag
+{
+    size_t id;
+    member_t members;
+
+}tag_t;
+
+typedef struct scan_params
+{
+    cache_scan_func_t scan_func;
+    void *user_params;
+
+}scan_params_t;
+
+
+/*coarse clock, a tick of a few ms is precise enough for expiry*/
+static uint64_t NowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static int IsExpired(uint64_t expires)
+{
+    return 0 != expires && NowMs() >= expires;
+}
+
+static size_t *Version(const cache_t *cache, size_t hash)
+{
+    return &cache->versions[hash % cache->hash_capacity];
+}
+
+static void BumpVersion(cache_t *cache, const void *key)
+{
+    __atomic_add_fetch(Version(cache, cache->hash_func(key)), 1,
+                                                        __ATOMIC_RELEASE);
+}
+
+static front_set_t *FrontSet(size_t hash)
+{
+    return &front[(hash * (size_t)0x9e3779b97f4a7c15ULL >> 24) &
+                                                        (FRONT_SETS - 1)];
+}
+
+/*
+ * Returns the data of 'key' if this thread's front cache holds a still valid
+ * copy, NULL sends the caller to the shared cache (periodically also on a
+ * valid slot, so the shared LRU keeps seeing the key as hot).
+ */
+static void *FrontGet(cache_t *cache, const void *key, size_t hash)
+{
+    front_set_t *set = FrontSet(hash);
+    size_t version = __atomic_load_n(Version(cache, hash), __ATOMIC_ACQUIRE);
+    int i = 0;
+
+    for(i = 0 ; i < FRONT_WAYS ; i++)
+    {
+        front_slot_t *slot = &set->ways[i];
+
+        if(slot->cache_id == cache->id && slot->hash == hash &&
+                    slot->version == version && cache->match(slot->key, key))
+        {
+            if(0 == (++slot->hits % FRONT_SAMPLE) || IsExpired(slot->expires))
+            {
+                return NULL;
+            }
+
+            return slot->data;
+        }
+    }
+
+    return NULL;
+}
+
+static void FrontFill(cache_t *cache, const void *key, size_t hash,
+                            void *data, size_t version, uint64_t expires)
+{
+    front_set_t *set = FrontSet(hash);
+    front_slot_t *slot = NULL;
+    int i = 0;
+
+    /*a stale slot's key may already be freed, it is reused unseen*/
+    for(i = 0 ; i < FRONT_WAYS && NULL == slot ; i++)
+    {
+        if(set->ways[i].cache_id == cache->id && set->ways[i].hash == hash &&
+                                    (set->ways[i].version != version ||
+                                    cache->match(set->ways[i].key, key)))
+        {
+            slot = &set->ways[i];
+        }
+    }
+
+    if(NULL == slot)
+    {
+        slot = &set->ways[set->next++ % FRONT_WAYS];
+        slot->hits = 0;
+    }
+
+    slot->cache_id = cache->id;
+    slot->hash = hash;
+    slot->key = key;
+    slot->data = data;
+    slot->version = version;
+    slot->expires = expires;
+}
+
+
+/*replays a recorded hit onto the policy, see "PolicyHit()"*/
+static int Promote(void *data, void *user_params)
+{
+    PolicyHit(((cache_t*)user_params)->policy, (data_and_itr_t*)data);
+
+    return 0;
+}
+
+/*the release hook a tier implies, keys and data come from malloc()*/
+static void FreeKeyAndData(void *key, void *data, void *user_params)
+{
+    (void)user_params;
+    free(key);
+    free(data);
+}
+
+static cache_handle_t *NewValue(void *data)
+{
+    cache_handle_t *value = (cache_handle_t*)malloc(sizeof(cache_handle_t));
+
+    if(NULL != value)
+    {
+        value->data = data;
+        value->refs = 1;
+    }
+
+    return value;
+}
+
+/*
+ * Drops a reference to 'value' and, when the cache owns them, releases 'key'
+ * (if any) and the data once nobody holds it any more.
+ */
+static void Unpin(cache_t *cache, cache_handle_t *value, void *key)
+{
+    void *data = NULL;
+
+    if(0 == __atomic_sub_fetch(&value->refs, 1, __ATOMIC_ACQ_REL))
+    {
+        data = value->data;
+        free(value);
+    }
+
+    /*a copy in a slab chunk, the caller's data was never kept*/
+    if(NULL != cache->slab && NULL != data)
+    {
+        SlabFree(cache->slab, data);
+        data = NULL;
+    }
+
+    if(NULL != cache->release && (NULL != key || NULL != data))
+    {
+        cache->release(key, data, cache->release_params);
+    }
+}
+
+/*frees an entry, its key and data go unless a handle still pins the data*/
+static int FreeEntry(void *data, void *user_params)
+{
+    data_and_itr_t *entry = (data_and_itr_t*)data;
+    cache_t *cache = (cache_t*)user_params;
+
+    Unpin(cache, entry->value, entry->key);
+    free(entry->members);
+    free(entry);
+
+    return 0;
+}
+
+static int FreeValue(void *data, void *user_params)
+{
+    Unpin((cache_t*)user_params, (cache_handle_t*)data, NULL);
+
+    return 0;
+}
+
+/*
+ * Called under 'lru_lock' by the epoch reclamation of a writer. Returns 1
+ * if the maintenance thread takes 'ptr' to free it off the writers' path.
+ */
+static int Defer(cache_t *cache, void *ptr, action_func_t free_func)
+{
+    maintenance_t *maint = cache->maintenance;
+
+    /*a writer out of slab chunks waits for them, see "CopyIn()"*/
+    if(NULL == maint || NULL != cache->slab)
+    {
+        return 0;
+    }
+
+    if(maint->n_dead == maint->dead_cap)
+    {
+        size_t cap = 0 == maint->dead_cap ? 64 : maint->dead_cap * 2;
+        dead_t *dead = (dead_t*)realloc(maint->dead, cap * sizeof(dead_t));
+
+        if(NULL == dead)
+        {
+            return 0; /*no memory, freed right away*/
+        }
+        maint->dead = dead;
+        maint->dead_cap = cap;
+    }
+
+    maint->dead[maint->n_dead].ptr = ptr;
+    maint->dead[maint->n_dead].free_func = free_func;
+    ++maint->n_dead;
+
+    return 1;
+}
+
+static int ReleaseEntry(void *data, void *user_params)
+{
+    if(!Defer((cache_t*)user_params, data, FreeEntry))
+    {
+        FreeEntry(data, user_params);
+    }
+
+    return 0;
+}
+
+/*value replaced under a key that stays in the cache*/
+static int ReleaseValue(void *data, void *user_params)
+{
+    if(!Defer((cache_t*)user_params, data, FreeValue))
+    {
+        FreeValue(data, user_params);
+    }
+
+    return 0;
+}
+
+/*
+ * Called by writers under 'lru_lock' before they touch the list.
+ * Returns 1 if a hit still being recorded kept the buffer from draining,
+ * retired entries must not be reclaimed then.
+ */
+static int DrainHits(cache_t *cache)
+{
+    /*readers that saw entries retired two epochs ago are gone now*/
+    EpochAdvance(cache->epoch);
+
+    return ReadBufDrain(cache->read_buf, Promote, cache);
+}
+
+static size_t HashId(const void *tag)
+{
+    size_t id = *(const size_t*)tag;
+
+    id ^= id >> 33;
+    id *= (size_t)0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+
+    return id;
+}
+
+static int MatchId(const void *data, const void *user_params)
+{
+    return *(const size_t*)data == *(const size_t*)user_params;
+}
+
+static int FreeItem(void *data, void *user_params)
+{
+    (void)user_params;
+    free(data);
+
+    return 0;
+}
+
+/*
+ * Called under both locks when 'entry' leaves the index or is tagged anew.
+ * Readers never look at memberships, they are freed right away.
+ */
+static void Untag(cache_t *cache, data_and_itr_t *entry)
+{
+    size_t i = 0;
+
+    for(i = 0 ; i < entry->n_members ; i++)
+    {
+        member_t *member = &entry->members[i];
+        tag_t *tag = member->tag;
+
+        member->prev->next = member->next;
+        member->next->prev = member->prev;
+
+        if(&tag->members == tag->members.next)
+        {
+            HashRemove(cache->tags, &tag->id);
+            --cache->n_tags;
+            free(tag);
+        }
+    }
+
+    free(entry->members);
+    entry->members = NULL;
+    entry->n_members = 0;
+}
+
+/*called under both locks, the tag index doubles as tags are added*/
+static tag_t *FindTag(cache_t *cache, size_t id)
+{
+    tag_t *tag = (tag_t*)HashFind(cache->tags, &id);
+
+    if(NULL != tag)
+    {
+        return tag;
+    }
+
+    tag = (tag_t*)malloc(sizeof(tag_t));
+    if(NULL == tag)
+    {
+        return NULL;
+    }
+    tag->id = id;
+    tag->members.prev = &tag->members;
+    tag->members.next = &tag->members;
+
+    if(0 != HashInsert(cache->tags, &tag->id, tag))
+    {
+        free(tag);
+        return NULL;
+    }
+    ++cache->n_tags;
+
+    if(cache->tags_growing)
+    {
+        cache->tags_growing = 0 != HashMigrate(cache->tags, MIGRATE_STEP);
+    }
+    else if(cache->n_tags > cache->tags_size && 0 == HashGrow(cache->tags))
+    {
+        cache->tags_size *= 2;
+        cache->tags_growing = 1;
+    }
+
+    return tag;
+}
+
+/*
+ * Called under both locks once 'entry' holds the data of a write, the
+ * entry's tags become 'ids'. Returns 1 if there was no memory, the entry
+ * must be deleted then: it would outlive an invalidation.
+ */
+static int Tag(cache_t *cache, data_and_itr_t *entry, const size_t *ids,
+                                                                size_t n)
+{
+    size_t i = 0;
+
+    Untag(cache, entry);
+
+    if(0 == n)
+    {
+        return 0;
+    }
+
+    if(NULL == cache->tags)
+    {
+        cache->tags = HashCreate(cache->hash_capacity, HashId, MatchId);
+        if(NULL == cache->tags)
+        {
+            return 1;
+        }
+        cache->tags_size = cache->hash_capacity;
+    }
+
+    entry->members = (member_t*)malloc(n * sizeof(member_t));
+    if(NULL == entry->members)
+    {
+        return 1;
+    }
+
+    for(i = 0 ; i < n ; i++)
+    {
+        tag_t *tag = FindTag(cache, ids[i]);
+        member_t *member = &entry->members[i];
+
+        if(NULL == tag)
+        {
+            return 1;
+        }
+
+        member->tag = tag;
+        member->entry = entry;
+        member->prev = tag->members.prev;
+        member->next = &tag->members;
+        tag->members.prev->next = member;
+        tag->members.prev = member;
+        ++entry->n_members;
+    }
+
+    return 0;
+}
+
+/*
+ * Records a change of 'entry', called under the locks that make it. A full
+ * ring drops the event, writers never wait for consumers.
+ */
+static void Emit(const cache_t *cache, cache_event_op_t op,
+                                            const data_and_itr_t *entry)
+{
+    cache_event_t event;
+
+    if(NULL == cache->events)
+    {
+        return;
+    }
+
+    event.op = op;
+    event.key_hash = cache->hash_func(entry->key);
+    event.key = entry->key;
+    event.size = NULL == cache->event_size ? 0 :
+                                    cache->event_size(entry->value->data);
+    event.time_ms = NowMs();
+
+    RingPush(cache->events, &event);
+}
+
+/*
+ * Called back by "WriteBackPut()" for the entries deleted while flushed.
+ * Out of memory the epoch may not take the entry, it waits on 'stranded'
+ * for "ReclaimEntries()" to try again.
+ */
+static int RetireEntry(void *data, void *user_params)
+{
+    data_and_itr_t *entry = (data_and_itr_t*)data;
+    cache_t *cache = (cache_t*)user_params;
+
+    if(2 == EpochRetire(cache->epoch, entry, ReleaseEntry, cache))
+    {
+        entry->stranded = cache->stranded;
+        cache->stranded = entry;
+    }
+
+    return 0;
+}
+
+/*a replaced value, see "RetireEntry()"*/
+static void RetireValue(cache_t *cache, cache_handle_t *value)
+{
+    if(2 == EpochRetire(cache->epoch, value, ReleaseValue, cache))
+    {
+        value->stranded = cache->stranded_values;
+        cache->stranded_values = value;
+    }
+}
+
+/*
+ * Retires an unlinked entry. One that is being flushed is left to "Flush()",
+ * which still hands its key to the flush function.
+ */
+static void Retire(cache_t *cache, data_and_itr_t *entry)
+{
+    if(NULL != cache->write_back && WriteBackOrphan(entry))
+    {
+        return;
+    }
+
+    RetireEntry(entry, cache);
+}
+
+/*
+ * The entry already left the index and the LRU list. Front cache probes and
+ * lock-free readers may still look at it, so it is retired, not freed.
+ * A tagged entry does not go down to the tier, no invalidation reaches it
+ * there.
+ */
+static void DropEntry(cache_t *cache, data_and_itr_t *entry)
+{
+    Emit(cache, CACHE_EVENT_EVICT, entry);
+    if(NULL != cache->tier_put && 0 == entry->n_members)
+    {
+        cache->tier_put(cache->tier, entry->key, entry->value->data);
+    }
+    Untag(cache, entry);
+
+    Retire(cache, entry);
+}
+
+/*
+ * A retired batch is only handed over here, whoever reclaims the epoch must
+ * not pay for freeing it. "CacheSetCapacity()" frees it on its caller.
+ */
+static int ReapBatch(void *data, void *user_params)
+{
+    batch_t *batch = (batch_t*)data;
+    cache_t *cache = (cache_t*)user_params;
+
+    batch->next = __atomic_load_n(&cache->reaped, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&cache->reaped, &batch->next, batch,
+                                1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+    }
+
+    return 0;
+}
+
+static void FreeReaped(cache_t *cache)
+{
+    batch_t *batch = __atomic_exchange_n(&cache->reaped, NULL,
+                                                        __ATOMIC_ACQUIRE);
+
+    while(NULL != batch)
+    {
+        batch_t *next = batch->next;
+        size_t i = 0;
+
+        for(i = 0 ; i < batch->count ; i++)
+        {
+            FreeEntry(batch->entries[i], cache);
+        }
+        free(batch->entries);
+        free(batch);
+        batch = next;
+    }
+}
+
+/*an evicted batch, see "RetireEntry()"*/
+static void RetireBatch(cache_t *cache, batch_t *batch)
+{
+    if(2 == EpochRetire(cache->epoch, batch, ReapBatch, cache))
+    {
+        batch->next = cache->stranded_batches;
+        cache->stranded_batches = batch;
+    }
+}
+
+/*
+ * Retires again what the epoch had no room for. Stops at the first one it
+ * still cannot take, which the retire function put back.
+ */
+static void RetireStranded(cache_t *cache)
+{
+    while(NULL != cache->stranded)
+    {
+        data_and_itr_t *entry = cache->stranded;
+
+        cache->stranded = entry->stranded;
+        RetireEntry(entry, cache);
+        if(entry == cache->stranded)
+        {
+            return;
+        }
+    }
+
+    while(NULL != cache->stranded_values)
+    {
+        cache_handle_t *value = cache->stranded_values;
+
+        cache->stranded_values = value->stranded;
+        RetireValue(cache, value);
+        if(value == cache->stranded_values)
+        {
+            return;
+        }
+    }
+
+    while(NULL != cache->stranded_batches)
+    {
+        batch_t *batch = cache->stranded_batches;
+
+        cache->stranded_batches = batch->next;
+        RetireBatch(cache, batch);
+        if(batch == cache->stranded_batches)
+        {
+            return;
+        }
+    }
+}
+
+static void ReclaimEntries(cache_t *cache, int blocked)
+{
+    if(!blocked)
+    {
+        EpochReclaim(cache->epoch);
+    }
+    RetireStranded(cache);
+}
+
+/*at destroy nothing reads them any more*/
+static void FreeStranded(cache_t *cache)
+{
+    while(NULL != cache->stranded)
+    {
+        data_and_itr_t *entry = cache->stranded;
+
+        cache->stranded = entry->stranded;
+        FreeEntry(entry, cache);
+    }
+
+    while(NULL != cache->stranded_values)
+    {
+        cache_handle_t *value = cache->stranded_values;
+
+        cache->stranded_values = value->stranded;
+        FreeValue(value, cache);
+    }
+
+    while(NULL != cache->stranded_batches)
+    {
+        batch_t *batch = cache->stranded_batches;
+
+        cache->stranded_batches = batch->next;
+        ReapBatch(batch, cache);
+    }
+}
+
+/*
+ * The slab chunk of 'entry' stops pointing back at it, called under both
+ * locks whenever the entry leaves the index or gets another chunk.
+ */
+static void Disown(const cache_t *cache, const data_and_itr_t *entry)
+{
+    if(NULL != cache->slab)
+    {
+        SlabSetOwner(entry->value->data, NULL);
+    }
+}
+
+static void Unlink(cache_t *cache, data_and_itr_t *entry)
+{
+    PolicyRemove(cache->policy, entry);
+    --entry->space->size;
+    IndexRemove(cache->hash_table, entry->key);
+    BumpVersion(cache, entry->key);
+    Disown(cache, entry);
+    if(NULL != cache->write_back)
+    {
+        WriteBackUnlist(cache->write_back, entry);
+    }
+    Untag(cache, entry);
+    --cache->size;
+}
+
+/*
+ * Unlinks an entry that is deleted, not evicted, so it does not go down to
+ * the tier, and retires it. 'op' tells why.
+ */
+static void Delete(cache_t *cache, data_and_itr_t *entry, cache_event_op_t op)
+{
+    Emit(cache, op, entry);
+    Unlink(cache, entry);
+
+    Retire(cache, entry);
+}
+
+/*called by "SlabMovePage()" for the entries in a page it takes away*/
+static int EvictOwner(void *owner, void *user_params)
+{
+    cache_t *cache = (cache_t*)user_params;
+    data_and_itr_t *entry = (data_and_itr_t*)owner;
+
+    Unlink(cache, entry);
+    DropEntry(cache, entry);
+
+    return 0;
+}
+
+/*returns the namespace of 'key', 0 for an unknown one*/
+static space_t *SpaceOf(const cache_t *cache, const void *key)
+{
+    size_t id = NULL == cache->ns_func ? 0 : cache->ns_func(key);
+
+    return cache->spaces[id < cache->n_spaces ? id : 0];
+}
+
+/*
+ * Picks the namespace to evict from for 'space' (NULL if none is inserted),
+ * see "SpaceVictim()". Slab classes evict their own entries first, only
+ * those free a chunk of the right size.
+ */
+static space_t *VictimSpace(const cache_t *cache, space_t *space)
+{
+    return SpaceVictim(cache->spaces, cache->n_spaces, cache->limit,
+                            cache->reserved, space, NULL != cache->slab);
+}
+
+/*
+ * Unlinks the victim of 'space' the policy picks, see "PolicyPopVictim()".
+ * Returns NULL if none was found within a few entries.
+ */
+static data_and_itr_t *PopVictim(cache_t *cache, space_t *space)
+{
+    data_and_itr_t *victim = PolicyPopVictim(cache->policy, space,
+                                                            cache->limit);
+
+    if(NULL != victim)
+    {
+        Disown(cache, victim);
+    }
+
+    return victim;
+}
+
+/*
+ * Unlinks the 'count' least recently used entries and retires them as a
+ * single batch.
+ */
+static void EvictBatch(cache_t *cache, size_t count)
+{
+    batch_t *batch = (batch_t*)malloc(sizeof(batch_t));
+    data_and_itr_t **entries =
+                (data_and_itr_t**)malloc(count * sizeof(data_and_itr_t*));
+    size_t i = 0;
+
+    if(NULL == batch || NULL == entries)
+    {
+        free(batch);
+        free(entries);
+
+        /*no memory for the batch, fall back to one by one*/
+        for(i = 0 ; i < count ; i++)
+        {
+            data_and_itr_t *victim = PopVictim(cache, VictimSpace(cache, NULL));
+
+            if(NULL == victim)
+            {
+                break;
+            }
+            IndexRemove(cache->hash_table, victim->key);
+            BumpVersion(cache, victim->key);
+            DropEntry(cache, victim);
+        }
+        cache->size -= i;
+
+        return;
+    }
+
+    for(i = 0 ; i < count ; i++)
+    {
+        data_and_itr_t *victim = PopVictim(cache, VictimSpace(cache, NULL));
+
+        /*the rest is dirty, it stays until flushed*/
+        if(NULL == victim)
+        {
+            break;
+        }
+        IndexRemove(cache->hash_table, victim->key);
+        BumpVersion(cache, victim->key);
+        Emit(cache, CACHE_EVENT_EVICT, victim);
+        if(NULL != cache->tier_put && 0 == victim->n_members)
+        {
+            cache->tier_put(cache->tier, victim->key, victim->value->data);
+        }
+        Untag(cache, victim);
+        entries[i] = victim;
+    }
+    count = i;
+
+    if(0 == count)
+    {
+        free(batch);
+        free(entries);
+        return;
+    }
+
+    cache->size -= count;
+
+    batch->count = count;
+    batch->entries = entries;
+    RetireBatch(cache, batch);
+}
+
+
+cache_t *CacheCreate(size_t capacity ,hash_func_t hash_func , is_match_func_t match)
+{
+    cache_t *cache = (cache_t*)malloc(sizeof(cache_t));
+   
+    if(NULL == cache)
+    {
+        return NULL;
+    }
+    
+    cache->hash_table = IndexCreate(capacity * FACTOR,hash_func, match);
+    cache->spaces = (space_t**)malloc(sizeof(space_t*));
+    cache->n_spaces = 1;
+    cache->reserved = 0;
+    cache->ns_func = NULL;
+    cache->read_buf = ReadBufCreate(0, READ_BUF_STRIPE_LEN);
+    cache->epoch = EpochCreate();
+    cache->versions = (size_t*)calloc(capacity * FACTOR, sizeof(size_t));
+    cache->size = 0;
+    cache->hash_capacity = capacity * FACTOR;
+    cache->index_size = capacity * FACTOR;
+    cache->index_growing = 0;
+    cache->limit = capacity;
+    cache->reaped = NULL;
+    cache->stranded = NULL;
+    cache->stranded_values = NULL;
+    cache->stranded_batches = NULL;
+    cache->hash_func = hash_func;
+    cache->match = match;
+    cache->id = __atomic_fetch_add(&next_cache_id, 1, __ATOMIC_RELAXED);
+    cache->front_enabled = 0;
+    cache->tier_put = NULL;
+    cache->tier_take = NULL;
+    cache->tier = NULL;
+    cache->release = NULL;
+    cache->release_params = NULL;
+    cache->hot_keys = NULL;
+    cache->last_version = 0;
+    cache->maintenance = NULL;
+    cache->has_ttl = 0;
+    cache->slab = NULL;
+    cache->data_size = NULL;
+    cache->write_back = NULL;
+    cache->tags = NULL;
+    cache->events = NULL;
+    cache->event_size = NULL;
+    cache->policy = PolicyCreate(CACHE_POLICY_LRU, capacity,
+                                            capacity * FACTOR, hash_func);
+    cache->n_tags = 0;
+    cache->tags_size = 0;
+    cache->tags_growing = 0;
+
+    if(NULL != cache->spaces)
+    {
+        cache->spaces[0] = SpaceCreate(capacity, 0, 0);
+    }
+
+    if(NULL == cache->hash_table || NULL == cache->spaces ||
+        NULL == cache->spaces[0] || NULL == cache->read_buf ||
+        NULL == cache->epoch || NULL == cache->versions ||
+        NULL == cache->policy)
+    {
+        free(cache->versions);
+        if(NULL != cache->policy)
+        {
+            PolicyDestroy(cache->policy, FreeEntry, cache);
+        }
+        if(NULL != cache->hash_table)
+        {
+            IndexDestroy(cache->hash_table);
+        }
+        if(NULL != cache->spaces && NULL != cache->spaces[0])
+        {
+            SpaceDestroy(cache->spaces[0]);
+        }
+        free(cache->spaces);
+        if(NULL != cache->read_buf)
+        {
+            ReadBufDestroy(cache->read_buf);
+        }
+        if(NULL != cache->epoch)
+        {
+            EpochDestroy(cache->epoch);
+        }
+        free(cache);
+        return NULL;
+    }
+
+#ifdef CACHE_LF_INDEX
+    LFHashSetEpoch(cache->hash_table, cache->epoch);
+#endif
+    pthread_rwlock_init(&cache->lock, NULL);
+    pthread_mutex_init(&cache->lru_lock, NULL);
+
+    return cache;
+}
+
+
+void CacheSetFrontCache(cache_t *cache, int enable)
+{
+    assert(cache);
+
+    __atomic_store_n(&cache->front_enabled, enable, __ATOMIC_RELAXED);
+}
+
+
+void CacheAttachTier(cache_t *cache, tier_put_func_t put,
+                                        tier_take_func_t take, void *tier)
+{
+    assert(cache);
+    assert(put);
+    assert(take);
+    assert(NULL == cache->slab);
+
+    cache->tier_put = put;
+    cache->tier_take = take;
+    cache->tier = tier;
+
+    if(NULL == cache->release)
+    {
+        cache->release = FreeKeyAndData;
+    }
+}
+
+
+int CacheTrackHotKeys(cache_t *cache, size_t k, size_t sample,
+                                                    size_func_t key_size)
+{
+    assert(cache);
+    assert(NULL == cache->hot_keys);
+
+    cache->hot_keys = TopKCreate(k, sample, HOT_KEYS_HALF_LIFE,
+                                cache->hash_func, cache->match, key_size);
+
+    return NULL == cache->hot_keys;
+}
+
+
+size_t CacheHotKeys(cache_t *cache, topk_entry_t *entries, size_t n)
+{
+    assert(cache);
+
+    return NULL == cache->hot_keys ? 0 :
+                                TopKList(cache->hot_keys, entries, n);
+}
+
+
+void CacheSetRelease(cache_t *cache, cache_release_func_t release,
+                                                        void *user_params)
+{
+    assert(cache);
+    assert(release);
+
+    cache->release = release;
+    cache->release_params = user_params;
+}
+
+
+void CacheSetNamespaceFunc(cache_t *cache, cache_ns_func_t ns_func)
+{
+    assert(cache);
+    assert(ns_func);
+    assert(NULL == cache->slab);
+    assert(CACHE_POLICY_LRU == PolicyKind(cache->policy));
+
+    cache->ns_func = ns_func;
+}
+
+
+size_t CacheAddNamespace(cache_t *cache, size_t reserved, size_t quota)
+{
+    space_t **spaces = NULL;
+    space_t *space = NULL;
+
+    assert(cache);
+    assert(0 == quota || reserved <= quota);
+    assert(NULL == cache->slab);
+    assert(CACHE_POLICY_LRU == PolicyKind(cache->policy));
+
+    spaces = (space_t**)realloc(cache->spaces,
+                                (cache->n_spaces + 1) * sizeof(space_t*));
+    if(NULL == spaces)
+    {
+        return 0;
+    }
+    cache->spaces = spaces;
+
+    /*the list grows with the namespace, it starts at what it keeps for sure*/
+    space = SpaceCreate(reserved, reserved, quota);
+    if(NULL == space)
+    {
+        return 0;
+    }
+
+    cache->spaces[cache->n_spaces] = space;
+    cache->reserved += reserved;
+
+    return cache->n_spaces++;
+}
+
+
+int CacheUseSlabs(cache_t *cache, size_t memory, size_func_t data_size)
+{
+    space_t **spaces = NULL;
+    slab_t *slab = NULL;
+    size_t n_classes = 0;
+    size_t i = 0;
+
+    assert(cache);
+    assert(data_size);
+    assert(NULL == cache->slab);
+    assert(1 == cache->n_spaces && NULL == cache->ns_func);
+    assert(NULL == cache->tier_put);
+    assert(NULL == cache->write_back);
+    assert(CACHE_POLICY_LRU == PolicyKind(cache->policy));
+    assert(0 == cache->size);
+
+    slab = SlabCreate(memory);
+    if(NULL == slab)
+    {
+        return 1;
+    }
+    n_classes = SlabClasses(slab);
+
+    spaces = (space_t**)realloc(cache->spaces, n_classes * sizeof(space_t*));
+    if(NULL == spaces)
+    {
+        SlabDestroy(slab);
+        return 1;
+    }
+    cache->spaces = spaces;
+
+    /*namespace 0 becomes the first class, the lists grow with the classes*/
+    for(i = 1 ; i < n_classes ; i++)
+    {
+        cache->spaces[i] = SpaceCreate(0, 0, 0);
+        if(NULL == cache->spaces[i])
+        {
+            while(--i > 0)
+            {
+                SpaceDestroy(cache->spaces[i]);
+            }
+            SlabDestroy(slab);
+            return 1;
+        }
+    }
+
+    cache->n_spaces = n_classes;
+    cache->slab = slab;
+    cache->data_size = data_size;
+
+    return 0;
+}
+
+
+int CacheSetPolicy(cache_t *cache, cache_policy_t policy)
+{
+    policy_t *chosen = NULL;
+
+    assert(cache);
+    assert(CACHE_POLICY_LRU == PolicyKind(cache->policy));
+    assert(1 == cache->n_spaces && NULL == cache->ns_func);
+    assert(NULL == cache->slab);
+    assert(0 == cache->size);
+
+    if(CACHE_POLICY_LRU == policy)
+    {
+        return 0;
+    }
+
+    chosen = PolicyCreate(policy, cache->limit, cache->hash_capacity,
+                                                        cache->hash_func);
+    if(NULL == chosen)
+    {
+        return 1;
+    }
+
+    /*the cache is empty, the LRU policy holds no entry*/
+    PolicyDestroy(cache->policy, FreeEntry, cache);
+    cache->policy = chosen;
+
+    return 0;
+}
+
+
+int CacheNamespaceStats(cache_t *cache, size_t ns, cache_ns_stats_t *stats)
+{
+    space_t *space = NULL;
+
+    assert(cache);
+    assert(stats);
+
+    if(ns >= cache->n_spaces)
+    {
+        return 1;
+    }
+
+    space = cache->spaces[ns];
+
+    pthread_mutex_lock(&cache->lru_lock);
+    SpaceStats(space, stats);
+    pthread_mutex_unlock(&cache->lru_lock);
+
+    return 0;
+}
+
+
+/*
+ * Runs inside the caller's epoch critical section, the entry returned stays
+ * readable until "EpochExit()" even if a writer retires it meanwhile.
+ */
+static data_and_itr_t *Find(cache_t *cache, const void *key)
+{
+    data_and_itr_t *data_and_p = NULL;
+
+    ReadLock(cache);
+
+    /*contains data and iitr_t iterator*/
+    data_and_p = (data_and_itr_t*)IndexFind(cache->hash_table,key);
+
+    /*an expired entry is a miss, it stays until swept, evicted or set*/
+    if(NULL != data_and_p && IsExpired(
+                __atomic_load_n(&data_and_p->expires, __ATOMIC_RELAXED)))
+    {
+        data_and_p = NULL;
+    }
+
+    /*only counted with namespaces, the counters are shared by all threads*/
+    if(NULL != cache->ns_func)
+    {
+        if(NULL != data_and_p)
+        {
+            __atomic_add_fetch(&data_and_p->space->hits, 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            __atomic_add_fetch(&SpaceOf(cache, key)->misses, 1,
+                                                        __ATOMIC_RELAXED);
+        }
+    }
+
+    if(NULL != data_and_p)
+    {
+        /*update priority LRU - buffered, replayed under lru_lock*/
+        if(ReadBufRecord(cache->read_buf, data_and_p) &&
+                            0 == pthread_mutex_trylock(&cache->lru_lock))
+        {
+            ReadBufDrain(cache->read_buf, Promote, cache);
+            pthread_mutex_unlock(&cache->lru_lock);
+        }
+    }
+
+    ReadUnlock(cache);
+
+    return data_and_p;
+}
+
+/*
+ * Secondary hit, promote it back to the primary LRU. Only if the key is
+ * still missing: a write that raced with the miss is newer than the copy.
+ */
+static void *TakeFromTier(cache_t *cache, void *key)
+{
+    void *stored_key = NULL;
+    void *data = cache->tier_take(cache->tier, key, &stored_key);
+
+    if(NULL != data && 0 != CacheCompareAndSet(cache, stored_key, 0, data))
+    {
+        cache->release(stored_key, data, cache->release_params);
+        data = NULL;
+    }
+
+    return data;
+}
+
+/*
+ * Takes the copy of 'key' out of the tier and releases it, a write or a
+ * remove makes it stale and it would come back on the next miss.
+ * Returns 1 if there was one.
+ */
+static int DropFromTier(cache_t *cache, const void *key)
+{
+    void *stored_key = NULL;
+    void *data = NULL;
+
+    if(NULL == cache->tier_take)
+    {
+        return 0;
+    }
+
+    data = cache->tier_take(cache->tier, key, &stored_key);
+    if(NULL == data)
+    {
+        return 0;
+    }
+    cache->release(stored_key, data, cache->release_params);
+
+    return 1;
+}
+
+
+void *CacheGet(cache_t *cache, void *key)
+{
+    data_and_itr_t *data_and_p = NULL;
+    void *data = NULL;
+    int front_enabled = 0;
+    size_t version = 0;
+    size_t hash = 0;
+
+    assert(cache);
+    assert(key);
+
+    if(NULL != cache->hot_keys)
+    {
+        TopKAdd(cache->hot_keys, key);
+    }
+
+    EpochEnter(cache->epoch);
+
+    front_enabled = __atomic_load_n(&cache->front_enabled, __ATOMIC_RELAXED);
+    if(front_enabled)
+    {
+        hash = cache->hash_func(key);
+        data = FrontGet(cache, key, hash);
+        if(NULL != data)
+        {
+            if(NULL != cache->ns_func)
+            {
+                __atomic_add_fetch(&SpaceOf(cache, key)->hits, 1,
+                                                        __ATOMIC_RELAXED);
+            }
+            EpochExit(cache->epoch);
+            return data;
+        }
+
+        /*read before the lookup, a racing write leaves the slot stale*/
+        version = __atomic_load_n(Version(cache, hash), __ATOMIC_ACQUIRE);
+    }
+    
+    data_and_p = Find(cache, key);
+    if(NULL != data_and_p)
+    {
+        data = __atomic_load_n(&data_and_p->value, __ATOMIC_ACQUIRE)->data;
+
+        if(front_enabled)
+        {
+            FrontFill(cache, data_and_p->key, hash, data, version,
+                    __atomic_load_n(&data_and_p->expires, __ATOMIC_RELAXED));
+        }
+    }
+
+    EpochExit(cache->epoch);
+
+    if(NULL == data_and_p && NULL != cache->tier_take)
+    {
+        data = TakeFromTier(cache, key);
+    }
+
+    /*return data that matches key, NULL on Cache Miss*/
+    return data;
+}
+
+/*
+ * Called under both locks. Moves a few buckets of a growing index and
+ * starts growing it once 'limit' outgrew it.
+ * Returns 1 while buckets are left to move.
+ */
+static int StepIndex(cache_t *cache, size_t buckets)
+{
+    cache->index_growing = 0 != IndexMigrate(cache->hash_table, buckets);
+
+    if(!cache->index_growing && cache->limit * FACTOR > cache->index_size &&
+                                        0 == IndexGrow(cache->hash_table))
+    {
+        cache->index_size *= 2;
+        cache->index_growing = 1;
+    }
+
+    return cache->index_growing;
+}
+
+/*wakes the maintenance thread up before its tick, the limit was crossed*/
+static void Kick(maintenance_t *maint)
+{
+    pthread_mutex_lock(&maint->lock);
+    maint->kicked = 1;
+    pthread_cond_signal(&maint->cond);
+    pthread_mutex_unlock(&maint->lock);
+}
+
+/*lists a written entry for the next flush, once however often it is set*/
+static void MarkDirty(cache_t *cache, data_and_itr_t *entry)
+{
+    if(NULL == cache->write_back)
+    {
+        return;
+    }
+
+    /*a full batch is flushed before the tick*/
+    if(WriteBackMark(cache->write_back, entry) && NULL != cache->maintenance)
+    {
+        Kick(cache->maintenance);
+    }
+    PolicyDirty(cache->policy, entry);
+}
+
+/*
+ * Maps 'key' to 'data' under both locks, the entry gets a new version and
+ * 'weight' (see "CacheSetWithCost()"). Returns the entry, NULL if there was
+ * no memory for it. An owned 'key' may be released already when an entry
+ * of it existed, the entry's key stands for it then.
+ */
+static data_and_itr_t *Store(cache_t *cache, void *key, void *data,
+        data_and_itr_t *data_and_itr, uint64_t expires, double weight)
+{
+    uint64_t version = ++cache->last_version;
+    size_t limit = cache->limit;
+    space_t *space = NULL != cache->slab ?
+                cache->spaces[SlabClassOf(data)] : SpaceOf(cache, key);
+    data_and_itr_t *victim = NULL;
+    iitr_t itr = ILIST_END;
+
+    if((NULL != cache->write_back && 0 != WriteBackReserve(cache->write_back))
+                                    || 0 != PolicyReserve(cache->policy))
+    {
+        return NULL;
+    }
+
+    if(NULL != data_and_itr)
+    {
+        cache_handle_t *old_value = data_and_itr->value;
+
+        if(old_value->data != data)
+        {
+            cache_handle_t *value = NewValue(data);
+
+            if(NULL == value)
+            {
+                return NULL;
+            }
+
+            /*the old value may still be read or pinned*/
+            Disown(cache, data_and_itr);
+            __atomic_store_n(&data_and_itr->value, value, __ATOMIC_RELEASE);
+            RetireValue(cache, old_value);
+            if(NULL != cache->slab)
+            {
+                SlabSetOwner(data, data_and_itr);
+            }
+        }
+
+        /*data first: a reader that sees the new version sees its data*/
+        __atomic_store_n(&data_and_itr->expires, expires, __ATOMIC_RELAXED);
+        __atomic_store_n(&data_and_itr->version, version, __ATOMIC_RELEASE);
+        BumpVersion(cache, key);
+        data_and_itr->weight = weight;
+
+        /*
+         * A copy of another size moves to the LRU list of its slab class.
+         * Without a node there it stays where it is, evicting it frees a
+         * chunk of the other class.
+         */
+        itr = space == data_and_itr->space ? ILIST_END :
+                                    IListPushBack(space->list, data_and_itr);
+        if(ILIST_END != itr)
+        {
+            IListRemove(data_and_itr->space->list, data_and_itr->itr);
+            --data_and_itr->space->size;
+            data_and_itr->space = space;
+            ++space->size;
+            data_and_itr->itr = itr;
+        }
+        else
+        {
+            PolicyHit(cache->policy, data_and_itr);
+        }
+        MarkDirty(cache, data_and_itr);
+        Emit(cache, CACHE_EVENT_UPDATE, data_and_itr);
+
+        /*the new key was never visible*/
+        if(NULL != cache->release && key != data_and_itr->key)
+        {
+            cache->release(key, NULL, cache->release_params);
+        }
+
+        return data_and_itr;
+    }
+
+    data_and_itr = (data_and_itr_t*)malloc(sizeof(data_and_itr_t));
+    if(NULL == data_and_itr || NULL == (data_and_itr->value = NewValue(data)))
+    {
+        free(data_and_itr);
+        return NULL;
+    }
+
+    __atomic_add_fetch(&space->sets, 1, __ATOMIC_RELAXED);
+
+    data_and_itr->key = key;
+    data_and_itr->version = version;
+    data_and_itr->expires = expires;
+    data_and_itr->space = space;
+    data_and_itr->dirty = 0;
+    data_and_itr->members = NULL;
+    data_and_itr->n_members = 0;
+    data_and_itr->weight = weight;
+    PolicyAdmit(cache->policy, data_and_itr, cache->limit);
+
+    if(NULL != cache->maintenance)
+    {
+        /*the thread evicts in batches, writers only at the hard limit*/
+        if(cache->size == limit)
+        {
+            Kick(cache->maintenance);
+        }
+        limit = HARD_LIMIT(limit);
+    }
+    else if(cache->index_growing)
+    {
+        StepIndex(cache, MIGRATE_STEP);
+    }
+
+    /*evict first, a victim of the same namespace leaves its node free*/
+    if(cache->size >= limit ||
+                    (0 != space->quota && space->size >= space->quota))
+    {
+        /*Cache Miss*/
+        victim = PopVictim(cache, VictimSpace(cache, space));
+    }
+
+    if(NULL != victim)
+    {
+        IndexRemove(cache->hash_table,victim->key);
+        BumpVersion(cache, victim->key);
+        DropEntry(cache, victim);
+    }
+    else
+    {
+        /*past the limit if all it found was dirty, until the next flush*/
+        ++cache->size;
+    }
+
+    ++space->size;
+    /*after the eviction, which may have moved the clock of GDSF*/
+    if(0 != PolicyInsert(cache->policy, data_and_itr))
+    {
+        /*no node for it, a victim evicted for it stays evicted*/
+        --space->size;
+        --cache->size;
+        free(data_and_itr->value);
+        free(data_and_itr);
+        return NULL;
+    }
+    if(0 != IndexInsert(cache->hash_table , key , data_and_itr))
+    {
+        /*no memory for the index node, taken back out of its list*/
+        PolicyRemove(cache->policy, data_and_itr);
+        --space->size;
+        --cache->size;
+        free(data_and_itr->value);
+        free(data_and_itr);
+        return NULL;
+    }
+    PolicyTrim(cache->policy, space, cache->limit);
+    if(NULL != cache->slab)
+    {
+        SlabSetOwner(data, data_and_itr);
+    }
+    MarkDirty(cache, data_and_itr);
+    Emit(cache, CACHE_EVENT_INSERT, data_and_itr);
+
+    return data_and_itr;
+}
+
+/*
+ * Evicts a few of the least recently used entries of a full slab class.
+ * Returns 1 if the class has no chunk in use, none can come free then.
+ */
+static int MakeRoom(cache_t *cache, size_t class_id)
+{
+    space_t *space = cache->spaces[class_id];
+    slab_class_stats_t stats;
+    int blocked = 0;
+    size_t i = 0;
+
+    SlabClassStats(cache->slab, class_id, &stats);
+    if(0 == stats.used)
+    {
+        return 1;
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    for(i = 0 ; i < ROOM_BATCH && 0 != space->size ; i++)
+    {
+        data_and_itr_t *victim = PopVictim(cache, space);
+
+        if(NULL == victim)
+        {
+            break;
+        }
+        IndexRemove(cache->hash_table, victim->key);
+        BumpVersion(cache, victim->key);
+        DropEntry(cache, victim);
+        --cache->size;
+    }
+
+    /*chunks of earlier rounds come back once no reader sees them*/
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    return 0;
+}
+
+/*
+ * Copies 'data' into a chunk of its slab class. A full class evicts its own
+ * entries, their chunks are only freed once no reader can see them, so it
+ * takes a few rounds with the locks let go in between.
+ * Returns NULL if no class fits 'data' or no chunk came free.
+ */
+static void *CopyIn(cache_t *cache, const void *data)
+{
+    size_t size = cache->data_size(data);
+    size_t class_id = SlabClassFor(cache->slab, size);
+    void *chunk = NULL;
+    int tries = 0;
+
+    if(SlabClasses(cache->slab) == class_id)
+    {
+        return NULL;
+    }
+
+    while(NULL == (chunk = SlabAlloc(cache->slab, class_id)) &&
+                    tries++ < ROOM_TRIES && 0 == MakeRoom(cache, class_id))
+    {
+    }
+
+    if(NULL != chunk)
+    {
+        memcpy(chunk, data, size);
+    }
+
+    return chunk;
+}
+
+/*
+ * The data of 'key' could not be copied: its old entry is deleted rather
+ * than left stale, and 'key' is let go.
+ */
+static void Forget(cache_t *cache, void *key)
+{
+    data_and_itr_t *data_and_itr = NULL;
+    int blocked = 0;
+    int kept = 0;
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    data_and_itr = (data_and_itr_t*)IndexFind(cache->hash_table, key);
+    if(NULL != data_and_itr)
+    {
+        kept = key == data_and_itr->key;
+        Delete(cache, data_and_itr, CACHE_EVENT_REMOVE);
+    }
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    if(NULL != cache->release && !kept)
+    {
+        cache->release(key, NULL, cache->release_params);
+    }
+}
+
+/*called back by "WriteBackPut()" for the entries it wrote, clean now*/
+static int CleanEntry(void *data, void *user_params)
+{
+    PolicyClean(((cache_t*)user_params)->policy, (data_and_itr_t*)data);
+
+    return 0;
+}
+
+/*
+ * Writes the entries dirty so far through the flush function, in batches.
+ * Entries set again meanwhile, and those of a batch that failed, stay dirty.
+ * No lock of the cache is held while writing: the data written is pinned
+ * like by a handle, and entries deleted meanwhile are retired once done.
+ * Returns 1 if a batch failed, or if there was no memory to start.
+ */
+static int Flush(cache_t *cache)
+{
+    write_back_t *wb = cache->write_back;
+    int failed = 0;
+
+    WriteBackBegin(wb);
+
+    pthread_mutex_lock(&cache->lru_lock);
+    failed = WriteBackTake(wb);
+    pthread_mutex_unlock(&cache->lru_lock);
+
+    if(!failed)
+    {
+        failed = WriteBackWrite(wb);
+
+        pthread_rwlock_rdlock(&cache->lock);
+        pthread_mutex_lock(&cache->lru_lock);
+        WriteBackPut(wb, RetireEntry, CleanEntry, cache);
+        pthread_mutex_unlock(&cache->lru_lock);
+        pthread_rwlock_unlock(&cache->lock);
+    }
+
+    WriteBackEnd(wb, FreeValue, cache);
+
+    return failed;
+}
+
+/*without a maintenance thread the writer that fills a batch flushes it*/
+static int WriterFlushes(const cache_t *cache)
+{
+    return NULL != cache->write_back && NULL == cache->maintenance &&
+                                        WriteBackIsFull(cache->write_back);
+}
+
+static void Set(cache_t *cache, void *key, void *data, uint64_t expires,
+                        const size_t *tags, size_t n_tags, double weight)
+{
+    data_and_itr_t *data_and_itr = NULL;
+    int blocked = 0;
+    int flush = 0;
+
+    if(NULL != cache->hot_keys)
+    {
+        TopKAdd(cache->hot_keys, key);
+    }
+
+    if(NULL != cache->slab)
+    {
+        data = CopyIn(cache, data);
+        if(NULL == data)
+        {
+            Forget(cache, key);
+            return;
+        }
+    }
+
+    DropFromTier(cache, key);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    /*replay pending hits before choosing a victim*/
+    blocked = DrainHits(cache);
+
+    data_and_itr = Store(cache, key, data,
+        (data_and_itr_t*)IndexFind(cache->hash_table, key), expires, weight);
+    if(NULL == data_and_itr)
+    {
+        if(NULL != cache->slab)
+        {
+            SlabFree(cache->slab, data);
+        }
+    }
+    else if(NULL != cache->tags || 0 != n_tags)
+    {
+        /*the tags of a write replace the old ones, none for a plain set*/
+        if(0 != Tag(cache, data_and_itr, tags, n_tags))
+        {
+            Delete(cache, data_and_itr, CACHE_EVENT_REMOVE);
+        }
+    }
+    flush = WriterFlushes(cache);
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    if(flush)
+    {
+        Flush(cache);
+    }
+}
+
+void CacheSet(cache_t *cache, void *key , void *data)
+{
+    assert(cache);
+    assert(key);
+    assert(data);
+
+    Set(cache, key, data, 0, NULL, 0, 1);
+}
+
+void CacheSetTagged(cache_t *cache, void *key, void *data,
+                                        const size_t *tags, size_t n_tags)
+{
+    assert(cache);
+    assert(key);
+    assert(data);
+    assert(tags || 0 == n_tags);
+
+    Set(cache, key, data, 0, tags, n_tags, 1);
+}
+
+void CacheSetWithCost(cache_t *cache, void *key, void *data, double cost,
+                                                                size_t size)
+{
+    assert(cache);
+    assert(key);
+    assert(data);
+    assert(0 <= cost);
+
+    Set(cache, key, data, 0, NULL, 0, cost / (0 == size ? 1 : size));
+}
+
+size_t CacheInvalidateTag(cache_t *cache, size_t tag)
+{
+    tag_t *found = NULL;
+    size_t removed = 0;
+    int blocked = 0;
+
+    assert(cache);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    /*each delete unlinks all memberships of its entry, the last one the tag*/
+    while(NULL != cache->tags &&
+                NULL != (found = (tag_t*)HashFind(cache->tags, &tag)))
+    {
+        Delete(cache, found->members.next->entry, CACHE_EVENT_INVALIDATE);
+        ++removed;
+    }
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    return removed;
+}
+
+void CacheSetWithTTL(cache_t *cache, void *key, void *data,
+                                                    unsigned long ttl_ms)
+{
+    assert(cache);
+    assert(key);
+    assert(data);
+
+    if(0 == ttl_ms)
+    {
+        Set(cache, key, data, 0, NULL, 0, 1);
+        return;
+    }
+
+    if(!__atomic_load_n(&cache->has_ttl, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&cache->has_ttl, 1, __ATOMIC_RELAXED);
+    }
+
+    Set(cache, key, data, NowMs() + ttl_ms, NULL, 0, 1);
+}
+
+int CacheCompareAndSet(cache_t *cache, void *key, uint64_t expected_version,
+                                                            void *new_data)
+{
+    data_and_itr_t *data_and_itr = NULL;
+    int blocked = 0;
+    int status = 1;
+    int live = 0;
+    int flush = 0;
+
+    assert(cache);
+    assert(key);
+    assert(new_data);
+
+    if(NULL != cache->hot_keys)
+    {
+        TopKAdd(cache->hot_keys, key);
+    }
+
+    if(NULL != cache->slab)
+    {
+        new_data = CopyIn(cache, new_data);
+        if(NULL == new_data)
+        {
+            return 1;
+        }
+    }
+
+    /*empty for a promotion from the tier, which took the copy already*/
+    DropFromTier(cache, key);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    /*version 0 expects no entry at all, an expired one is none*/
+    data_and_itr = (data_and_itr_t*)IndexFind(cache->hash_table, key);
+    live = NULL != data_and_itr && !IsExpired(data_and_itr->expires);
+    if((!live && 0 == expected_version) ||
+                (live && expected_version == data_and_itr->version))
+    {
+        status = NULL == Store(cache, key, new_data, data_and_itr, 0,
+                            NULL != data_and_itr ? data_and_itr->weight : 1);
+    }
+
+    if(0 != status && NULL != cache->slab)
+    {
+        SlabFree(cache->slab, new_data);
+    }
+    flush = WriterFlushes(cache);
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    if(flush)
+    {
+        Flush(cache);
+    }
+
+    return status;
+}
+
+void *CacheGetVersioned(cache_t *cache, void *key, uint64_t *version)
+{
+    data_and_itr_t *data_and_p = NULL;
+    void *data = NULL;
+
+    assert(cache);
+    assert(key);
+    assert(version);
+
+    if(NULL != cache->hot_keys)
+    {
+        TopKAdd(cache->hot_keys, key);
+    }
+
+    EpochEnter(cache->epoch);
+
+    /*
+     * Version first: the data read after it is at least as new, so a stale
+     * pair can only make a compare-and-set fail, never let it through.
+     */
+    data_and_p = Find(cache, key);
+    if(NULL != data_and_p)
+    {
+        *version = __atomic_load_n(&data_and_p->version, __ATOMIC_ACQUIRE);
+        data = __atomic_load_n(&data_and_p->value, __ATOMIC_ACQUIRE)->data;
+    }
+
+    EpochExit(cache->epoch);
+
+    if(NULL == data_and_p && NULL != cache->tier_take)
+    {
+        /*promoted, look it up again for the version it got*/
+        if(NULL != TakeFromTier(cache, key))
+        {
+            return CacheGetVersioned(cache, key, version);
+        }
+    }
+
+    if(NULL == data_and_p)
+    {
+        *version = 0;
+    }
+
+    return data;
+}
+
+int CacheVisit(cache_t *cache, void *key, cache_scan_func_t visit_func,
+                                                        void *user_params)
+{
+    data_and_itr_t *data_and_p = NULL;
+    int tries = 0;
+
+    assert(cache);
+    assert(key);
+    assert(visit_func);
+
+    if(NULL != cache->hot_keys)
+    {
+        TopKAdd(cache->hot_keys, key);
+    }
+
+    for(tries = 0 ; tries < 2 && NULL == data_and_p ; tries++)
+    {
+        /*on a secondary hit the promoted entry is looked up again*/
+        if(tries > 0 && (NULL == cache->tier_take ||
+                                        NULL == TakeFromTier(cache, key)))
+        {
+            break;
+        }
+
+        EpochEnter(cache->epoch);
+
+        data_and_p = Find(cache, key);
+        if(NULL != data_and_p)
+        {
+            visit_func(data_and_p->key,
+                    __atomic_load_n(&data_and_p->value, __ATOMIC_ACQUIRE)->data,
+                    user_params);
+        }
+
+        EpochExit(cache->epoch);
+    }
+
+    return NULL == data_and_p;
+}
+
+cache_handle_t *CacheAcquire(cache_t *cache, void *key)
+{
+    data_and_itr_t *data_and_p = NULL;
+    cache_handle_t *handle = NULL;
+    int tries = 0;
+
+    assert(cache);
+    assert(key);
+
+    if(NULL != cache->hot_keys)
+    {
+        TopKAdd(cache->hot_keys, key);
+    }
+
+    for(tries = 0 ; tries < 2 && NULL == handle ; tries++)
+    {
+        /*on a secondary hit the promoted entry is looked up again*/
+        if(tries > 0 && (NULL == cache->tier_take ||
+                                        NULL == TakeFromTier(cache, key)))
+        {
+            break;
+        }
+
+        EpochEnter(cache->epoch);
+
+        /*the entry's own reference is only dropped after EpochExit()*/
+        data_and_p = Find(cache, key);
+        if(NULL != data_and_p)
+        {
+            handle = __atomic_load_n(&data_and_p->value, __ATOMIC_ACQUIRE);
+            __atomic_add_fetch(&handle->refs, 1, __ATOMIC_RELAXED);
+        }
+
+        EpochExit(cache->epoch);
+    }
+
+    return handle;
+}
+
+void *CacheHandleData(const cache_handle_t *handle)
+{
+    assert(handle);
+
+    return handle->data;
+}
+
+void CacheRelease(cache_t *cache, cache_handle_t *handle)
+{
+    assert(cache);
+    assert(handle);
+
+    Unpin(cache, handle, NULL);
+}
+
+int CacheRemove(cache_t *cache, const void *key)
+{
+    data_and_itr_t *data_and_itr = NULL;
+    int blocked = 0;
+
+    assert(cache);
+    assert(key);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    data_and_itr = (data_and_itr_t*)IndexFind(cache->hash_table, key);
+    if(NULL != data_and_itr)
+    {
+        Delete(cache, data_and_itr, CACHE_EVENT_REMOVE);
+    }
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    /*an evicted copy may be left from before the entry was set again*/
+    if(DropFromTier(cache, key))
+    {
+        return 0;
+    }
+
+    return NULL == data_and_itr;
+}
 
-struct cache
+void CacheSetCapacity(cache_t *cache, size_t capacity)
 {
-	hash_t *hash_table;
-    dlist_t *linked_list;
-    size_t hash_capacity;
-    size_t size;
-};
+    int blocked = 0;
+
+    assert(cache);
+
+    if(0 == capacity)
+    {
+        capacity = 1;
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    __atomic_store_n(&cache->limit, capacity, __ATOMIC_RELAXED);
+    if(cache->size > cache->limit)
+    {
+        EvictBatch(cache, cache->size - cache->limit);
+    }
 
-typedef struct DataAndItr
+    /*a larger cache gets a larger index, moved over by later writes*/
+    StepIndex(cache, 0);
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    /*frees batches retired by this or earlier calls, off the writers' path*/
+    FreeReaped(cache);
+}
+
+
+size_t CacheGetCapacity(cache_t *cache)
 {
-    void *data;
-    ditr_t itr;
+    assert(cache);
 
-}data_and_itr_t;
+    return __atomic_load_n(&cache->limit, __ATOMIC_RELAXED);
+}
 
 
-cache_t *CacheCreate(size_t capacity ,hash_func_t hash_func , is_match_func_t match)
+static int ScanEntry(void *data, void *user_params)
 {
-    cache_t *cache = (cache_t*)malloc(sizeof(cache_t));
-   
-    if(NULL == cache)
+    data_and_itr_t *entry = (data_and_itr_t*)data;
+    scan_params_t *params = (scan_params_t*)user_params;
+
+    if(IsExpired(__atomic_load_n(&entry->expires, __ATOMIC_RELAXED)))
     {
-        return NULL;
+        return 0;
     }
-    
-    cache->hash_table = HashCreate(capacity * FACTOR,hash_func, match);
-    cache->linked_list = DListCreate();
-    cache->size = 0;
-    cache->hash_capacity = capacity * FACTOR;
 
-    return cache;
+    return params->scan_func(entry->key,
+                    __atomic_load_n(&entry->value, __ATOMIC_ACQUIRE)->data,
+                    params->user_params);
 }
 
-
-void *CacheGet(cache_t *cache, void *key)
+size_t CacheScan(cache_t *cache, size_t cursor, size_t count,
+                            cache_scan_func_t scan_func, void *user_params)
 {
+    scan_params_t params;
+
     assert(cache);
-    assert(key);
-    
-    if(cache->size == 0)
+    assert(scan_func);
+
+    params.scan_func = scan_func;
+    params.user_params = user_params;
+
+    /*
+     * Shared lock only: hits go on, writers wait for this one batch. Hits
+     * are not recorded, the scan leaves the LRU order alone.
+     */
+    EpochEnter(cache->epoch);
+    pthread_rwlock_rdlock(&cache->lock);
+
+    cursor = IndexScan(cache->hash_table, cursor, 0 == count ? 1 : count,
+                                                        ScanEntry, &params);
+
+    pthread_rwlock_unlock(&cache->lock);
+    EpochExit(cache->epoch);
+
+    return cursor;
+}
+
+static int CollectExpired(void *data, void *user_params)
+{
+    data_and_itr_t *entry = (data_and_itr_t*)data;
+    maintenance_t *maint = (maintenance_t*)user_params;
+
+    if(!IsExpired(__atomic_load_n(&entry->expires, __ATOMIC_RELAXED)))
     {
-        return NULL;
+        return 0;
     }
-    else
+
+    if(maint->n_expired == maint->expired_cap)
     {
-        /*contains data and ditr_t iterator*/
-        data_and_itr_t *data_and_p = (data_and_itr_t*)HashFind(cache->hash_table,key);
+        size_t cap = 0 == maint->expired_cap ? 64 : maint->expired_cap * 2;
+        data_and_itr_t **expired = (data_and_itr_t**)realloc(maint->expired,
+                                            cap * sizeof(data_and_itr_t*));
 
-        if(NULL == data_and_p)
+        if(NULL == expired)
         {
-            return NULL; /*Cache Miss*/
+            return 0; /*found again by the next sweep*/
         }
-        
-        /*update priority LRU*/
-        DListRemove(data_and_p->itr);
-        DListPushBack(cache->linked_list, key);
-    
-        /*return data that matches key*/
-        return data_and_p->data;
+        maint->expired = expired;
+        maint->expired_cap = cap;
     }
+
+    maint->expired[maint->n_expired++] = entry;
+
+    return 0;
 }
 
-void CacheSet(cache_t *cache, void *key , void *data)
+/*
+ * Deletes the expired entries of the next few index buckets. They are found
+ * under the shared lock and deleted under the exclusive one, the epoch
+ * keeps them readable in between. It is left once both locks are held:
+ * nobody reclaims without 'lru_lock', and the deletes retire entries.
+ */
+static void SweepExpired(cache_t *cache, maintenance_t *maint)
 {
-    
-    data_and_itr_t *data_and_itr = (data_and_itr_t*)malloc(sizeof(data_and_itr_t));
+    size_t i = 0;
+    int blocked = 0;
+
+    maint->n_expired = 0;
+
+    EpochEnter(cache->epoch);
+
+    pthread_rwlock_rdlock(&cache->lock);
+    maint->sweep_cursor = IndexScan(cache->hash_table, maint->sweep_cursor,
+                                        SWEEP_STEP, CollectExpired, maint);
+    pthread_rwlock_unlock(&cache->lock);
+
+    if(0 == maint->n_expired)
+    {
+        EpochExit(cache->epoch);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    EpochExit(cache->epoch);
+
+    blocked = DrainHits(cache);
+
+    for(i = 0 ; i < maint->n_expired ; i++)
+    {
+        data_and_itr_t *entry = maint->expired[i];
+
+        /*it may have been deleted, or set again, meanwhile*/
+        if(entry == IndexFind(cache->hash_table, entry->key) &&
+                                                IsExpired(entry->expires))
+        {
+            Delete(cache, entry, CACHE_EVENT_EXPIRE);
+        }
+    }
+
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+/*called under 'lru_lock', the caller frees what it returns off the locks*/
+static dead_t *TakeDead(maintenance_t *maint, size_t *n_dead)
+{
+    dead_t *dead = maint->dead;
+
+    *n_dead = maint->n_dead;
+    maint->dead = NULL;
+    maint->n_dead = 0;
+    maint->dead_cap = 0;
+
+    return dead;
+}
+
+static void FreeDead(cache_t *cache, dead_t *dead, size_t n_dead)
+{
+    size_t i = 0;
+
+    for(i = 0 ; i < n_dead ; i++)
+    {
+        dead[i].free_func(dead[i].ptr, cache);
+    }
+
+    free(dead);
+}
+
+/*
+ * Moves a page of slab memory to the class that ran out of chunks the most
+ * often since the last round (each time costs it evictions), from the class
+ * with the most pages among those that did not run out for a while. Classes
+ * that all run out keep their pages rather than pass them around.
+ */
+static void Rebalance(cache_t *cache, maintenance_t *maint)
+{
+    size_t n_classes = SlabClasses(cache->slab);
+    size_t from = n_classes;
+    size_t to = n_classes;
+    size_t most_demand = 0;
+    size_t most_pages = 1;
+    size_t i = 0;
+    int blocked = 0;
+
+    if(NULL == maint->demand)
+    {
+        maint->demand = (demand_t*)calloc(n_classes, sizeof(demand_t));
+        if(NULL == maint->demand)
+        {
+            return;
+        }
+    }
+
+    for(i = 0 ; i < n_classes ; i++)
+    {
+        slab_class_stats_t stats;
+        size_t delta = 0;
+
+        SlabClassStats(cache->slab, i, &stats);
+        delta = stats.failures - maint->demand[i].failures;
+        maint->demand[i].failures = stats.failures;
+        maint->demand[i].quiet = 0 == delta ? maint->demand[i].quiet + 1 : 0;
+
+        if(delta > most_demand)
+        {
+            most_demand = delta;
+            to = i;
+        }
+        else if(maint->demand[i].quiet >= QUIET_ROUNDS &&
+                                                stats.pages > most_pages)
+        {
+            most_pages = stats.pages;
+            from = i;
+        }
+    }
+
+    if(n_classes == to || n_classes == from)
+    {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+    SlabMovePage(cache->slab, from, to, EvictOwner, cache);
+    ReclaimEntries(cache, blocked);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+/*
+ * A full batch, a dirty entry older than the interval, or dirty entries
+ * holding the cache past its limit call for a flush.
+ */
+static int FlushDue(cache_t *cache)
+{
+    int due = 0;
+
+    pthread_mutex_lock(&cache->lru_lock);
+    due = WriteBackIsDue(cache->write_back, cache->size > cache->limit);
+    pthread_mutex_unlock(&cache->lru_lock);
+
+    return due;
+}
+
+/*one round of the maintenance thread*/
+static void Maintain(cache_t *cache, maintenance_t *maint)
+{
+    dead_t *dead = NULL;
+    size_t n_dead = 0;
+    int busy = 0;
+
+    /*first, so flushed entries can be evicted this round*/
+    if(NULL != cache->write_back && FlushDue(cache))
+    {
+        Flush(cache);
+    }
+
+    if(__atomic_load_n(&cache->has_ttl, __ATOMIC_RELAXED))
+    {
+        SweepExpired(cache, maint);
+    }
+
+    if(NULL != cache->slab)
+    {
+        Rebalance(cache, maint);
+    }
+
+    pthread_mutex_lock(&cache->lru_lock);
+    busy = cache->size > cache->limit || cache->index_growing ||
+                                cache->limit * FACTOR > cache->index_size;
+    pthread_mutex_unlock(&cache->lru_lock);
+
+    /*the index is moved in steps, writers get the locks in between*/
+    while(busy && !__atomic_load_n(&maint->stop, __ATOMIC_RELAXED))
+    {
+        int blocked = 0;
+
+        pthread_rwlock_wrlock(&cache->lock);
+        pthread_mutex_lock(&cache->lru_lock);
+
+        blocked = DrainHits(cache);
+
+        if(cache->size > cache->limit)
+        {
+            EvictBatch(cache, cache->size - LOW_WATERMARK(cache->limit));
+        }
+        busy = StepIndex(cache, MAINTENANCE_MIGRATE_STEP);
+
+        ReclaimEntries(cache, blocked);
+
+        pthread_mutex_unlock(&cache->lru_lock);
+        pthread_rwlock_unlock(&cache->lock);
+    }
+
+    /*entries and values released since the last round, off the locks*/
+    pthread_mutex_lock(&cache->lru_lock);
+    ReclaimEntries(cache, DrainHits(cache));
+    dead = TakeDead(maint, &n_dead);
+    pthread_mutex_unlock(&cache->lru_lock);
+
+    FreeDead(cache, dead, n_dead);
+    FreeReaped(cache);
+}
+
+static void *Maintainer(void *arg)
+{
+    cache_t *cache = (cache_t*)arg;
+    maintenance_t *maint = cache->maintenance;
+
+    pthread_mutex_lock(&maint->lock);
+
+    while(!maint->stop)
+    {
+        struct timespec until;
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += maint->interval_ms / 1000;
+        until.tv_nsec += (long)(maint->interval_ms % 1000) * 1000000;
+        if(until.tv_nsec >= 1000000000)
+        {
+            ++until.tv_sec;
+            until.tv_nsec -= 1000000000;
+        }
+
+        while(!maint->stop && !maint->kicked &&
+            0 == pthread_cond_timedwait(&maint->cond, &maint->lock, &until))
+        {
+        }
+        if(maint->stop)
+        {
+            break;
+        }
+        maint->kicked = 0;
+
+        pthread_mutex_unlock(&maint->lock);
+
+        Maintain(cache, maint);
+
+        pthread_mutex_lock(&maint->lock);
+    }
+
+    pthread_mutex_unlock(&maint->lock);
+
+    return NULL;
+}
+
+static void DestroyMaintenance(maintenance_t *maint)
+{
+    pthread_cond_destroy(&maint->cond);
+    pthread_mutex_destroy(&maint->lock);
+    free(maint->expired);
+    free(maint->demand);
+    free(maint);
+}
+
+int CacheStartMaintenance(cache_t *cache, unsigned interval_ms)
+{
+    maintenance_t *maint = NULL;
+    dead_t *dead = NULL;
+    size_t n_dead = 0;
 
     assert(cache);
-    assert(key);
-    assert(data);
+    assert(NULL == cache->maintenance);
 
-    data_and_itr->data = data;
-    data_and_itr->itr = DListPushBack(cache->linked_list,key);
+    maint = (maintenance_t*)calloc(1, sizeof(maintenance_t));
+    if(NULL == maint)
+    {
+        return 1;
+    }
+
+    maint->interval_ms = 0 == interval_ms ? 1 : interval_ms;
+    pthread_mutex_init(&maint->lock, NULL);
+    pthread_cond_init(&maint->cond, NULL);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+    cache->maintenance = maint;
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
 
-    if(cache->size == cache->hash_capacity)
+    if(0 != pthread_create(&maint->thread, NULL, Maintainer, cache))
     {
-        /*Cache Miss*/
-        void *removeKey = DListPopFront(cache->linked_list);
-        HashRemove(cache->hash_table,removeKey);
+        pthread_rwlock_wrlock(&cache->lock);
+        pthread_mutex_lock(&cache->lru_lock);
+        cache->maintenance = NULL;
+        dead = TakeDead(maint, &n_dead);
+        pthread_mutex_unlock(&cache->lru_lock);
+        pthread_rwlock_unlock(&cache->lock);
+
+        FreeDead(cache, dead, n_dead);
+        DestroyMaintenance(maint);
+
+        return 1;
     }
-    else
+
+    return 0;
+}
+
+void CacheStopMaintenance(cache_t *cache)
+{
+    maintenance_t *maint = NULL;
+    dead_t *dead = NULL;
+    size_t n_dead = 0;
+    int blocked = 0;
+
+    assert(cache);
+
+    maint = cache->maintenance;
+    if(NULL == maint)
     {
-        ++cache->size;
+        return;
+    }
+
+    pthread_mutex_lock(&maint->lock);
+    __atomic_store_n(&maint->stop, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&maint->cond);
+    pthread_mutex_unlock(&maint->lock);
+
+    pthread_join(maint->thread, NULL);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    pthread_mutex_lock(&cache->lru_lock);
+
+    blocked = DrainHits(cache);
+
+    /*writers go back to evicting at the limit, start from there*/
+    cache->maintenance = NULL;
+    if(cache->size > cache->limit)
+    {
+        EvictBatch(cache, cache->size - cache->limit);
     }
 
-    HashInsert(cache->hash_table , key , data_and_itr);
+    ReclaimEntries(cache, blocked);
+    dead = TakeDead(maint, &n_dead);
+
+    pthread_mutex_unlock(&cache->lru_lock);
+    pthread_rwlock_unlock(&cache->lock);
+
+    FreeDead(cache, dead, n_dead);
+    FreeReaped(cache);
+    DestroyMaintenance(maint);
+}
+
+
+int CacheSetWriteBack(cache_t *cache, cache_flush_func_t flush, size_t batch,
+                                unsigned interval_ms, void *user_params)
+{
+    assert(cache);
+    assert(flush);
+    assert(NULL == cache->write_back);
+    assert(NULL == cache->slab);
+
+    cache->write_back = WriteBackCreate(flush, batch, interval_ms,
+                                                            user_params);
+
+    return NULL == cache->write_back;
+}
+
+int CacheFlush(cache_t *cache)
+{
+    assert(cache);
+
+    return NULL == cache->write_back ? 0 : Flush(cache);
+}
+
+int CacheEnableEvents(cache_t *cache, size_t capacity, size_func_t data_size)
+{
+    assert(cache);
+    assert(NULL == cache->events);
+
+    cache->events = RingCreate(capacity, sizeof(cache_event_t));
+    if(NULL == cache->events)
+    {
+        return 1;
+    }
+    cache->event_size = data_size;
+
+    return 0;
+}
+
+size_t CacheDrainEvents(cache_t *cache, cache_event_t *events, size_t n)
+{
+    size_t i = 0;
+
+    assert(cache);
+    assert(events || 0 == n);
+
+    if(NULL == cache->events)
+    {
+        return 0;
+    }
+
+    while(i < n && 0 == RingPop(cache->events, &events[i]))
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+size_t CacheDroppedEvents(cache_t *cache)
+{
+    assert(cache);
+
+    return NULL == cache->events ? 0 : RingDropped(cache->events);
 }
 
+
 void CacheDestroy(cache_t *cache)
 {
-    HashDestroy(cache->hash_table);
-    DListDestroy(cache->linked_list);
+    size_t i = 0;
+
+    CacheStopMaintenance(cache);
+    if(NULL != cache->write_back)
+    {
+        Flush(cache);
+        WriteBackDestroy(cache->write_back);
+    }
+    for(i = 0 ; i < cache->n_spaces ; i++)
+    {
+        ilist_t *list = cache->spaces[i]->list;
+
+        IListForEach(list, IListIterBegin(list), IListIterEnd(list),
+                                                        FreeEntry, cache);
+    }
+    PolicyDestroy(cache->policy, FreeEntry, cache);
+    IndexDestroy(cache->hash_table);
+    ReadBufDestroy(cache->read_buf);
+    EpochDestroy(cache->epoch);
+    FreeStranded(cache);
+    FreeReaped(cache);
+    if(NULL != cache->tags)
+    {
+        HashForEach(cache->tags, FreeItem, NULL);
+        HashDestroy(cache->tags);
+    }
+    for(i = 0 ; i < cache->n_spaces ; i++)
+    {
+        SpaceDestroy(cache->spaces[i]);
+    }
+    free(cache->spaces);
+    if(NULL != cache->slab)
+    {
+        SlabDestroy(cache->slab);
+    }
+    if(NULL != cache->hot_keys)
+    {
+        TopKDestroy(cache->hot_keys);
+    }
+    if(NULL != cache->events)
+    {
+        RingDestroy(cache->events);
+    }
+    free(cache->versions);
+    pthread_rwlock_destroy(&cache->lock);
+    pthread_mutex_destroy(&cache->lru_lock);
     free(cache);cache = NULL;
 }
 
 
+/*demo, build with -DCACHE_NO_MAIN to link the cache into another program*/
+#ifndef CACHE_NO_MAIN
 size_t hash_func(const void *key)
 {
 	char key_val = 0; 
@@ -117,9 +2794,6 @@ size_t hash_func(const void *key)
     key_val = *((char*)key);
     return (size_t)(key_val - 'a');
 }
-     arg.val = argv[2];
-
-        semctl(semid,  0, SETVAL, arg);
 
 int match(const void *data, const void *user_params)
 {
@@ -127,6 +2801,24 @@ int match(const void *data, const void *user_params)
 }
 
 
+static void PrintEnds(cache_t *cache)
+{
+    ilist_t *list = cache->spaces[0]->list;
+    data_and_itr_t *first = NULL;
+    data_and_itr_t *last = NULL;
+
+    pthread_mutex_lock(&cache->lru_lock);
+    ReadBufDrain(cache->read_buf, Promote, cache);
+    first = (data_and_itr_t*)IListGetData(list, IListIterBegin(list));
+    last = (data_and_itr_t*)IListGetData(list,
+                            IListIterPrev(list, IListIterEnd(list)));
+    pthread_mutex_unlock(&cache->lru_lock);
+
+    printf("last one ---- %s\n",(char*)first->key);
+    printf("LRU ---- %s\n",(char*)last->key);
+}
+
+
 int main()
 {
     /* code */
@@ -137,29 +2829,30 @@ int main()
     cache_t *cache =  CacheCreate(13,hash_func, match);
 
     int i = 0;
+    char *data = NULL;
     for (i = 0; i < 26; i++)
     {
        CacheSet(cache, str_arr[i] , str_arr[i]);
     }
     for (i = 0; i < 26; i++)
     {
-        printf("%s\n",CacheGet(cache, str_arr[i]));
+        data = (char*)CacheGet(cache, str_arr[i]);
+        printf("%s\n", NULL != data ? data : "(miss)");
     }
 
-    printf("last one ---- %s\n",(char*)DListPopFront(cache->linked_list));
-    printf("LRU ---- %s\n",(char*)DListPopBack(cache->linked_list));
+    PrintEnds(cache);
 
     CacheSet(cache, str_arr[0] , str_arr[0]);
    
-    printf("last one ---- %s\n",(char*)DListPopFront(cache->linked_list));
-    printf("LRU ---- %s\n",(char*)DListPopBack(cache->linked_list));
+    PrintEnds(cache);
 
-    printf("%s\n",CacheGet(cache, str_arr[10]));
+    data = (char*)CacheGet(cache, str_arr[10]);
+    printf("%s\n", NULL != data ? data : "(miss)");
 
-    printf("last one ---- %s\n",(char*)DListPopFront(cache->linked_list));
-    printf("LRU ---- %s\n",(char*)DListPopBack(cache->linked_list));
+    PrintEnds(cache);
 
     CacheDestroy(cache);
 
     return 0;
 }
+#endif /*CACHE_NO_MAIN*/
@@ -0,0 +1,720 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <stdio.h>		/* snprintf			*/
+#include <string.h>		/* memcpy, strcmp	*/
+#include <stdint.h>		/* uint64_t			*/
+#include <errno.h>		/* errno			*/
+#include <math.h>		/* log				*/
+#include <unistd.h>		/* read, close		*/
+#include <sys/socket.h>	/* socket, sendmsg	*/
+#include <sys/uio.h>	/* iovec			*/
+#include <sys/un.h>		/* sockaddr_un		*/
+
+#include "cache_client.h"
+
+/*a node that went away must not kill the process with SIGPIPE*/
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0		/* SO_NOSIGPIPE is set on the socket instead */
+#endif
+
+enum{
+	MAX_KEY = 250,
+	MAX_LINE = 512,
+	RBUF_SIZE = 16 * 1024
+};
+
+typedef struct node
+{
+	char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+	unsigned weight;
+	uint64_t seed;
+	int fd;					/* -1 until first use or after a failure */
+	char rbuf[RBUF_SIZE];
+	size_t rpos;
+	size_t rlen;
+}node_t;
+
+struct cache_client
+{
+	node_t **nodes;
+	size_t n_nodes;
+};
+
+
+static uint64_t Fnv1a(const char *str)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while('\0' != *str)
+	{
+		hash ^= (unsigned char)*str++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t Mix(uint64_t hash)
+{
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+/*
+ * Weighted rendezvous hashing: every node scores the key with
+ * weight / -ln(u), u uniform in (0, 1) from hashing the key with the node,
+ * the best score wins. A node's keys only move when that node comes or goes.
+ */
+static long Pick(const cache_client_t *client, const char *key)
+{
+	uint64_t key_hash = Fnv1a(key);
+	double best = -1;
+	long pick = -1;
+	size_t i = 0;
+
+	for(i = 0 ; i < client->n_nodes ; i++)
+	{
+		uint64_t hash = Mix(key_hash ^ client->nodes[i]->seed);
+		double u = ((double)(hash >> 11) + 0.5) / 9007199254740992.0;
+		double score = (double)client->nodes[i]->weight / -log(u);
+
+		if(score > best)
+		{
+			best = score;
+			pick = (long)i;
+		}
+	}
+
+	return pick;
+}
+
+static int IsValidKey(const char *key)
+{
+	size_t len = 0;
+
+	for(len = 0 ; '\0' != key[len] ; len++)
+	{
+		if((unsigned char)key[len] <= ' ' || 127 == (unsigned char)key[len])
+		{
+			return 0;
+		}
+	}
+
+	return len > 0 && len <= MAX_KEY;
+}
+
+static void Fail(node_t *node)
+{
+	if(node->fd >= 0)
+	{
+		close(node->fd);
+	}
+	node->fd = -1;
+	node->rpos = 0;
+	node->rlen = 0;
+}
+
+static int Connect(node_t *node)
+{
+	struct sockaddr_un addr;
+
+	if(node->fd >= 0)
+	{
+		return 0;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, node->path, sizeof(addr.sun_path));
+
+	node->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(node->fd < 0)
+	{
+		return 1;
+	}
+
+#ifdef SO_NOSIGPIPE
+	{
+		int on = 1;
+
+		if(0 != setsockopt(node->fd, SOL_SOCKET, SO_NOSIGPIPE, &on,
+																sizeof(on)))
+		{
+			Fail(node);
+			return 1;
+		}
+	}
+#endif
+
+	if(0 != connect(node->fd, (struct sockaddr*)&addr, sizeof(addr)))
+	{
+		Fail(node);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int WriteAll(node_t *node, struct iovec *iov, int cnt)
+{
+	while(cnt > 0)
+	{
+		struct msghdr msg;
+		ssize_t done = 0;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = cnt;
+		done = sendmsg(node->fd, &msg, MSG_NOSIGNAL);
+
+		if(done < 0 && EINTR == errno)
+		{
+			continue;
+		}
+		if(done < 0)
+		{
+			return 1;
+		}
+
+		while(cnt > 0 && (size_t)done >= iov->iov_len)
+		{
+			done -= (ssize_t)iov->iov_len;
+			++iov;
+			--cnt;
+		}
+		if(cnt > 0)
+		{
+			iov->iov_base = (char*)iov->iov_base + done;
+			iov->iov_len -= (size_t)done;
+		}
+	}
+
+	return 0;
+}
+
+static int Fill(node_t *node)
+{
+	ssize_t done = 0;
+
+	if(node->rpos == node->rlen)
+	{
+		node->rpos = 0;
+		node->rlen = 0;
+	}
+	else if(node->rpos > 0)
+	{
+		memmove(node->rbuf, node->rbuf + node->rpos, node->rlen - node->rpos);
+		node->rlen -= node->rpos;
+		node->rpos = 0;
+	}
+
+	do
+	{
+		done = read(node->fd, node->rbuf + node->rlen, RBUF_SIZE - node->rlen);
+	}while(done < 0 && EINTR == errno);
+
+	if(done <= 0)
+	{
+		return 1;
+	}
+
+	node->rlen += (size_t)done;
+
+	return 0;
+}
+
+/*reads a line without its "\r\n" into 'line', returns 1 on failure*/
+static int ReadLine(node_t *node, char *line)
+{
+	for(;;)
+	{
+		char *end = (char*)memchr(node->rbuf + node->rpos, '\n',
+												node->rlen - node->rpos);
+		if(NULL != end)
+		{
+			size_t len = (size_t)(end - (node->rbuf + node->rpos));
+
+			if(len >= MAX_LINE || 0 == len || '\r' != end[-1])
+			{
+				return 1;
+			}
+
+			memcpy(line, node->rbuf + node->rpos, len - 1);
+			line[len - 1] = '\0';
+			node->rpos += len + 1;
+
+			return 0;
+		}
+
+		if(node->rlen - node->rpos >= MAX_LINE || 0 != Fill(node))
+		{
+			return 1;
+		}
+	}
+}
+
+static int ReadBytes(node_t *node, char *dest, size_t len)
+{
+	while(len > 0)
+	{
+		size_t chunk = node->rlen - node->rpos;
+
+		if(0 == chunk && 0 != Fill(node))
+		{
+			return 1;
+		}
+
+		chunk = node->rlen - node->rpos;
+		chunk = chunk < len ? chunk : len;
+		memcpy(dest, node->rbuf + node->rpos, chunk);
+		node->rpos += chunk;
+		dest += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/*sends "get" with the keys of 'node' (picks[i] == which), 1 on failure*/
+static int SendGet(node_t *node, const char **keys, const long *picks,
+															size_t n, long which)
+{
+	size_t len = 4;
+	char *request = NULL;
+	char *at = NULL;
+	struct iovec iov;
+	size_t i = 0;
+	int status = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		if(picks[i] == which)
+		{
+			len += 1 + strlen(keys[i]);
+		}
+	}
+
+	request = (char*)malloc(len + 2);
+	if(NULL == request)
+	{
+		return 1;
+	}
+
+	memcpy(request, "get", 3);
+	at = request + 3;
+	for(i = 0 ; i < n ; i++)
+	{
+		if(picks[i] == which)
+		{
+			size_t key_len = strlen(keys[i]);
+
+			*at++ = ' ';
+			memcpy(at, keys[i], key_len);
+			at += key_len;
+		}
+	}
+	memcpy(at, "\r\n", 2);
+	at += 2;
+
+	iov.iov_base = request;
+	iov.iov_len = (size_t)(at - request);
+	status = WriteAll(node, &iov, 1);
+	free(request);
+
+	return status;
+}
+
+/*reads "VALUE" lines up to "END", returns 1 on failure*/
+static int ReadValues(node_t *node, const char **keys, const long *picks,
+									size_t n, long which, void **vals, size_t *lens)
+{
+	char line[MAX_LINE];
+
+	for(;;)
+	{
+		char key[MAX_KEY + 1];
+		unsigned flags = 0;
+		size_t bytes = 0;
+		char *val = NULL;
+		size_t i = 0;
+
+		if(0 != ReadLine(node, line))
+		{
+			return 1;
+		}
+		if(0 == strcmp(line, "END"))
+		{
+			return 0;
+		}
+		if(3 != sscanf(line, "VALUE %250s %u %zu", key, &flags, &bytes))
+		{
+			return 1;
+		}
+
+		val = (char*)malloc(bytes + 1);
+		if(NULL == val || 0 != ReadBytes(node, val, bytes) ||
+								0 != ReadBytes(node, line, 2) ||
+								'\r' != line[0] || '\n' != line[1])
+		{
+			free(val);
+			return 1;
+		}
+		val[bytes] = '\0';
+
+		/*first request slot of this key still waiting for its value*/
+		for(i = 0 ; i < n ; i++)
+		{
+			if(picks[i] == which && NULL == vals[i] &&
+												0 == strcmp(keys[i], key))
+			{
+				break;
+			}
+		}
+
+		if(i < n)
+		{
+			vals[i] = val;
+			lens[i] = bytes;
+		}
+		else
+		{
+			free(val);
+		}
+	}
+}
+
+
+/******************************************************************************
+Description:     	Creates a client for a fleet of cache servers.
+Return value:    	Pointer to client in case of success, otherwise NULL.
+Time Complexity: 	O(1).
+******************************************************************************/
+cache_client_t *ClientCreate(void)
+{
+	cache_client_t *client = (cache_client_t*)malloc(sizeof(cache_client_t));
+
+	if(NULL == client)
+	{
+		return NULL;
+	}
+
+	client->nodes = NULL;
+	client->n_nodes = 0;
+
+	return client;
+}
+
+
+/******************************************************************************
+Description:     	Deletes a client pointed to by "client" from memory.
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+void ClientDestroy(cache_client_t *client)
+{
+	size_t i = 0;
+
+	assert(client);
+
+	for(i = 0 ; i < client->n_nodes ; i++)
+	{
+		Fail(client->nodes[i]);
+		free(client->nodes[i]);
+	}
+
+	free(client->nodes);
+	free(client);client = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Adds the server listening on the Unix socket 'path'.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+int ClientAddNode(cache_client_t *client, const char *path, unsigned weight)
+{
+	node_t **nodes = NULL;
+	node_t *node = NULL;
+	size_t i = 0;
+
+	assert(client);
+	assert(path);
+
+	if(strlen(path) >= sizeof(node->path))
+	{
+		return 1;
+	}
+
+	for(i = 0 ; i < client->n_nodes ; i++)
+	{
+		if(0 == strcmp(client->nodes[i]->path, path))
+		{
+			return 1;
+		}
+	}
+
+	node = (node_t*)malloc(sizeof(node_t));
+	nodes = (node_t**)realloc(client->nodes,
+								(client->n_nodes + 1) * sizeof(node_t*));
+	if(NULL == node || NULL == nodes)
+	{
+		free(node);
+		if(NULL != nodes)
+		{
+			client->nodes = nodes;
+		}
+		return 1;
+	}
+
+	memset(node->path, 0, sizeof(node->path));
+	strcpy(node->path, path);
+	node->weight = 0 == weight ? 1 : weight;
+	node->seed = Mix(Fnv1a(path));
+	node->fd = -1;
+	node->rpos = 0;
+	node->rlen = 0;
+
+	client->nodes = nodes;
+	client->nodes[client->n_nodes++] = node;
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Removes the node added with 'path'.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+int ClientRemoveNode(cache_client_t *client, const char *path)
+{
+	size_t i = 0;
+
+	assert(client);
+	assert(path);
+
+	for(i = 0 ; i < client->n_nodes ; i++)
+	{
+		if(0 == strcmp(client->nodes[i]->path, path))
+		{
+			Fail(client->nodes[i]);
+			free(client->nodes[i]);
+
+			/*order does not matter to rendezvous hashing*/
+			client->nodes[i] = client->nodes[--client->n_nodes];
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+/*******************************************************************************
+Description:     	Returns the path of the node 'key' maps to.
+Time Complexity: 	O(nodes).
+*******************************************************************************/
+const char *ClientNodeFor(const cache_client_t *client, const char *key)
+{
+	long pick = 0;
+
+	assert(client);
+	assert(key);
+
+	pick = Pick(client, key);
+
+	return pick < 0 ? NULL : client->nodes[pick]->path;
+}
+
+
+/*******************************************************************************
+Description:     	Stores 'len' bytes of 'val' under 'key' on its node.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(nodes) + one round trip.
+*******************************************************************************/
+int ClientSet(cache_client_t *client, const char *key, const void *val,
+																size_t len)
+{
+	char header[MAX_LINE];
+	char line[MAX_LINE];
+	struct iovec iov[3];
+	node_t *node = NULL;
+	long pick = 0;
+
+	assert(client);
+	assert(key);
+	assert(val || 0 == len);
+
+	pick = Pick(client, key);
+	if(pick < 0 || !IsValidKey(key))
+	{
+		return 1;
+	}
+
+	node = client->nodes[pick];
+	if(0 != Connect(node))
+	{
+		return 1;
+	}
+
+	/*the value goes out as is, no copy into a request buffer*/
+	iov[0].iov_base = header;
+	iov[0].iov_len = (size_t)snprintf(header, sizeof(header),
+											"set %s 0 0 %zu\r\n", key, len);
+	iov[1].iov_base = (void*)val;
+	iov[1].iov_len = len;
+	iov[2].iov_base = (void*)"\r\n";
+	iov[2].iov_len = 2;
+
+	if(0 != WriteAll(node, iov, 3) || 0 != ReadLine(node, line))
+	{
+		Fail(node);
+		return 1;
+	}
+
+	return 0 == strcmp(line, "STORED") ? 0 : 1;
+}
+
+
+/*******************************************************************************
+Description:     	Fetches the value of 'key' from its node.
+Return value:    	malloc'd copy of the value in case of hit, otherwise NULL.
+Time Complexity: 	O(nodes) + one round trip.
+*******************************************************************************/
+void *ClientGet(cache_client_t *client, const char *key, size_t *len)
+{
+	void *val = NULL;
+	size_t val_len = 0;
+
+	assert(len);
+
+	ClientMultiGet(client, &key, 1, &val, &val_len);
+	*len = val_len;
+
+	return val;
+}
+
+
+/*******************************************************************************
+Description:     	Fetches 'n' keys at once, one pipelined request per node.
+Return value:    	Number of hits.
+Time Complexity: 	O(n * nodes) + one round trip.
+*******************************************************************************/
+size_t ClientMultiGet(cache_client_t *client, const char **keys, size_t n,
+												void **vals, size_t *lens)
+{
+	long *picks = NULL;
+	char *sent = NULL;
+	size_t hits = 0;
+	size_t i = 0;
+
+	assert(client);
+	assert(keys);
+	assert(vals);
+	assert(lens);
+
+	for(i = 0 ; i < n ; i++)
+	{
+		vals[i] = NULL;
+		lens[i] = 0;
+	}
+
+	picks = (long*)malloc((n + 1) * sizeof(long));
+	sent = (char*)calloc(client->n_nodes + 1, 1);
+	if(NULL == picks || NULL == sent)
+	{
+		free(picks);
+		free(sent);
+		return 0;
+	}
+
+	for(i = 0 ; i < n ; i++)
+	{
+		picks[i] = IsValidKey(keys[i]) ? Pick(client, keys[i]) : -1;
+		if(picks[i] >= 0)
+		{
+			sent[picks[i]] = 1;
+		}
+	}
+
+	/*every request goes out before the first reply is read*/
+	for(i = 0 ; i < client->n_nodes ; i++)
+	{
+		node_t *node = client->nodes[i];
+
+		if(sent[i] && (0 != Connect(node) ||
+						0 != SendGet(node, keys, picks, n, (long)i)))
+		{
+			Fail(node);
+			sent[i] = 0;
+		}
+	}
+
+	for(i = 0 ; i < client->n_nodes ; i++)
+	{
+		/*values read before a failure are kept, the connection is dropped*/
+		if(sent[i] && 0 != ReadValues(client->nodes[i], keys, picks, n,
+														(long)i, vals, lens))
+		{
+			Fail(client->nodes[i]);
+		}
+	}
+
+	for(i = 0 ; i < n ; i++)
+	{
+		hits += NULL != vals[i];
+	}
+
+	free(picks);
+	free(sent);
+
+	return hits;
+}
+
+
+/*******************************************************************************
+Description:     	Deletes 'key' from its node.
+Return value:    	0 if it was deleted, 1 if it was not found or on failure.
+Time Complexity: 	O(nodes) + one round trip.
+*******************************************************************************/
+int ClientDelete(cache_client_t *client, const char *key)
+{
+	char request[MAX_LINE];
+	char line[MAX_LINE];
+	struct iovec iov;
+	node_t *node = NULL;
+	long pick = 0;
+
+	assert(client);
+	assert(key);
+
+	pick = Pick(client, key);
+	if(pick < 0 || !IsValidKey(key))
+	{
+		return 1;
+	}
+
+	node = client->nodes[pick];
+	if(0 != Connect(node))
+	{
+		return 1;
+	}
+
+	iov.iov_base = request;
+	iov.iov_len = (size_t)snprintf(request, sizeof(request), "delete %s\r\n",
+																		key);
+
+	if(0 != WriteAll(node, &iov, 1) || 0 != ReadLine(node, line))
+	{
+		Fail(node);
+		return 1;
+	}
+
+	return 0 == strcmp(line, "DELETED") ? 0 : 1;
+}
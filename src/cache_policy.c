@@ -0,0 +1,710 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+
+#include "hash_t.h"
+#include "ilist.h" 		/* ilist_t */
+#include "cache_policy.h"
+
+enum{
+	MIGRATE_STEP = 16,		/*ghost index buckets moved per insert while growing*/
+	VICTIM_TRIES = 16		/*dirty entries skipped looking for a victim*/
+};
+
+/*a key evicted from T1 or T2 of ARC, only its hash is kept*/
+typedef struct ghost
+{
+	size_t hash;
+	int frequent;			/*in B2, evicted from T2*/
+	iitr_t itr;
+
+}ghost_t;
+
+/*
+ * The LRU list of the namespace is T1, keys hit once since they came in, and
+ * 'frequent' is T2, keys hit again. B1 and B2 remember keys evicted from T1
+ * and T2, a miss on one of them moves 'target', the part of the capacity T1
+ * gets, towards the list that should have kept it.
+ */
+typedef struct arc
+{
+	ilist_t *frequent;		/*T2, LRU first*/
+	ilist_t *ghosts[2];		/*B1 and B2 of ghost_t, LRU first*/
+	hash_t *index;			/*ghost_t by hash*/
+	size_t index_size;		/*buckets of 'index'*/
+	int index_growing;
+	size_t target;
+
+}arc_t;
+
+/*
+ * A min-heap of the entries by priority. 'clock' is the priority of the last
+ * entry evicted, new priorities start from it so entries that stopped being
+ * hit age out. Dirty entries can't be evicted, they wait in the 'n_dirty'
+ * slots after the heap until they are flushed.
+ */
+typedef struct gdsf
+{
+	data_and_itr_t **heap;
+	size_t n;
+	size_t n_dirty;
+	size_t cap;
+	double clock;
+
+}gdsf_t;
+
+/*plain LRU has neither*/
+struct policy
+{
+	hash_func_t hash_func;
+	arc_t *arc;				/*NULL unless the policy is ARC*/
+	gdsf_t *gdsf;			/*NULL unless the policy is GDSF*/
+};
+
+
+static ilist_t *ListOf(const policy_t *policy, const data_and_itr_t *entry)
+{
+	return entry->frequent ? policy->arc->frequent : entry->space->list;
+}
+
+/*moves the element of 'itr' to the MRU end, the node itself is reused*/
+static void Requeue(ilist_t *list, iitr_t itr)
+{
+	if(ILIST_END != IListIterNext(list, itr))
+	{
+		IListSplice(list, ILIST_END, itr, itr);
+	}
+}
+
+static void HeapSet(gdsf_t *gdsf, size_t pos, data_and_itr_t *entry)
+{
+	gdsf->heap[pos] = entry;
+	entry->heap_pos = pos;
+}
+
+/*moves the entry at 'pos' up or down to where its priority belongs*/
+static void HeapFix(gdsf_t *gdsf, size_t pos)
+{
+	data_and_itr_t *entry = gdsf->heap[pos];
+
+	while(0 < pos && entry->priority < gdsf->heap[(pos - 1) / 2]->priority)
+	{
+		HeapSet(gdsf, pos, gdsf->heap[(pos - 1) / 2]);
+		pos = (pos - 1) / 2;
+	}
+
+	for(;;)
+	{
+		size_t child = 2 * pos + 1;
+
+		if(child >= gdsf->n)
+		{
+			break;
+		}
+		if(child + 1 < gdsf->n &&
+				gdsf->heap[child + 1]->priority < gdsf->heap[child]->priority)
+		{
+			++child;
+		}
+		if(entry->priority <= gdsf->heap[child]->priority)
+		{
+			break;
+		}
+		HeapSet(gdsf, pos, gdsf->heap[child]);
+		pos = child;
+	}
+
+	HeapSet(gdsf, pos, entry);
+}
+
+/*GreedyDual-Size-Frequency: recently and often used, costly per byte*/
+static void Prioritize(gdsf_t *gdsf, data_and_itr_t *entry)
+{
+	entry->priority = gdsf->clock + (double)entry->uses * entry->weight;
+}
+
+static void HeapPush(gdsf_t *gdsf, data_and_itr_t *entry)
+{
+	/*the first dirty entry makes room, it moves to the end*/
+	if(0 < gdsf->n_dirty)
+	{
+		HeapSet(gdsf, gdsf->n + gdsf->n_dirty, gdsf->heap[gdsf->n]);
+	}
+
+	Prioritize(gdsf, entry);
+	HeapSet(gdsf, gdsf->n++, entry);
+	HeapFix(gdsf, entry->heap_pos);
+}
+
+static void HeapRemove(gdsf_t *gdsf, data_and_itr_t *entry)
+{
+	size_t pos = entry->heap_pos;
+
+	entry->heap_pos = NOT_LISTED;
+	if(pos != --gdsf->n)
+	{
+		HeapSet(gdsf, pos, gdsf->heap[gdsf->n]);
+		HeapFix(gdsf, pos);
+	}
+
+	/*the last dirty entry takes the slot the heap gave up*/
+	if(0 < gdsf->n_dirty)
+	{
+		HeapSet(gdsf, gdsf->n, gdsf->heap[gdsf->n + gdsf->n_dirty]);
+	}
+}
+
+static int IsWaiting(const gdsf_t *gdsf, const data_and_itr_t *entry)
+{
+	return NOT_LISTED != entry->heap_pos && entry->heap_pos >= gdsf->n;
+}
+
+/*the last one waiting takes the slot of 'entry'*/
+static void StopWaiting(gdsf_t *gdsf, data_and_itr_t *entry)
+{
+	HeapSet(gdsf, entry->heap_pos, gdsf->heap[gdsf->n + --gdsf->n_dirty]);
+	entry->heap_pos = NOT_LISTED;
+}
+
+/*the hashes of the ghost index are the cache's, spread over the buckets*/
+static size_t HashGhost(const void *hash)
+{
+	return *(const size_t*)hash * (size_t)0x9e3779b97f4a7c15ULL >> 16;
+}
+
+static int MatchGhost(const void *data, const void *user_params)
+{
+	return *(const size_t*)data == *(const size_t*)user_params;
+}
+
+static int FreeGhost(void *data, void *user_params)
+{
+	(void)user_params;
+	free(data);
+
+	return 0;
+}
+
+static void DropGhost(arc_t *arc, ghost_t *ghost)
+{
+	IListRemove(arc->ghosts[ghost->frequent], ghost->itr);
+	HashRemove(arc->index, &ghost->hash);
+	free(ghost);
+}
+
+/*
+ * Remembers an evicted entry in B1 or B2. Ghosts are best effort, one is
+ * not kept if there is no memory for it.
+ */
+static void Haunt(policy_t *policy, const space_t *space,
+								const data_and_itr_t *victim, size_t limit)
+{
+	arc_t *arc = policy->arc;
+	size_t hash = policy->hash_func(victim->key);
+	ghost_t *ghost = (ghost_t*)HashFind(arc->index, &hash);
+
+	/*another key of the same hash*/
+	if(NULL != ghost)
+	{
+		DropGhost(arc, ghost);
+	}
+
+	ghost = (ghost_t*)malloc(sizeof(ghost_t));
+	if(NULL == ghost)
+	{
+		return;
+	}
+	ghost->hash = hash;
+	ghost->frequent = victim->frequent;
+	ghost->itr = IListPushBack(arc->ghosts[ghost->frequent], ghost);
+	if(ILIST_END == ghost->itr)
+	{
+		free(ghost);
+		return;
+	}
+	if(0 != HashInsert(arc->index, &ghost->hash, ghost))
+	{
+		IListRemove(arc->ghosts[ghost->frequent], ghost->itr);
+		free(ghost);
+		return;
+	}
+
+	if(arc->index_growing)
+	{
+		arc->index_growing = 0 != HashMigrate(arc->index, MIGRATE_STEP);
+	}
+	else if(IListSize(arc->ghosts[0]) + IListSize(arc->ghosts[1]) >
+							arc->index_size && 0 == HashGrow(arc->index))
+	{
+		arc->index_size *= 2;
+		arc->index_growing = 1;
+	}
+
+	PolicyTrim(policy, space, limit);
+}
+
+/*
+ * ARC's choice of the list to evict from: T1 while it holds more than its
+ * target, T2 otherwise.
+ */
+static ilist_t *VictimList(const policy_t *policy, const space_t *space)
+{
+	const arc_t *arc = policy->arc;
+
+	if(NULL == arc || IListIsEmpty(arc->frequent) ||
+		(!IListIsEmpty(space->list) && IListSize(space->list) > arc->target))
+	{
+		return space->list;
+	}
+
+	return arc->frequent;
+}
+
+/*
+ * GDSF's victim: the root of the heap, the entry of the lowest priority,
+ * never dirty. The clock moves up to the priority of the victim.
+ */
+static data_and_itr_t *PopCheapest(gdsf_t *gdsf, space_t *space)
+{
+	data_and_itr_t *victim = NULL;
+
+	if(0 == gdsf->n)
+	{
+		return NULL;
+	}
+	victim = gdsf->heap[0];
+
+	HeapRemove(gdsf, victim);
+	if(victim->priority > gdsf->clock)
+	{
+		gdsf->clock = victim->priority;
+	}
+	--space->size;
+	__atomic_add_fetch(&space->evictions, 1, __ATOMIC_RELAXED);
+
+	return victim;
+}
+
+static void DestroyArc(arc_t *arc)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < 2 ; i++)
+	{
+		if(NULL != arc->ghosts[i])
+		{
+			IListForEach(arc->ghosts[i], IListIterBegin(arc->ghosts[i]),
+						IListIterEnd(arc->ghosts[i]), FreeGhost, NULL);
+			IListDestroy(arc->ghosts[i]);
+		}
+	}
+	if(NULL != arc->frequent)
+	{
+		IListDestroy(arc->frequent);
+	}
+	if(NULL != arc->index)
+	{
+		HashDestroy(arc->index);
+	}
+	free(arc);
+}
+
+static arc_t *NewArc(size_t capacity, size_t index_size)
+{
+	arc_t *arc = (arc_t*)calloc(1, sizeof(arc_t));
+
+	if(NULL == arc)
+	{
+		return NULL;
+	}
+
+	arc->frequent = IListCreate(capacity);
+	arc->ghosts[0] = IListCreate(capacity);
+	arc->ghosts[1] = IListCreate(capacity);
+	arc->index = HashCreate(index_size, HashGhost, MatchGhost);
+	if(NULL == arc->frequent || NULL == arc->ghosts[0] ||
+							NULL == arc->ghosts[1] || NULL == arc->index)
+	{
+		DestroyArc(arc);
+		return NULL;
+	}
+	arc->index_size = index_size;
+
+	return arc;
+}
+
+static gdsf_t *NewGdsf(size_t capacity)
+{
+	gdsf_t *gdsf = (gdsf_t*)calloc(1, sizeof(gdsf_t));
+
+	if(NULL == gdsf)
+	{
+		return NULL;
+	}
+
+	gdsf->cap = 0 == capacity ? 1 : capacity;
+	gdsf->heap = (data_and_itr_t**)malloc(gdsf->cap * sizeof(data_and_itr_t*));
+	if(NULL == gdsf->heap)
+	{
+		free(gdsf);
+		return NULL;
+	}
+
+	return gdsf;
+}
+
+
+policy_t *PolicyCreate(cache_policy_t kind, size_t capacity,
+								size_t index_size, hash_func_t hash_func)
+{
+	policy_t *policy = (policy_t*)calloc(1, sizeof(policy_t));
+
+	assert(hash_func);
+
+	if(NULL == policy)
+	{
+		return NULL;
+	}
+	policy->hash_func = hash_func;
+
+	if(CACHE_POLICY_ARC == kind)
+	{
+		policy->arc = NewArc(capacity, index_size);
+		if(NULL == policy->arc)
+		{
+			free(policy);
+			return NULL;
+		}
+	}
+	else if(CACHE_POLICY_GDSF == kind)
+	{
+		policy->gdsf = NewGdsf(capacity);
+		if(NULL == policy->gdsf)
+		{
+			free(policy);
+			return NULL;
+		}
+	}
+
+	return policy;
+}
+
+
+void PolicyDestroy(policy_t *policy, action_func_t free_entry,
+															void *user_params)
+{
+	size_t i = 0;
+
+	assert(policy);
+	assert(free_entry);
+
+	if(NULL != policy->arc)
+	{
+		IListForEach(policy->arc->frequent,
+						IListIterBegin(policy->arc->frequent),
+						IListIterEnd(policy->arc->frequent),
+						free_entry, user_params);
+		DestroyArc(policy->arc);
+	}
+	if(NULL != policy->gdsf)
+	{
+		for(i = 0 ; i < policy->gdsf->n + policy->gdsf->n_dirty ; i++)
+		{
+			free_entry(policy->gdsf->heap[i], user_params);
+		}
+		free(policy->gdsf->heap);
+		free(policy->gdsf);
+	}
+
+	free(policy);policy = NULL;
+}
+
+
+cache_policy_t PolicyKind(const policy_t *policy)
+{
+	assert(policy);
+
+	return NULL != policy->arc ? CACHE_POLICY_ARC :
+			NULL != policy->gdsf ? CACHE_POLICY_GDSF : CACHE_POLICY_LRU;
+}
+
+
+int PolicyReserve(policy_t *policy)
+{
+	gdsf_t *gdsf = NULL;
+	data_and_itr_t **heap = NULL;
+
+	assert(policy);
+
+	gdsf = policy->gdsf;
+	if(NULL == gdsf || gdsf->n + gdsf->n_dirty < gdsf->cap)
+	{
+		return 0;
+	}
+
+	heap = (data_and_itr_t**)realloc(gdsf->heap,
+								2 * gdsf->cap * sizeof(data_and_itr_t*));
+	if(NULL == heap)
+	{
+		return 1;
+	}
+	gdsf->heap = heap;
+	gdsf->cap *= 2;
+
+	return 0;
+}
+
+
+void PolicyHit(policy_t *policy, data_and_itr_t *entry)
+{
+	iitr_t itr = ILIST_END;
+
+	assert(policy);
+	assert(entry);
+
+	if(NULL != policy->gdsf)
+	{
+		if(NOT_LISTED == entry->heap_pos)
+		{
+			return;
+		}
+
+		/*a dirty entry gets its priority once it is back in the heap*/
+		++entry->uses;
+		if(!IsWaiting(policy->gdsf, entry))
+		{
+			Prioritize(policy->gdsf, entry);
+			HeapFix(policy->gdsf, entry->heap_pos);
+		}
+
+		return;
+	}
+
+	if(ILIST_END == entry->itr)
+	{
+		return;
+	}
+
+	if(NULL != policy->arc && !entry->frequent)
+	{
+		itr = IListPushBack(policy->arc->frequent, entry);
+	}
+
+	if(ILIST_END == itr)
+	{
+		Requeue(ListOf(policy, entry), entry->itr);
+	}
+	else
+	{
+		IListRemove(entry->space->list, entry->itr);
+		entry->itr = itr;
+		entry->frequent = 1;
+	}
+}
+
+
+void PolicyAdmit(policy_t *policy, data_and_itr_t *entry, size_t limit)
+{
+	arc_t *arc = NULL;
+	ghost_t *ghost = NULL;
+	size_t hash = 0;
+	size_t recent = 0;
+	size_t frequent = 0;
+	size_t step = 0;
+
+	assert(policy);
+	assert(entry);
+
+	entry->frequent = 0;
+	entry->uses = 1;
+	entry->heap_pos = NOT_LISTED;
+
+	arc = policy->arc;
+	if(NULL == arc)
+	{
+		return;
+	}
+
+	hash = policy->hash_func(entry->key);
+	ghost = (ghost_t*)HashFind(arc->index, &hash);
+	if(NULL == ghost)
+	{
+		return;
+	}
+
+	recent = IListSize(arc->ghosts[0]);
+	frequent = IListSize(arc->ghosts[1]);
+	if(!ghost->frequent)
+	{
+		step = frequent > recent ? frequent / recent : 1;
+		arc->target = arc->target + step < limit ? arc->target + step : limit;
+	}
+	else
+	{
+		step = recent > frequent ? recent / frequent : 1;
+		arc->target = arc->target > step ? arc->target - step : 0;
+	}
+	DropGhost(arc, ghost);
+
+	entry->frequent = 1;
+}
+
+
+int PolicyInsert(policy_t *policy, data_and_itr_t *entry)
+{
+	assert(policy);
+	assert(entry);
+
+	if(NULL != policy->gdsf)
+	{
+		/*after the eviction, which may have moved the clock*/
+		entry->itr = ILIST_END;
+		HeapPush(policy->gdsf, entry);
+
+		return 0;
+	}
+
+	entry->itr = IListPushBack(ListOf(policy, entry), entry);
+
+	return ILIST_END == entry->itr;
+}
+
+
+void PolicyRemove(policy_t *policy, data_and_itr_t *entry)
+{
+	assert(policy);
+	assert(entry);
+
+	if(NULL != policy->gdsf && IsWaiting(policy->gdsf, entry))
+	{
+		StopWaiting(policy->gdsf, entry);
+	}
+	else if(NULL != policy->gdsf)
+	{
+		HeapRemove(policy->gdsf, entry);
+	}
+	else
+	{
+		IListRemove(ListOf(policy, entry), entry->itr);
+		entry->itr = ILIST_END;
+	}
+}
+
+
+void PolicyDirty(policy_t *policy, data_and_itr_t *entry)
+{
+	gdsf_t *gdsf = NULL;
+
+	assert(policy);
+	assert(entry);
+
+	gdsf = policy->gdsf;
+	if(NULL == gdsf || NOT_LISTED == entry->heap_pos ||
+												IsWaiting(gdsf, entry))
+	{
+		return;
+	}
+
+	HeapRemove(gdsf, entry);
+	HeapSet(gdsf, gdsf->n + gdsf->n_dirty++, entry);
+}
+
+
+void PolicyClean(policy_t *policy, data_and_itr_t *entry)
+{
+	assert(policy);
+	assert(entry);
+
+	if(NULL == policy->gdsf || !IsWaiting(policy->gdsf, entry))
+	{
+		return;
+	}
+
+	StopWaiting(policy->gdsf, entry);
+	HeapPush(policy->gdsf, entry);
+}
+
+
+data_and_itr_t *PolicyPopVictim(policy_t *policy, space_t *space,
+																size_t limit)
+{
+	ilist_t *list = NULL;
+	data_and_itr_t *victim = NULL;
+	int tries = 0;
+
+	assert(policy);
+	assert(space);
+
+	if(NULL != policy->gdsf)
+	{
+		return PopCheapest(policy->gdsf, space);
+	}
+
+	list = VictimList(policy, space);
+	for(;;)
+	{
+		if(IListIsEmpty(list))
+		{
+			return NULL;
+		}
+
+		victim = (data_and_itr_t*)IListGetData(list, IListIterBegin(list));
+		if(!victim->dirty)
+		{
+			break;
+		}
+		if(++tries == VICTIM_TRIES)
+		{
+			return NULL;
+		}
+		Requeue(list, victim->itr);
+	}
+
+	IListPopFront(list);
+	victim->itr = ILIST_END;
+	--space->size;
+	__atomic_add_fetch(&space->evictions, 1, __ATOMIC_RELAXED);
+	if(NULL != policy->arc)
+	{
+		Haunt(policy, space, victim, limit);
+	}
+
+	return victim;
+}
+
+
+void PolicyTrim(policy_t *policy, const space_t *space, size_t limit)
+{
+	arc_t *arc = NULL;
+	size_t recent = 0;
+	size_t resident = 0;
+
+	assert(policy);
+	assert(space);
+
+	arc = policy->arc;
+	if(NULL == arc)
+	{
+		return;
+	}
+
+	recent = IListSize(space->list);
+	resident = recent + IListSize(arc->frequent);
+
+	while(!IListIsEmpty(arc->ghosts[0]) &&
+					recent + IListSize(arc->ghosts[0]) > limit)
+	{
+		DropGhost(arc, (ghost_t*)IListGetData(arc->ghosts[0],
+										IListIterBegin(arc->ghosts[0])));
+	}
+
+	/*the cache itself may be past the limit until it shrinks*/
+	while(resident + IListSize(arc->ghosts[0]) +
+							IListSize(arc->ghosts[1]) > 2 * limit &&
+			!(IListIsEmpty(arc->ghosts[0]) && IListIsEmpty(arc->ghosts[1])))
+	{
+		ilist_t *ghosts = arc->ghosts[!IListIsEmpty(arc->ghosts[1])];
+
+		DropGhost(arc, (ghost_t*)IListGetData(ghosts,
+												IListIterBegin(ghosts)));
+	}
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h> 	/* calloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+
+#include "ilist.h"
+#include "cache_space.h"
+
+
+space_t *SpaceCreate(size_t capacity, size_t reserved, size_t quota)
+{
+	space_t *space = (space_t*)calloc(1, sizeof(space_t));
+
+	if(NULL == space)
+	{
+		return NULL;
+	}
+
+	space->list = IListCreate(capacity);
+	if(NULL == space->list)
+	{
+		free(space);
+		return NULL;
+	}
+
+	space->reserved = reserved;
+	space->quota = quota;
+
+	return space;
+}
+
+
+void SpaceDestroy(space_t *space)
+{
+	assert(space);
+
+	IListDestroy(space->list);
+	free(space);space = NULL;
+}
+
+
+/*
+ * Slab classes evict their own entries first ('own_first'), only those free
+ * a chunk of the right size.
+ */
+space_t *SpaceVictim(space_t *const *spaces, size_t n_spaces, size_t limit,
+							size_t reserved, space_t *space, int own_first)
+{
+	size_t unreserved = limit > reserved ? limit - reserved : 0;
+	size_t even = unreserved / n_spaces;
+	space_t *victim = NULL;
+	space_t *largest = NULL;
+	size_t i = 0;
+
+	assert(spaces);
+	assert(0 < n_spaces);
+
+	if(NULL != space && ((0 != space->quota && space->size >= space->quota) ||
+											(own_first && 0 != space->size)))
+	{
+		return space;
+	}
+
+	for(i = 0 ; i < n_spaces ; i++)
+	{
+		space_t *candidate = spaces[i];
+
+		if(NULL == largest || candidate->size > largest->size)
+		{
+			largest = candidate;
+		}
+
+		/*size - share > victim size - victim share, without going negative*/
+		if(candidate->size > candidate->reserved && (NULL == victim ||
+				candidate->size + victim->reserved + even >
+								victim->size + candidate->reserved + even))
+		{
+			victim = candidate;
+		}
+	}
+
+	return NULL != victim ? victim : largest;
+}
+
+
+void SpaceStats(const space_t *space, cache_ns_stats_t *stats)
+{
+	assert(space);
+	assert(stats);
+
+	stats->entries = space->size;
+	stats->reserved = space->reserved;
+	stats->quota = space->quota;
+	stats->hits = __atomic_load_n(&space->hits, __ATOMIC_RELAXED);
+	stats->misses = __atomic_load_n(&space->misses, __ATOMIC_RELAXED);
+	stats->sets = __atomic_load_n(&space->sets, __ATOMIC_RELAXED);
+	stats->evictions = __atomic_load_n(&space->evictions, __ATOMIC_RELAXED);
+}
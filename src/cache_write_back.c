@@ -0,0 +1,344 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <stdint.h>		/* uint64_t			*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+#include <time.h>		/* clock_gettime	*/
+
+#include "cache_write_back.h"
+
+#define ORPHANED ((size_t)-2)		/*'dirty_pos' of one deleted meanwhile*/
+
+/*
+ * 'dirty' lists the entries to flush. The entries a flush took, and what it
+ * saw of them, are kept from "WriteBackTake()" to "WriteBackEnd()", 'lock'
+ * lets one flush run at a time. Until "WriteBackPut()" 'dirty' keeps room
+ * for the 'to_put' entries it may list again.
+ */
+struct write_back
+{
+	cache_flush_func_t flush;
+	void *user_params;
+	size_t batch;
+	unsigned interval_ms;
+	data_and_itr_t **dirty;
+	size_t n_dirty;
+	size_t dirty_cap;
+	uint64_t dirty_since;	/*"NowMs()" when 'dirty' was last empty*/
+	pthread_mutex_t lock;
+	data_and_itr_t **taken;
+	size_t taken_cap;
+	size_t to_put;
+	uint64_t *versions;
+	cache_handle_t **values;
+	void **keys;
+	void **data;
+	size_t n_taken;
+	size_t sent;
+};
+
+
+/*coarse clock, the interval is a matter of a few ms*/
+static uint64_t NowMs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static void List(write_back_t *wb, data_and_itr_t *entry)
+{
+	if(0 == wb->n_dirty)
+	{
+		wb->dirty_since = NowMs();
+	}
+	entry->dirty = 1;
+	entry->dirty_pos = wb->n_dirty;
+	wb->dirty[wb->n_dirty++] = entry;
+}
+
+static void FreeTaken(write_back_t *wb)
+{
+	free(wb->taken);
+	free(wb->versions);
+	free(wb->values);
+	free(wb->keys);
+	free(wb->data);
+	wb->taken = NULL;
+	wb->taken_cap = 0;
+	wb->versions = NULL;
+	wb->values = NULL;
+	wb->keys = NULL;
+	wb->data = NULL;
+	wb->n_taken = 0;
+	wb->sent = 0;
+}
+
+
+write_back_t *WriteBackCreate(cache_flush_func_t flush, size_t batch,
+								unsigned interval_ms, void *user_params)
+{
+	write_back_t *wb = NULL;
+
+	assert(flush);
+
+	wb = (write_back_t*)calloc(1, sizeof(write_back_t));
+	if(NULL == wb)
+	{
+		return NULL;
+	}
+
+	wb->flush = flush;
+	wb->user_params = user_params;
+	wb->batch = 0 == batch ? 1 : batch;
+	wb->interval_ms = interval_ms;
+	pthread_mutex_init(&wb->lock, NULL);
+
+	return wb;
+}
+
+
+void WriteBackDestroy(write_back_t *wb)
+{
+	assert(wb);
+
+	free(wb->dirty);
+	FreeTaken(wb);
+	pthread_mutex_destroy(&wb->lock);
+	free(wb);wb = NULL;
+}
+
+
+int WriteBackReserve(write_back_t *wb)
+{
+	data_and_itr_t **dirty = NULL;
+	size_t cap = 0;
+
+	assert(wb);
+
+	if(wb->n_dirty + wb->to_put < wb->dirty_cap)
+	{
+		return 0;
+	}
+
+	cap = 0 == wb->dirty_cap ? 64 : wb->dirty_cap * 2;
+	while(cap <= wb->n_dirty + wb->to_put)
+	{
+		cap *= 2;
+	}
+	dirty = (data_and_itr_t**)realloc(wb->dirty,
+										cap * sizeof(data_and_itr_t*));
+	if(NULL == dirty)
+	{
+		return 1;
+	}
+	wb->dirty = dirty;
+	wb->dirty_cap = cap;
+
+	return 0;
+}
+
+
+int WriteBackMark(write_back_t *wb, data_and_itr_t *entry)
+{
+	assert(wb);
+	assert(entry);
+
+	if(entry->dirty)
+	{
+		return 0;
+	}
+
+	List(wb, entry);
+
+	return wb->n_dirty == wb->batch;
+}
+
+
+void WriteBackUnlist(write_back_t *wb, data_and_itr_t *entry)
+{
+	data_and_itr_t *last = NULL;
+
+	assert(wb);
+	assert(entry);
+
+	if(!entry->dirty || NOT_LISTED == entry->dirty_pos)
+	{
+		return;
+	}
+
+	last = wb->dirty[--wb->n_dirty];
+	wb->dirty[entry->dirty_pos] = last;
+	last->dirty_pos = entry->dirty_pos;
+	entry->dirty = 0;
+}
+
+
+/*the flush still hands its key to the flush function*/
+int WriteBackOrphan(data_and_itr_t *entry)
+{
+	assert(entry);
+
+	if(!entry->dirty || NOT_LISTED != entry->dirty_pos)
+	{
+		return 0;
+	}
+
+	entry->dirty_pos = ORPHANED;
+
+	return 1;
+}
+
+
+int WriteBackIsFull(const write_back_t *wb)
+{
+	assert(wb);
+
+	return wb->n_dirty >= wb->batch;
+}
+
+
+int WriteBackIsDue(const write_back_t *wb, int over_limit)
+{
+	assert(wb);
+
+	return 0 < wb->n_dirty && (wb->n_dirty >= wb->batch ||
+						NowMs() - wb->dirty_since >= wb->interval_ms ||
+						over_limit);
+}
+
+
+void WriteBackBegin(write_back_t *wb)
+{
+	assert(wb);
+
+	pthread_mutex_lock(&wb->lock);
+}
+
+
+/*allocated before the list is taken, it stays as it is on failure*/
+int WriteBackTake(write_back_t *wb)
+{
+	size_t n = 0;
+	size_t i = 0;
+
+	assert(wb);
+
+	n = wb->n_dirty;
+	wb->versions = (uint64_t*)malloc((n + 1) * sizeof(uint64_t));
+	wb->values = (cache_handle_t**)malloc((n + 1) * sizeof(cache_handle_t*));
+	wb->keys = (void**)malloc((n + 1) * sizeof(void*));
+	wb->data = (void**)malloc((n + 1) * sizeof(void*));
+	if(NULL == wb->versions || NULL == wb->values || NULL == wb->keys ||
+														NULL == wb->data)
+	{
+		FreeTaken(wb);
+		return 1;
+	}
+
+	wb->taken = wb->dirty;
+	wb->taken_cap = wb->dirty_cap;
+	wb->n_taken = n;
+	wb->to_put = n;
+	wb->dirty = NULL;
+	wb->n_dirty = 0;
+	wb->dirty_cap = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		data_and_itr_t *entry = wb->taken[i];
+
+		entry->dirty_pos = NOT_LISTED;
+		wb->versions[i] = entry->version;
+		wb->values[i] = entry->value;
+		__atomic_add_fetch(&wb->values[i]->refs, 1, __ATOMIC_RELAXED);
+		wb->keys[i] = entry->key;
+		wb->data[i] = wb->values[i]->data;
+	}
+
+	return 0;
+}
+
+
+int WriteBackWrite(write_back_t *wb)
+{
+	int failed = 0;
+
+	assert(wb);
+
+	while(!failed && wb->sent < wb->n_taken)
+	{
+		size_t count = wb->n_taken - wb->sent < wb->batch ?
+										wb->n_taken - wb->sent : wb->batch;
+
+		failed = 0 != wb->flush(wb->keys + wb->sent, wb->data + wb->sent,
+												count, wb->user_params);
+		wb->sent += failed ? 0 : count;
+	}
+
+	return failed;
+}
+
+
+/*
+ * Nothing written meanwhile, the entries kept are listed again in place in
+ * the array taken. Otherwise "WriteBackReserve()" left room for them.
+ */
+void WriteBackPut(write_back_t *wb, action_func_t retire, action_func_t clean,
+															void *user_params)
+{
+	data_and_itr_t **taken = NULL;
+	size_t i = 0;
+
+	assert(wb);
+	assert(retire);
+	assert(clean);
+
+	taken = wb->taken;
+	if(NULL == wb->dirty)
+	{
+		wb->dirty = taken;
+		wb->dirty_cap = wb->taken_cap;
+		wb->taken = NULL;
+	}
+
+	for(i = 0 ; i < wb->n_taken ; i++)
+	{
+		data_and_itr_t *entry = taken[i];
+
+		if(ORPHANED == entry->dirty_pos)
+		{
+			/*deleted while it was written*/
+			entry->dirty = 0;
+			retire(entry, user_params);
+		}
+		else if(i < wb->sent && entry->version == wb->versions[i])
+		{
+			entry->dirty = 0;
+			clean(entry, user_params);
+		}
+		else
+		{
+			List(wb, entry);
+		}
+	}
+	wb->to_put = 0;
+}
+
+
+void WriteBackEnd(write_back_t *wb, action_func_t unpin, void *user_params)
+{
+	size_t i = 0;
+
+	assert(wb);
+	assert(unpin);
+
+	for(i = 0 ; i < wb->n_taken ; i++)
+	{
+		unpin(wb->values[i], user_params);
+	}
+	FreeTaken(wb);
+
+	pthread_mutex_unlock(&wb->lock);
+}
@@ -0,0 +1,746 @@
+#define _GNU_SOURCE				/* pthread_setaffinity_np	*/
+#include <stdlib.h> 			/* malloc ,size_t			*/
+#include <assert.h>				/* assert					*/
+#include <pthread.h>			/* pthread_barrier_t		*/
+#include <sched.h>				/* cpu_set_t				*/
+#include <unistd.h>				/* sysconf					*/
+
+#include "hash_t.h"
+#include "ilist.h"				/* ilist_t					*/
+#include "core_cache.h"
+
+enum{
+	CACHE_LINE = 64,
+	FACTOR = 2,
+	SEND_BATCH = 32		/*requests made visible to the owner at once*/
+};
+
+enum op{
+	OP_GET,
+	OP_SET,
+	OP_REMOVE
+};
+
+/*a request, or the answer to one ('data' is the result then)*/
+typedef struct message
+{
+	enum op op;
+	void *key;
+	void *data;
+	core_done_func_t done;
+	void *user_params;
+}message_t;
+
+/*
+ * One way from one core to another, its slots live with the consumer.
+ * 'tail' is the only thing both sides touch: the producer publishes it once
+ * per batch. There is no head, a core never has more than 'queue_len'
+ * requests in flight to a peer, so neither queue of the pair can overflow:
+ * a slot is written again only after its answer came back.
+ */
+typedef struct queue
+{
+	size_t tail __attribute__((aligned(CACHE_LINE)));
+}queue_t;
+
+typedef struct entry
+{
+	void *key;
+	void *data;
+	iitr_t itr;
+	struct entry *next_free;
+}entry_t;
+
+/*a key and data let go while an answer may still carry the data*/
+typedef struct deferred
+{
+	void *key;
+	void *data;
+}deferred_t;
+
+/*
+ * Everything of a core, allocated by its own thread and written by no other
+ * one, apart from the slots of its queues. Arrays are by peer core.
+ * Data let go is released once every peer completed the answers sent before
+ * (see "Reclaim()"): 'pending' collects it, 'waiting' waits for the peers
+ * to reach 'stamp'.
+ */
+typedef struct part
+{
+	hash_t *index;
+	ilist_t *lru;				/*LRU first*/
+	entry_t *arena;
+	entry_t *free;
+	size_t size;
+	queue_t *requests;			/*from each peer*/
+	message_t *request_slots;
+	queue_t *replies;			/*to the requests of this core*/
+	message_t *reply_slots;
+	size_t *served;				/*read position in 'requests'*/
+	size_t *completed;			/*read position in 'replies'*/
+	size_t *sent;				/*write position in the peer's 'requests'*/
+	size_t *published;			/*of 'sent'*/
+	size_t *answered;			/*write position in the peer's 'replies'*/
+	size_t *in_flight;
+	deferred_t *pending;
+	size_t n_pending;
+	size_t pending_cap;
+	deferred_t *waiting;
+	size_t n_waiting;
+	size_t waiting_cap;
+	size_t *stamp;				/*of 'answered' when 'waiting' was filled*/
+}part_t;
+
+struct core_cache
+{
+	size_t n_cores;
+	size_t capacity;			/*of a core*/
+	size_t queue_len;			/*power of 2*/
+	hash_func_t hash_func;
+	is_match_func_t match;
+	core_release_func_t release;
+	void *release_params;
+	pthread_barrier_t attached;
+	int failed;
+	part_t **parts;				/*read only once all cores attached*/
+};
+
+
+static size_t RoundPow2(size_t n)
+{
+	size_t pow2 = 1;
+
+	while(pow2 < n)
+	{
+		pow2 <<= 1;
+	}
+
+	return pow2;
+}
+
+/*the owner takes other bits of the hash than the buckets of its index*/
+static size_t Mix(size_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= (size_t)0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+static void Release(const core_cache_t *cache, void *key, void *data)
+{
+	if(NULL != cache->release && (NULL != key || NULL != data))
+	{
+		cache->release(key, data, cache->release_params);
+	}
+}
+
+static void FreePart(part_t *part)
+{
+	if(NULL != part->index)
+	{
+		HashDestroy(part->index);
+	}
+	if(NULL != part->lru)
+	{
+		IListDestroy(part->lru);
+	}
+	free(part->arena);
+	free(part->requests);
+	free(part->request_slots);
+	free(part->replies);
+	free(part->reply_slots);
+	free(part->served);
+	free(part->completed);
+	free(part->sent);
+	free(part->published);
+	free(part->answered);
+	free(part->in_flight);
+	free(part->pending);
+	free(part->waiting);
+	free(part->stamp);
+	free(part);
+}
+
+static part_t *NewPart(const core_cache_t *cache)
+{
+	size_t n = cache->n_cores;
+	size_t slots = n * cache->queue_len;
+	part_t *part = (part_t*)aligned_alloc(CACHE_LINE,
+					(sizeof(part_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1));
+	size_t i = 0;
+
+	if(NULL == part)
+	{
+		return NULL;
+	}
+
+	part->index = HashCreate(cache->capacity * FACTOR, cache->hash_func,
+																cache->match);
+	part->lru = IListCreate(cache->capacity);
+	part->arena = (entry_t*)malloc(cache->capacity * sizeof(entry_t));
+	part->requests = (queue_t*)aligned_alloc(CACHE_LINE, n * sizeof(queue_t));
+	part->request_slots = (message_t*)malloc(slots * sizeof(message_t));
+	part->replies = (queue_t*)aligned_alloc(CACHE_LINE, n * sizeof(queue_t));
+	part->reply_slots = (message_t*)malloc(slots * sizeof(message_t));
+	part->served = (size_t*)calloc(n, sizeof(size_t));
+	part->completed = (size_t*)calloc(n, sizeof(size_t));
+	part->sent = (size_t*)calloc(n, sizeof(size_t));
+	part->published = (size_t*)calloc(n, sizeof(size_t));
+	part->answered = (size_t*)calloc(n, sizeof(size_t));
+	part->in_flight = (size_t*)calloc(n, sizeof(size_t));
+	part->pending = NULL;
+	part->n_pending = 0;
+	part->pending_cap = 0;
+	part->waiting = NULL;
+	part->n_waiting = 0;
+	part->waiting_cap = 0;
+	part->stamp = (size_t*)calloc(n, sizeof(size_t));
+
+	if(NULL == part->index || NULL == part->lru || NULL == part->arena ||
+		NULL == part->requests || NULL == part->request_slots ||
+		NULL == part->replies || NULL == part->reply_slots ||
+		NULL == part->served || NULL == part->completed ||
+		NULL == part->sent || NULL == part->published ||
+		NULL == part->answered || NULL == part->in_flight ||
+		NULL == part->stamp)
+	{
+		FreePart(part);
+		return NULL;
+	}
+
+	part->free = NULL;
+	for(i = cache->capacity ; i > 0 ; i--)
+	{
+		part->arena[i - 1].next_free = part->free;
+		part->free = &part->arena[i - 1];
+	}
+	part->size = 0;
+
+	for(i = 0 ; i < n ; i++)
+	{
+		part->requests[i].tail = 0;
+		part->replies[i].tail = 0;
+	}
+
+	return part;
+}
+
+/*best effort, a core that is not pinned still works*/
+static void Pin(size_t core, size_t n_cores)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+
+	if(cpus <= 0 || (size_t)cpus < n_cores)
+	{
+		return;
+	}
+
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+
+/*******************************************************************************
+Description:     	Creates a shared-nothing LRU cache run by 'n_cores' threads.
+Return value:    	Pointer to cache in case of success, otherwise NULL.
+Time Complexity: 	O(n_cores^2).
+*******************************************************************************/
+core_cache_t *CoreCacheCreate(size_t n_cores, size_t capacity,
+				hash_func_t hash_func, is_match_func_t match, size_t queue_len)
+{
+	core_cache_t *cache = NULL;
+
+	assert(0 < n_cores);
+	assert(hash_func);
+	assert(match);
+
+	cache = (core_cache_t*)malloc(sizeof(core_cache_t));
+	if(NULL == cache)
+	{
+		return NULL;
+	}
+
+	cache->parts = (part_t**)calloc(n_cores, sizeof(part_t*));
+	if(NULL == cache->parts ||
+			0 != pthread_barrier_init(&cache->attached, NULL, n_cores))
+	{
+		free(cache->parts);
+		free(cache);
+		return NULL;
+	}
+
+	cache->n_cores = n_cores;
+	cache->capacity = (capacity + n_cores - 1) / n_cores;
+	cache->capacity = 0 == cache->capacity ? 1 : cache->capacity;
+	cache->queue_len = RoundPow2(0 == queue_len ? 1 : queue_len);
+	cache->hash_func = hash_func;
+	cache->match = match;
+	cache->release = NULL;
+	cache->release_params = NULL;
+	cache->failed = 0;
+
+	return cache;
+}
+
+
+void CoreCacheDestroy(core_cache_t *cache)
+{
+	size_t i = 0;
+
+	assert(cache);
+
+	for(i = 0 ; i < cache->n_cores ; i++)
+	{
+		part_t *part = cache->parts[i];
+		size_t j = 0;
+
+		if(NULL == part)
+		{
+			continue;
+		}
+
+		while(!IListIsEmpty(part->lru))
+		{
+			entry_t *entry = (entry_t*)IListPopFront(part->lru);
+
+			Release(cache, entry->key, entry->data);
+		}
+		for(j = 0 ; j < part->n_waiting ; j++)
+		{
+			Release(cache, part->waiting[j].key, part->waiting[j].data);
+		}
+		for(j = 0 ; j < part->n_pending ; j++)
+		{
+			Release(cache, part->pending[j].key, part->pending[j].data);
+		}
+		FreePart(part);
+	}
+
+	pthread_barrier_destroy(&cache->attached);
+	free(cache->parts);
+	free(cache);cache = NULL;
+}
+
+
+void CoreCacheSetRelease(core_cache_t *cache, core_release_func_t release,
+															void *user_params)
+{
+	assert(cache);
+
+	cache->release = release;
+	cache->release_params = user_params;
+}
+
+
+int CoreCacheAttach(core_cache_t *cache, size_t core)
+{
+	assert(cache);
+	assert(core < cache->n_cores);
+	assert(NULL == cache->parts[core]);
+
+	/*pinned first, so the partition is allocated on the core's node*/
+	Pin(core, cache->n_cores);
+
+	cache->parts[core] = NewPart(cache);
+	if(NULL == cache->parts[core])
+	{
+		__atomic_store_n(&cache->failed, 1, __ATOMIC_SEQ_CST);
+	}
+
+	/*publishes every core's partition to all the others*/
+	pthread_barrier_wait(&cache->attached);
+
+	return __atomic_load_n(&cache->failed, __ATOMIC_SEQ_CST);
+}
+
+
+size_t CoreCacheOwner(const core_cache_t *cache, const void *key)
+{
+	assert(cache);
+
+	return Mix(cache->hash_func(key)) % cache->n_cores;
+}
+
+/*
+ * Operations of the owner on its own partition, no other thread ever
+ * touches it.
+ */
+
+/*
+ * Releases what waited once every peer completed the answers sent before it
+ * was let go, none of them can still hand the data to "done" then. What was
+ * deferred since starts waiting in its place.
+ */
+static void Reclaim(const core_cache_t *cache, part_t *part, size_t core)
+{
+	deferred_t *swap = NULL;
+	size_t cap = 0;
+	size_t i = 0;
+
+	for(i = 0 ; i < cache->n_cores && 0 < part->n_waiting ; i++)
+	{
+		if(__atomic_load_n(&cache->parts[i]->completed[core],
+										__ATOMIC_ACQUIRE) < part->stamp[i])
+		{
+			return;
+		}
+	}
+
+	for(i = 0 ; i < part->n_waiting ; i++)
+	{
+		Release(cache, part->waiting[i].key, part->waiting[i].data);
+	}
+	part->n_waiting = 0;
+
+	if(0 == part->n_pending)
+	{
+		return;
+	}
+
+	swap = part->waiting;
+	cap = part->waiting_cap;
+	part->waiting = part->pending;
+	part->waiting_cap = part->pending_cap;
+	part->n_waiting = part->n_pending;
+	part->pending = swap;
+	part->pending_cap = cap;
+	part->n_pending = 0;
+	for(i = 0 ; i < cache->n_cores ; i++)
+	{
+		part->stamp[i] = part->answered[i];
+	}
+}
+
+/*
+ * Makes room to defer one release, an operation lets go of one data at
+ * most. Returns 1 if there is no memory for it.
+ */
+static int Reserve(const core_cache_t *cache, part_t *part, size_t core)
+{
+	deferred_t *pending = NULL;
+	size_t cap = 0;
+
+	if(part->n_pending < part->pending_cap)
+	{
+		return 0;
+	}
+
+	Reclaim(cache, part, core);
+	if(part->n_pending < part->pending_cap)
+	{
+		return 0;
+	}
+
+	cap = 0 == part->pending_cap ? 64 : part->pending_cap * 2;
+	pending = (deferred_t*)realloc(part->pending, cap * sizeof(deferred_t));
+	if(NULL == pending)
+	{
+		return 1;
+	}
+	part->pending = pending;
+	part->pending_cap = cap;
+
+	return 0;
+}
+
+/*"Reserve()" made room for it*/
+static void Defer(part_t *part, void *key, void *data)
+{
+	part->pending[part->n_pending].key = key;
+	part->pending[part->n_pending].data = data;
+	++part->n_pending;
+}
+
+static void Promote(part_t *part, const entry_t *entry)
+{
+	if(ILIST_END != IListIterNext(part->lru, entry->itr))
+	{
+		IListSplice(part->lru, ILIST_END, entry->itr, entry->itr);
+	}
+}
+
+static void *LocalGet(part_t *part, const void *key)
+{
+	entry_t *entry = (entry_t*)HashFind(part->index, key);
+
+	if(NULL == entry)
+	{
+		return NULL;
+	}
+	Promote(part, entry);
+
+	return entry->data;
+}
+
+static void *LocalSet(const core_cache_t *cache, part_t *part, void *key,
+																	void *data)
+{
+	entry_t *entry = (entry_t*)HashFind(part->index, key);
+
+	if(NULL != entry)
+	{
+		if(entry->data != data)
+		{
+			Defer(part, NULL, entry->data);
+			entry->data = data;
+		}
+		/*the new key was never visible*/
+		if(entry->key != key)
+		{
+			Release(cache, key, NULL);
+		}
+		Promote(part, entry);
+
+		return data;
+	}
+
+	if(NULL != part->free)
+	{
+		entry = part->free;
+		part->free = entry->next_free;
+		++part->size;
+	}
+	else
+	{
+		entry = (entry_t*)IListPopFront(part->lru);
+		HashRemove(part->index, entry->key);
+		Defer(part, entry->key, entry->data);
+	}
+
+	entry->key = key;
+	entry->data = data;
+	if(0 != HashInsert(part->index, key, entry))
+	{
+		entry->next_free = part->free;
+		part->free = entry;
+		--part->size;
+		return NULL;
+	}
+	entry->itr = IListPushBack(part->lru, entry);
+
+	return data;
+}
+
+static void LocalRemove(part_t *part, const void *key)
+{
+	entry_t *entry = (entry_t*)HashFind(part->index, key);
+
+	if(NULL == entry)
+	{
+		return;
+	}
+
+	IListRemove(part->lru, entry->itr);
+	HashRemove(part->index, key);
+	Defer(part, entry->key, entry->data);
+	entry->next_free = part->free;
+	part->free = entry;
+	--part->size;
+}
+
+static void *Serve(const core_cache_t *cache, part_t *part,
+														const message_t *request)
+{
+	switch(request->op)
+	{
+		case OP_GET:
+			return LocalGet(part, request->key);
+		case OP_SET:
+			return LocalSet(cache, part, request->key, request->data);
+		default:
+			LocalRemove(part, request->key);
+			return NULL;
+	}
+}
+
+static void Publish(queue_t *queue, size_t tail, size_t *published)
+{
+	__atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+	*published = tail;
+}
+
+static int Request(core_cache_t *cache, size_t core, enum op op, void *key,
+						void *data, core_done_func_t done, void *user_params)
+{
+	size_t owner = CoreCacheOwner(cache, key);
+	part_t *self = cache->parts[core];
+	part_t *peer = NULL;
+	message_t *slot = NULL;
+
+	assert(core < cache->n_cores);
+	assert(self);
+
+	if(owner == core)
+	{
+		message_t request;
+
+		if(0 != Reserve(cache, self, core))
+		{
+			return 1;
+		}
+
+		request.op = op;
+		request.key = key;
+		request.data = data;
+		data = Serve(cache, self, &request);
+		if(NULL != done)
+		{
+			done(data, user_params);
+		}
+
+		return 0;
+	}
+
+	if(self->in_flight[owner] == cache->queue_len)
+	{
+		return 1;
+	}
+
+	peer = cache->parts[owner];
+	slot = &peer->request_slots[core * cache->queue_len +
+							(self->sent[owner] & (cache->queue_len - 1))];
+	slot->op = op;
+	slot->key = key;
+	slot->data = data;
+	slot->done = done;
+	slot->user_params = user_params;
+	++self->sent[owner];
+	++self->in_flight[owner];
+
+	if(self->sent[owner] - self->published[owner] == SEND_BATCH)
+	{
+		Publish(&peer->requests[core], self->sent[owner],
+												&self->published[owner]);
+	}
+
+	return 0;
+}
+
+
+int CoreCacheGet(core_cache_t *cache, size_t core, const void *key,
+									core_done_func_t done, void *user_params)
+{
+	assert(cache);
+	assert(key);
+	assert(done);
+
+	return Request(cache, core, OP_GET, (void*)key, NULL, done, user_params);
+}
+
+
+int CoreCacheSet(core_cache_t *cache, size_t core, void *key, void *data,
+									core_done_func_t done, void *user_params)
+{
+	assert(cache);
+	assert(key);
+
+	return Request(cache, core, OP_SET, key, data, done, user_params);
+}
+
+
+int CoreCacheRemove(core_cache_t *cache, size_t core, const void *key,
+									core_done_func_t done, void *user_params)
+{
+	assert(cache);
+	assert(key);
+
+	return Request(cache, core, OP_REMOVE, (void*)key, NULL, done,
+																user_params);
+}
+
+
+size_t CoreCachePoll(core_cache_t *cache, size_t core)
+{
+	size_t mask = cache->queue_len - 1;
+	part_t *self = NULL;
+	size_t handled = 0;
+	size_t i = 0;
+
+	assert(cache);
+	assert(core < cache->n_cores);
+
+	self = cache->parts[core];
+
+	/*first, the peers may serve them while this core serves theirs*/
+	for(i = 0 ; i < cache->n_cores ; i++)
+	{
+		if(self->sent[i] != self->published[i])
+		{
+			Publish(&cache->parts[i]->requests[core], self->sent[i],
+													&self->published[i]);
+		}
+	}
+
+	for(i = 0 ; i < cache->n_cores ; i++)
+	{
+		size_t tail = __atomic_load_n(&self->requests[i].tail,
+														__ATOMIC_ACQUIRE);
+		message_t *requests = &self->request_slots[i * cache->queue_len];
+		part_t *peer = cache->parts[i];
+		message_t *replies = NULL;
+
+		if(tail == self->served[i])
+		{
+			continue;
+		}
+
+		replies = &peer->reply_slots[core * cache->queue_len];
+		for( ; self->served[i] != tail ; ++self->served[i], ++handled)
+		{
+			const message_t *request = &requests[self->served[i] & mask];
+			message_t *reply = &replies[self->answered[i] & mask];
+
+			/*no memory, the rest waits for the next round*/
+			if(0 != Reserve(cache, self, core))
+			{
+				break;
+			}
+
+			reply->data = Serve(cache, self, request);
+			reply->done = request->done;
+			reply->user_params = request->user_params;
+			++self->answered[i];
+		}
+		__atomic_store_n(&peer->replies[core].tail, self->answered[i],
+														__ATOMIC_RELEASE);
+	}
+
+	for(i = 0 ; i < cache->n_cores ; i++)
+	{
+		size_t tail = __atomic_load_n(&self->replies[i].tail,
+														__ATOMIC_ACQUIRE);
+		const message_t *replies = &self->reply_slots[i * cache->queue_len];
+
+		for( ; self->completed[i] != tail ; ++handled)
+		{
+			message_t reply = replies[self->completed[i] & mask];
+
+			/*"done" may make requests, this one's slot is free already*/
+			--self->in_flight[i];
+			if(NULL != reply.done)
+			{
+				reply.done(reply.data, reply.user_params);
+			}
+			/*the owner may release the data of the answer from now on*/
+			__atomic_store_n(&self->completed[i], self->completed[i] + 1,
+														__ATOMIC_RELEASE);
+		}
+	}
+
+	Reclaim(cache, self, core);
+
+	return handled;
+}
+
+
+size_t CoreCacheSize(const core_cache_t *cache, size_t core)
+{
+	assert(cache);
+	assert(core < cache->n_cores);
+
+	return cache->parts[core]->size;
+}
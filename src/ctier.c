@@ -0,0 +1,336 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <string.h>		/* memcpy			*/
+#include <stdint.h>		/* uint32_t			*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+
+#include "aux_funcs.h" /*is_match_t*/
+#include "hash_t.h"
+#include "lz.h"
+#include "ctier.h"
+
+#define CHUNKS(bytes) (((bytes) + CHUNK - 1) / CHUNK)
+
+enum{
+	CHUNK = 64,
+	FACTOR = 2,
+	REC_RAW = 1 	/* value did not compress, stored as is */
+};
+
+/*
+ * Records are allocated at 'head' and dropped at 'tail' in FIFO order, the
+ * free space is always the circular range [head, tail). A record never wraps,
+ * the end of the area is filled with a dead padding record instead.
+ */
+typedef struct record
+{
+	uint32_t chunks;
+	uint32_t key_len;
+	uint32_t raw_len;
+	uint32_t comp_len;
+	uint32_t live;
+	uint32_t flags;
+	/* key bytes followed by comp_len value bytes */
+}record_t;
+
+struct ctier
+{
+	hash_t *index;
+	unsigned char *area;
+	size_t n_chunks;
+	size_t head;
+	size_t tail;
+	size_t used;
+	size_t count;
+	size_func_t key_size;
+	size_func_t val_size;
+	unsigned char *scratch;
+	size_t scratch_len;
+	pthread_mutex_t lock;
+};
+
+
+static record_t *Rec(const ctier_t *tier, size_t chunk)
+{
+	return (record_t*)(tier->area + chunk * CHUNK);
+}
+
+static unsigned char *RecKey(record_t *rec)
+{
+	return (unsigned char*)(rec + 1);
+}
+
+static void Unindex(ctier_t *tier, record_t *rec)
+{
+	if(rec->live)
+	{
+		HashRemove(tier->index, RecKey(rec));
+		rec->live = 0;
+		--tier->count;
+	}
+}
+
+static void DropTail(ctier_t *tier)
+{
+	record_t *rec = Rec(tier, tier->tail);
+
+	Unindex(tier, rec);
+	tier->used -= rec->chunks;
+	tier->tail = (tier->tail + rec->chunks) % tier->n_chunks;
+}
+
+/* returns the first chunk of 'chunks' free chunks, dropping old records */
+static size_t Allocate(ctier_t *tier, size_t chunks)
+{
+	size_t at = 0;
+
+	if(tier->head + chunks > tier->n_chunks)
+	{
+		size_t pad = tier->n_chunks - tier->head;
+		record_t *rec = NULL;
+
+		while(tier->n_chunks - tier->used < pad)
+		{
+			DropTail(tier);
+		}
+
+		rec = Rec(tier, tier->head);
+		rec->chunks = (uint32_t)pad;
+		rec->live = 0;
+		tier->used += pad;
+		tier->head = 0;
+	}
+
+	while(tier->n_chunks - tier->used < chunks)
+	{
+		DropTail(tier);
+	}
+
+	at = tier->head;
+	tier->head = (tier->head + chunks) % tier->n_chunks;
+	tier->used += chunks;
+
+	return at;
+}
+
+
+/******************************************************************************
+Description:     	Creates a compressed in-memory tier of 'bytes' bytes.
+Return value:    	Pointer to tier in case of success, otherwise NULL.
+Time Complexity: 	O(bytes) + system call complexity.
+******************************************************************************/
+ctier_t *CTierCreate(size_t bytes, hash_func_t hash_func, is_match_func_t match,
+									size_func_t key_size, size_func_t val_size)
+{
+	ctier_t *tier = (ctier_t*)malloc(sizeof(ctier_t));
+
+	assert(key_size);
+	assert(val_size);
+
+	if(NULL == tier)
+	{
+		return NULL;
+	}
+
+	tier->n_chunks = bytes / CHUNK;
+	tier->area = (unsigned char*)malloc(tier->n_chunks * CHUNK);
+	tier->index = HashCreate(tier->n_chunks / FACTOR + 1, hash_func, match);
+	tier->scratch = NULL;
+	tier->scratch_len = 0;
+
+	if(0 == tier->n_chunks || NULL == tier->area || NULL == tier->index)
+	{
+		if(NULL != tier->index)
+		{
+			HashDestroy(tier->index);
+		}
+		free(tier->area);
+		free(tier);
+		return NULL;
+	}
+
+	tier->head = 0;
+	tier->tail = 0;
+	tier->used = 0;
+	tier->count = 0;
+	tier->key_size = key_size;
+	tier->val_size = val_size;
+	pthread_mutex_init(&tier->lock, NULL);
+
+	return tier;
+}
+
+
+/******************************************************************************
+Description:     	Deletes a tier pointed to by "tier" from memory.
+Time Complexity: 	O(n).
+*******************************************************************************/
+void CTierDestroy(ctier_t *tier)
+{
+	assert(tier);
+
+	HashDestroy(tier->index);
+	pthread_mutex_destroy(&tier->lock);
+	free(tier->scratch);
+	free(tier->area);
+	free(tier);tier = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Compresses 'key' and 'data' into the tier.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(key and value size) + O(dropped entries).
+*******************************************************************************/
+int CTierPut(void *tier_p, const void *key, const void *data)
+{
+	ctier_t *tier = (ctier_t*)tier_p;
+	size_t key_len = 0;
+	size_t raw_len = 0;
+	size_t comp_len = 0;
+	size_t total = 0;
+	record_t *rec = NULL;
+	record_t *old = NULL;
+	int status = 1;
+
+	assert(tier);
+	assert(key);
+	assert(data);
+
+	key_len = tier->key_size(key);
+	raw_len = tier->val_size(data);
+
+	pthread_mutex_lock(&tier->lock);
+
+	if(tier->scratch_len < raw_len)
+	{
+		unsigned char *scratch = (unsigned char*)realloc(tier->scratch,
+																	raw_len);
+		if(NULL != scratch)
+		{
+			tier->scratch = scratch;
+			tier->scratch_len = raw_len;
+		}
+	}
+
+	if(tier->scratch_len >= raw_len && raw_len > 0)
+	{
+		/*keep it only if it saves something*/
+		comp_len = LZCompress(data, raw_len, tier->scratch, raw_len - 1);
+	}
+
+	total = sizeof(record_t) + key_len + (comp_len ? comp_len : raw_len);
+
+	if(CHUNKS(total) <= tier->n_chunks)
+	{
+		old = (record_t*)HashFind(tier->index, key);
+		if(NULL != old)
+		{
+			Unindex(tier, old);
+		}
+
+		rec = Rec(tier, Allocate(tier, CHUNKS(total)));
+		rec->chunks = (uint32_t)CHUNKS(total);
+		rec->key_len = (uint32_t)key_len;
+		rec->raw_len = (uint32_t)raw_len;
+		rec->comp_len = (uint32_t)(comp_len ? comp_len : raw_len);
+		rec->flags = comp_len ? 0 : REC_RAW;
+		memcpy(RecKey(rec), key, key_len);
+		memcpy(RecKey(rec) + key_len, comp_len ? tier->scratch :
+							(const unsigned char*)data, rec->comp_len);
+
+		if(0 == HashInsert(tier->index, RecKey(rec), rec))
+		{
+			rec->live = 1;
+			++tier->count;
+			status = 0;
+		}
+		else
+		{
+			rec->live = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&tier->lock);
+
+	return status;
+}
+
+
+/*******************************************************************************
+Description:     	Removes 'key' and returns a decompressed copy of its value.
+Return value:    	Pointer to value in case of hit, otherwise NULL.
+Time Complexity: 	O(key and value size).
+*******************************************************************************/
+void *CTierTake(void *tier_p, const void *key, void **stored_key)
+{
+	ctier_t *tier = (ctier_t*)tier_p;
+	record_t *rec = NULL;
+	unsigned char *val = NULL;
+	unsigned char *key_copy = NULL;
+
+	assert(tier);
+	assert(key);
+	assert(stored_key);
+
+	pthread_mutex_lock(&tier->lock);
+
+	rec = (record_t*)HashFind(tier->index, key);
+	if(NULL != rec)
+	{
+		val = (unsigned char*)malloc(rec->raw_len ? rec->raw_len : 1);
+		key_copy = (unsigned char*)malloc(rec->key_len ? rec->key_len : 1);
+
+		if(NULL != val && NULL != key_copy)
+		{
+			unsigned char *bytes = RecKey(rec) + rec->key_len;
+
+			memcpy(key_copy, RecKey(rec), rec->key_len);
+			if(rec->flags & REC_RAW)
+			{
+				memcpy(val, bytes, rec->raw_len);
+			}
+			else if(rec->raw_len != LZDecompress(bytes, rec->comp_len, val,
+																rec->raw_len))
+			{
+				free(val);
+				val = NULL;
+			}
+
+			/*promoted back to the caller's tier, the copy here is dead*/
+			Unindex(tier, rec);
+		}
+
+		if(NULL == val || NULL == key_copy)
+		{
+			free(val);
+			free(key_copy);
+			val = NULL;
+			key_copy = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&tier->lock);
+
+	*stored_key = key_copy;
+
+	return val;
+}
+
+
+/*******************************************************************************
+Description:     	Returns number of entries in "tier".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t CTierCount(ctier_t *tier)
+{
+	size_t count = 0;
+
+	assert(tier);
+
+	pthread_mutex_lock(&tier->lock);
+	count = tier->count;
+	pthread_mutex_unlock(&tier->lock);
+
+	return count;
+}
@@ -0,0 +1,456 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+
+#include "aux_funcs.h" /* action_func_t */
+#include "epoch.h"
+
+enum{
+	THREAD_DOMAINS = 16,	/*domains a thread finds its record of in O(1)*/
+	RESERVE = 64			/*limbo nodes a domain keeps for out of memory*/
+};
+
+/* one per thread that ever entered the domain, never unlinked */
+typedef struct epoch_rec
+{
+	size_t epoch;
+	int active;
+	int nesting;
+	pthread_t owner;
+	struct epoch_rec *next;
+}epoch_rec_t;
+
+/* retired pointers, oldest first */
+typedef struct limbo
+{
+	void *ptr;
+	action_func_t free_func;
+	void *user_params;
+	size_t epoch;
+	struct limbo *next;
+}limbo_t;
+
+/*
+ * 'shared' stands in for the record of a thread that had no memory for one
+ * of its own: 'nesting' counts the sections inside it, and the epoch it
+ * holds is taken by the first of them, under 'shared_lock'. Spare limbo
+ * nodes are kept in 'reserve', unused ones are linked from 'spare'.
+ */
+struct epoch
+{
+	size_t id;
+	size_t global;
+	epoch_rec_t *recs;
+	pthread_mutex_t limbo_lock;
+	limbo_t *limbo_head;
+	limbo_t *limbo_tail;
+	limbo_t *spare;
+	limbo_t reserve[RESERVE];
+	pthread_mutex_t shared_lock;
+	epoch_rec_t shared;
+};
+
+/* the record a thread found for a domain, see "ThreadRec()" */
+typedef struct seen
+{
+	size_t id;
+	epoch_rec_t *rec;
+}seen_t;
+
+/*domains are told apart by id, a new domain may reuse a freed address*/
+static size_t next_id = 1;
+static __thread seen_t seen[THREAD_DOMAINS];
+/*sections the thread is in on a shared record, it gets no record meanwhile*/
+static __thread int shared_depth = 0;
+
+
+/*
+ * Returns the calling thread's record in "epoch", a new one if 'add' is set
+ * and it has none yet. NULL if it has none: it was out of memory, or it is
+ * inside a section on a shared record, whose exit must find it has none.
+ */
+static epoch_rec_t *ThreadRec(epoch_t *epoch, int add)
+{
+	seen_t *last = &seen[epoch->id % THREAD_DOMAINS];
+	epoch_rec_t *rec = NULL;
+	pthread_t self = pthread_self();
+
+	if(last->id == epoch->id)
+	{
+		return last->rec;
+	}
+
+	for(rec = __atomic_load_n(&epoch->recs, __ATOMIC_SEQ_CST) ; NULL != rec ;
+															rec = rec->next)
+	{
+		if(pthread_equal(rec->owner, self))
+		{
+			break;
+		}
+	}
+
+	if(NULL == rec && add && 0 == shared_depth)
+	{
+		rec = (epoch_rec_t*)malloc(sizeof(epoch_rec_t));
+		if(NULL == rec)
+		{
+			return NULL;
+		}
+
+		rec->epoch = 0;
+		rec->active = 0;
+		rec->nesting = 0;
+		rec->owner = self;
+		rec->next = __atomic_load_n(&epoch->recs, __ATOMIC_SEQ_CST);
+
+		while(!__atomic_compare_exchange_n(&epoch->recs, &rec->next, rec, 1,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+		}
+	}
+
+	if(NULL != rec)
+	{
+		last->id = epoch->id;
+		last->rec = rec;
+	}
+
+	return rec;
+}
+
+/*publishes the observed epoch in 'rec' before touching shared memory*/
+static void Publish(epoch_t *epoch, epoch_rec_t *rec)
+{
+	size_t global = 0;
+
+	do
+	{
+		global = __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&rec->epoch, global, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&rec->active, 1, __ATOMIC_SEQ_CST);
+	}
+	while(global != __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST));
+}
+
+/*
+ * Enters on the shared record: later sections keep the epoch of the first
+ * one, older than theirs, which only holds reclamation back longer.
+ */
+static void EnterShared(epoch_t *epoch)
+{
+	pthread_mutex_lock(&epoch->shared_lock);
+	if(0 == epoch->shared.nesting++)
+	{
+		Publish(epoch, &epoch->shared);
+	}
+	pthread_mutex_unlock(&epoch->shared_lock);
+
+	++shared_depth;
+}
+
+static void ExitShared(epoch_t *epoch)
+{
+	pthread_mutex_lock(&epoch->shared_lock);
+	assert(epoch->shared.nesting > 0);
+	if(0 == --epoch->shared.nesting)
+	{
+		__atomic_store_n(&epoch->shared.active, 0, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&epoch->shared_lock);
+
+	--shared_depth;
+}
+
+/*called under 'limbo_lock'*/
+static limbo_t *NewNode(epoch_t *epoch)
+{
+	limbo_t *node = epoch->spare;
+
+	if(NULL != node)
+	{
+		epoch->spare = node->next;
+	}
+
+	return node;
+}
+
+static void FreeNode(epoch_t *epoch, limbo_t *node)
+{
+	if(node >= epoch->reserve && node < epoch->reserve + RESERVE)
+	{
+		pthread_mutex_lock(&epoch->limbo_lock);
+		node->next = epoch->spare;
+		epoch->spare = node;
+		pthread_mutex_unlock(&epoch->limbo_lock);
+	}
+	else
+	{
+		free(node);
+	}
+}
+
+static size_t FreeUpTo(epoch_t *epoch, size_t safe_epoch, int all)
+{
+	limbo_t *list = NULL;
+	limbo_t *last = NULL;
+	size_t freed = 0;
+
+	pthread_mutex_lock(&epoch->limbo_lock);
+
+	list = epoch->limbo_head;
+	while(NULL != epoch->limbo_head &&
+						(all || epoch->limbo_head->epoch + 2 <= safe_epoch))
+	{
+		last = epoch->limbo_head;
+		epoch->limbo_head = last->next;
+	}
+
+	if(NULL == epoch->limbo_head)
+	{
+		epoch->limbo_tail = NULL;
+	}
+
+	if(NULL != last)
+	{
+		last->next = NULL;
+	}
+	else
+	{
+		list = NULL;
+	}
+
+	pthread_mutex_unlock(&epoch->limbo_lock);
+
+	while(NULL != list)
+	{
+		limbo_t *next = list->next;
+
+		list->free_func(list->ptr, list->user_params);
+		FreeNode(epoch, list);
+		list = next;
+		++freed;
+	}
+
+	return freed;
+}
+
+
+/*******************************************************************************
+Description:     	Creates an epoch based reclamation domain.
+Return value:    	Pointer to domain in case of success, otherwise NULL.
+Time Complexity: 	O(1) + system call complexity.
+*******************************************************************************/
+epoch_t *EpochCreate(void)
+{
+	epoch_t *epoch = (epoch_t*)malloc(sizeof(epoch_t));
+	size_t i = 0;
+
+	if(NULL == epoch)
+	{
+		return NULL;
+	}
+
+	epoch->id = __atomic_fetch_add(&next_id, 1, __ATOMIC_SEQ_CST);
+	epoch->global = 2;
+	epoch->recs = NULL;
+	pthread_mutex_init(&epoch->limbo_lock, NULL);
+	epoch->limbo_head = NULL;
+	epoch->limbo_tail = NULL;
+
+	epoch->spare = NULL;
+	for(i = 0 ; i < RESERVE ; i++)
+	{
+		epoch->reserve[i].next = epoch->spare;
+		epoch->spare = &epoch->reserve[i];
+	}
+
+	pthread_mutex_init(&epoch->shared_lock, NULL);
+	epoch->shared.epoch = 0;
+	epoch->shared.active = 0;
+	epoch->shared.nesting = 0;
+	epoch->shared.next = NULL;
+
+	return epoch;
+}
+
+
+/*******************************************************************************
+Description:     	Frees every retired pointer and deletes the domain.
+Time Complexity: 	O(retired + threads).
+*******************************************************************************/
+void EpochDestroy(epoch_t *epoch)
+{
+	epoch_rec_t *rec = NULL;
+
+	assert(epoch);
+
+	FreeUpTo(epoch, 0, 1);
+
+	rec = __atomic_load_n(&epoch->recs, __ATOMIC_SEQ_CST);
+	while(NULL != rec)
+	{
+		epoch_rec_t *next = rec->next;
+		free(rec);
+		rec = next;
+	}
+
+	pthread_mutex_destroy(&epoch->shared_lock);
+	pthread_mutex_destroy(&epoch->limbo_lock);
+	free(epoch);epoch = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Starts a read-side critical section of the calling thread.
+Time Complexity: 	O(1), never blocks.
+*******************************************************************************/
+void EpochEnter(epoch_t *epoch)
+{
+	epoch_rec_t *rec = NULL;
+
+	assert(epoch);
+
+	rec = ThreadRec(epoch, 1);
+	if(NULL == rec)
+	{
+		EnterShared(epoch);
+		return;
+	}
+
+	if(0 == rec->nesting++)
+	{
+		Publish(epoch, rec);
+	}
+}
+
+
+/*******************************************************************************
+Description:     	Ends the read-side critical section of the calling thread.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void EpochExit(epoch_t *epoch)
+{
+	epoch_rec_t *rec = NULL;
+
+	assert(epoch);
+
+	rec = ThreadRec(epoch, 0);
+	if(NULL == rec)
+	{
+		ExitShared(epoch);
+		return;
+	}
+	assert(rec->nesting > 0);
+
+	if(0 == --rec->nesting)
+	{
+		__atomic_store_n(&rec->active, 0, __ATOMIC_RELEASE);
+	}
+}
+
+
+/*******************************************************************************
+Description:     	Schedules "free_func(ptr, user_params)" once no reader can
+					hold 'ptr'.
+Return value:    	0 in case of success, 1 if 'ptr' was freed on the spot,
+					2 if it was not retired.
+Time Complexity: 	O(1) + system call complexity.
+*******************************************************************************/
+int EpochRetire(epoch_t *epoch, void *ptr, action_func_t free_func,
+															void *user_params)
+{
+	limbo_t *node = (limbo_t*)malloc(sizeof(limbo_t));
+
+	assert(epoch);
+	assert(free_func);
+
+	pthread_mutex_lock(&epoch->limbo_lock);
+
+	if(NULL == node && NULL == (node = NewNode(epoch)))
+	{
+		size_t target = __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST) + 2;
+
+		pthread_mutex_unlock(&epoch->limbo_lock);
+
+		/*two epochs right away, then nobody can hold 'ptr', never waits*/
+		if(0 == EpochAdvance(epoch) && 0 == EpochAdvance(epoch) &&
+				__atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST) >= target)
+		{
+			free_func(ptr, user_params);
+			return 1;
+		}
+
+		return 2;
+	}
+
+	node->ptr = ptr;
+	node->free_func = free_func;
+	node->user_params = user_params;
+	node->next = NULL;
+
+	node->epoch = __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST);
+	if(NULL == epoch->limbo_tail)
+	{
+		epoch->limbo_head = node;
+	}
+	else
+	{
+		epoch->limbo_tail->next = node;
+	}
+	epoch->limbo_tail = node;
+
+	pthread_mutex_unlock(&epoch->limbo_lock);
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Moves the global epoch forward if every active reader has
+					observed the current one.
+Return value:    	0 if the epoch advanced, 1 if a reader holds it back.
+Time Complexity: 	O(threads).
+*******************************************************************************/
+int EpochAdvance(epoch_t *epoch)
+{
+	epoch_rec_t *rec = NULL;
+	size_t global = 0;
+
+	assert(epoch);
+
+	global = __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST);
+
+	for(rec = __atomic_load_n(&epoch->recs, __ATOMIC_SEQ_CST) ; NULL != rec ;
+															rec = rec->next)
+	{
+		if(__atomic_load_n(&rec->active, __ATOMIC_SEQ_CST) &&
+				__atomic_load_n(&rec->epoch, __ATOMIC_SEQ_CST) != global)
+		{
+			return 1;
+		}
+	}
+
+	rec = &epoch->shared;
+	if(__atomic_load_n(&rec->active, __ATOMIC_SEQ_CST) &&
+				__atomic_load_n(&rec->epoch, __ATOMIC_SEQ_CST) != global)
+	{
+		return 1;
+	}
+
+	return !__atomic_compare_exchange_n(&epoch->global, &global, global + 1,
+									0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+
+/*******************************************************************************
+Description:     	Frees the retired pointers that are two epochs old.
+Return value:    	Number of freed pointers.
+Time Complexity: 	O(freed).
+*******************************************************************************/
+size_t EpochReclaim(epoch_t *epoch)
+{
+	assert(epoch);
+
+	return FreeUpTo(epoch, __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST),
+																		0);
+}
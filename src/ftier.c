@@ -0,0 +1,738 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <string.h>		/* memcpy, memset	*/
+#include <stdint.h>		/* uint32_t			*/
+#include <errno.h>		/* errno			*/
+#include <fcntl.h>		/* open				*/
+#include <unistd.h>		/* pread, pwrite	*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+
+#include "aux_funcs.h" /*is_match_t*/
+#include "ftier.h"
+
+#define ALIGN8(bytes) (((bytes) + 7) & ~(size_t)7)
+
+enum{
+	REGION = 1 << 20,
+	BLOOM_KEYS_PER_WORD = 6,
+	BLOOM_HASHES = 3,
+	NO_REGION = UINT32_MAX
+};
+
+/* record layout in a region, the key bytes and the value bytes follow */
+typedef struct record
+{
+	uint32_t key_len;
+	uint32_t val_len;
+}record_t;
+
+/*
+ * A slot is live while 'gen' equals the generation of its region. Reclaiming
+ * a region bumps the generation, which drops all its slots at once, stale
+ * slots are reused by later inserts until the table is rebuilt. A key is
+ * told apart by its hash and 'fingerprint', a hash of its bytes.
+ */
+typedef struct slot
+{
+	uint64_t hash;
+	uint64_t fingerprint;
+	uint32_t region;
+	uint32_t gen;
+	uint32_t offset;
+	uint32_t len;
+}slot_t;
+
+struct ftier
+{
+	int fd;
+	size_t region_size;
+	uint32_t n_regions;
+	uint32_t *gens;
+	size_t *live;
+	uint64_t *blooms;
+	size_t bloom_words;		/*per region, a power of 2*/
+	slot_t *slots;
+	slot_t *spare;			/*the table is rebuilt into it*/
+	size_t mask;
+	size_t used;			/*slots ever filled since the last rebuild*/
+	size_t count;
+	size_t max_entries;
+	unsigned char *bufs[2];
+	int active;				/*bufs[active] holds 'active_region'*/
+	uint32_t active_region;
+	size_t fill;
+	unsigned char *flush_buf;	/*handed to the writer, NULL when idle*/
+	uint32_t flush_region;
+	size_t flush_len;
+	int stop;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	hash_func_t hash_func;
+	is_match_func_t match;
+	size_func_t key_size;
+	size_func_t val_size;
+};
+
+
+static uint64_t Mix(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+static uint64_t Fingerprint(const void *key, size_t len)
+{
+	const unsigned char *p = (const unsigned char*)key;
+	uint64_t h = 14695981039346656037ULL;
+	size_t i = 0;
+
+	for(i = 0 ; i < len ; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+/*
+ * Blocked Bloom filters: a key sets BLOOM_HASHES bits of one word. Word 'w' of
+ * every region is stored side by side, so testing all regions for a key is a
+ * single sequential scan of one row.
+ */
+static uint64_t BloomMask(uint64_t hash)
+{
+	uint64_t mask = 0;
+	int i = 0;
+
+	for(i = 0 ; i < BLOOM_HASHES ; i++)
+	{
+		mask |= (uint64_t)1 << ((hash >> (32 + 6 * i)) & 63);
+	}
+
+	return mask;
+}
+
+static uint64_t *BloomRow(const ftier_t *tier, uint64_t hash)
+{
+	return tier->blooms + (hash & (tier->bloom_words - 1)) * tier->n_regions;
+}
+
+static void BloomAdd(ftier_t *tier, uint32_t region, uint64_t hash)
+{
+	BloomRow(tier, hash)[region] |= BloomMask(hash);
+}
+
+static void BloomClear(ftier_t *tier, uint32_t region)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < tier->bloom_words ; i++)
+	{
+		tier->blooms[i * tier->n_regions + region] = 0;
+	}
+}
+
+static int MayContain(const ftier_t *tier, uint64_t hash)
+{
+	const uint64_t *row = BloomRow(tier, hash);
+	uint64_t mask = BloomMask(hash);
+	uint32_t i = 0;
+
+	for(i = 0 ; i < tier->n_regions ; i++)
+	{
+		if(mask == (row[i] & mask))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int IsLive(const ftier_t *tier, const slot_t *slot)
+{
+	return NO_REGION != slot->region && slot->gen == tier->gens[slot->region];
+}
+
+static slot_t *Find(ftier_t *tier, uint64_t hash, uint64_t fingerprint)
+{
+	size_t idx = hash & tier->mask;
+	size_t i = 0;
+
+	for(i = 0 ; i <= tier->mask ; i++, idx = (idx + 1) & tier->mask)
+	{
+		slot_t *slot = &tier->slots[idx];
+
+		if(NO_REGION == slot->region)
+		{
+			break;
+		}
+		if(slot->hash == hash && slot->fingerprint == fingerprint &&
+														IsLive(tier, slot))
+		{
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+/*returns the slot to fill for the key, its live copy if there is one*/
+static slot_t *Claim(ftier_t *tier, uint64_t hash, uint64_t fingerprint)
+{
+	size_t idx = hash & tier->mask;
+	slot_t *free_slot = NULL;
+	size_t i = 0;
+
+	for(i = 0 ; i <= tier->mask ; i++, idx = (idx + 1) & tier->mask)
+	{
+		slot_t *slot = &tier->slots[idx];
+
+		if(NO_REGION == slot->region)
+		{
+			return NULL != free_slot ? free_slot : slot;
+		}
+		if(IsLive(tier, slot))
+		{
+			if(slot->hash == hash && slot->fingerprint == fingerprint)
+			{
+				return slot;
+			}
+		}
+		else if(NULL == free_slot)
+		{
+			free_slot = slot;
+		}
+	}
+
+	return free_slot;
+}
+
+static void Kill(ftier_t *tier, slot_t *slot)
+{
+	--tier->live[slot->region];
+	--tier->count;
+	slot->gen = tier->gens[slot->region] - 1;
+}
+
+/*drops every entry of 'region', it is about to be overwritten*/
+static void Reclaim(ftier_t *tier, uint32_t region)
+{
+	if(0 == ++tier->gens[region])
+	{
+		/*0 is the generation of killed slots of a fresh region*/
+		tier->gens[region] = 1;
+	}
+
+	tier->count -= tier->live[region];
+	tier->live[region] = 0;
+	BloomClear(tier, region);
+}
+
+/*
+ * Reinserts the live slots into the cleared spare table. Dead slots are only
+ * ever reused, never emptied, so without this every probe would end up
+ * crossing them.
+ */
+static void Rebuild(ftier_t *tier)
+{
+	slot_t *old = tier->slots;
+	size_t i = 0;
+
+	tier->slots = tier->spare;
+	tier->spare = old;
+	tier->used = 0;
+
+	for(i = 0 ; i <= tier->mask ; i++)
+	{
+		tier->slots[i].region = NO_REGION;
+	}
+
+	for(i = 0 ; i <= tier->mask ; i++)
+	{
+		if(IsLive(tier, &old[i]))
+		{
+			*Claim(tier, old[i].hash, old[i].fingerprint) = old[i];
+			++tier->used;
+		}
+	}
+}
+
+static int WriteAll(int fd, const unsigned char *buf, size_t len, off_t at)
+{
+	while(len > 0)
+	{
+		ssize_t done = pwrite(fd, buf, len, at);
+
+		if(done < 0 && EINTR == errno)
+		{
+			continue;
+		}
+		if(done <= 0)
+		{
+			return 1;
+		}
+
+		buf += done;
+		len -= (size_t)done;
+		at += done;
+	}
+
+	return 0;
+}
+
+static int ReadAll(int fd, unsigned char *buf, size_t len, off_t at)
+{
+	while(len > 0)
+	{
+		ssize_t done = pread(fd, buf, len, at);
+
+		if(done < 0 && EINTR == errno)
+		{
+			continue;
+		}
+		if(done <= 0)
+		{
+			return 1;
+		}
+
+		buf += done;
+		len -= (size_t)done;
+		at += done;
+	}
+
+	return 0;
+}
+
+/*writes sealed regions out, one large sequential write each*/
+static void *Writer(void *arg)
+{
+	ftier_t *tier = (ftier_t*)arg;
+
+	pthread_mutex_lock(&tier->lock);
+
+	for(;;)
+	{
+		unsigned char *buf = NULL;
+		uint32_t region = 0;
+		size_t len = 0;
+		int status = 0;
+
+		while(NULL == tier->flush_buf && !tier->stop)
+		{
+			pthread_cond_wait(&tier->cond, &tier->lock);
+		}
+		if(NULL == tier->flush_buf)
+		{
+			break;
+		}
+
+		buf = tier->flush_buf;
+		region = tier->flush_region;
+		len = tier->flush_len;
+		pthread_mutex_unlock(&tier->lock);
+
+		status = WriteAll(tier->fd, buf, len,
+								(off_t)region * (off_t)tier->region_size);
+
+		pthread_mutex_lock(&tier->lock);
+		if(0 != status)
+		{
+			Reclaim(tier, region);
+		}
+		tier->flush_buf = NULL;
+		tier->flush_region = NO_REGION;
+		pthread_cond_broadcast(&tier->cond);
+	}
+
+	pthread_mutex_unlock(&tier->lock);
+
+	return NULL;
+}
+
+/*hands the full active region to the idle writer and opens the next one*/
+static void Seal(ftier_t *tier)
+{
+	tier->flush_buf = tier->bufs[tier->active];
+	tier->flush_region = tier->active_region;
+	tier->flush_len = tier->fill;
+	pthread_cond_broadcast(&tier->cond);
+
+	tier->active ^= 1;
+	tier->active_region = (tier->active_region + 1) % tier->n_regions;
+	tier->fill = 0;
+	Reclaim(tier, tier->active_region);
+
+	/*dead slots outnumber a quarter of the table*/
+	if(tier->used - tier->count > (tier->mask + 1) / 4)
+	{
+		Rebuild(tier);
+	}
+}
+
+static void FreeTier(ftier_t *tier)
+{
+	free(tier->gens);
+	free(tier->live);
+	free(tier->blooms);
+	free(tier->slots);
+	free(tier->spare);
+	free(tier->bufs[0]);
+	free(tier->bufs[1]);
+	free(tier);
+}
+
+
+/******************************************************************************
+Description:     	Creates a tier of 'bytes' bytes in the file at 'path'.
+Return value:    	Pointer to tier in case of success, otherwise NULL.
+Time Complexity: 	O(max_entries) + system call complexity.
+******************************************************************************/
+ftier_t *FTierCreate(const char *path, size_t bytes, size_t max_entries,
+						hash_func_t hash_func, is_match_func_t match,
+						size_func_t key_size, size_func_t val_size)
+{
+	ftier_t *tier = (ftier_t*)calloc(1, sizeof(ftier_t));
+	size_t per_region = 0;
+	size_t slots = 2;
+	size_t words = 1;
+	uint32_t i = 0;
+
+	assert(path);
+	assert(hash_func);
+	assert(match);
+	assert(key_size);
+	assert(val_size);
+
+	if(NULL == tier)
+	{
+		return NULL;
+	}
+
+	/*the log needs a region being filled and one being written*/
+	tier->region_size = bytes / 2 < REGION ? (bytes / 2) & ~(size_t)7 : REGION;
+	tier->n_regions = 0 == tier->region_size ? 0 :
+								(uint32_t)(bytes / tier->region_size);
+
+	if(tier->n_regions < 2 || 0 == max_entries)
+	{
+		free(tier);
+		return NULL;
+	}
+
+	per_region = max_entries / tier->n_regions + 1;
+	while(words * BLOOM_KEYS_PER_WORD < per_region)
+	{
+		words <<= 1;
+	}
+	while(slots < max_entries * 2)
+	{
+		slots <<= 1;
+	}
+
+	tier->bloom_words = words;
+	tier->mask = slots - 1;
+	tier->max_entries = max_entries;
+	tier->gens = (uint32_t*)malloc(tier->n_regions * sizeof(uint32_t));
+	tier->live = (size_t*)calloc(tier->n_regions, sizeof(size_t));
+	tier->blooms = (uint64_t*)calloc(tier->n_regions * words, sizeof(uint64_t));
+	tier->slots = (slot_t*)malloc(slots * sizeof(slot_t));
+	tier->spare = (slot_t*)malloc(slots * sizeof(slot_t));
+	tier->bufs[0] = (unsigned char*)malloc(tier->region_size);
+	tier->bufs[1] = (unsigned char*)malloc(tier->region_size);
+
+	if(NULL == tier->gens || NULL == tier->live || NULL == tier->blooms ||
+			NULL == tier->slots || NULL == tier->spare ||
+			NULL == tier->bufs[0] || NULL == tier->bufs[1])
+	{
+		FreeTier(tier);
+		return NULL;
+	}
+
+	for(i = 0 ; i < tier->n_regions ; i++)
+	{
+		tier->gens[i] = 1;
+	}
+	for(i = 0 ; i <= tier->mask ; i++)
+	{
+		tier->slots[i].region = NO_REGION;
+	}
+
+	tier->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(tier->fd < 0)
+	{
+		FreeTier(tier);
+		return NULL;
+	}
+	unlink(path);
+
+	if(0 != ftruncate(tier->fd, (off_t)tier->n_regions *
+											(off_t)tier->region_size))
+	{
+		close(tier->fd);
+		FreeTier(tier);
+		return NULL;
+	}
+
+	tier->active = 0;
+	tier->active_region = 0;
+	tier->fill = 0;
+	tier->flush_buf = NULL;
+	tier->flush_region = NO_REGION;
+	tier->stop = 0;
+	tier->count = 0;
+	tier->used = 0;
+	tier->hash_func = hash_func;
+	tier->match = match;
+	tier->key_size = key_size;
+	tier->val_size = val_size;
+	pthread_mutex_init(&tier->lock, NULL);
+	pthread_cond_init(&tier->cond, NULL);
+
+	if(0 != pthread_create(&tier->writer, NULL, Writer, tier))
+	{
+		pthread_cond_destroy(&tier->cond);
+		pthread_mutex_destroy(&tier->lock);
+		close(tier->fd);
+		FreeTier(tier);
+		return NULL;
+	}
+
+	return tier;
+}
+
+
+/******************************************************************************
+Description:     	Deletes a tier pointed to by "tier" from memory.
+Time Complexity: 	O(1) + system call complexity.
+*******************************************************************************/
+void FTierDestroy(ftier_t *tier)
+{
+	assert(tier);
+
+	pthread_mutex_lock(&tier->lock);
+	tier->stop = 1;
+	pthread_cond_broadcast(&tier->cond);
+	pthread_mutex_unlock(&tier->lock);
+
+	pthread_join(tier->writer, NULL);
+
+	pthread_cond_destroy(&tier->cond);
+	pthread_mutex_destroy(&tier->lock);
+	close(tier->fd);
+	FreeTier(tier);tier = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Appends a copy of 'key' and 'data' to the current region.
+Return value:    	0 in case of success otherwise 1, also when the region is
+					full while the previous one is still being written.
+Time Complexity: 	O(key and value size).
+*******************************************************************************/
+int FTierPut(void *tier_p, const void *key, const void *data)
+{
+	ftier_t *tier = (ftier_t*)tier_p;
+	size_t key_len = 0;
+	size_t val_len = 0;
+	size_t len = 0;
+	uint64_t hash = 0;
+	uint64_t fingerprint = 0;
+	record_t rec = {0, 0};
+	unsigned char *at = NULL;
+	slot_t *slot = NULL;
+	int status = 1;
+	int full = 0;
+
+	assert(tier);
+	assert(key);
+	assert(data);
+
+	key_len = tier->key_size(key);
+	val_len = tier->val_size(data);
+	len = ALIGN8(sizeof(record_t) + key_len + val_len);
+	hash = Mix(tier->hash_func(key));
+	fingerprint = Fingerprint(key, key_len);
+
+	if(len > tier->region_size)
+	{
+		return 1;
+	}
+
+	pthread_mutex_lock(&tier->lock);
+
+	/*
+	 * The caller may hold its own locks, so it never waits for the disk:
+	 * with the previous region still being written the copy is dropped,
+	 * and the older copy of the key with it.
+	 */
+	full = tier->fill + len > tier->region_size;
+	if(full && NULL == tier->flush_buf)
+	{
+		Seal(tier);
+		full = 0;
+	}
+
+	slot = full ? Find(tier, hash, fingerprint) :
+										Claim(tier, hash, fingerprint);
+	if(NULL != slot && IsLive(tier, slot))
+	{
+		Kill(tier, slot);
+	}
+
+	if(!full && NULL != slot && tier->count < tier->max_entries)
+	{
+		rec.key_len = (uint32_t)key_len;
+		rec.val_len = (uint32_t)val_len;
+		at = tier->bufs[tier->active] + tier->fill;
+		memcpy(at, &rec, sizeof(rec));
+		memcpy(at + sizeof(rec), key, key_len);
+		memcpy(at + sizeof(rec) + key_len, data, val_len);
+
+		if(NO_REGION == slot->region)
+		{
+			++tier->used;
+		}
+		slot->hash = hash;
+		slot->fingerprint = fingerprint;
+		slot->region = tier->active_region;
+		slot->gen = tier->gens[tier->active_region];
+		slot->offset = (uint32_t)tier->fill;
+		slot->len = (uint32_t)len;
+
+		BloomAdd(tier, tier->active_region, hash);
+		++tier->live[tier->active_region];
+		++tier->count;
+		tier->fill += len;
+		status = 0;
+	}
+
+	pthread_mutex_unlock(&tier->lock);
+
+	return status;
+}
+
+
+/*******************************************************************************
+Description:     	Removes 'key' and returns a copy of its value.
+Return value:    	Pointer to value in case of hit, otherwise NULL.
+Time Complexity: 	O(key and value size) + one pread().
+*******************************************************************************/
+void *FTierTake(void *tier_p, const void *key, void **stored_key)
+{
+	ftier_t *tier = (ftier_t*)tier_p;
+	uint64_t hash = 0;
+	uint64_t fingerprint = 0;
+	slot_t *slot = NULL;
+	slot_t loc;
+	unsigned char *copy = NULL;
+	unsigned char *val = NULL;
+	unsigned char *key_copy = NULL;
+	record_t rec = {0, 0};
+
+	assert(tier);
+	assert(key);
+	assert(stored_key);
+
+	*stored_key = NULL;
+	hash = Mix(tier->hash_func(key));
+	fingerprint = Fingerprint(key, tier->key_size(key));
+
+	pthread_mutex_lock(&tier->lock);
+
+	if(!MayContain(tier, hash) || NULL == (slot = Find(tier, hash, fingerprint)))
+	{
+		pthread_mutex_unlock(&tier->lock);
+		return NULL;
+	}
+
+	loc = *slot;
+	copy = (unsigned char*)malloc(loc.len);
+	if(NULL == copy)
+	{
+		pthread_mutex_unlock(&tier->lock);
+		return NULL;
+	}
+
+	if(loc.region == tier->active_region)
+	{
+		memcpy(copy, tier->bufs[tier->active] + loc.offset, loc.len);
+	}
+	else if(loc.region == tier->flush_region)
+	{
+		memcpy(copy, tier->flush_buf + loc.offset, loc.len);
+	}
+	else
+	{
+		int status = 0;
+
+		/*other threads keep going while the disk is read*/
+		pthread_mutex_unlock(&tier->lock);
+		status = ReadAll(tier->fd, copy, loc.len, (off_t)loc.region *
+								(off_t)tier->region_size + (off_t)loc.offset);
+		pthread_mutex_lock(&tier->lock);
+
+		/*the region may have been reclaimed and rewritten meanwhile*/
+		slot = Find(tier, hash, fingerprint);
+		if(0 != status || NULL == slot || slot->region != loc.region ||
+				slot->gen != loc.gen || slot->offset != loc.offset)
+		{
+			pthread_mutex_unlock(&tier->lock);
+			free(copy);
+			return NULL;
+		}
+	}
+
+	memcpy(&rec, copy, sizeof(rec));
+	key_copy = (unsigned char*)malloc(rec.key_len ? rec.key_len : 1);
+	val = (unsigned char*)malloc(rec.val_len ? rec.val_len : 1);
+
+	if(NULL != key_copy && NULL != val)
+	{
+		memcpy(key_copy, copy + sizeof(rec), rec.key_len);
+		memcpy(val, copy + sizeof(rec) + rec.key_len, rec.val_len);
+	}
+
+	if(NULL == key_copy || NULL == val || !tier->match(key_copy, key))
+	{
+		free(key_copy);
+		free(val);
+		key_copy = NULL;
+		val = NULL;
+	}
+	else
+	{
+		/*promoted back to the caller's tier, the copy here is dead*/
+		Kill(tier, slot);
+	}
+
+	pthread_mutex_unlock(&tier->lock);
+
+	free(copy);
+	*stored_key = key_copy;
+
+	return val;
+}
+
+
+/*******************************************************************************
+Description:     	Returns number of entries in "tier".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t FTierCount(ftier_t *tier)
+{
+	size_t count = 0;
+
+	assert(tier);
+
+	pthread_mutex_lock(&tier->lock);
+	count = tier->count;
+	pthread_mutex_unlock(&tier->lock);
+
+	return count;
+}
@@ -1,6 +1,7 @@
 #include <stdlib.h> 	/* malloc ,size_t*/
 #include <assert.h>		/* assert		*/
 #include <stdio.h>		/*printf		*/
+#include <stdint.h>		/* uint64_t		*/
 
 
 #include "dlist.h" 		/* dlist_t */
@@ -9,6 +10,8 @@
 #include "hash_t.h"
 
 #define UNUSED(x) ((void)(x))
+#define WORD_BITS 64
+#define WORDS(bits) (((bits) + WORD_BITS - 1) / WORD_BITS)
 
 struct hash
 {
@@ -16,6 +19,11 @@ struct hash
 	dlist_t **table;
 	size_t table_size;
 	is_match_func_t match;
+	uint64_t *occupied;		/* bit per bucket, set while it is not empty */
+	dlist_t **old_table;	/* while growing, see "HashGrow()" */
+	uint64_t *old_occupied;
+	size_t old_size;
+	size_t migrated;		/* old buckets below it moved to 'table' */
 };
 
 
@@ -59,6 +67,103 @@ static int ActionOnVal( void *data,  void *user_params)
 	return up->action_func(data_elem->val , up->val);
 }
 
+static void MarkOccupied(uint64_t *occupied, size_t index)
+{
+	occupied[index / WORD_BITS] |= (uint64_t)1 << (index % WORD_BITS);
+}
+
+static void MarkEmpty(uint64_t *occupied, size_t index)
+{
+	occupied[index / WORD_BITS] &= ~((uint64_t)1 << (index % WORD_BITS));
+}
+
+static int IsOccupied(const uint64_t *occupied, size_t index)
+{
+	return 0 != (occupied[index / WORD_BITS] >> (index % WORD_BITS) & 1);
+}
+
+/*returns the first occupied bucket at or after 'index', 'size' if none*/
+static size_t NextOccupied(const uint64_t *occupied, size_t size, size_t index)
+{
+	size_t word = index / WORD_BITS;
+	uint64_t bits = 0;
+
+	if(index >= size)
+	{
+		return size;
+	}
+
+	bits = occupied[word] & (~(uint64_t)0 << (index % WORD_BITS));
+
+	while(0 == bits)
+	{
+		if(++word == WORDS(size))
+		{
+			return size;
+		}
+		bits = occupied[word];
+	}
+
+	return word * WORD_BITS + (size_t)__builtin_ctzll(bits);
+}
+
+/*
+ * Returns the bucket 'key' lives in: the old one while it was not moved yet
+ * by "HashMigrate()", '*occupied' and '*index' locate its bit.
+ */
+static dlist_t *Bucket(const hash_t *hash, const void *key,
+										uint64_t **occupied, size_t *index)
+{
+	size_t hash_val = hash->hash_func(key);
+
+	if(NULL != hash->old_table && hash_val % hash->old_size >= hash->migrated)
+	{
+		*index = hash_val % hash->old_size;
+		*occupied = hash->old_occupied;
+
+		return hash->old_table[*index];
+	}
+
+	*index = hash_val % hash->table_size;
+	*occupied = hash->occupied;
+
+	return hash->table[*index];
+}
+
+/*calls "action_func" on the buckets in both tables until fail*/
+static int ForEachBucket(hash_t *hash, action_func_t action_func,
+															void *user_params)
+{
+	size_t i = 0;
+
+	for(i = NextOccupied(hash->occupied, hash->table_size, 0) ;
+				i < hash->table_size ;
+				i = NextOccupied(hash->occupied, hash->table_size, i + 1))
+	{
+		if(0 != action_func(hash->table[i], user_params))
+		{
+			return 1;
+		}
+	}
+
+	if(NULL == hash->old_table)
+	{
+		return 0;
+	}
+
+	for(i = NextOccupied(hash->old_occupied, hash->old_size, hash->migrated) ;
+				i < hash->old_size ;
+				i = NextOccupied(hash->old_occupied, hash->old_size, i + 1))
+	{
+		if(0 != action_func(hash->old_table[i], user_params))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 
 /******************************************************************************
 Description:     	Creates hash table ordered according to "hash_func".
@@ -79,9 +184,17 @@ hash_t *HashCreate(size_t table_size, hash_func_t hash_func, is_match_func_t mat
 	hash_table->table_size = table_size;
 	hash_table->table = (dlist_t**)malloc(table_size * sizeof(dlist_t*));
 	hash_table->match = match;
+	hash_table->occupied = (uint64_t*)calloc(WORDS(table_size),
+															sizeof(uint64_t));
+	hash_table->old_table = NULL;
+	hash_table->old_occupied = NULL;
+	hash_table->old_size = 0;
+	hash_table->migrated = 0;
 	
-	if(NULL == hash_table->table)
+	if(NULL == hash_table->table || NULL == hash_table->occupied)
 	{
+		free(hash_table->table);
+		free(hash_table->occupied);
 		free(hash_table);
 		return NULL;
 	}
@@ -99,6 +212,7 @@ hash_t *HashCreate(size_t table_size, hash_func_t hash_func, is_match_func_t mat
 			}
 		
 			free(hash_table->table);
+			free(hash_table->occupied);
 			free(hash_table);
 			return NULL;
 		}
@@ -117,27 +231,32 @@ static int freeData(void *data, void *user_params)
 	return 0;
 }
 
+static int ForEachInBucket(void *data, void *user_params)
+{
+	dlist_t *list = (dlist_t*)data;
+	user_params_action_t *up = (user_params_action_t*)user_params;
+
+	return DListForEach(DListIterBegin(list), DListIterEnd(list),
+													up->action_func, up->val);
+}
+
+static int CountBucket(void *data, void *user_params)
+{
+	*(size_t*)user_params += DListSize((dlist_t*)data);
+
+	return 0;
+}
+
 static int StaticHashForEach(hash_t *hash, action_func_t action_func, void *user_params)
 {
-	size_t size = 0;
-	size_t i = 0;
-	dlist_t *list = NULL;
-	
+	user_params_action_t up = {0};
+
 	assert(hash);
 
-	for(i = 0 ; i < hash->table_size ; i++)
-	{
-		list = hash->table[i];
-		
-		if(!DListIsEmpty(list))
-		{
-			ditr_t begin = DListIterBegin(list);
-			ditr_t end = DListIterEnd(list);
-			DListForEach(begin, end, action_func,user_params);
-		}
-	}
-	
-	return size;
+	up.action_func = action_func;
+	up.val = user_params;
+
+	return ForEachBucket(hash, ForEachInBucket, &up);
 }
 
 /******************************************************************************
@@ -155,11 +274,24 @@ void HashDestroy(hash_t *hash)
 	
 	for(i = 0 ; i < hash->table_size ; i++)
 	{
-		DListDestroy(hash->table[i]);
+		if(NULL != hash->table[i])
+		{
+			DListDestroy(hash->table[i]);
+		}
+	}
+
+	if(NULL != hash->old_table)
+	{
+		for(i = hash->migrated ; i < hash->old_size ; i++)
+		{
+			DListDestroy(hash->old_table[i]);
+		}
+		free(hash->old_table);
+		free(hash->old_occupied);
 	}
 	
-	
 	free(hash->table);hash->table=NULL;
+	free(hash->occupied);
 	free(hash);hash=NULL;
 }
 
@@ -178,8 +310,9 @@ void HashRemove(hash_t *hash, const void *key)
 	{
 	hash_elem_t *found = NULL;
 	ditr_t find;
-	size_t index = hash->hash_func(key);
-	dlist_t *list = hash->table[index];
+	uint64_t *occupied = NULL;
+	size_t index = 0;
+	dlist_t *list = Bucket(hash, key, &occupied, &index);
 	ditr_t begin = DListIterBegin(list);
 	ditr_t end = DListIterEnd(list);
 	user_params_t up = {0};
@@ -198,6 +331,11 @@ void HashRemove(hash_t *hash, const void *key)
 
 	free(found);
 	DListRemove(find);
+
+	if(DListIsEmpty(list))
+	{
+		MarkEmpty(occupied, index);
+	}
 	
 	}
 	
@@ -215,6 +353,8 @@ Notes: 			 	Undefined behaviour if hash is invalid pointer.
 int HashInsert(hash_t *hash,const void *key, void *val)
 {
 	size_t index = 0;
+	uint64_t *occupied = NULL;
+	dlist_t *list = NULL;
 	hash_elem_t *elem = (hash_elem_t*)malloc(sizeof(hash_elem_t));
 	if(NULL == elem)
 	{
@@ -225,8 +365,13 @@ int HashInsert(hash_t *hash,const void *key, void *val)
 	
 	assert(hash);
 
-	index = hash->hash_func(key) % hash->table_size;
-	DListPushFront(hash->table[index],elem);
+	list = Bucket(hash, key, &occupied, &index);
+	if(DListIterIsEqual(DListIterEnd(list), DListPushFront(list, elem)))
+	{
+		free(elem);
+		return 1;
+	}
+	MarkOccupied(occupied, index);
 	
 	return 0;
 }
@@ -239,14 +384,10 @@ Notes:			 	Undefined behaviour if 'hash' is invalid pointer.
 size_t HashSize(const hash_t *hash)
 {
 	size_t size = 0;
-	size_t i = 0;
 	
 	assert(hash);
 	
-	for(i = 0 ; i < hash->table_size ; i++)
-	{
-		size+=DListSize(hash->table[i]);
-	}
+	ForEachBucket((hash_t*)hash, CountBucket, &size);
 	
 	return size;
 }
@@ -278,8 +419,9 @@ void *HashFind(const hash_t *hash, const void *key)
 	assert(hash);
 	{
 	hash_elem_t *found = NULL;
-	size_t index = hash->hash_func(key);
-	dlist_t *list = hash->table[index];
+	uint64_t *occupied = NULL;
+	size_t index = 0;
+	dlist_t *list = Bucket(hash, key, &occupied, &index);
 	ditr_t begin = DListIterBegin(list);
 	ditr_t end = DListIterEnd(list);
 
@@ -313,9 +455,6 @@ Notes:            	Undefined behaviour if 'hash' is invalid pointer.
 *******************************************************************************/
 int HashForEach(hash_t *hash, action_func_t action_func, void *user_params)
 {
-	size_t size = 0;
-	size_t i = 0;
-	dlist_t *list = NULL;
 	user_params_action_t up = {0};
 	
 	up.action_func = action_func;
@@ -323,23 +462,191 @@ int HashForEach(hash_t *hash, action_func_t action_func, void *user_params)
 	
 	assert(hash);
 
-	for(i = 0 ; i < hash->table_size ; i++)
+	return StaticHashForEach(hash, ActionOnVal, &up);
+}
+
+
+/*******************************************************************************
+Description:  	  	Calls "action_func" on the elements of up to 'count'
+					occupied buckets, starting at 'cursor', until fail.
+Return value:     	Cursor to pass to the next call, 0 once the scan is done
+					or failed.
+Time complexity:  	O(count) + O(empty buckets / 64).
+Notes:            	Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+size_t HashScan(hash_t *hash, size_t cursor, size_t count,
+								action_func_t action_func, void *user_params)
+{
+	size_t i = 0;
+	user_params_action_t up = {0};
+	user_params_action_t bucket = {0};
+
+	up.action_func = action_func;
+	up.val = user_params;
+	bucket.action_func = ActionOnVal;
+	bucket.val = &up;
+
+	assert(hash);
+	assert(action_func);
+
+	if(NULL != hash->old_table)
 	{
-		list = hash->table[i];
-		
-		if(!DListIsEmpty(list))
+		/*
+		 * Growing: the cursor counts old buckets, a moved one is visited as
+		 * the two new buckets it was split into. Once the table grew the
+		 * cursor goes on in the new table, revisiting the upper halves of
+		 * the buckets it already passed but missing none.
+		 */
+		for(i = cursor ; i < hash->old_size && count > 0 ; ++i, --count)
 		{
-			ditr_t begin = DListIterBegin(list);
-			ditr_t end = DListIterEnd(list);
-			DListForEach(begin, end, ActionOnVal,&up);
+			if(i >= hash->migrated)
+			{
+				i = NextOccupied(hash->old_occupied, hash->old_size, i);
+				if(i == hash->old_size)
+				{
+					break;
+				}
+				if(0 != ForEachInBucket(hash->old_table[i], &bucket))
+				{
+					return 0;
+				}
+			}
+			else if((IsOccupied(hash->occupied, i) &&
+							0 != ForEachInBucket(hash->table[i], &bucket)) ||
+					(IsOccupied(hash->occupied, i + hash->old_size) &&
+							0 != ForEachInBucket(
+									hash->table[i + hash->old_size], &bucket)))
+			{
+				return 0;
+			}
 		}
 
+		return i < hash->old_size ? i : 0;
 	}
-	
-	return size;
+
+	for(i = NextOccupied(hash->occupied, hash->table_size, cursor) ;
+				i < hash->table_size && count > 0 ;
+				i = NextOccupied(hash->occupied, hash->table_size, i + 1),
+																	--count)
+	{
+		if(0 != ForEachInBucket(hash->table[i], &bucket))
+		{
+			return 0;
+		}
+	}
+
+	return i < hash->table_size ? i : 0;
+}
+
+
+/*******************************************************************************
+Description:  	  	Starts doubling the number of buckets of "hash". The
+					elements are moved over to the new buckets in small steps
+					by "HashMigrate()", meanwhile every function keeps working
+					on both tables.
+Return value:     	0 in case of success, otherwise 1 (no memory, or 'hash'
+					is still growing).
+Time complexity:  	O(1) + system call complexity.
+Notes:            	Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+int HashGrow(hash_t *hash)
+{
+	size_t new_size = 0;
+	dlist_t **table = NULL;
+	uint64_t *occupied = NULL;
+
+	assert(hash);
+
+	if(NULL != hash->old_table)
+	{
+		return 1;
+	}
+
+	/*h % 2n is h % n or h % n + n, an old bucket splits into two new ones*/
+	new_size = hash->table_size * 2;
+	table = (dlist_t**)calloc(new_size, sizeof(dlist_t*));
+	occupied = (uint64_t*)calloc(WORDS(new_size), sizeof(uint64_t));
+	if(NULL == table || NULL == occupied)
+	{
+		free(table);
+		free(occupied);
+		return 1;
+	}
+
+	hash->old_table = hash->table;
+	hash->old_occupied = hash->occupied;
+	hash->old_size = hash->table_size;
+	hash->migrated = 0;
+	hash->table = table;
+	hash->occupied = occupied;
+	hash->table_size = new_size;
+
+	return 0;
 }
 
 
+/*******************************************************************************
+Description:  	  	Moves the elements of up to 'buckets' old buckets of a
+					growing "hash" (see "HashGrow()") to the new table.
+Return value:     	Number of old buckets left to move, 0 once 'hash' does
+					not grow any more.
+Time complexity:  	O(buckets) average. Elements are relinked, not copied.
+Notes:            	Undefined behaviour if 'hash' is invalid pointer.
+*******************************************************************************/
+size_t HashMigrate(hash_t *hash, size_t buckets)
+{
+	assert(hash);
+
+	if(NULL == hash->old_table)
+	{
+		return 0;
+	}
+
+	for( ; buckets > 0 && hash->migrated < hash->old_size ; --buckets)
+	{
+		size_t low = hash->migrated;
+		size_t high = low + hash->old_size;
+		dlist_t *list = hash->old_table[low];
+
+		/*the new buckets only come to use once their old one moved*/
+		if(NULL == hash->table[low])
+		{
+			hash->table[low] = DListCreate();
+		}
+		if(NULL == hash->table[high])
+		{
+			hash->table[high] = DListCreate();
+		}
+		if(NULL == hash->table[low] || NULL == hash->table[high])
+		{
+			break; /*no memory, try again on the next call*/
+		}
+
+		while(!DListIsEmpty(list))
+		{
+			ditr_t first = DListIterBegin(list);
+			hash_elem_t *elem = (hash_elem_t*)DListGetData(first);
+			size_t index = hash->hash_func(elem->key) % hash->table_size;
+
+			DListSplice(DListIterBegin(hash->table[index]), first, first);
+			MarkOccupied(hash->occupied, index);
+		}
 
+		DListDestroy(list);
+		hash->old_table[low] = NULL;
+		MarkEmpty(hash->old_occupied, low);
+		++hash->migrated;
+	}
 
+	if(hash->migrated < hash->old_size)
+	{
+		return hash->old_size - hash->migrated;
+	}
+
+	free(hash->old_table);hash->old_table = NULL;
+	free(hash->old_occupied);hash->old_occupied = NULL;
+	hash->old_size = 0;
+	hash->migrated = 0;
 
+	return 0;
+}
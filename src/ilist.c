@@ -0,0 +1,352 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <stdint.h>		/* uint32_t			*/
+
+#include "aux_funcs.h" /*is_match_t , action_func*/
+#include "ilist.h"
+
+enum{
+	MIN_NODES = 16
+};
+
+/*
+ * Node 0 is the dummy: its 'next' is the first element and its 'prev' the
+ * last one. Free nodes are chained through 'next', 'free_head' 0 means none.
+ */
+typedef struct inode
+{
+	void *data;
+	uint32_t next;
+	uint32_t prev;
+}inode_t;
+
+struct ilist
+{
+	inode_t *nodes;
+	size_t n_nodes;
+	size_t size;
+	uint32_t free_head;
+};
+
+
+/*returns 1 if the array could not grow*/
+static int Grow(ilist_t *list)
+{
+	size_t n_nodes = list->n_nodes * 2;
+	inode_t *nodes = NULL;
+	size_t i = 0;
+
+	if(n_nodes > UINT32_MAX)
+	{
+		n_nodes = UINT32_MAX;
+	}
+	if(n_nodes == list->n_nodes)
+	{
+		return 1;
+	}
+
+	nodes = (inode_t*)realloc(list->nodes, n_nodes * sizeof(inode_t));
+	if(NULL == nodes)
+	{
+		return 1;
+	}
+
+	/*links are indices, they survive the move*/
+	for(i = list->n_nodes ; i < n_nodes ; i++)
+	{
+		nodes[i].next = i + 1 < n_nodes ? (uint32_t)(i + 1) : 0;
+	}
+
+	list->free_head = (uint32_t)list->n_nodes;
+	list->nodes = nodes;
+	list->n_nodes = n_nodes;
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Creates an empty index linked list.
+Return value:    	Pointer to list in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+*******************************************************************************/
+ilist_t *IListCreate(size_t capacity)
+{
+	ilist_t *list = (ilist_t*)malloc(sizeof(ilist_t));
+	size_t i = 0;
+
+	if(NULL == list)
+	{
+		return NULL;
+	}
+
+	list->n_nodes = capacity + 1 < MIN_NODES ? MIN_NODES : capacity + 1;
+	if(list->n_nodes > UINT32_MAX)
+	{
+		list->n_nodes = UINT32_MAX;
+	}
+
+	list->nodes = (inode_t*)malloc(list->n_nodes * sizeof(inode_t));
+	if(NULL == list->nodes)
+	{
+		free(list);
+		return NULL;
+	}
+
+	list->nodes[0].data = NULL;
+	list->nodes[0].next = 0;
+	list->nodes[0].prev = 0;
+
+	for(i = 1 ; i < list->n_nodes ; i++)
+	{
+		list->nodes[i].next = i + 1 < list->n_nodes ? (uint32_t)(i + 1) : 0;
+	}
+
+	list->free_head = 1;
+	list->size = 0;
+
+	return list;
+}
+
+
+/*******************************************************************************
+Description:     	Deletes a list pointed by "list" from memory.
+Time Complexity: 	O(1) + system call complexity.
+*******************************************************************************/
+void IListDestroy(ilist_t *list)
+{
+	assert(list);
+
+	free(list->nodes);list->nodes = NULL;
+	free(list);list = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Insert 'data' before 'where' in list pointed to by 'list'.
+Return value:    	Iterator to inserted data in success otherwise
+					IListIterEnd().
+Time Complexity: 	O(1), amortized when the array grows.
+*******************************************************************************/
+iitr_t IListInsertBefore(ilist_t *list, iitr_t where, void *data)
+{
+	iitr_t node = 0;
+	inode_t *nodes = NULL;
+
+	assert(list);
+	assert(where < list->n_nodes);
+
+	if(0 == list->free_head && 0 != Grow(list))
+	{
+		return ILIST_END;
+	}
+
+	nodes = list->nodes;
+	node = list->free_head;
+	list->free_head = nodes[node].next;
+
+	nodes[node].data = data;
+	nodes[node].next = where;
+	nodes[node].prev = nodes[where].prev;
+	nodes[nodes[where].prev].next = node;
+	nodes[where].prev = node;
+	++list->size;
+
+	return node;
+}
+
+
+iitr_t IListPushBack(ilist_t *list, void *data)
+{
+	return IListInsertBefore(list, ILIST_END, data);
+}
+
+
+iitr_t IListPushFront(ilist_t *list, void *data)
+{
+	assert(list);
+
+	return IListInsertBefore(list, list->nodes[0].next, data);
+}
+
+
+/*******************************************************************************
+Description:     	Deletes the element from the list pointed to by "what".
+Return value:    	Iterator to next element.
+Time Complexity: 	O(1).
+*******************************************************************************/
+iitr_t IListRemove(ilist_t *list, iitr_t what)
+{
+	inode_t *nodes = NULL;
+	iitr_t next = 0;
+
+	assert(list);
+	assert(ILIST_END != what);
+
+	nodes = list->nodes;
+	next = nodes[what].next;
+
+	nodes[nodes[what].prev].next = next;
+	nodes[next].prev = nodes[what].prev;
+
+	nodes[what].next = list->free_head;
+	list->free_head = what;
+	--list->size;
+
+	return next;
+}
+
+
+void *IListPopBack(ilist_t *list)
+{
+	void *data = NULL;
+	iitr_t last = 0;
+
+	assert(list);
+
+	last = list->nodes[0].prev;
+	data = list->nodes[last].data;
+	IListRemove(list, last);
+
+	return data;
+}
+
+
+void *IListPopFront(ilist_t *list)
+{
+	void *data = NULL;
+	iitr_t first = 0;
+
+	assert(list);
+
+	first = list->nodes[0].next;
+	data = list->nodes[first].data;
+	IListRemove(list, first);
+
+	return data;
+}
+
+
+size_t IListSize(const ilist_t *list)
+{
+	assert(list);
+
+	return list->size;
+}
+
+
+int IListIsEmpty(const ilist_t *list)
+{
+	assert(list);
+
+	return 0 == list->size;
+}
+
+
+/*******************************************************************************
+Description:  		Calls "action_func" on the elements in range [from, to)
+					until fail.
+Return value:     	0 for success, otherwise the status of the failed call.
+Time complexity:  	O(n).
+*******************************************************************************/
+int IListForEach(ilist_t *list, iitr_t from, iitr_t to,
+							action_func_t action_func, void *user_params)
+{
+	int status = 0;
+
+	assert(list);
+	assert(action_func);
+
+	while(from != to && 0 == status)
+	{
+		/*read the link first, the action may free the element's data*/
+		iitr_t next = list->nodes[from].next;
+
+		status = action_func(list->nodes[from].data, user_params);
+		from = next;
+	}
+
+	return status;
+}
+
+
+/*******************************************************************************
+Description:  		Moves [src_first, src_last] before "dest_where".
+Return value:     	Iterator to the last moved element.
+Time complexity:  	O(1).
+*******************************************************************************/
+iitr_t IListSplice(ilist_t *list, iitr_t dest_where, iitr_t src_first,
+															iitr_t src_last)
+{
+	inode_t *nodes = NULL;
+
+	assert(list);
+	assert(ILIST_END != src_first);
+	assert(ILIST_END != src_last);
+
+	nodes = list->nodes;
+
+	/*disconnect src, and reconnect first->prev and last->next*/
+	nodes[nodes[src_first].prev].next = nodes[src_last].next;
+	nodes[nodes[src_last].next].prev = nodes[src_first].prev;
+
+	/*connect first and where->prev*/
+	nodes[nodes[dest_where].prev].next = src_first;
+	nodes[src_first].prev = nodes[dest_where].prev;
+
+	/*connect last and where*/
+	nodes[src_last].next = dest_where;
+	nodes[dest_where].prev = src_last;
+
+	return src_last;
+}
+
+
+iitr_t IListIterBegin(const ilist_t *list)
+{
+	assert(list);
+
+	return list->nodes[0].next;
+}
+
+
+iitr_t IListIterEnd(const ilist_t *list)
+{
+	assert(list);
+
+	return ILIST_END;
+}
+
+
+iitr_t IListIterNext(const ilist_t *list, iitr_t itr)
+{
+	assert(list);
+
+	return list->nodes[itr].next;
+}
+
+
+iitr_t IListIterPrev(const ilist_t *list, iitr_t itr)
+{
+	assert(list);
+
+	return list->nodes[itr].prev;
+}
+
+
+void *IListGetData(const ilist_t *list, iitr_t itr)
+{
+	assert(list);
+	assert(ILIST_END != itr);
+
+	return list->nodes[itr].data;
+}
+
+
+void IListSetData(ilist_t *list, iitr_t itr, void *data)
+{
+	assert(list);
+	assert(ILIST_END != itr);
+
+	list->nodes[itr].data = data;
+}
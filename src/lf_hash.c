@@ -0,0 +1,555 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <stdint.h>		/* uintptr_t		*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+
+#include "aux_funcs.h" /*is_match_t*/
+#include "lf_hash.h"
+
+#define FROZEN_BIT ((uintptr_t)1)
+#define IS_FROZEN(val) (((uintptr_t)(val)) & FROZEN_BIT)
+#define THAW(val) ((void*)(((uintptr_t)(val)) & ~FROZEN_BIT))
+#define FREEZE(val) ((void*)(((uintptr_t)(val)) | FROZEN_BIT))
+#define TOMB ((void*)&tomb)
+#define IS_LIVE(val) (NULL != THAW(val) && TOMB != THAW(val))
+/* a scan cursor holds the slot to resume at and the table generation */
+#define CURSOR_POS_BITS (sizeof(size_t) * 8 - 16)
+#define CURSOR_POS(cursor) ((cursor) & (((size_t)1 << CURSOR_POS_BITS) - 1))
+#define CURSOR_GEN(cursor) ((cursor) >> CURSOR_POS_BITS)
+#define GEN_MASK ((size_t)0xffff)
+
+static long tomb = 0;
+
+enum{
+	MIN_TABLE_SIZE = 16,
+	LOAD_NUM = 3,		/* rebuild once 3/4 of the slots hold a key */
+	LOAD_DEN = 4
+};
+
+/*
+ * A slot's key is claimed once with a CAS. Removal CASes the value to TOMB
+ * (terminal: nobody writes that slot's value again) and then replaces the
+ * key with TOMB too, so the table drops its reference to the removed key.
+ * A key therefore has at most one live slot, dead slots are skipped and only
+ * reclaimed by a rebuild. While a table is rebuilt every value is frozen
+ * (lowest bit set), writers that meet a frozen value wait for the new table
+ * and retry there, readers just ignore the bit.
+ */
+typedef struct lf_slot
+{
+	const void *key;
+	void *val;
+}lf_slot_t;
+
+typedef struct lf_table
+{
+	size_t mask;
+	size_t gen;			/* bumped by every rebuild */
+	size_t claimed;
+	struct lf_table *retired_next;
+	lf_slot_t slots[1];
+}lf_table_t;
+
+struct lf_hash
+{
+	lf_table_t *table;
+	hash_func_t hash_func;
+	is_match_func_t match;
+	size_t size;
+	size_t min_size;
+	pthread_mutex_t rebuild_lock;
+	lf_table_t *retired;
+	epoch_t *epoch;
+};
+
+
+static size_t Mix(size_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= (size_t)0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+static lf_table_t *TableCreate(size_t size)
+{
+	lf_table_t *table = (lf_table_t*)malloc(sizeof(lf_table_t) +
+										(size - 1) * sizeof(lf_slot_t));
+	size_t i = 0;
+
+	if(NULL == table)
+	{
+		return NULL;
+	}
+
+	table->mask = size - 1;
+	table->gen = 0;
+	table->retired_next = NULL;
+	table->claimed = 0;
+
+	for(i = 0 ; i < size ; i++)
+	{
+		table->slots[i].key = NULL;
+		table->slots[i].val = NULL;
+	}
+
+	return table;
+}
+
+static size_t RoundPow2(size_t n)
+{
+	size_t pow2 = MIN_TABLE_SIZE;
+
+	while(pow2 < n)
+	{
+		pow2 <<= 1;
+	}
+
+	return pow2;
+}
+
+static int FreeTable(void *data, void *user_params)
+{
+	(void)user_params;
+	free(data);
+
+	return 0;
+}
+
+/*
+ * Replaces 'old' with a table that holds only the live keys.
+ * Returns 1 if the new table could not be allocated.
+ */
+static int Rebuild(lf_hash_t *hash, lf_table_t *old)
+{
+	lf_table_t *table = NULL;
+	size_t live = 0;
+	size_t i = 0;
+
+	pthread_mutex_lock(&hash->rebuild_lock);
+
+	if(old != __atomic_load_n(&hash->table, __ATOMIC_SEQ_CST))
+	{
+		pthread_mutex_unlock(&hash->rebuild_lock);
+		return 0; /*another writer already did it*/
+	}
+
+	for(i = 0 ; i <= old->mask ; i++)
+	{
+		void *val = __atomic_load_n(&old->slots[i].val, __ATOMIC_SEQ_CST);
+
+		while(!__atomic_compare_exchange_n(&old->slots[i].val, &val,
+							FREEZE(val), 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+		}
+
+		if(IS_LIVE(val))
+		{
+			++live;
+		}
+	}
+
+	table = TableCreate(RoundPow2(LOAD_DEN * live > hash->min_size ?
+										LOAD_DEN * live : hash->min_size));
+	if(NULL == table)
+	{
+		/*thaw, writers keep going in the old table*/
+		for(i = 0 ; i <= old->mask ; i++)
+		{
+			void *val = __atomic_load_n(&old->slots[i].val, __ATOMIC_SEQ_CST);
+
+			__atomic_store_n(&old->slots[i].val, THAW(val), __ATOMIC_SEQ_CST);
+		}
+
+		pthread_mutex_unlock(&hash->rebuild_lock);
+		return 1;
+	}
+
+	table->gen = old->gen + 1;
+
+	for(i = 0 ; i <= old->mask ; i++)
+	{
+		const void *key = __atomic_load_n(&old->slots[i].key, __ATOMIC_SEQ_CST);
+		void *val = THAW(__atomic_load_n(&old->slots[i].val, __ATOMIC_SEQ_CST));
+
+		if(NULL != key && TOMB != key && IS_LIVE(val))
+		{
+			size_t idx = Mix(hash->hash_func(key)) & table->mask;
+
+			while(NULL != __atomic_load_n(&table->slots[idx].key,
+														__ATOMIC_RELAXED))
+			{
+				idx = (idx + 1) & table->mask;
+			}
+
+			__atomic_store_n(&table->slots[idx].key, key,
+														__ATOMIC_RELAXED);
+			__atomic_store_n(&table->slots[idx].val, val,
+														__ATOMIC_RELAXED);
+			__atomic_fetch_add(&table->claimed, 1,
+														__ATOMIC_RELAXED);
+		}
+	}
+
+	__atomic_store_n(&hash->table, table, __ATOMIC_RELEASE);
+
+	/*
+	 * readers may still probe the old table, it waits for "LFHashDestroy()"
+	 * if the epoch has no room for it
+	 */
+	if(NULL == hash->epoch ||
+					2 == EpochRetire(hash->epoch, old, FreeTable, NULL))
+	{
+		old->retired_next = hash->retired;
+		hash->retired = old;
+	}
+
+	pthread_mutex_unlock(&hash->rebuild_lock);
+
+	return 0;
+}
+
+/* values are frozen only under rebuild_lock, wait for it to be released */
+static void WaitRebuild(lf_hash_t *hash)
+{
+	pthread_mutex_lock(&hash->rebuild_lock);
+	pthread_mutex_unlock(&hash->rebuild_lock);
+}
+
+
+/******************************************************************************
+Description:     	Creates a lock-free open addressing hash table.
+Return value:    	Pointer to hash table in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+******************************************************************************/
+lf_hash_t *LFHashCreate(size_t capacity, hash_func_t hash_func,
+												is_match_func_t match)
+{
+	lf_hash_t *hash = (lf_hash_t*)malloc(sizeof(lf_hash_t));
+	lf_table_t *table = NULL;
+
+	assert(hash_func);
+	assert(match);
+
+	if(NULL == hash)
+	{
+		return NULL;
+	}
+
+	hash->min_size = RoundPow2(capacity * LOAD_DEN / LOAD_NUM + 1);
+	table = TableCreate(hash->min_size);
+	if(NULL == table)
+	{
+		free(hash);
+		return NULL;
+	}
+
+	hash->table = table;
+	hash->size = 0;
+	hash->hash_func = hash_func;
+	hash->match = match;
+	hash->retired = NULL;
+	hash->epoch = NULL;
+	pthread_mutex_init(&hash->rebuild_lock, NULL);
+
+	return hash;
+}
+
+
+/******************************************************************************
+Description:     	Deletes a hash table pointed to by "hash" from memory.
+Time Complexity: 	O(table size).
+*******************************************************************************/
+void LFHashDestroy(lf_hash_t *hash)
+{
+	lf_table_t *table = NULL;
+
+	assert(hash);
+
+	while(NULL != hash->retired)
+	{
+		table = hash->retired;
+		hash->retired = table->retired_next;
+		free(table);
+	}
+
+	free(__atomic_load_n(&hash->table, __ATOMIC_SEQ_CST));
+	pthread_mutex_destroy(&hash->rebuild_lock);
+	free(hash);hash = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Hands replaced tables to "epoch".
+Time Complexity: 	O(1).
+*******************************************************************************/
+void LFHashSetEpoch(lf_hash_t *hash, epoch_t *epoch)
+{
+	assert(hash);
+
+	hash->epoch = epoch;
+}
+
+
+/*******************************************************************************
+Description:     	Maps 'key' to 'val', replacing the value of an existing key.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(1) average.
+*******************************************************************************/
+int LFHashInsert(lf_hash_t *hash, const void *key, void *val)
+{
+	size_t hash_val = 0;
+
+	assert(hash);
+	assert(key);
+	assert(val);
+	assert(!IS_FROZEN(val));
+
+	hash_val = Mix(hash->hash_func(key));
+
+	for(;;)
+	{
+		lf_table_t *table = __atomic_load_n(&hash->table,
+														__ATOMIC_ACQUIRE);
+		size_t idx = hash_val & table->mask;
+		size_t probes = 0;
+		lf_slot_t *slot = NULL;
+
+		for(probes = 0 ; probes <= table->mask ; probes++)
+		{
+			const void *slot_key = NULL;
+			void *old = NULL;
+
+			slot = &table->slots[idx];
+			idx = (idx + 1) & table->mask;
+			slot_key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+
+			if(NULL == slot_key)
+			{
+				if((__atomic_load_n(&table->claimed, __ATOMIC_SEQ_CST) + 1) *
+							LOAD_DEN > (table->mask + 1) * LOAD_NUM)
+				{
+					break;
+				}
+
+				if(__atomic_compare_exchange_n(&slot->key, &slot_key, key, 0,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+				{
+					__atomic_fetch_add(&table->claimed, 1, __ATOMIC_SEQ_CST);
+					slot_key = key;
+				}
+				/*else lost the slot, slot_key now holds the winner's key*/
+			}
+
+			if(TOMB == slot_key || !hash->match(slot_key, key))
+			{
+				continue;
+			}
+
+			old = __atomic_load_n(&slot->val, __ATOMIC_SEQ_CST);
+			while(!IS_FROZEN(old) && TOMB != old &&
+					!__atomic_compare_exchange_n(&slot->val, &old, val, 1,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+			}
+
+			if(IS_FROZEN(old))
+			{
+				break;
+			}
+
+			if(TOMB == old)
+			{
+				continue; /*removed meanwhile, the key goes further on*/
+			}
+
+			if(NULL == old)
+			{
+				__atomic_fetch_add(&hash->size, 1, __ATOMIC_SEQ_CST);
+			}
+
+			return 0;
+		}
+
+		/*no room, or the table is frozen - help or wait for the rebuild*/
+		if(0 != Rebuild(hash, table))
+		{
+			return 1;
+		}
+	}
+}
+
+
+/*******************************************************************************
+Description:     	Deletes the element related to 'key' from hash table.
+Return value:    	The removed value, NULL if 'key' was not found.
+Time Complexity: 	O(1) average.
+*******************************************************************************/
+void *LFHashRemove(lf_hash_t *hash, const void *key)
+{
+	size_t hash_val = 0;
+
+	assert(hash);
+	assert(key);
+
+	hash_val = Mix(hash->hash_func(key));
+
+	for(;;)
+	{
+		lf_table_t *table = __atomic_load_n(&hash->table,
+														__ATOMIC_ACQUIRE);
+		size_t idx = hash_val & table->mask;
+		size_t probes = 0;
+		int frozen = 0;
+
+		for(probes = 0 ; probes <= table->mask && !frozen ; probes++)
+		{
+			lf_slot_t *slot = &table->slots[idx];
+			const void *slot_key = __atomic_load_n(&slot->key,
+														__ATOMIC_ACQUIRE);
+			void *old = NULL;
+
+			idx = (idx + 1) & table->mask;
+
+			if(NULL == slot_key)
+			{
+				return NULL;
+			}
+
+			if(TOMB == slot_key || !hash->match(slot_key, key))
+			{
+				continue;
+			}
+
+			old = __atomic_load_n(&slot->val, __ATOMIC_SEQ_CST);
+			while(!IS_FROZEN(old) && IS_LIVE(old) &&
+					!__atomic_compare_exchange_n(&slot->val, &old, TOMB, 1,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+			}
+
+			if(IS_FROZEN(old))
+			{
+				frozen = 1;
+			}
+			else if(NULL == old)
+			{
+				return NULL; /*claimed, value not published yet*/
+			}
+			else if(TOMB != old)
+			{
+				__atomic_store_n(&slot->key, TOMB, __ATOMIC_RELEASE);
+				__atomic_fetch_sub(&hash->size, 1, __ATOMIC_SEQ_CST);
+
+				return old;
+			}
+		}
+
+		if(!frozen)
+		{
+			return NULL;
+		}
+
+		WaitRebuild(hash);
+	}
+}
+
+
+/*******************************************************************************
+Description:		Finds 'val' mapped to 'key'.
+Return value:       Pointer to val in case of success, otherwise NULL.
+Time complexity:    O(1) average, never takes a lock.
+*******************************************************************************/
+void *LFHashFind(const lf_hash_t *hash, const void *key)
+{
+	lf_table_t *table = NULL;
+	size_t idx = 0;
+	size_t probes = 0;
+
+	assert(hash);
+	assert(key);
+
+	table = __atomic_load_n(&hash->table, __ATOMIC_ACQUIRE);
+	idx = Mix(hash->hash_func(key)) & table->mask;
+
+	for(probes = 0 ; probes <= table->mask ; probes++)
+	{
+		const void *slot_key = __atomic_load_n(&table->slots[idx].key,
+														__ATOMIC_ACQUIRE);
+		if(NULL == slot_key)
+		{
+			return NULL;
+		}
+
+		if(TOMB != slot_key && hash->match(slot_key, key))
+		{
+			void *val = THAW(__atomic_load_n(&table->slots[idx].val,
+														__ATOMIC_ACQUIRE));
+			if(TOMB != val)
+			{
+				return val;
+			}
+		}
+
+		idx = (idx + 1) & table->mask;
+	}
+
+	return NULL;
+}
+
+
+/*******************************************************************************
+Description:  	  	Calls "action_func" on the values of up to 'count' live
+					slots, starting at 'cursor', until fail.
+Return value:     	Cursor to pass to the next call, 0 once the scan is done
+					or failed.
+Time complexity:  	O(count) + O(dead slots skipped), never takes a lock.
+*******************************************************************************/
+size_t LFHashScan(const lf_hash_t *hash, size_t cursor, size_t count,
+								action_func_t action_func, void *user_params)
+{
+	lf_table_t *table = NULL;
+	size_t gen = 0;
+	size_t i = 0;
+
+	assert(hash);
+	assert(action_func);
+
+	table = __atomic_load_n(&hash->table, __ATOMIC_ACQUIRE);
+	gen = table->gen & GEN_MASK;
+
+	/*a rebuild moved every key, start over in the new table*/
+	i = gen == CURSOR_GEN(cursor) ? CURSOR_POS(cursor) : 0;
+
+	for( ; i <= table->mask && count > 0 ; i++)
+	{
+		const void *key = __atomic_load_n(&table->slots[i].key,
+														__ATOMIC_ACQUIRE);
+		void *val = THAW(__atomic_load_n(&table->slots[i].val,
+														__ATOMIC_ACQUIRE));
+
+		if(NULL != key && TOMB != key && IS_LIVE(val))
+		{
+			if(0 != action_func(val, user_params))
+			{
+				return 0;
+			}
+			--count;
+		}
+	}
+
+	return i <= table->mask ? (gen << CURSOR_POS_BITS) | i : 0;
+}
+
+
+/*******************************************************************************
+Description:     	Returns number of elements in "hash".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t LFHashSize(const lf_hash_t *hash)
+{
+	assert(hash);
+
+	return __atomic_load_n(&hash->size, __ATOMIC_SEQ_CST);
+}
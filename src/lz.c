@@ -0,0 +1,230 @@
+#include <assert.h>		/* assert			*/
+#include <string.h>		/* memcpy, memset	*/
+#include <stdint.h>		/* uint32_t			*/
+
+#include "lz.h"
+
+/*
+ * Stream format (LZF):
+ *  000LLLLL                   literal run of L+1 bytes follows
+ *  LLLOOOOO OOOOOOOO          match of L+2 bytes at offset O+1 back
+ *  111OOOOO LLLLLLLL OOOOOOOO match of L+9 bytes at offset O+1 back
+ */
+enum{
+	HASH_LOG = 13,
+	MAX_LIT = 32,
+	MAX_OFF = 1 << 13,
+	MAX_REF = (1 << 8) + (1 << 3)
+};
+
+static uint32_t Hash3(const unsigned char *p)
+{
+	uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+	return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+
+/*******************************************************************************
+Description:     	Compresses 'in' into 'out'.
+Return value:    	Compressed length, 0 if it does not fit in 'out_cap'.
+Time Complexity: 	O(in_len).
+*******************************************************************************/
+size_t LZCompress(const void *in, size_t in_len, void *out, size_t out_cap)
+{
+	const unsigned char *ip = (const unsigned char*)in;
+	const unsigned char *in_end = ip + in_len;
+	unsigned char *op = (unsigned char*)out;
+	unsigned char *out_end = op + out_cap;
+	const unsigned char *table[1 << HASH_LOG];
+	size_t lit = 0;
+
+	assert(in);
+	assert(out);
+
+	memset(table, 0, sizeof(table));
+
+	if(0 == in_len || out_cap < 2)
+	{
+		return 0;
+	}
+
+	/*reserve the control byte of the first literal run*/
+	++op;
+
+	while(ip + 2 < in_end)
+	{
+		uint32_t h = Hash3(ip);
+		const unsigned char *ref = table[h];
+		size_t off = NULL == ref ? 0 : (size_t)(ip - ref);
+
+		table[h] = ip;
+
+		if(0 != off && off - 1 < MAX_OFF &&
+				ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+		{
+			size_t len = 3;
+			size_t max = (size_t)(in_end - ip);
+
+			if(max > MAX_REF)
+			{
+				max = MAX_REF;
+			}
+
+			while(len < max && ref[len] == ip[len])
+			{
+				++len;
+			}
+
+			if(op + 3 + 1 > out_end)
+			{
+				return 0;
+			}
+
+			/*close the pending literal run*/
+			if(0 == lit)
+			{
+				--op;
+			}
+			else
+			{
+				op[-(long)lit - 1] = (unsigned char)(lit - 1);
+			}
+
+			--off;
+			len -= 2;
+
+			if(len < 7)
+			{
+				*op++ = (unsigned char)((len << 5) + (off >> 8));
+			}
+			else
+			{
+				*op++ = (unsigned char)((7 << 5) + (off >> 8));
+				*op++ = (unsigned char)(len - 7);
+			}
+			*op++ = (unsigned char)off;
+
+			ip += len + 2;
+			lit = 0;
+			++op; /*control byte of the next literal run*/
+			continue;
+		}
+
+		if(op + 1 > out_end)
+		{
+			return 0;
+		}
+
+		*op++ = *ip++;
+		if(MAX_LIT == ++lit)
+		{
+			op[-(long)lit - 1] = (unsigned char)(lit - 1);
+			lit = 0;
+			++op;
+		}
+	}
+
+	while(ip < in_end)
+	{
+		if(op + 1 > out_end)
+		{
+			return 0;
+		}
+
+		*op++ = *ip++;
+		if(MAX_LIT == ++lit)
+		{
+			op[-(long)lit - 1] = (unsigned char)(lit - 1);
+			lit = 0;
+			++op;
+		}
+	}
+
+	if(0 == lit)
+	{
+		--op; /*drop the unused control byte*/
+	}
+	else
+	{
+		op[-(long)lit - 1] = (unsigned char)(lit - 1);
+	}
+
+	if(op > out_end)
+	{
+		return 0;
+	}
+
+	return (size_t)(op - (unsigned char*)out);
+}
+
+
+/*******************************************************************************
+Description:     	Decompresses 'in' into 'out'.
+Return value:    	Decompressed length, 0 on corrupt input or small 'out'.
+Time Complexity: 	O(output length).
+*******************************************************************************/
+size_t LZDecompress(const void *in, size_t in_len, void *out, size_t out_cap)
+{
+	const unsigned char *ip = (const unsigned char*)in;
+	const unsigned char *in_end = ip + in_len;
+	unsigned char *op = (unsigned char*)out;
+	unsigned char *out_end = op + out_cap;
+
+	assert(in);
+	assert(out);
+
+	while(ip < in_end)
+	{
+		size_t ctrl = *ip++;
+
+		if(ctrl < (1 << 5))
+		{
+			size_t len = ctrl + 1;
+
+			if(ip + len > in_end || op + len > out_end)
+			{
+				return 0;
+			}
+
+			memcpy(op, ip, len);
+			op += len;
+			ip += len;
+		}
+		else
+		{
+			size_t len = ctrl >> 5;
+			const unsigned char *ref = op - ((ctrl & 0x1f) << 8) - 1;
+
+			if(7 == len)
+			{
+				if(ip >= in_end)
+				{
+					return 0;
+				}
+				len += *ip++;
+			}
+
+			if(ip >= in_end)
+			{
+				return 0;
+			}
+
+			ref -= *ip++;
+			len += 2;
+
+			if(ref < (unsigned char*)out || op + len > out_end)
+			{
+				return 0;
+			}
+
+			/*byte by byte, the match may overlap its own output*/
+			while(len--)
+			{
+				*op++ = *ref++;
+			}
+		}
+	}
+
+	return (size_t)(op - (unsigned char*)out);
+}
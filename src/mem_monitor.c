@@ -0,0 +1,257 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <stdio.h>		/* fopen, fscanf	*/
+#include <time.h>		/* clock_gettime	*/
+#include <unistd.h>		/* sysconf			*/
+#include <pthread.h>	/* pthread_t		*/
+
+#include "cache.h"
+#include "mem_monitor.h"
+
+#define PSI_HIGH 10.0	/* % of time some task stalled on memory */
+#define PSI_LOW 1.0
+#define RSS_LOW(limit) ((limit) / 10 * 9)
+
+enum{
+	CALM_CHECKS = 5,	/* calm checks in a row before growing back */
+	GROW_STEPS = 16		/* growing back to max takes 16 checks */
+};
+
+struct mem_monitor
+{
+	cache_t *cache;
+	size_t min_capacity;
+	size_t max_capacity;
+	const char *psi_path;
+	size_t rss_limit;
+	unsigned interval_ms;
+	int stop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/* pressure levels */
+enum{
+	CALM,
+	STEADY,
+	HIGH
+};
+
+
+/*returns "some avg10" of a PSI file, -1 if it cannot be read*/
+static double ReadPsi(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	double avg10 = -1;
+
+	if(NULL == file)
+	{
+		return -1;
+	}
+
+	if(1 != fscanf(file, "some avg10=%lf", &avg10))
+	{
+		avg10 = -1;
+	}
+	fclose(file);
+
+	return avg10;
+}
+
+/*returns the resident set size of this process in bytes, 0 if unknown*/
+static size_t ReadRss(void)
+{
+	FILE *file = fopen("/proc/self/statm", "r");
+	unsigned long size = 0;
+	unsigned long resident = 0;
+
+	if(NULL == file)
+	{
+		return 0;
+	}
+
+	if(2 != fscanf(file, "%lu %lu", &size, &resident))
+	{
+		resident = 0;
+	}
+	fclose(file);
+
+	return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static int Level(const mem_monitor_t *monitor)
+{
+	int level = CALM;
+
+	if(NULL != monitor->psi_path)
+	{
+		double avg10 = ReadPsi(monitor->psi_path);
+
+		if(avg10 >= PSI_HIGH)
+		{
+			return HIGH;
+		}
+		if(avg10 > PSI_LOW)
+		{
+			level = STEADY;
+		}
+	}
+
+	if(0 != monitor->rss_limit)
+	{
+		size_t rss = ReadRss();
+
+		if(rss >= monitor->rss_limit)
+		{
+			return HIGH;
+		}
+		if(rss > RSS_LOW(monitor->rss_limit))
+		{
+			level = STEADY;
+		}
+	}
+
+	return level;
+}
+
+static size_t NextCapacity(const mem_monitor_t *monitor, size_t capacity,
+													int level, size_t *calm)
+{
+	size_t step = monitor->max_capacity / GROW_STEPS + 1;
+
+	if(HIGH == level)
+	{
+		*calm = 0;
+		capacity -= capacity / 4;
+
+		return capacity < monitor->min_capacity ?
+										monitor->min_capacity : capacity;
+	}
+
+	if(STEADY == level)
+	{
+		*calm = 0;
+
+		return capacity;
+	}
+
+	if(++*calm < CALM_CHECKS)
+	{
+		return capacity;
+	}
+
+	/*the cache may have been set past the maximum meanwhile*/
+	return capacity >= monitor->max_capacity ||
+				monitor->max_capacity - capacity < step ?
+								monitor->max_capacity : capacity + step;
+}
+
+static void *Monitor(void *arg)
+{
+	mem_monitor_t *monitor = (mem_monitor_t*)arg;
+	size_t calm = 0;
+
+	pthread_mutex_lock(&monitor->lock);
+
+	while(!monitor->stop)
+	{
+		struct timespec until;
+		size_t capacity = 0;
+
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += monitor->interval_ms / 1000;
+		until.tv_nsec += (long)(monitor->interval_ms % 1000) * 1000000;
+		if(until.tv_nsec >= 1000000000)
+		{
+			++until.tv_sec;
+			until.tv_nsec -= 1000000000;
+		}
+
+		while(!monitor->stop && 0 == pthread_cond_timedwait(&monitor->cond,
+												&monitor->lock, &until))
+		{
+		}
+		if(monitor->stop)
+		{
+			break;
+		}
+
+		pthread_mutex_unlock(&monitor->lock);
+
+		capacity = NextCapacity(monitor, CacheGetCapacity(monitor->cache),
+												Level(monitor), &calm);
+
+		/*called on every check, it also frees earlier evicted batches*/
+		CacheSetCapacity(monitor->cache, capacity);
+
+		pthread_mutex_lock(&monitor->lock);
+	}
+
+	pthread_mutex_unlock(&monitor->lock);
+
+	return NULL;
+}
+
+
+/******************************************************************************
+Description:     	Starts a thread that adapts the capacity of "cache".
+Return value:    	Pointer to monitor in case of success, otherwise NULL.
+Time Complexity: 	O(1) + system call complexity.
+******************************************************************************/
+mem_monitor_t *MemMonitorStart(cache_t *cache, size_t min_capacity,
+								size_t max_capacity, const char *psi_path,
+								size_t rss_limit, unsigned interval_ms)
+{
+	mem_monitor_t *monitor = NULL;
+
+	assert(cache);
+	assert(min_capacity <= max_capacity);
+
+	monitor = (mem_monitor_t*)malloc(sizeof(mem_monitor_t));
+	if(NULL == monitor)
+	{
+		return NULL;
+	}
+
+	monitor->cache = cache;
+	monitor->min_capacity = 0 == min_capacity ? 1 : min_capacity;
+	monitor->max_capacity = max_capacity;
+	monitor->psi_path = psi_path;
+	monitor->rss_limit = rss_limit;
+	monitor->interval_ms = 0 == interval_ms ? 1 : interval_ms;
+	monitor->stop = 0;
+	pthread_mutex_init(&monitor->lock, NULL);
+	pthread_cond_init(&monitor->cond, NULL);
+
+	if(0 != pthread_create(&monitor->thread, NULL, Monitor, monitor))
+	{
+		pthread_cond_destroy(&monitor->cond);
+		pthread_mutex_destroy(&monitor->lock);
+		free(monitor);
+		return NULL;
+	}
+
+	return monitor;
+}
+
+
+/******************************************************************************
+Description:     	Stops and deletes a monitor pointed to by "monitor".
+Time Complexity: 	O(1).
+*******************************************************************************/
+void MemMonitorStop(mem_monitor_t *monitor)
+{
+	assert(monitor);
+
+	pthread_mutex_lock(&monitor->lock);
+	monitor->stop = 1;
+	pthread_cond_signal(&monitor->cond);
+	pthread_mutex_unlock(&monitor->lock);
+
+	pthread_join(monitor->thread, NULL);
+
+	pthread_cond_destroy(&monitor->cond);
+	pthread_mutex_destroy(&monitor->lock);
+	free(monitor);monitor = NULL;
+}
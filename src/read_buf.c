@@ -0,0 +1,200 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <unistd.h>		/* sysconf			*/
+
+#include "aux_funcs.h" /* action_func_t */
+#include "read_buf.h"
+
+enum{
+	CACHE_LINE = 64
+};
+
+/* tail is bumped by recording threads, head only by the draining thread */
+typedef struct stripe
+{
+	size_t tail __attribute__((aligned(CACHE_LINE)));
+	size_t head __attribute__((aligned(CACHE_LINE)));
+	char pad __attribute__((aligned(CACHE_LINE)));
+}stripe_t;
+
+struct read_buf
+{
+	size_t n_stripes;
+	size_t stripe_len;
+	stripe_t *stripes;
+	void **slots;
+};
+
+static size_t next_thread_id = 1;
+static __thread size_t thread_id = 0;
+
+
+static size_t RoundPow2(size_t n)
+{
+	size_t pow2 = 1;
+
+	while(pow2 < n)
+	{
+		pow2 <<= 1;
+	}
+
+	return pow2;
+}
+
+static size_t ThreadStripe(const read_buf_t *buf)
+{
+	if(0 == thread_id)
+	{
+		thread_id = __atomic_fetch_add(&next_thread_id, 1, __ATOMIC_SEQ_CST);
+	}
+
+	return thread_id & (buf->n_stripes - 1);
+}
+
+
+/*******************************************************************************
+Description:     	Creates a striped, lossy buffer of recorded items.
+Return value:    	Pointer to buffer in case of success, otherwise NULL.
+Time Complexity: 	O(stripes * stripe_len).
+*******************************************************************************/
+read_buf_t *ReadBufCreate(size_t stripes, size_t stripe_len)
+{
+	read_buf_t *buf = (read_buf_t*)malloc(sizeof(read_buf_t));
+	size_t i = 0;
+
+	if(NULL == buf)
+	{
+		return NULL;
+	}
+
+	if(0 == stripes)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		stripes = cpus > 0 ? (size_t)cpus : 1;
+	}
+
+	buf->n_stripes = RoundPow2(stripes);
+	buf->stripe_len = RoundPow2(stripe_len ? stripe_len : 1);
+	buf->stripes = (stripe_t*)aligned_alloc(CACHE_LINE,
+										buf->n_stripes * sizeof(stripe_t));
+	buf->slots = (void**)malloc(buf->n_stripes * buf->stripe_len *
+														sizeof(*buf->slots));
+
+	if(NULL == buf->stripes || NULL == buf->slots)
+	{
+		free(buf->stripes);
+		free(buf->slots);
+		free(buf);
+		return NULL;
+	}
+
+	for(i = 0 ; i < buf->n_stripes ; i++)
+	{
+		buf->stripes[i].tail = 0;
+		buf->stripes[i].head = 0;
+	}
+
+	for(i = 0 ; i < buf->n_stripes * buf->stripe_len ; i++)
+	{
+		buf->slots[i] = NULL;
+	}
+
+	return buf;
+}
+
+
+/*******************************************************************************
+Description:     	Deletes a buffer pointed to by "buf" from memory.
+Time Complexity: 	O(1) + system call complexity.
+*******************************************************************************/
+void ReadBufDestroy(read_buf_t *buf)
+{
+	assert(buf);
+
+	free(buf->stripes);
+	free(buf->slots);
+	free(buf);buf = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Records 'item' in the stripe of the calling thread.
+Return value:    	1 if the stripe is full and should be drained, otherwise 0.
+Time complexity:  	O(1), never blocks.
+*******************************************************************************/
+int ReadBufRecord(read_buf_t *buf, void *item)
+{
+	size_t idx = 0;
+	stripe_t *stripe = NULL;
+	size_t head = 0;
+	size_t tail = 0;
+
+	assert(buf);
+	assert(item);
+
+	idx = ThreadStripe(buf);
+	stripe = &buf->stripes[idx];
+
+	tail = __atomic_load_n(&stripe->tail, __ATOMIC_RELAXED);
+	head = __atomic_load_n(&stripe->head, __ATOMIC_ACQUIRE);
+
+	if(tail - head >= buf->stripe_len)
+	{
+		return 1; /*lossy - drop the item*/
+	}
+
+	if(!__atomic_compare_exchange_n(&stripe->tail, &tail, tail + 1, 0,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+	{
+		return 0; /*lost the race to another recorder, drop*/
+	}
+
+	__atomic_store_n(&buf->slots[idx * buf->stripe_len +
+						(tail & (buf->stripe_len - 1))], item,
+													__ATOMIC_RELEASE);
+
+	return tail + 1 - head >= buf->stripe_len;
+}
+
+
+/*******************************************************************************
+Description:  	  	Calls "action_func" on every recorded item and removes them.
+Return value:     	0 if fully drained, 1 if an unpublished slot stopped it.
+Time complexity:  	O(number of recorded items).
+*******************************************************************************/
+int ReadBufDrain(read_buf_t *buf, action_func_t action_func,
+														void *user_params)
+{
+	int blocked = 0;
+	size_t i = 0;
+
+	assert(buf);
+	assert(action_func);
+
+	for(i = 0 ; i < buf->n_stripes ; i++)
+	{
+		stripe_t *stripe = &buf->stripes[i];
+		void **ring = &buf->slots[i * buf->stripe_len];
+		size_t head = __atomic_load_n(&stripe->head, __ATOMIC_RELAXED);
+		size_t tail = __atomic_load_n(&stripe->tail, __ATOMIC_ACQUIRE);
+
+		while(head != tail)
+		{
+			void *item = __atomic_exchange_n(
+							&ring[head & (buf->stripe_len - 1)], NULL,
+													__ATOMIC_ACQUIRE);
+			if(NULL == item)
+			{
+				blocked = 1; /*slot reserved but not published yet*/
+				break;
+			}
+
+			action_func(item, user_params);
+			++head;
+		}
+
+		__atomic_store_n(&stripe->head, head, __ATOMIC_RELEASE);
+	}
+
+	return blocked;
+}
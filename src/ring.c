@@ -0,0 +1,218 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <string.h>		/* memcpy			*/
+
+#include "ring.h"
+
+enum{
+	CACHE_LINE = 64,
+	SLOT_ALIGN = 16
+};
+
+/*
+ * The record of a slot follows its sequence number. A slot at position pos
+ * is free for the push of pos while 'seq' == pos, holds a record for the pop
+ * of pos while 'seq' == pos + 1, and is free again for the push of
+ * pos + capacity once popped.
+ */
+typedef struct slot
+{
+	size_t seq;
+}slot_t;
+
+/* producers only bump 'tail', consumers only 'head' */
+struct ring
+{
+	size_t tail __attribute__((aligned(CACHE_LINE)));
+	size_t head __attribute__((aligned(CACHE_LINE)));
+	size_t dropped __attribute__((aligned(CACHE_LINE)));
+	size_t mask;
+	size_t record_size;
+	size_t stride;
+	unsigned char *slots;
+};
+
+
+static size_t RoundPow2(size_t n)
+{
+	size_t pow2 = 1;
+
+	while(pow2 < n)
+	{
+		pow2 <<= 1;
+	}
+
+	return pow2;
+}
+
+static slot_t *Slot(const ring_t *ring, size_t pos)
+{
+	return (slot_t*)(ring->slots + (pos & ring->mask) * ring->stride);
+}
+
+
+/*******************************************************************************
+Description:     	Creates a bounded queue of 'capacity' records.
+Return value:    	Pointer to ring in case of success, otherwise NULL.
+Time Complexity: 	O(capacity).
+*******************************************************************************/
+ring_t *RingCreate(size_t capacity, size_t record_size)
+{
+	ring_t *ring = (ring_t*)aligned_alloc(CACHE_LINE,
+						(sizeof(ring_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1));
+	size_t i = 0;
+
+	assert(record_size > 0);
+
+	if(NULL == ring)
+	{
+		return NULL;
+	}
+
+	capacity = RoundPow2(0 == capacity ? 1 : capacity);
+	ring->mask = capacity - 1;
+	ring->record_size = record_size;
+	/*the record starts SLOT_ALIGN bytes into the slot*/
+	ring->stride = SLOT_ALIGN + ((record_size + SLOT_ALIGN - 1) &
+													~(size_t)(SLOT_ALIGN - 1));
+	ring->slots = (unsigned char*)malloc(capacity * ring->stride);
+	if(NULL == ring->slots)
+	{
+		free(ring);
+		return NULL;
+	}
+
+	for(i = 0 ; i < capacity ; i++)
+	{
+		Slot(ring, i)->seq = i;
+	}
+	ring->tail = 0;
+	ring->head = 0;
+	ring->dropped = 0;
+
+	return ring;
+}
+
+
+/*******************************************************************************
+Description:     	Deletes a ring pointed to by "ring" from memory.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void RingDestroy(ring_t *ring)
+{
+	assert(ring);
+
+	free(ring->slots);
+	free(ring);ring = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Copies 'record' into "ring", drops it if the ring is full.
+Return value:    	0 in case of success, 1 if the record was dropped.
+Time complexity:  	O(1), never blocks.
+*******************************************************************************/
+int RingPush(ring_t *ring, const void *record)
+{
+	size_t pos = 0;
+	slot_t *slot = NULL;
+
+	assert(ring);
+	assert(record);
+
+	pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+	for(;;)
+	{
+		size_t seq = 0;
+
+		slot = Slot(ring, pos);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if(seq == pos)
+		{
+			/*on failure 'pos' gets the tail another push moved to*/
+			if(__atomic_compare_exchange_n(&ring->tail, &pos,
+						pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if((ptrdiff_t)(seq - pos) < 0)
+		{
+			/*the slot still holds the record pushed a lap ago*/
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return 1;
+		}
+		else
+		{
+			pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy((unsigned char*)slot + SLOT_ALIGN, record, ring->record_size);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Copies the oldest record of "ring" to 'record' and removes
+					it.
+Return value:    	0 in case of success, 1 if the ring is empty.
+Time complexity:  	O(1), never blocks.
+*******************************************************************************/
+int RingPop(ring_t *ring, void *record)
+{
+	size_t pos = 0;
+	slot_t *slot = NULL;
+
+	assert(ring);
+	assert(record);
+
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+	for(;;)
+	{
+		size_t seq = 0;
+
+		slot = Slot(ring, pos);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if(seq == pos + 1)
+		{
+			if(__atomic_compare_exchange_n(&ring->head, &pos,
+						pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if((ptrdiff_t)(seq - (pos + 1)) < 0)
+		{
+			return 1;
+		}
+		else
+		{
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy(record, (unsigned char*)slot + SLOT_ALIGN, ring->record_size);
+	__atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Returns the number of records dropped because "ring" was
+					full.
+Time complexity:  	O(1).
+*******************************************************************************/
+size_t RingDropped(const ring_t *ring)
+{
+	assert(ring);
+
+	return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,830 @@
+#define _GNU_SOURCE			/* F_OFD_SETLK			*/
+#include <stdlib.h> 	/* malloc, qsort		*/
+#include <assert.h>		/* assert				*/
+#include <string.h>		/* memcpy, memcmp		*/
+#include <errno.h>		/* EEXIST, EOWNERDEAD	*/
+#include <stdint.h>		/* uint32_t, uint64_t	*/
+#include <time.h>		/* nanosleep			*/
+#include <fcntl.h>		/* O_CREAT, fcntl		*/
+#include <unistd.h>		/* ftruncate, close		*/
+#include <pthread.h>	/* pthread_mutex_t		*/
+#include <sys/mman.h>	/* shm_open, mmap		*/
+#include <sys/stat.h>	/* fstat				*/
+
+#include "shm_cache.h"
+
+#define NIL ((uint32_t)-1)
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+/* open file description locks are not shared by the threads of a process */
+#ifndef F_OFD_SETLK
+#define F_OFD_SETLK F_SETLK
+#endif
+
+enum{
+	SHM_MAGIC = 0x4c525543,		/* "LRUC" */
+	FACTOR = 2,
+	ATTACH_RETRIES = 1000
+};
+
+enum slot_state{
+	SLOT_FREE = 0,
+	SLOT_USED = 1
+};
+
+/* everything below lives inside the segment, links are slot indices */
+typedef struct shm_header
+{
+	uint32_t magic;
+	int ready;
+	size_t total_size;
+	size_t capacity;
+	size_t key_max;
+	size_t val_max;
+	size_t table_size;
+	size_t slot_size;
+	size_t buckets_off;
+	size_t slots_off;
+
+	pthread_mutex_t lock;
+	int dirty;
+	size_t size;
+	uint32_t lru_head;
+	uint32_t lru_tail;
+	uint32_t free_head;
+	uint64_t clock;
+}shm_header_t;
+
+typedef struct shm_slot
+{
+	uint32_t hnext;
+	uint32_t prev;
+	uint32_t next;
+	uint32_t state;
+	uint32_t key_len;
+	uint32_t val_len;
+	uint64_t hash;
+	uint64_t stamp;
+	/* key_max key bytes followed by val_max value bytes */
+}shm_slot_t;
+
+struct shm_cache
+{
+	shm_header_t *hdr;
+	uint32_t *buckets;
+	char *slots;
+	size_t map_size;
+};
+
+
+static uint64_t HashBytes(const void *key, size_t len)
+{
+	const unsigned char *p = (const unsigned char*)key;
+	uint64_t h = 14695981039346656037ULL;
+	size_t i = 0;
+
+	for(i = 0 ; i < len ; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+static shm_slot_t *Slot(const shm_cache_t *cache, uint32_t idx)
+{
+	return (shm_slot_t*)(cache->slots + (size_t)idx * cache->hdr->slot_size);
+}
+
+static char *SlotKey(shm_slot_t *slot)
+{
+	return (char*)(slot + 1);
+}
+
+static char *SlotVal(const shm_cache_t *cache, shm_slot_t *slot)
+{
+	return SlotKey(slot) + cache->hdr->key_max;
+}
+
+static void SetDirty(shm_header_t *hdr, int dirty)
+{
+	__atomic_store_n(&hdr->dirty, dirty, __ATOMIC_SEQ_CST);
+}
+
+static void LruUnlink(shm_cache_t *cache, uint32_t idx)
+{
+	shm_header_t *hdr = cache->hdr;
+	shm_slot_t *slot = Slot(cache, idx);
+
+	if(NIL == slot->prev)
+	{
+		hdr->lru_head = slot->next;
+	}
+	else
+	{
+		Slot(cache, slot->prev)->next = slot->next;
+	}
+
+	if(NIL == slot->next)
+	{
+		hdr->lru_tail = slot->prev;
+	}
+	else
+	{
+		Slot(cache, slot->next)->prev = slot->prev;
+	}
+
+	slot->prev = NIL;
+	slot->next = NIL;
+}
+
+static void LruPushBack(shm_cache_t *cache, uint32_t idx)
+{
+	shm_header_t *hdr = cache->hdr;
+	shm_slot_t *slot = Slot(cache, idx);
+
+	slot->next = NIL;
+	slot->prev = hdr->lru_tail;
+
+	if(NIL == hdr->lru_tail)
+	{
+		hdr->lru_head = idx;
+	}
+	else
+	{
+		Slot(cache, hdr->lru_tail)->next = idx;
+	}
+
+	hdr->lru_tail = idx;
+	slot->stamp = ++hdr->clock;
+}
+
+/* returns the link that points at the slot holding 'key' (or at NIL) */
+static uint32_t *FindLink(shm_cache_t *cache, const void *key, size_t key_len,
+																uint64_t hash)
+{
+	uint32_t *link = &cache->buckets[hash % cache->hdr->table_size];
+
+	while(NIL != *link)
+	{
+		shm_slot_t *slot = Slot(cache, *link);
+
+		if(slot->hash == hash && slot->key_len == key_len &&
+								0 == memcmp(SlotKey(slot), key, key_len))
+		{
+			break;
+		}
+
+		link = &slot->hnext;
+	}
+
+	return link;
+}
+
+/* unlinks the slot *link points at from the index and LRU, frees it */
+static void DropSlot(shm_cache_t *cache, uint32_t *link)
+{
+	shm_header_t *hdr = cache->hdr;
+	uint32_t idx = *link;
+	shm_slot_t *slot = Slot(cache, idx);
+
+	*link = slot->hnext;
+	LruUnlink(cache, idx);
+
+	slot->state = SLOT_FREE;
+	slot->hnext = hdr->free_head;
+	hdr->free_head = idx;
+	--hdr->size;
+}
+
+typedef struct stamp_idx
+{
+	uint64_t stamp;
+	uint32_t idx;
+}stamp_idx_t;
+
+static int CompareByStamp(const void *a, const void *b)
+{
+	uint64_t sa = ((const stamp_idx_t*)a)->stamp;
+	uint64_t sb = ((const stamp_idx_t*)b)->stamp;
+
+	return (sa > sb) - (sa < sb);
+}
+
+/*
+ * Called by the process that inherited the lock of a crashed owner while a
+ * mutation was in flight. Only the slot states and bytes are trusted, the
+ * index, the LRU order (from the access stamps) and the free list are rebuilt.
+ */
+static void Repair(shm_cache_t *cache)
+{
+	shm_header_t *hdr = cache->hdr;
+	stamp_idx_t *used = NULL;
+	uint64_t clock = 0;
+	size_t n_used = 0;
+	size_t i = 0;
+
+	for(i = 0 ; i < hdr->table_size ; i++)
+	{
+		cache->buckets[i] = NIL;
+	}
+
+	for(i = 0 ; i < hdr->capacity ; i++)
+	{
+		shm_slot_t *slot = Slot(cache, (uint32_t)i);
+
+		if(SLOT_USED == slot->state)
+		{
+			uint32_t *link = FindLink(cache, SlotKey(slot), slot->key_len,
+																	slot->hash);
+
+			/* a crash between writing a new copy and freeing the old one */
+			if(NIL != *link)
+			{
+				shm_slot_t *twin = Slot(cache, *link);
+
+				if(twin->stamp >= slot->stamp)
+				{
+					slot->state = SLOT_FREE;
+					continue;
+				}
+
+				twin->state = SLOT_FREE;
+				*link = twin->hnext;
+			}
+
+			slot->hnext = cache->buckets[slot->hash % hdr->table_size];
+			cache->buckets[slot->hash % hdr->table_size] = (uint32_t)i;
+		}
+	}
+
+	used = (stamp_idx_t*)malloc(hdr->capacity * sizeof(stamp_idx_t));
+
+	hdr->free_head = NIL;
+	for(i = hdr->capacity ; i > 0 ; i--)
+	{
+		shm_slot_t *slot = Slot(cache, (uint32_t)(i - 1));
+
+		if(SLOT_FREE == slot->state)
+		{
+			slot->hnext = hdr->free_head;
+			hdr->free_head = (uint32_t)(i - 1);
+		}
+		else if(NULL != used)
+		{
+			used[n_used].stamp = slot->stamp;
+			used[n_used].idx = (uint32_t)(i - 1);
+			++n_used;
+		}
+	}
+
+	hdr->lru_head = NIL;
+	hdr->lru_tail = NIL;
+	hdr->size = 0;
+
+	if(NULL == used)
+	{
+		/* no memory to sort, recency is lost but the set survives */
+		for(i = 0 ; i < hdr->capacity ; i++)
+		{
+			if(SLOT_USED == Slot(cache, (uint32_t)i)->state)
+			{
+				LruPushBack(cache, (uint32_t)i);
+				++hdr->size;
+			}
+		}
+	}
+	else
+	{
+		qsort(used, n_used, sizeof(stamp_idx_t), CompareByStamp);
+
+		for(i = 0 ; i < n_used ; i++)
+		{
+			LruPushBack(cache, used[i].idx);
+			Slot(cache, used[i].idx)->stamp = used[i].stamp;
+			clock = used[i].stamp;
+		}
+
+		hdr->size = n_used;
+		free(used);
+	}
+
+	if(clock > hdr->clock)
+	{
+		hdr->clock = clock;
+	}
+
+	SetDirty(hdr, 0);
+}
+
+/*
+ * Returns 0 with the lock held, 1 if it could not be taken: a lock left
+ * ENOTRECOVERABLE (an owner died and the heir failed to repair it) stays
+ * unusable until the segment is unlinked and created again.
+ */
+static int Lock(shm_cache_t *cache)
+{
+	int status = pthread_mutex_lock(&cache->hdr->lock);
+
+	if(EOWNERDEAD == status)
+	{
+		if(cache->hdr->dirty)
+		{
+			Repair(cache);
+		}
+
+		status = pthread_mutex_consistent(&cache->hdr->lock);
+		if(0 != status)
+		{
+			pthread_mutex_unlock(&cache->hdr->lock);
+		}
+	}
+
+	return 0 != status;
+}
+
+static void Unlock(shm_cache_t *cache)
+{
+	pthread_mutex_unlock(&cache->hdr->lock);
+}
+
+static void InitSegment(shm_header_t *hdr, size_t capacity, size_t key_max,
+										size_t val_max, size_t table_size)
+{
+	pthread_mutexattr_t attr;
+	shm_cache_t view = {0};
+	size_t i = 0;
+
+	hdr->capacity = capacity;
+	hdr->key_max = key_max;
+	hdr->val_max = val_max;
+	hdr->table_size = table_size;
+	hdr->slot_size = ALIGN8(sizeof(shm_slot_t) + key_max + val_max);
+	hdr->buckets_off = ALIGN8(sizeof(shm_header_t));
+	hdr->slots_off = ALIGN8(hdr->buckets_off + table_size * sizeof(uint32_t));
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&hdr->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	view.hdr = hdr;
+	view.buckets = (uint32_t*)((char*)hdr + hdr->buckets_off);
+	view.slots = (char*)hdr + hdr->slots_off;
+
+	for(i = 0 ; i < table_size ; i++)
+	{
+		view.buckets[i] = NIL;
+	}
+
+	hdr->free_head = NIL;
+	for(i = capacity ; i > 0 ; i--)
+	{
+		shm_slot_t *slot = Slot(&view, (uint32_t)(i - 1));
+
+		slot->state = SLOT_FREE;
+		slot->hnext = hdr->free_head;
+		hdr->free_head = (uint32_t)(i - 1);
+	}
+
+	hdr->lru_head = NIL;
+	hdr->lru_tail = NIL;
+	hdr->size = 0;
+	hdr->clock = 0;
+	hdr->dirty = 0;
+	hdr->magic = SHM_MAGIC;
+
+	__atomic_store_n(&hdr->ready, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * The creator holds a write lock on the object until the segment is ready,
+ * the system drops it when the creator dies. Returns 0 if it was taken.
+ */
+static int LockInit(int fd)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+
+	return 0 != fcntl(fd, F_OFD_SETLK, &fl);
+}
+
+/* removes "name" if it still refers to the (abandoned) object of 'fd' */
+static void UnlinkOrphan(const char *name, int fd)
+{
+	struct stat mine;
+	struct stat named;
+	int other = shm_open(name, O_RDWR, 0600);
+
+	if(-1 == other)
+	{
+		return;
+	}
+
+	if(0 == fstat(fd, &mine) && 0 == fstat(other, &named) &&
+			mine.st_dev == named.st_dev && mine.st_ino == named.st_ino)
+	{
+		shm_unlink(name);
+	}
+
+	close(other);
+}
+
+static void Nap(void)
+{
+	struct timespec ts = {0, 1000000};
+
+	nanosleep(&ts, NULL);
+}
+
+/*
+ * Called by an attacher that waited in vain for the segment to be ready. If
+ * no creator holds the init lock any more, the creator died half way: the
+ * segment is removed and, unless only attaching, created again.
+ */
+static shm_cache_t *Abandon(shm_cache_t *cache, const char *name, int fd,
+						shm_header_t *hdr, size_t total, size_t capacity,
+									size_t key_max, size_t val_max)
+{
+	int orphan = (0 == LockInit(fd));
+
+	if(orphan)
+	{
+		UnlinkOrphan(name, fd);
+	}
+
+	close(fd);
+	if(NULL != hdr)
+	{
+		munmap(hdr, total);
+	}
+	free(cache);
+
+	if(!orphan || 0 == capacity)
+	{
+		return NULL;
+	}
+
+	return ShmCacheOpen(name, capacity, key_max, val_max);
+}
+
+
+/******************************************************************************
+Description:     	Opens (or creates) a shared LRU cache named "name".
+Return value:    	Pointer to cache handle in case of success, otherwise NULL.
+Time Complexity: 	O(capacity) on creation, O(1) when attaching.
+******************************************************************************/
+shm_cache_t *ShmCacheOpen(const char *name, size_t capacity, size_t key_max,
+															size_t val_max)
+{
+	shm_cache_t *cache = NULL;
+	shm_header_t *hdr = NULL;
+	size_t table_size = capacity * FACTOR;
+	size_t total = 0;
+	int created = 1;
+	int fd = -1;
+	int i = 0;
+
+	assert(name);
+
+	if(capacity >= NIL)
+	{
+		return NULL;
+	}
+
+	cache = (shm_cache_t*)malloc(sizeof(shm_cache_t));
+	if(NULL == cache)
+	{
+		return NULL;
+	}
+
+	/* a zero capacity only attaches to an existing segment */
+	if(0 != capacity)
+	{
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+
+	if(0 == capacity || (-1 == fd && EEXIST == errno))
+	{
+		created = 0;
+		fd = shm_open(name, O_RDWR, 0600);
+	}
+
+	if(-1 == fd)
+	{
+		free(cache);
+		return NULL;
+	}
+
+	if(created)
+	{
+		total = ALIGN8(sizeof(shm_header_t));
+		total = ALIGN8(total + table_size * sizeof(uint32_t));
+		total += capacity * ALIGN8(sizeof(shm_slot_t) + key_max + val_max);
+
+		if(0 != LockInit(fd) || 0 != ftruncate(fd, (off_t)total))
+		{
+			close(fd);
+			shm_unlink(name);
+			free(cache);
+			return NULL;
+		}
+	}
+	else
+	{
+		struct stat st;
+
+		/* wait for the creator to size the segment */
+		for(i = 0 ; i < ATTACH_RETRIES ; i++)
+		{
+			if(0 != fstat(fd, &st))
+			{
+				st.st_size = 0;
+			}
+			else if((size_t)st.st_size >= sizeof(shm_header_t))
+			{
+				break;
+			}
+			Nap();
+		}
+
+		total = (size_t)st.st_size;
+		if(total < sizeof(shm_header_t))
+		{
+			return Abandon(cache, name, fd, NULL, 0, capacity, key_max,
+																	val_max);
+		}
+	}
+
+	hdr = (shm_header_t*)mmap(NULL, total, PROT_READ | PROT_WRITE,
+														MAP_SHARED, fd, 0);
+
+	if(MAP_FAILED == (void*)hdr)
+	{
+		close(fd);
+		if(created)
+		{
+			shm_unlink(name);
+		}
+		free(cache);
+		return NULL;
+	}
+
+	if(created)
+	{
+		hdr->total_size = total;
+		InitSegment(hdr, capacity, key_max, val_max, table_size);
+	}
+	else
+	{
+		for(i = 0 ; i < ATTACH_RETRIES ; i++)
+		{
+			if(__atomic_load_n(&hdr->ready, __ATOMIC_ACQUIRE))
+			{
+				break;
+			}
+			Nap();
+		}
+
+		if(!__atomic_load_n(&hdr->ready, __ATOMIC_ACQUIRE))
+		{
+			return Abandon(cache, name, fd, hdr, total, capacity, key_max,
+																	val_max);
+		}
+
+		if(SHM_MAGIC != hdr->magic || hdr->total_size != total)
+		{
+			close(fd);
+			munmap(hdr, total);
+			free(cache);
+			return NULL;
+		}
+	}
+
+	/* lets go of the init lock of a creator */
+	close(fd);
+
+	cache->hdr = hdr;
+	cache->map_size = total;
+	cache->buckets = (uint32_t*)((char*)hdr + hdr->buckets_off);
+	cache->slots = (char*)hdr + hdr->slots_off;
+
+	return cache;
+}
+
+
+/******************************************************************************
+Description:     	Detaches the calling process from the shared segment.
+Time Complexity: 	Determined by system call complexity.
+******************************************************************************/
+void ShmCacheClose(shm_cache_t *cache)
+{
+	assert(cache);
+
+	munmap(cache->hdr, cache->map_size);
+	free(cache);cache = NULL;
+}
+
+
+/******************************************************************************
+Description:     	Removes the shared memory object "name".
+Return value:    	0 in case of success otherwise 1.
+******************************************************************************/
+int ShmCacheUnlink(const char *name)
+{
+	assert(name);
+
+	return 0 != shm_unlink(name);
+}
+
+
+/*******************************************************************************
+Description:     	Copies key and value bytes into the shared cache.
+Return value:    	0 in case of success otherwise 1.
+Time Complexity: 	O(1) average.
+*******************************************************************************/
+int ShmCacheSet(shm_cache_t *cache, const void *key, size_t key_len,
+										const void *val, size_t val_len)
+{
+	shm_header_t *hdr = NULL;
+	shm_slot_t *slot = NULL;
+	uint32_t *link = NULL;
+	uint32_t idx = NIL;
+	uint64_t hash = 0;
+
+	assert(cache);
+	assert(key);
+	assert(val);
+
+	hdr = cache->hdr;
+	if(key_len > hdr->key_max || val_len > hdr->val_max)
+	{
+		return 1;
+	}
+
+	hash = HashBytes(key, key_len);
+
+	if(0 != Lock(cache))
+	{
+		return 1;
+	}
+	SetDirty(hdr, 1);
+
+	link = FindLink(cache, key, key_len, hash);
+	if(NIL == hdr->free_head)
+	{
+		if(NIL == *link)
+		{
+			/*Cache Miss - evict the least recently used*/
+			shm_slot_t *victim = Slot(cache, hdr->lru_head);
+
+			DropSlot(cache, FindLink(cache, SlotKey(victim), victim->key_len,
+																victim->hash));
+		}
+		else
+		{
+			/* no room for a second copy: a crash now loses the entry */
+			DropSlot(cache, link);
+		}
+	}
+
+	/* when there is room the new copy is complete before the old one goes */
+	idx = hdr->free_head;
+	slot = Slot(cache, idx);
+	hdr->free_head = slot->hnext;
+
+	slot->hash = hash;
+	slot->key_len = (uint32_t)key_len;
+	slot->val_len = (uint32_t)val_len;
+	memcpy(SlotKey(slot), key, key_len);
+	memcpy(SlotVal(cache, slot), val, val_len);
+	slot->stamp = hdr->clock + 1;
+	__atomic_store_n(&slot->state, SLOT_USED, __ATOMIC_SEQ_CST);
+
+	link = FindLink(cache, key, key_len, hash);
+	if(NIL != *link)
+	{
+		DropSlot(cache, link);
+	}
+
+	slot->hnext = cache->buckets[hash % hdr->table_size];
+	cache->buckets[hash % hdr->table_size] = idx;
+	LruPushBack(cache, idx);
+	++hdr->size;
+
+	SetDirty(hdr, 0);
+	Unlock(cache);
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Copies the value mapped to key into 'buf'.
+Return value:    	0 on hit, 1 on miss, 2 if 'buf' is too small.
+Time Complexity: 	O(1) average.
+*******************************************************************************/
+int ShmCacheGet(shm_cache_t *cache, const void *key, size_t key_len,
+											void *buf, size_t *val_len)
+{
+	uint32_t *link = NULL;
+	shm_slot_t *slot = NULL;
+	int status = 1;
+
+	assert(cache);
+	assert(key);
+	assert(buf);
+	assert(val_len);
+
+	if(0 != Lock(cache))
+	{
+		return 1;
+	}
+
+	link = FindLink(cache, key, key_len, HashBytes(key, key_len));
+	if(NIL != *link)
+	{
+		slot = Slot(cache, *link);
+
+		if(slot->val_len > *val_len)
+		{
+			status = 2;
+		}
+		else
+		{
+			memcpy(buf, SlotVal(cache, slot), slot->val_len);
+
+			/*update priority LRU*/
+			SetDirty(cache->hdr, 1);
+			LruUnlink(cache, *link);
+			LruPushBack(cache, *link);
+			SetDirty(cache->hdr, 0);
+
+			status = 0;
+		}
+
+		*val_len = slot->val_len;
+	}
+
+	Unlock(cache);
+
+	return status;
+}
+
+
+/*******************************************************************************
+Description:     	Deletes the entry of key.
+Return value:    	0 if an entry was removed, otherwise 1.
+Time Complexity: 	O(1) average.
+*******************************************************************************/
+int ShmCacheRemove(shm_cache_t *cache, const void *key, size_t key_len)
+{
+	uint32_t *link = NULL;
+	int status = 1;
+
+	assert(cache);
+	assert(key);
+
+	if(0 != Lock(cache))
+	{
+		return 1;
+	}
+
+	link = FindLink(cache, key, key_len, HashBytes(key, key_len));
+	if(NIL != *link)
+	{
+		SetDirty(cache->hdr, 1);
+		DropSlot(cache, link);
+		SetDirty(cache->hdr, 0);
+		status = 0;
+	}
+
+	Unlock(cache);
+
+	return status;
+}
+
+
+/*******************************************************************************
+Description:     	Returns number of entries in the shared cache.
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t ShmCacheSize(shm_cache_t *cache)
+{
+	size_t size = 0;
+
+	assert(cache);
+
+	if(0 == Lock(cache))
+	{
+		size = cache->hdr->size;
+		Unlock(cache);
+	}
+
+	return size;
+}
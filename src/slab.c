@@ -0,0 +1,544 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <stdint.h>		/* uintptr_t		*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+#include <sys/mman.h>	/* mmap				*/
+
+#include "aux_funcs.h" /*action_func_t*/
+#include "slab.h"
+
+#define NO_CLASS ((size_t)-1)
+
+enum{
+	PAGE = 1 << 20,
+	PAGE_HEAD = 64,		/* page_t, rounded up */
+	ALIGN = 16,
+	MIN_CHUNK = 64,
+	GROWTH_NUM = 5,		/* chunk sizes grow by 5/4 */
+	GROWTH_DEN = 4
+};
+
+/* precedes every chunk, a free chunk is linked through 'next' */
+typedef struct chunk
+{
+	void *owner;
+	struct chunk *next;
+}chunk_t;
+
+/*
+ * Lives at the start of its page, pages are aligned to PAGE so a chunk finds
+ * it by masking its address. Chunks past 'carved' were never handed out, a
+ * page is only touched as far as it is used. A page is in its class's
+ * 'partial' list while it has a free chunk and is not being moved.
+ */
+typedef struct page
+{
+	struct page *next;
+	struct page *prev;
+	chunk_t *free;
+	size_t carved;
+	size_t used;
+	size_t class_id;
+	size_t move_to;		/* NO_CLASS unless the page is being moved */
+}page_t;
+
+typedef struct slab_class
+{
+	size_t chunk_size;	/* with its chunk_t */
+	size_t per_page;
+	page_t partial;		/* sentinel */
+	size_t pages;
+	size_t used;
+	size_t failures;
+	pthread_mutex_t lock;
+}slab_class_t;
+
+/*
+ * 'pages_lock' guards 'pages' and 'n_pages', it is taken under a class lock,
+ * never the other way around. 'moving' is set while a page is on its way.
+ */
+struct slab
+{
+	slab_class_t *classes;
+	size_t n_classes;
+	page_t **pages;
+	size_t n_pages;
+	size_t max_pages;
+	pthread_mutex_t pages_lock;
+	int moving;
+};
+
+
+static page_t *PageOf(const chunk_t *chunk)
+{
+	return (page_t*)((uintptr_t)chunk & ~(uintptr_t)(PAGE - 1));
+}
+
+static chunk_t *ChunkAt(const slab_t *slab, page_t *page, size_t i)
+{
+	return (chunk_t*)((char*)page + PAGE_HEAD +
+									i * slab->classes[page->class_id].chunk_size);
+}
+
+static void LinkPartial(slab_class_t *class, page_t *page)
+{
+	page->next = class->partial.next;
+	page->prev = &class->partial;
+	class->partial.next->prev = page;
+	class->partial.next = page;
+}
+
+static void UnlinkPartial(page_t *page)
+{
+	page->prev->next = page->next;
+	page->next->prev = page->prev;
+	page->next = page;
+	page->prev = page;
+}
+
+static void InitPage(page_t *page, size_t class_id)
+{
+	page->next = page;
+	page->prev = page;
+	page->free = NULL;
+	page->carved = 0;
+	page->used = 0;
+	page->class_id = class_id;
+	page->move_to = NO_CLASS;
+}
+
+/*maps twice the size and trims it, so the page is aligned to its size*/
+static page_t *MapPage(void)
+{
+	char *area = (char*)mmap(NULL, 2 * (size_t)PAGE, PROT_READ | PROT_WRITE,
+										MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	char *page = NULL;
+
+	if(MAP_FAILED == area)
+	{
+		return NULL;
+	}
+
+	page = (char*)(((uintptr_t)area + PAGE - 1) & ~(uintptr_t)(PAGE - 1));
+	if(page > area)
+	{
+		munmap(area, (size_t)(page - area));
+	}
+	if(page + PAGE < area + 2 * (size_t)PAGE)
+	{
+		munmap(page + PAGE, (size_t)(area + 2 * (size_t)PAGE - (page + PAGE)));
+	}
+
+	return (page_t*)page;
+}
+
+/*called under the lock of the class, NULL once all memory is mapped*/
+static page_t *NewPage(slab_t *slab, size_t class_id)
+{
+	page_t *page = NULL;
+
+	pthread_mutex_lock(&slab->pages_lock);
+
+	if(slab->n_pages < slab->max_pages)
+	{
+		page = MapPage();
+		if(NULL != page)
+		{
+			InitPage(page, class_id);
+			slab->pages[slab->n_pages++] = page;
+		}
+	}
+
+	pthread_mutex_unlock(&slab->pages_lock);
+
+	return page;
+}
+
+/*an emptied page that was on its way joins its new class*/
+static void Adopt(slab_t *slab, page_t *page)
+{
+	slab_class_t *class = &slab->classes[page->move_to];
+
+	pthread_mutex_lock(&class->lock);
+	InitPage(page, (size_t)(class - slab->classes));
+	LinkPartial(class, page);
+	++class->pages;
+	pthread_mutex_unlock(&class->lock);
+
+	__atomic_store_n(&slab->moving, 0, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+Description:     	Creates an allocator of up to 'memory' bytes.
+Return value:    	Pointer to allocator in case of success, otherwise NULL.
+Time Complexity: 	O(classes).
+******************************************************************************/
+slab_t *SlabCreate(size_t memory)
+{
+	slab_t *slab = (slab_t*)malloc(sizeof(slab_t));
+	size_t chunk_size = MIN_CHUNK;
+	size_t n_classes = 0;
+	size_t i = 0;
+
+	assert(sizeof(page_t) <= PAGE_HEAD);
+
+	if(NULL == slab)
+	{
+		return NULL;
+	}
+
+	/*the last class takes the rest of a page in one chunk*/
+	while(chunk_size < PAGE - PAGE_HEAD)
+	{
+		++n_classes;
+		chunk_size = (chunk_size * GROWTH_NUM / GROWTH_DEN + ALIGN - 1) &
+														~(size_t)(ALIGN - 1);
+	}
+	++n_classes;
+
+	slab->max_pages = memory / PAGE > 0 ? memory / PAGE : 1;
+	slab->classes = (slab_class_t*)malloc(n_classes * sizeof(slab_class_t));
+	slab->pages = (page_t**)malloc(slab->max_pages * sizeof(page_t*));
+	if(NULL == slab->classes || NULL == slab->pages)
+	{
+		free(slab->classes);
+		free(slab->pages);
+		free(slab);
+
+		return NULL;
+	}
+
+	chunk_size = MIN_CHUNK;
+	for(i = 0 ; i < n_classes ; i++)
+	{
+		slab_class_t *class = &slab->classes[i];
+
+		class->chunk_size = i + 1 < n_classes ? chunk_size : PAGE - PAGE_HEAD;
+		class->per_page = (PAGE - PAGE_HEAD) / class->chunk_size;
+		class->partial.next = &class->partial;
+		class->partial.prev = &class->partial;
+		class->pages = 0;
+		class->used = 0;
+		class->failures = 0;
+		pthread_mutex_init(&class->lock, NULL);
+
+		chunk_size = (chunk_size * GROWTH_NUM / GROWTH_DEN + ALIGN - 1) &
+														~(size_t)(ALIGN - 1);
+	}
+
+	slab->n_classes = n_classes;
+	slab->n_pages = 0;
+	slab->moving = 0;
+	pthread_mutex_init(&slab->pages_lock, NULL);
+
+	return slab;
+}
+
+
+/******************************************************************************
+Description:     	Deletes an allocator pointed to by "slab" from memory.
+Time Complexity: 	O(pages) + system call complexity.
+*******************************************************************************/
+void SlabDestroy(slab_t *slab)
+{
+	size_t i = 0;
+
+	assert(slab);
+
+	for(i = 0 ; i < slab->n_pages ; i++)
+	{
+		munmap(slab->pages[i], PAGE);
+	}
+	for(i = 0 ; i < slab->n_classes ; i++)
+	{
+		pthread_mutex_destroy(&slab->classes[i].lock);
+	}
+
+	pthread_mutex_destroy(&slab->pages_lock);
+	free(slab->classes);
+	free(slab->pages);
+	free(slab);slab = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Returns the number of size classes of "slab".
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t SlabClasses(const slab_t *slab)
+{
+	assert(slab);
+
+	return slab->n_classes;
+}
+
+
+/*******************************************************************************
+Description:     	Returns the smallest class whose chunks hold 'size' bytes.
+Return value:    	Id of the class, "SlabClasses()" if none does.
+Time Complexity: 	O(log classes).
+*******************************************************************************/
+size_t SlabClassFor(const slab_t *slab, size_t size)
+{
+	size_t low = 0;
+	size_t high = 0;
+
+	assert(slab);
+
+	high = slab->n_classes;
+	size += sizeof(chunk_t);
+
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(slab->classes[mid].chunk_size < size)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+/*******************************************************************************
+Description:     	Allocates a chunk of class 'class_id'.
+Return value:    	Pointer to the chunk, NULL if the class is full.
+Time Complexity: 	O(1) + system call complexity for a new page.
+*******************************************************************************/
+void *SlabAlloc(slab_t *slab, size_t class_id)
+{
+	slab_class_t *class = NULL;
+	page_t *page = NULL;
+	chunk_t *chunk = NULL;
+
+	assert(slab);
+	assert(class_id < slab->n_classes);
+
+	class = &slab->classes[class_id];
+
+	pthread_mutex_lock(&class->lock);
+
+	page = class->partial.next;
+	if(&class->partial == page)
+	{
+		page = NewPage(slab, class_id);
+		if(NULL == page)
+		{
+			++class->failures;
+			pthread_mutex_unlock(&class->lock);
+
+			return NULL;
+		}
+		LinkPartial(class, page);
+		++class->pages;
+	}
+
+	/*freed chunks first, fresh ones are only carved out after them*/
+	chunk = page->free;
+	if(NULL != chunk)
+	{
+		page->free = chunk->next;
+	}
+	else
+	{
+		chunk = ChunkAt(slab, page, page->carved++);
+	}
+
+	if(++page->used == class->per_page)
+	{
+		UnlinkPartial(page);
+	}
+	++class->used;
+	chunk->owner = NULL;
+
+	pthread_mutex_unlock(&class->lock);
+
+	return chunk + 1;
+}
+
+
+/*******************************************************************************
+Description:     	Gives 'chunk' back to its class.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void SlabFree(slab_t *slab, void *chunk)
+{
+	chunk_t *head = (chunk_t*)chunk - 1;
+	page_t *page = PageOf(head);
+	slab_class_t *class = NULL;
+
+	assert(slab);
+	assert(chunk);
+
+	/*a page only changes class once all its chunks are free*/
+	class = &slab->classes[page->class_id];
+
+	pthread_mutex_lock(&class->lock);
+
+	--class->used;
+
+	if(NO_CLASS != page->move_to)
+	{
+		/*the chunks of a page on its way are not reused*/
+		if(0 == --page->used)
+		{
+			pthread_mutex_unlock(&class->lock);
+			Adopt(slab, page);
+
+			return;
+		}
+
+		pthread_mutex_unlock(&class->lock);
+
+		return;
+	}
+
+	head->next = page->free;
+	page->free = head;
+	if(page->used-- == class->per_page)
+	{
+		LinkPartial(class, page);
+	}
+
+	pthread_mutex_unlock(&class->lock);
+}
+
+
+/*******************************************************************************
+Description:     	Returns the class of an allocated 'chunk'.
+Time Complexity: 	O(1).
+*******************************************************************************/
+size_t SlabClassOf(const void *chunk)
+{
+	assert(chunk);
+
+	return PageOf((const chunk_t*)chunk - 1)->class_id;
+}
+
+
+/*******************************************************************************
+Description:     	Records 'owner' as the user of an allocated 'chunk'.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void SlabSetOwner(void *chunk, void *owner)
+{
+	assert(chunk);
+
+	((chunk_t*)chunk - 1)->owner = owner;
+}
+
+
+/*******************************************************************************
+Description:     	Moves a page from class 'from' to class 'to'.
+Return value:    	0 if the page is on its way, otherwise 1.
+Time Complexity: 	O(pages + chunks per page).
+*******************************************************************************/
+int SlabMovePage(slab_t *slab, size_t from, size_t to, action_func_t evict,
+															void *user_params)
+{
+	slab_class_t *class = NULL;
+	page_t *page = NULL;
+	size_t i = 0;
+	int idle = 0;
+
+	assert(slab);
+	assert(from < slab->n_classes);
+	assert(to < slab->n_classes);
+	assert(evict);
+
+	if(from == to || !__atomic_compare_exchange_n(&slab->moving, &idle, 1,
+									0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		return 1;
+	}
+
+	class = &slab->classes[from];
+
+	pthread_mutex_lock(&class->lock);
+
+	if(class->pages < 2)
+	{
+		pthread_mutex_unlock(&class->lock);
+		__atomic_store_n(&slab->moving, 0, __ATOMIC_RELEASE);
+
+		return 1;
+	}
+
+	/*no other page changes class while 'moving' is set*/
+	pthread_mutex_lock(&slab->pages_lock);
+	for(i = 0 ; i < slab->n_pages ; i++)
+	{
+		page_t *candidate = slab->pages[i];
+
+		if(from == candidate->class_id &&
+						(NULL == page || candidate->used < page->used))
+		{
+			page = candidate;
+		}
+	}
+	pthread_mutex_unlock(&slab->pages_lock);
+
+	if(page->used < class->per_page)
+	{
+		UnlinkPartial(page);
+	}
+	page->move_to = to;
+	--class->pages;
+
+	/*held by the walk too, so the page can't join 'to' under it*/
+	++page->used;
+
+	pthread_mutex_unlock(&class->lock);
+
+	for(i = 0 ; i < page->carved ; i++)
+	{
+		chunk_t *chunk = ChunkAt(slab, page, i);
+
+		if(NULL != chunk->owner)
+		{
+			evict(chunk->owner, user_params);
+		}
+	}
+
+	pthread_mutex_lock(&class->lock);
+	if(0 == --page->used)
+	{
+		pthread_mutex_unlock(&class->lock);
+		Adopt(slab, page);
+
+		return 0;
+	}
+	pthread_mutex_unlock(&class->lock);
+
+	return 0;
+}
+
+
+/*******************************************************************************
+Description:     	Fills 'stats' with the statistics of class 'class_id'.
+Time Complexity: 	O(1).
+*******************************************************************************/
+void SlabClassStats(slab_t *slab, size_t class_id, slab_class_stats_t *stats)
+{
+	slab_class_t *class = NULL;
+
+	assert(slab);
+	assert(class_id < slab->n_classes);
+	assert(stats);
+
+	class = &slab->classes[class_id];
+
+	pthread_mutex_lock(&class->lock);
+	stats->chunk_size = class->chunk_size - sizeof(chunk_t);
+	stats->pages = class->pages;
+	stats->used = class->used;
+	stats->failures = class->failures;
+	pthread_mutex_unlock(&class->lock);
+}
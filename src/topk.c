@@ -0,0 +1,372 @@
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <assert.h>		/* assert			*/
+#include <string.h>		/* memcpy			*/
+#include <time.h>		/* clock_gettime	*/
+#include <pthread.h>	/* pthread_mutex_t	*/
+
+#include "aux_funcs.h" /*is_match_t*/
+#include "hash_t.h"
+#include "topk.h"
+
+enum{
+	FACTOR = 2,
+	MAX_SHIFT = 63
+};
+
+typedef struct counter
+{
+	void *key;
+	size_t count;
+	size_t error;
+	size_t heap_pos;
+}counter_t;
+
+/*
+ * 'heap' is a min-heap on 'count', the counter at its root is the one a new
+ * key takes over. 'index' maps the counted keys (the copies in 'counters')
+ * to their counter.
+ */
+struct topk
+{
+	hash_t *index;
+	counter_t *counters;
+	counter_t **heap;
+	size_t k;
+	size_t used;
+	size_t sample;
+	double half_life;
+	double period_start;	/* counts were last halved then */
+	size_t halvings;
+	size_func_t key_size;
+	pthread_mutex_t lock;
+};
+
+static __thread size_t tick = 0;
+
+
+static double Now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void Swap(counter_t **heap, size_t i, size_t j)
+{
+	counter_t *tmp = heap[i];
+
+	heap[i] = heap[j];
+	heap[j] = tmp;
+	heap[i]->heap_pos = i;
+	heap[j]->heap_pos = j;
+}
+
+static void SiftUp(topk_t *topk, size_t pos)
+{
+	while(pos > 0 &&
+			topk->heap[(pos - 1) / 2]->count > topk->heap[pos]->count)
+	{
+		Swap(topk->heap, pos, (pos - 1) / 2);
+		pos = (pos - 1) / 2;
+	}
+}
+
+static void SiftDown(topk_t *topk, size_t pos)
+{
+	for(;;)
+	{
+		size_t child = 2 * pos + 1;
+
+		if(child >= topk->used)
+		{
+			return;
+		}
+		if(child + 1 < topk->used &&
+					topk->heap[child + 1]->count < topk->heap[child]->count)
+		{
+			++child;
+		}
+		if(topk->heap[pos]->count <= topk->heap[child]->count)
+		{
+			return;
+		}
+
+		Swap(topk->heap, pos, child);
+		pos = child;
+	}
+}
+
+/*halves every count once per elapsed half life, the heap order stays*/
+static void Decay(topk_t *topk, double now)
+{
+	size_t periods = (size_t)((now - topk->period_start) / topk->half_life);
+	size_t shift = periods > MAX_SHIFT ? MAX_SHIFT : periods;
+	size_t i = 0;
+
+	if(0 == periods)
+	{
+		return;
+	}
+
+	for(i = 0 ; i < topk->used ; i++)
+	{
+		topk->counters[i].count >>= shift;
+		topk->counters[i].error >>= shift;
+	}
+
+	topk->halvings += periods;
+	topk->period_start += (double)periods * topk->half_life;
+}
+
+static void *CopyKey(topk_t *topk, void *old_copy, const void *key)
+{
+	size_t len = topk->key_size(key);
+	void *copy = realloc(old_copy, len);
+
+	if(NULL == copy)
+	{
+		free(old_copy);
+		return NULL;
+	}
+
+	memcpy(copy, key, len);
+
+	return copy;
+}
+
+/*Space-Saving step, called with the lock held*/
+static void Count(topk_t *topk, const void *key, size_t weight)
+{
+	counter_t *counter = (counter_t*)HashFind(topk->index, key);
+
+	if(NULL != counter)
+	{
+		counter->count += weight;
+		SiftDown(topk, counter->heap_pos);
+
+		return;
+	}
+
+	if(topk->used < topk->k)
+	{
+		counter = &topk->counters[topk->used];
+		counter->key = CopyKey(topk, NULL, key);
+		if(NULL == counter->key || 0 != HashInsert(topk->index,
+												counter->key, counter))
+		{
+			free(counter->key);
+			return;
+		}
+
+		counter->count = weight;
+		counter->error = 0;
+		counter->heap_pos = topk->used;
+		topk->heap[topk->used++] = counter;
+		SiftUp(topk, counter->heap_pos);
+
+		return;
+	}
+
+	/*the least counted key is replaced, its count becomes the error bound*/
+	counter = topk->heap[0];
+	if(NULL != counter->key)
+	{
+		HashRemove(topk->index, counter->key);
+	}
+	counter->key = CopyKey(topk, counter->key, key);
+	if(NULL == counter->key ||
+				0 != HashInsert(topk->index, counter->key, counter))
+	{
+		/*no memory, the empty counter stays the root for the next key*/
+		free(counter->key);
+		counter->key = NULL;
+		counter->count = 0;
+		counter->error = 0;
+
+		return;
+	}
+
+	counter->error = counter->count;
+	counter->count += weight;
+	SiftDown(topk, 0);
+}
+
+static int CompareCount(const void *a, const void *b)
+{
+	const counter_t *left = *(const counter_t* const*)a;
+	const counter_t *right = *(const counter_t* const*)b;
+
+	return (left->count < right->count) - (left->count > right->count);
+}
+
+
+/******************************************************************************
+Description:     	Creates a tracker of the 'k' most frequent keys.
+Return value:    	Pointer to tracker in case of success, otherwise NULL.
+Time Complexity: 	O(k).
+******************************************************************************/
+topk_t *TopKCreate(size_t k, size_t sample, double half_life,
+					hash_func_t hash_func, is_match_func_t match,
+					size_func_t key_size)
+{
+	topk_t *topk = (topk_t*)malloc(sizeof(topk_t));
+
+	assert(k > 0);
+	assert(half_life > 0);
+	assert(key_size);
+
+	if(NULL == topk)
+	{
+		return NULL;
+	}
+
+	topk->index = HashCreate(k * FACTOR, hash_func, match);
+	topk->counters = (counter_t*)calloc(k, sizeof(counter_t));
+	topk->heap = (counter_t**)malloc(k * sizeof(counter_t*));
+	if(NULL == topk->index || NULL == topk->counters || NULL == topk->heap)
+	{
+		if(NULL != topk->index)
+		{
+			HashDestroy(topk->index);
+		}
+		free(topk->counters);
+		free(topk->heap);
+		free(topk);
+
+		return NULL;
+	}
+
+	topk->k = k;
+	topk->used = 0;
+	topk->sample = 0 == sample ? 1 : sample;
+	topk->half_life = half_life;
+	topk->period_start = Now();
+	topk->halvings = 0;
+	topk->key_size = key_size;
+	pthread_mutex_init(&topk->lock, NULL);
+
+	return topk;
+}
+
+
+/******************************************************************************
+Description:     	Deletes a tracker pointed to by "topk" from memory.
+Time Complexity: 	O(k).
+*******************************************************************************/
+void TopKDestroy(topk_t *topk)
+{
+	size_t i = 0;
+
+	assert(topk);
+
+	for(i = 0 ; i < topk->used ; i++)
+	{
+		free(topk->counters[i].key);
+	}
+
+	HashDestroy(topk->index);
+	free(topk->counters);
+	free(topk->heap);
+	pthread_mutex_destroy(&topk->lock);
+	free(topk);topk = NULL;
+}
+
+
+/*******************************************************************************
+Description:     	Counts one occurrence of 'key'.
+Time Complexity: 	O(1) when not sampled, O(log k) average otherwise.
+*******************************************************************************/
+void TopKAdd(topk_t *topk, const void *key)
+{
+	assert(topk);
+	assert(key);
+
+	if(0 != ++tick % topk->sample)
+	{
+		return;
+	}
+
+	/*hot paths call this, a busy tracker costs a sample, not a wait*/
+	if(0 != pthread_mutex_trylock(&topk->lock))
+	{
+		return;
+	}
+
+	Decay(topk, Now());
+	Count(topk, key, topk->sample);
+
+	pthread_mutex_unlock(&topk->lock);
+}
+
+
+/*******************************************************************************
+Description:     	Fills 'entries' with up to 'n' of the hottest keys.
+Return value:    	Number of entries filled.
+Time Complexity: 	O(k log k).
+*******************************************************************************/
+size_t TopKList(topk_t *topk, topk_entry_t *entries, size_t n)
+{
+	counter_t **sorted = NULL;
+	double now = Now();
+	double seconds = 0;
+	size_t filled = 0;
+	size_t i = 0;
+
+	assert(topk);
+	assert(entries || 0 == n);
+
+	pthread_mutex_lock(&topk->lock);
+
+	sorted = (counter_t**)malloc((topk->used + 1) * sizeof(counter_t*));
+	if(NULL == sorted)
+	{
+		pthread_mutex_unlock(&topk->lock);
+		return 0;
+	}
+
+	Decay(topk, now);
+	memcpy(sorted, topk->heap, topk->used * sizeof(counter_t*));
+	qsort(sorted, topk->used, sizeof(counter_t*), CompareCount);
+
+	/*
+	 * A count weighs the current period fully and every earlier one half as
+	 * much as the next, so it covers now - period_start plus a geometric sum
+	 * of half lives.
+	 */
+	seconds = now - topk->period_start;
+	for(i = 0 ; i < topk->halvings && i < MAX_SHIFT ; i++)
+	{
+		seconds += topk->half_life / (double)((size_t)2 << i);
+	}
+
+	for(i = 0 ; i < topk->used && filled < n ; i++)
+	{
+		size_t len = 0;
+
+		if(NULL == sorted[i]->key)
+		{
+			continue;
+		}
+
+		len = topk->key_size(sorted[i]->key);
+		entries[filled].key = malloc(len);
+		if(NULL == entries[filled].key)
+		{
+			break;
+		}
+
+		memcpy(entries[filled].key, sorted[i]->key, len);
+		entries[filled].count = sorted[i]->count;
+		entries[filled].error = sorted[i]->error;
+		entries[filled].rate = seconds > 0 ?
+								(double)sorted[i]->count / seconds : 0;
+		++filled;
+	}
+
+	pthread_mutex_unlock(&topk->lock);
+	free(sorted);
+
+	return filled;
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Builds every test (or the ones named) under AddressSanitizer and
+# ThreadSanitizer, with the locked index of cache_t and with the lock-free
+# one (-DCACHE_LF_INDEX), and runs each build. Exits with 1 if any build or
+# run failed or a sanitizer reported anything.
+#
+# Run from the repository root, AUX names the directory of aux_funcs.h:
+#   AUX=../aux tests/run.sh [tests/test_cache.c ...]
+#
+AUX=${AUX:-.}
+CC=${CC:-gcc}
+OUT=${OUT:-/tmp/cache_tests}
+SRC="src/cache.c src/cache_space.c src/cache_policy.c src/cache_write_back.c
+	src/core_cache.c src/ctier.c src/ftier.c src/lz.c src/dlist.c src/ilist.c
+	src/hash_t.c src/lf_hash.c src/read_buf.c src/epoch.c src/topk.c
+	src/slab.c src/ring.c"
+TESTS=${*:-tests/test_*.c}
+failed=0
+
+mkdir -p "$OUT" || exit 1
+
+for test in $TESTS
+do
+	name=$(basename "$test" .c)
+
+	for san in address thread
+	do
+		for index in "" -DCACHE_LF_INDEX
+		do
+			what="$name $san hash_t"
+			[ -n "$index" ] && what="$name $san lf_hash"
+			bin="$OUT/$name"
+
+			if ! $CC -O1 -g -fsanitize=$san $index -DCACHE_NO_MAIN \
+					-Iinclude -I"$AUX" "$test" $SRC -lpthread -lm \
+					-o "$bin" 2> "$OUT/build.log"
+			then
+				echo "$what: build FAILED"
+				cat "$OUT/build.log"
+				failed=1
+				continue
+			fi
+
+			if ! TMPDIR="$OUT" "$bin" > "$OUT/run.log" 2>&1 ||
+					grep -q "SUMMARY:" "$OUT/run.log"
+			then
+				echo "$what: FAILED"
+				cat "$OUT/run.log"
+				failed=1
+			else
+				echo "$what: ok"
+			fi
+		done
+	done
+done
+
+exit $failed
@@ -0,0 +1,557 @@
+/*
+ * Checks the features of cache_t one at a time, on one thread: handles that
+ * outlive their entry, tags, write-back, the ARC and GDSF policies against
+ * LRU, and the compressed and the flash tiers. Prints one line per check and
+ * exits with 1 if any of them failed.
+ *
+ * Build and run with tests/run.sh.
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <string.h>		/* memset			*/
+
+#include "cache.h"
+#include "ctier.h"
+#include "ftier.h"
+
+enum{
+	KEYS = 20000,
+	VALUE_INTS = 64,	/* values of the tiers, 256 bytes */
+	NO_INTERVAL = 60000
+};
+
+typedef struct released
+{
+	size_t keys;
+	size_t data;
+	void *watched;		/* data to look out for */
+	int watched_gone;
+}released_t;
+
+typedef struct backend
+{
+	size_t values[KEYS];
+	size_t written;
+	size_t calls;
+	int fail;
+}backend_t;
+
+static size_t keys[KEYS];
+static int failures = 0;
+
+
+static void Check(int ok, const char *what)
+{
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	failures += !ok;
+}
+
+static size_t Hash(const void *key)
+{
+	return *(const size_t*)key * (size_t)0x9E3779B97F4A7C15ULL;
+}
+
+static int Match(const void *key1, const void *key2)
+{
+	return *(const size_t*)key1 == *(const size_t*)key2;
+}
+
+static size_t KeySize(const void *key)
+{
+	(void)key;
+
+	return sizeof(size_t);
+}
+
+static size_t ValueSize(const void *data)
+{
+	(void)data;
+
+	return VALUE_INTS * sizeof(int);
+}
+
+static size_t *NewKey(size_t k)
+{
+	size_t *key = (size_t*)malloc(sizeof(size_t));
+
+	if(NULL != key)
+	{
+		*key = k;
+	}
+
+	return key;
+}
+
+/*every int of the value holds 'k'*/
+static int *NewValue(size_t k)
+{
+	int *data = (int*)malloc(VALUE_INTS * sizeof(int));
+	size_t i = 0;
+
+	for(i = 0 ; NULL != data && i < VALUE_INTS ; i++)
+	{
+		data[i] = (int)k;
+	}
+
+	return data;
+}
+
+static int IsValueOf(const int *data, size_t k)
+{
+	size_t i = 0;
+
+	for(i = 0 ; NULL != data && i < VALUE_INTS ; i++)
+	{
+		if(data[i] != (int)k)
+		{
+			return 0;
+		}
+	}
+
+	return NULL != data;
+}
+
+static void Release(void *key, void *data, void *user_params)
+{
+	released_t *released = (released_t*)user_params;
+
+	released->keys += NULL != key;
+	released->data += NULL != data;
+	released->watched_gone |= NULL != data && data == released->watched;
+	free(key);
+	free(data);
+}
+
+static int Flush(void *const *flushed_keys, void *const *data, size_t n,
+															void *user_params)
+{
+	backend_t *backend = (backend_t*)user_params;
+	size_t i = 0;
+
+	if(backend->fail)
+	{
+		return 1;
+	}
+
+	for(i = 0 ; i < n ; i++)
+	{
+		backend->values[*(const size_t*)flushed_keys[i]] =
+											*(const size_t*)data[i];
+	}
+	backend->written += n;
+	++backend->calls;
+
+	return 0;
+}
+
+static void Handles(void)
+{
+	cache_t *cache = CacheCreate(64, Hash, Match);
+	released_t released = {0, 0, NULL, 0};
+	cache_handle_t *handle = NULL;
+	size_t k = 1;
+	size_t i = 0;
+
+	if(NULL == cache)
+	{
+		Check(0, "handles create");
+		return;
+	}
+	CacheSetRelease(cache, Release, &released);
+
+	released.watched = NewValue(k);
+	CacheSet(cache, NewKey(k), released.watched);
+	handle = CacheAcquire(cache, &k);
+	Check(NULL != handle && CacheHandleData(handle) == released.watched,
+													"acquire pins the data");
+
+	for(i = 100 ; i < 300 ; i++)
+	{
+		CacheSet(cache, NewKey(i), NewValue(i));
+	}
+	Check(NULL == CacheGet(cache, &k), "pinned entry still evicted");
+	Check(!released.watched_gone && NULL != handle &&
+				IsValueOf((int*)CacheHandleData(handle), k),
+										"pinned data outlives its entry");
+
+	if(NULL != handle)
+	{
+		CacheRelease(cache, handle);
+	}
+	/*a write drains what is deferred*/
+	CacheSet(cache, NewKey(1000), NewValue(1000));
+	Check(released.watched_gone, "last handle releases the data");
+
+	CacheDestroy(cache);
+	Check(released.keys == released.data && 202 == released.data,
+									"destroy releases every entry once");
+}
+
+/*writes of a cached key, each with its own copy of the key*/
+static void Tags(void)
+{
+	cache_t *cache = CacheCreate(64, Hash, Match);
+	released_t released = {0, 0, NULL, 0};
+	size_t tag = 1;
+	size_t k = 7;
+
+	if(NULL == cache)
+	{
+		Check(0, "tags create");
+		return;
+	}
+	CacheSetRelease(cache, Release, &released);
+
+	CacheSetTagged(cache, NewKey(k), NewValue(k), &tag, 1);
+	CacheSet(cache, NewKey(k), NewValue(k));
+	Check(0 == CacheInvalidateTag(cache, tag) &&
+				IsValueOf((int*)CacheGet(cache, &k), k),
+										"a plain set drops the tags");
+
+	CacheSetTagged(cache, NewKey(k), NewValue(k), &tag, 1);
+	Check(1 == CacheInvalidateTag(cache, tag) && NULL == CacheGet(cache, &k),
+										"invalidate removes the entry");
+
+	CacheDestroy(cache);
+	Check(3 == released.keys && 3 == released.data,
+										"every copy of the key is released");
+}
+
+static void WriteBack(void)
+{
+	cache_t *cache = CacheCreate(10, Hash, Match);
+	static backend_t backend;
+	static size_t values[2][KEYS];
+	size_t i = 0;
+	int ok = 1;
+
+	if(NULL == cache ||
+			0 != CacheSetWriteBack(cache, Flush, 1000, NO_INTERVAL, &backend))
+	{
+		Check(0, "write-back create");
+		return;
+	}
+
+	for(i = 0 ; i < 100 ; i++)
+	{
+		values[0][i] = i + 1;
+		values[1][i] = i + 2;
+		CacheSet(cache, &keys[i], &values[0][i]);
+		CacheSet(cache, &keys[i], &values[1][i]);
+	}
+	for(i = 0 ; i < 100 ; i++)
+	{
+		ok &= CacheGet(cache, &keys[i]) == &values[1][i];
+	}
+	Check(ok && 0 == backend.written, "dirty entries are not evicted");
+
+	Check(0 == CacheFlush(cache) && 100 == backend.written,
+								"flush writes each entry once");
+	for(i = 0 ; i < 100 ; i++)
+	{
+		ok &= backend.values[i] == i + 2;
+	}
+	Check(ok, "flush writes the latest data");
+
+	backend.fail = 1;
+	CacheSet(cache, &keys[0], &values[0][0]);
+	Check(1 == CacheFlush(cache) && 2 == backend.values[0],
+									"failed flush reports it");
+	backend.fail = 0;
+	Check(0 == CacheFlush(cache) && 1 == backend.values[0],
+									"failed entries are retried");
+
+	CacheSet(cache, &keys[5000], &values[0][5000]);
+	CacheRemove(cache, &keys[5000]);
+	i = backend.written;
+	Check(0 == CacheFlush(cache) && i == backend.written,
+									"removed entries are not flushed");
+
+	/*clean now, they make room again*/
+	for(i = 200 ; i < 300 ; i++)
+	{
+		CacheSet(cache, &keys[i], &values[0][i]);
+	}
+	CacheFlush(cache);
+	for(i = 300 ; i < 400 ; i++)
+	{
+		CacheSet(cache, &keys[i], &values[0][i]);
+		CacheFlush(cache);
+	}
+	Check(NULL == CacheGet(cache, &keys[200]) &&
+					NULL != CacheGet(cache, &keys[399]),
+									"flushed entries are evicted");
+
+	CacheDestroy(cache);
+}
+
+/*a hot set hit three times, then a scan of keys seen once*/
+static size_t ScanHits(cache_policy_t policy)
+{
+	cache_t *cache = CacheCreate(100, Hash, Match);
+	size_t hits = 0;
+	size_t round = 0;
+	size_t i = 0;
+	size_t k = 0;
+
+	if(NULL == cache || 0 != CacheSetPolicy(cache, policy))
+	{
+		return 0;
+	}
+
+	for(round = 0 ; round < 20 ; round++)
+	{
+		for(i = 0 ; i < 150 ; i++)
+		{
+			k = i % 50;
+			if(NULL != CacheGet(cache, &keys[k]))
+			{
+				++hits;
+			}
+			else
+			{
+				CacheSet(cache, &keys[k], &keys[k]);
+			}
+		}
+		for(i = 0 ; i < 200 ; i++)
+		{
+			k = 1000 + round * 200 + i;
+			if(NULL != CacheGet(cache, &keys[k]))
+			{
+				++hits;
+			}
+			else
+			{
+				CacheSet(cache, &keys[k], &keys[k]);
+			}
+		}
+	}
+
+	CacheDestroy(cache);
+
+	return hits;
+}
+
+static double Cost(size_t k)
+{
+	return 0 == k % 10 ? 1000.0 : 1.0;
+}
+
+/*total cost of the misses of a skewed run*/
+static double Penalty(cache_policy_t policy)
+{
+	cache_t *cache = CacheCreate(200, Hash, Match);
+	unsigned seed = 1;
+	double penalty = 0;
+	size_t i = 0;
+
+	if(NULL == cache || 0 != CacheSetPolicy(cache, policy))
+	{
+		return 0;
+	}
+
+	for(i = 0 ; i < 200000 ; i++)
+	{
+		size_t k = (size_t)rand_r(&seed) % 2000;
+
+		if(NULL == CacheGet(cache, &keys[k]))
+		{
+			penalty += Cost(k);
+			CacheSetWithCost(cache, &keys[k], &keys[k], Cost(k), 1);
+		}
+	}
+
+	CacheDestroy(cache);
+
+	return penalty;
+}
+
+static void Policies(void)
+{
+	cache_t *cache = CacheCreate(10, Hash, Match);
+	size_t lru = ScanHits(CACHE_POLICY_LRU);
+	size_t k = 0;
+	int ok = 1;
+
+	Check(ScanHits(CACHE_POLICY_ARC) > lru, "ARC keeps the hot set in a scan");
+	Check(Penalty(CACHE_POLICY_GDSF) < Penalty(CACHE_POLICY_LRU),
+										"GDSF lowers the cost of misses");
+
+	if(NULL == cache || 0 != CacheSetPolicy(cache, CACHE_POLICY_GDSF))
+	{
+		Check(0, "GDSF create");
+		return;
+	}
+	for(k = 0 ; k < 10 ; k++)
+	{
+		CacheSetWithCost(cache, &keys[k], &keys[k], k < 5 ? 100 : 1, 1);
+	}
+	for(k = 10 ; k < 15 ; k++)
+	{
+		CacheSetWithCost(cache, &keys[k], &keys[k], 100, 1);
+	}
+	for(k = 0 ; k < 10 ; k++)
+	{
+		ok &= (k < 5) == (NULL != CacheGet(cache, &keys[k]));
+	}
+	Check(ok, "GDSF evicts the cheap entries first");
+
+	CacheDestroy(cache);
+}
+
+/*dirty entries wait outside the heap of GDSF, the cheapest clean one goes*/
+static void GdsfWriteBack(void)
+{
+	cache_t *cache = CacheCreate(20, Hash, Match);
+	static backend_t backend;
+	size_t gone = 0;
+	size_t k = 0;
+	int ok = 1;
+
+	if(NULL == cache || 0 != CacheSetPolicy(cache, CACHE_POLICY_GDSF) ||
+			0 != CacheSetWriteBack(cache, Flush, 1000, NO_INTERVAL, &backend))
+	{
+		Check(0, "GDSF write-back create");
+		return;
+	}
+
+	for(k = 0 ; k < 20 ; k++)
+	{
+		CacheSetWithCost(cache, &keys[k], &keys[k],
+									k < 10 ? 1 : 100 + (double)k * 10, 1);
+	}
+	CacheFlush(cache);
+	for(k = 0 ; k < 10 ; k++)
+	{
+		CacheSetWithCost(cache, &keys[k], &keys[k], 1, 1);
+	}
+	for(k = 100 ; k < 105 ; k++)
+	{
+		CacheSetWithCost(cache, &keys[k], &keys[k], 10000, 1);
+	}
+
+	for(k = 0 ; k < 20 ; k++)
+	{
+		ok &= (k < 10 || k >= 15) == (NULL != CacheGet(cache, &keys[k]));
+	}
+	Check(ok, "GDSF evicts the cheapest clean entries");
+
+	CacheFlush(cache);
+	for(k = 105 ; k < 110 ; k++)
+	{
+		CacheSetWithCost(cache, &keys[k], &keys[k], 10000, 1);
+	}
+	/*the cheap ones are clean now*/
+	gone = 0;
+	for(k = 0 ; k < 10 ; k++)
+	{
+		gone += NULL == CacheGet(cache, &keys[k]);
+	}
+	Check(5 == gone, "GDSF evicts entries once flushed");
+
+	CacheDestroy(cache);
+}
+
+/*
+ * 'count' entries through a cache of 16, the evicted ones go down to
+ * the tier and come back on a hit.
+ */
+static void Tier(const char *name, tier_put_func_t put, tier_take_func_t take,
+											void *tier, size_t count)
+{
+	cache_t *cache = CacheCreate(16, Hash, Match);
+	char what[64];
+	size_t k = 0;
+	size_t i = 0;
+	int ok = 1;
+
+	if(NULL == cache)
+	{
+		Check(0, name);
+		return;
+	}
+	CacheAttachTier(cache, put, take, tier);
+
+	for(k = 0 ; k < count ; k++)
+	{
+		CacheSet(cache, NewKey(k), NewValue(k));
+	}
+	for(k = 0 ; k < count ; k++)
+	{
+		ok &= IsValueOf((int*)CacheGet(cache, &k), k);
+	}
+	sprintf(what, "%s: evicted entries come back", name);
+	Check(ok, what);
+
+	k = 0;
+	ok = 0 == CacheRemove(cache, &k) && NULL == CacheGet(cache, &k);
+	sprintf(what, "%s: remove reaches the tier", name);
+	Check(ok, what);
+
+	/*the copy evicted before the key was set again is stale*/
+	k = count;
+	CacheSet(cache, NewKey(k), NewValue(k + 1));
+	for(i = count + 1 ; i < count + 32 ; i++)
+	{
+		CacheSet(cache, NewKey(i), NewValue(i));
+	}
+	CacheSet(cache, NewKey(k), NewValue(k));
+	ok = IsValueOf((int*)CacheGet(cache, &k), k);
+	ok &= 0 == CacheRemove(cache, &k) && NULL == CacheGet(cache, &k);
+	sprintf(what, "%s: stale copies do not come back", name);
+	Check(ok, what);
+
+	CacheDestroy(cache);
+}
+
+static void Tiers(void)
+{
+	const char *dir = getenv("TMPDIR");
+	char path[256];
+	ctier_t *ctier = CTierCreate(256 * 1024, Hash, Match, KeySize, ValueSize);
+	ftier_t *ftier = NULL;
+
+	if(NULL == ctier)
+	{
+		Check(0, "ctier create");
+	}
+	else
+	{
+		Tier("ctier", CTierPut, CTierTake, ctier, 200);
+		CTierDestroy(ctier);
+	}
+
+	sprintf(path, "%.200s/test_cache.ftier", NULL != dir ? dir : "/tmp");
+	ftier = FTierCreate(path, 1024 * 1024, 1000, Hash, Match, KeySize,
+																ValueSize);
+	if(NULL == ftier)
+	{
+		Check(0, "ftier create");
+	}
+	else
+	{
+		Tier("ftier", FTierPut, FTierTake, ftier, 500);
+		FTierDestroy(ftier);
+	}
+}
+
+
+int main(void)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		keys[i] = i;
+	}
+
+	Handles();
+	Tags();
+	WriteBack();
+	Policies();
+	GdsfWriteBack();
+	Tiers();
+
+	return 0 == failures ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*
+ * Checks core_cache_t with one thread per core: every core writes a share
+ * of the keys, then every core reads all of them back through their owners,
+ * then random gets, sets and removes keep every queue busy. The cache owns
+ * the data and frees it, answers read it. Prints one line per check and
+ * exits with 1 if any of them failed.
+ *
+ * Build and run with tests/run.sh.
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <pthread.h>	/* pthread_create	*/
+
+#include "core_cache.h"
+
+enum{
+	CORES = 4,
+	CAPACITY = 3000,
+	KEYS = 5000,
+	SHARED = 1000,		/* keys read back by every core */
+	OPS = 200000,
+	QUEUE_LEN = 64
+};
+
+typedef struct core
+{
+	size_t id;
+	size_t made;
+	size_t done;
+	size_t wrong;		/* answers with the data of another key */
+	size_t misses;
+	size_t shared_misses;
+}core_t;
+
+static size_t keys[KEYS];
+static core_cache_t *cache = NULL;
+static size_t arrived = 0;
+static size_t made = 0;
+static size_t released = 0;
+static int failures = 0;
+
+
+static void Check(int ok, const char *what)
+{
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	failures += !ok;
+}
+
+static size_t Hash(const void *key)
+{
+	return *(const size_t*)key;
+}
+
+static int Match(const void *key1, const void *key2)
+{
+	return *(const size_t*)key1 == *(const size_t*)key2;
+}
+
+/*keys are static, the data of key 'k' is a malloc'd copy of 'k'*/
+static void Release(void *key, void *data, void *user_params)
+{
+	(void)key;
+	(void)user_params;
+	__atomic_add_fetch(&released, NULL != data, __ATOMIC_RELAXED);
+	free(data);
+}
+
+/*'user_params' is the core of the request*/
+static void Done(void *data, void *user_params)
+{
+	core_t *core = (core_t*)user_params;
+
+	++core->done;
+	if(NULL == data)
+	{
+		++core->misses;
+	}
+	else if(*(size_t*)data >= KEYS)
+	{
+		++core->wrong;
+	}
+}
+
+static void GetShared(void *data, void *user_params)
+{
+	core_t *core = (core_t*)user_params;
+
+	++core->done;
+	core->misses += NULL == data;
+	core->wrong += NULL != data && *(size_t*)data >= SHARED;
+}
+
+/*waits for the other cores, serving them meanwhile*/
+static void Barrier(core_t *core, size_t round)
+{
+	while(core->done != core->made)
+	{
+		CoreCachePoll(cache, core->id);
+	}
+
+	__atomic_add_fetch(&arrived, 1, __ATOMIC_ACQ_REL);
+	while(__atomic_load_n(&arrived, __ATOMIC_ACQUIRE) < round * CORES)
+	{
+		CoreCachePoll(cache, core->id);
+	}
+}
+
+static void Make(core_t *core, int op, size_t k, core_done_func_t done)
+{
+	size_t *data = NULL;
+	int full = 1;
+
+	if(1 == op)
+	{
+		data = (size_t*)malloc(sizeof(size_t));
+		if(NULL == data)
+		{
+			return;
+		}
+		*data = k;
+		__atomic_add_fetch(&made, 1, __ATOMIC_RELAXED);
+	}
+
+	while(full)
+	{
+		if(0 == op)
+		{
+			full = CoreCacheGet(cache, core->id, &keys[k], done, core);
+		}
+		else if(1 == op)
+		{
+			full = CoreCacheSet(cache, core->id, &keys[k], data, done, core);
+		}
+		else
+		{
+			full = CoreCacheRemove(cache, core->id, &keys[k], done, core);
+		}
+
+		if(full)
+		{
+			CoreCachePoll(cache, core->id);
+		}
+	}
+
+	++core->made;
+	if(0 == core->made % 64)
+	{
+		CoreCachePoll(cache, core->id);
+	}
+}
+
+static void *Core(void *arg)
+{
+	core_t *core = (core_t*)arg;
+	unsigned seed = (unsigned)core->id * 7 + 1;
+	size_t i = 0;
+
+	if(0 != CoreCacheAttach(cache, core->id))
+	{
+		core->wrong = 1;
+		return NULL;
+	}
+
+	for(i = core->id ; i < SHARED ; i += CORES)
+	{
+		Make(core, 1, i, Done);
+	}
+	Barrier(core, 1);
+
+	core->misses = 0;
+	for(i = 0 ; i < SHARED ; i++)
+	{
+		Make(core, 0, i, GetShared);
+	}
+	Barrier(core, 2);
+	core->shared_misses = core->misses;
+
+	for(i = 0 ; i < OPS ; i++)
+	{
+		int op = rand_r(&seed) % 10;
+
+		Make(core, op < 6 ? 0 : op < 9 ? 1 : 2,
+								(size_t)rand_r(&seed) % KEYS, Done);
+	}
+	Barrier(core, 3);
+
+	return NULL;
+}
+
+
+int main(void)
+{
+	pthread_t threads[CORES];
+	core_t cores[CORES];
+	size_t shared_misses = 0;
+	size_t wrong = 0;
+	size_t lost = 0;
+	size_t i = 0;
+
+	for(i = 0 ; i < KEYS ; i++)
+	{
+		keys[i] = i;
+	}
+
+	cache = CoreCacheCreate(CORES, CAPACITY, Hash, Match, QUEUE_LEN);
+	if(NULL == cache)
+	{
+		Check(0, "create");
+		return 1;
+	}
+	CoreCacheSetRelease(cache, Release, NULL);
+
+	for(i = 0 ; i < CORES ; i++)
+	{
+		cores[i].id = i;
+		cores[i].made = 0;
+		cores[i].done = 0;
+		cores[i].wrong = 0;
+		cores[i].misses = 0;
+		cores[i].shared_misses = 0;
+		pthread_create(&threads[i], NULL, Core, &cores[i]);
+	}
+	for(i = 0 ; i < CORES ; i++)
+	{
+		pthread_join(threads[i], NULL);
+		wrong += cores[i].wrong;
+		lost += cores[i].made - cores[i].done;
+		shared_misses += cores[i].shared_misses;
+	}
+
+	Check(0 == shared_misses, "every core reads what the others wrote");
+	Check(0 == wrong, "answers carry the data of their key");
+	Check(0 == lost, "every request completes");
+
+	CoreCacheDestroy(cache);
+	Check(made == released, "every value is released once");
+
+	return 0 == failures ? 0 : 1;
+}
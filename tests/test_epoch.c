@@ -0,0 +1,203 @@
+/*
+ * Checks epoch_t: a retired pointer outlives the readers that could see it,
+ * nested sections included, and no longer; then threads that alternate
+ * between many domains while others retire into them. Prints one line per
+ * check and exits with 1 if any of them failed.
+ *
+ * Build and run with tests/run.sh.
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <pthread.h>	/* pthread_create	*/
+
+#include "epoch.h"
+
+enum{
+	DOMAINS = 20,		/* more than a thread finds in O(1) */
+	READERS = 4,
+	RETIRES = 100000
+};
+
+typedef struct reader
+{
+	epoch_t *epoch;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int state;			/* 0 start, 1 inside, 2 may leave, 3 left */
+}reader_t;
+
+static epoch_t *domains[DOMAINS];
+static int stop = 0;
+static size_t freed = 0;
+static int failures = 0;
+
+
+static void Check(int ok, const char *what)
+{
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	failures += !ok;
+}
+
+static int CountFree(void *ptr, void *user_params)
+{
+	(void)user_params;
+	free(ptr);
+	__atomic_add_fetch(&freed, 1, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+static void SetState(reader_t *reader, int state)
+{
+	pthread_mutex_lock(&reader->lock);
+	reader->state = state;
+	pthread_cond_broadcast(&reader->cond);
+	pthread_mutex_unlock(&reader->lock);
+}
+
+static void WaitState(reader_t *reader, int state)
+{
+	pthread_mutex_lock(&reader->lock);
+	while(reader->state != state)
+	{
+		pthread_cond_wait(&reader->cond, &reader->lock);
+	}
+	pthread_mutex_unlock(&reader->lock);
+}
+
+static void *Reader(void *arg)
+{
+	reader_t *reader = (reader_t*)arg;
+
+	/*nested, the outer section still holds the epoch*/
+	EpochEnter(reader->epoch);
+	EpochEnter(reader->epoch);
+	EpochExit(reader->epoch);
+	SetState(reader, 1);
+	WaitState(reader, 2);
+	EpochExit(reader->epoch);
+	SetState(reader, 3);
+
+	return NULL;
+}
+
+/*advances and reclaims a few times, returns what was freed meanwhile*/
+static size_t Churn(epoch_t *epoch)
+{
+	size_t before = __atomic_load_n(&freed, __ATOMIC_RELAXED);
+	int i = 0;
+
+	for(i = 0 ; i < 4 ; i++)
+	{
+		EpochAdvance(epoch);
+		EpochReclaim(epoch);
+	}
+
+	return __atomic_load_n(&freed, __ATOMIC_RELAXED) - before;
+}
+
+static void Grace(void)
+{
+	reader_t reader;
+	pthread_t thread;
+
+	reader.epoch = EpochCreate();
+	if(NULL == reader.epoch)
+	{
+		Check(0, "create");
+		return;
+	}
+	pthread_mutex_init(&reader.lock, NULL);
+	pthread_cond_init(&reader.cond, NULL);
+	reader.state = 0;
+
+	pthread_create(&thread, NULL, Reader, &reader);
+	WaitState(&reader, 1);
+
+	Check(0 == EpochRetire(reader.epoch, malloc(16), CountFree, NULL),
+														"retire");
+	Check(0 == Churn(reader.epoch), "kept while a reader is inside");
+	Check(1 == EpochAdvance(reader.epoch), "reader holds the epoch back");
+
+	SetState(&reader, 2);
+	WaitState(&reader, 3);
+	Check(1 == Churn(reader.epoch), "freed once the reader left");
+
+	pthread_join(thread, NULL);
+	pthread_cond_destroy(&reader.cond);
+	pthread_mutex_destroy(&reader.lock);
+
+	EpochRetire(reader.epoch, malloc(16), CountFree, NULL);
+	EpochDestroy(reader.epoch);
+	Check(2 == freed, "destroy frees what is left");
+}
+
+static void *Walker(void *arg)
+{
+	size_t i = 0;
+
+	(void)arg;
+	while(!__atomic_load_n(&stop, __ATOMIC_ACQUIRE))
+	{
+		for(i = 0 ; i < DOMAINS ; i++)
+		{
+			EpochEnter(domains[i]);
+			EpochEnter(domains[(i + 1) % DOMAINS]);
+			EpochExit(domains[(i + 1) % DOMAINS]);
+			EpochExit(domains[i]);
+		}
+	}
+
+	return NULL;
+}
+
+static void ManyDomains(void)
+{
+	pthread_t threads[READERS];
+	size_t i = 0;
+
+	freed = 0;
+	for(i = 0 ; i < DOMAINS ; i++)
+	{
+		domains[i] = EpochCreate();
+		if(NULL == domains[i])
+		{
+			Check(0, "many domains create");
+			exit(1);
+		}
+	}
+
+	for(i = 0 ; i < READERS ; i++)
+	{
+		pthread_create(&threads[i], NULL, Walker, NULL);
+	}
+	for(i = 0 ; i < RETIRES ; i++)
+	{
+		epoch_t *epoch = domains[i % DOMAINS];
+
+		EpochRetire(epoch, malloc(16), CountFree, NULL);
+		EpochAdvance(epoch);
+		EpochReclaim(epoch);
+	}
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+	for(i = 0 ; i < READERS ; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for(i = 0 ; i < DOMAINS ; i++)
+	{
+		EpochDestroy(domains[i]);
+	}
+	Check(RETIRES == freed, "many domains, every pointer freed once");
+}
+
+
+int main(void)
+{
+	Grace();
+	ManyDomains();
+
+	return 0 == failures ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/*
+ * Checks lf_hash_t: insert, find and remove on their own, then threads that
+ * insert, remove and look up keys concurrently, each thread checking its
+ * own range of keys once the others are done with it. Prints one line per
+ * check and exits with 1 if any of them failed.
+ *
+ * Build and run with tests/run.sh.
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <pthread.h>	/* pthread_create	*/
+
+#include "epoch.h"
+#include "lf_hash.h"
+
+enum{
+	THREADS = 8,
+	RANGE = 512,		/* keys of each thread */
+	OPS = 200000
+};
+
+static size_t keys[THREADS * RANGE];
+static lf_hash_t *hash = NULL;
+static int failures = 0;
+
+
+static void Check(int ok, const char *what)
+{
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	failures += !ok;
+}
+
+static size_t Hash(const void *key)
+{
+	return *(const size_t*)key;
+}
+
+static int Match(const void *key1, const void *key2)
+{
+	return *(const size_t*)key1 == *(const size_t*)key2;
+}
+
+static void *Worker(void *arg)
+{
+	size_t id = (size_t)arg;
+	unsigned seed = (unsigned)id + 1;
+	size_t base = id * RANGE;
+	size_t *bad = (size_t*)calloc(1, sizeof(size_t));
+	size_t i = 0;
+
+	for(i = 0 ; i < OPS && NULL != bad ; i++)
+	{
+		/*any key, so threads race on the same buckets*/
+		size_t k = (size_t)rand_r(&seed) % (THREADS * RANGE);
+		int op = rand_r(&seed) % 3;
+		size_t *found = NULL;
+
+		if(k / RANGE != id && 2 != op)
+		{
+			continue;
+		}
+		if(0 == op)
+		{
+			LFHashInsert(hash, &keys[k], &keys[k]);
+		}
+		else if(1 == op)
+		{
+			LFHashRemove(hash, &keys[k]);
+		}
+		else
+		{
+			found = (size_t*)LFHashFind(hash, &keys[k]);
+			*bad += NULL != found && *found != k;
+		}
+	}
+
+	/*own range: no one else writes it*/
+	for(i = 0 ; i < RANGE && NULL != bad ; i++)
+	{
+		LFHashInsert(hash, &keys[base + i], &keys[base + i]);
+	}
+	for(i = 0 ; i < RANGE && NULL != bad ; i += 2)
+	{
+		*bad += LFHashRemove(hash, &keys[base + i]) != &keys[base + i];
+	}
+	for(i = 0 ; i < RANGE && NULL != bad ; i++)
+	{
+		*bad += (0 == i % 2) != (NULL == LFHashFind(hash, &keys[base + i]));
+	}
+
+	return bad;
+}
+
+static void Basic(void)
+{
+	size_t key = 7;
+	size_t other = 7;
+	size_t i = 0;
+	int ok = 1;
+
+	hash = LFHashCreate(4, Hash, Match);
+	Check(NULL != hash, "create");
+	if(NULL == hash)
+	{
+		return;
+	}
+
+	Check(0 == LFHashInsert(hash, &key, &key) &&
+				LFHashFind(hash, &other) == &key, "insert then find");
+	Check(0 == LFHashInsert(hash, &other, &other) &&
+				LFHashFind(hash, &key) == &other && 1 == LFHashSize(hash),
+													"insert replaces value");
+	Check(LFHashRemove(hash, &key) == &other &&
+				NULL == LFHashFind(hash, &key) && 0 == LFHashSize(hash),
+														"remove");
+
+	/*well past the initial buckets*/
+	for(i = 0 ; i < 4096 ; i++)
+	{
+		ok &= 0 == LFHashInsert(hash, &keys[i], &keys[i]);
+	}
+	for(i = 0 ; i < 4096 ; i++)
+	{
+		ok &= LFHashFind(hash, &keys[i]) == &keys[i];
+	}
+	Check(ok && 4096 == LFHashSize(hash), "grows past its buckets");
+
+	LFHashDestroy(hash);
+	hash = NULL;
+}
+
+static void Concurrent(void)
+{
+	pthread_t threads[THREADS];
+	size_t bad = 0;
+	size_t i = 0;
+
+	hash = LFHashCreate(300, Hash, Match);
+	if(NULL == hash)
+	{
+		Check(0, "concurrent create");
+		return;
+	}
+
+	for(i = 0 ; i < THREADS ; i++)
+	{
+		pthread_create(&threads[i], NULL, Worker, (void*)i);
+	}
+	for(i = 0 ; i < THREADS ; i++)
+	{
+		void *ret = NULL;
+
+		pthread_join(threads[i], &ret);
+		bad += NULL == ret ? 1 : *(size_t*)ret;
+		free(ret);
+	}
+
+	Check(0 == bad, "concurrent insert, remove, find");
+	Check(THREADS * RANGE / 2 == LFHashSize(hash), "concurrent size");
+
+	LFHashDestroy(hash);
+	hash = NULL;
+}
+
+/*a domain of the caller's own, shared with other structures*/
+static void SharedEpoch(void)
+{
+	epoch_t *epoch = EpochCreate();
+	size_t i = 0;
+	int ok = 1;
+
+	hash = LFHashCreate(16, Hash, Match);
+	if(NULL == epoch || NULL == hash)
+	{
+		Check(0, "shared epoch create");
+		return;
+	}
+	LFHashSetEpoch(hash, epoch);
+
+	for(i = 0 ; i < 1000 ; i++)
+	{
+		ok &= 0 == LFHashInsert(hash, &keys[i], &keys[i]);
+	}
+	for(i = 0 ; i < 1000 ; i++)
+	{
+		ok &= LFHashRemove(hash, &keys[i]) == &keys[i];
+	}
+	Check(ok && 0 == LFHashSize(hash), "shared epoch");
+
+	LFHashDestroy(hash);
+	hash = NULL;
+	EpochDestroy(epoch);
+}
+
+
+int main(void)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < THREADS * RANGE ; i++)
+	{
+		keys[i] = i;
+	}
+
+	Basic();
+	Concurrent();
+	SharedEpoch();
+
+	return 0 == failures ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+/*
+ * Threaded stress of cache_t: threads set, read, pin and remove owned keys
+ * of a small key space while the maintenance thread runs, under each
+ * policy, with the front cache, a compressed tier and write-back. Every
+ * value read must be a value of its key, every key and value must be
+ * released exactly once. Meant to run under AddressSanitizer and
+ * ThreadSanitizer (see tests/run.sh). Prints one line per check and exits
+ * with 1 if any of them failed.
+ */
+#include <stdlib.h> 	/* malloc ,size_t	*/
+#include <stdio.h>		/* printf			*/
+#include <pthread.h>	/* pthread_create	*/
+
+#include "cache.h"
+#include "ctier.h"
+
+enum{
+	THREADS = 4,
+	OPS = 50000,
+	KEYS = 600,
+	CAPACITY = 100,
+	VALUE_INTS = 16
+};
+
+typedef struct config
+{
+	const char *name;
+	cache_policy_t policy;
+	int front;
+	int tier;
+	int write_back;
+}config_t;
+
+static const config_t configs[] = {
+	{"LRU", CACHE_POLICY_LRU, 0, 0, 0},
+	{"LRU, front cache", CACHE_POLICY_LRU, 1, 0, 0},
+	{"ARC", CACHE_POLICY_ARC, 0, 0, 0},
+	{"GDSF", CACHE_POLICY_GDSF, 0, 0, 0},
+	{"LRU, ctier", CACHE_POLICY_LRU, 0, 1, 0},
+	{"LRU, write-back", CACHE_POLICY_LRU, 0, 0, 1},
+	{"GDSF, write-back", CACHE_POLICY_GDSF, 0, 0, 1}
+};
+
+static cache_t *cache = NULL;
+static size_t made = 0;			/* keys and values handed to the cache */
+static size_t released_keys = 0;
+static size_t released_data = 0;
+static size_t wrong = 0;
+static int failures = 0;
+
+
+static void Check(int ok, const char *what)
+{
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	failures += !ok;
+}
+
+static size_t Hash(const void *key)
+{
+	return *(const size_t*)key * (size_t)0x9E3779B97F4A7C15ULL;
+}
+
+static int Match(const void *key1, const void *key2)
+{
+	return *(const size_t*)key1 == *(const size_t*)key2;
+}
+
+static size_t KeySize(const void *key)
+{
+	(void)key;
+
+	return sizeof(size_t);
+}
+
+static size_t ValueSize(const void *data)
+{
+	(void)data;
+
+	return VALUE_INTS * sizeof(int);
+}
+
+static void Release(void *key, void *data, void *user_params)
+{
+	(void)user_params;
+	__atomic_add_fetch(&released_keys, NULL != key, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&released_data, NULL != data, __ATOMIC_RELAXED);
+	free(key);
+	free(data);
+}
+
+static int IsValueOf(const int *data, size_t k)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < VALUE_INTS ; i++)
+	{
+		if(data[i] != (int)k)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int Flush(void *const *keys, void *const *data, size_t n,
+															void *user_params)
+{
+	size_t i = 0;
+
+	(void)user_params;
+	for(i = 0 ; i < n ; i++)
+	{
+		if(!IsValueOf((const int*)data[i], *(const size_t*)keys[i]))
+		{
+			__atomic_add_fetch(&wrong, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	return 0;
+}
+
+static int Visit(const void *key, void *data, void *user_params)
+{
+	(void)user_params;
+	if(!IsValueOf((const int*)data, *(const size_t*)key))
+	{
+		__atomic_add_fetch(&wrong, 1, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+static void Set(size_t k, int op)
+{
+	size_t *key = (size_t*)malloc(sizeof(size_t));
+	int *data = (int*)malloc(VALUE_INTS * sizeof(int));
+	size_t i = 0;
+
+	if(NULL == key || NULL == data)
+	{
+		free(key);
+		free(data);
+		return;
+	}
+
+	*key = k;
+	for(i = 0 ; i < VALUE_INTS ; i++)
+	{
+		data[i] = (int)k;
+	}
+	__atomic_add_fetch(&made, 1, __ATOMIC_RELAXED);
+
+	if(0 == op)
+	{
+		CacheSet(cache, key, data);
+	}
+	else if(1 == op)
+	{
+		CacheSetWithTTL(cache, key, data, 1);
+	}
+	else
+	{
+		CacheSetWithCost(cache, key, data, (double)(k % 7 + 1), k % 3 + 1);
+	}
+}
+
+static void *Worker(void *arg)
+{
+	unsigned seed = (unsigned)(size_t)arg;
+	size_t i = 0;
+
+	for(i = 0 ; i < OPS ; i++)
+	{
+		/*a hot third of the keys takes most of the traffic*/
+		size_t k = rand_r(&seed) % 4 ? (size_t)rand_r(&seed) % (KEYS / 3) :
+											(size_t)rand_r(&seed) % KEYS;
+		int op = rand_r(&seed) % 20;
+		cache_handle_t *handle = NULL;
+
+		if(op < 5)
+		{
+			Set(k, op % 3);
+		}
+		else if(op < 10)
+		{
+			handle = CacheAcquire(cache, &k);
+			if(NULL != handle)
+			{
+				if(!IsValueOf((const int*)CacheHandleData(handle), k))
+				{
+					__atomic_add_fetch(&wrong, 1, __ATOMIC_RELAXED);
+				}
+				CacheRelease(cache, handle);
+			}
+		}
+		else if(op < 19)
+		{
+			CacheVisit(cache, &k, Visit, NULL);
+		}
+		else
+		{
+			CacheRemove(cache, &k);
+		}
+	}
+
+	return NULL;
+}
+
+static void Run(const config_t *config)
+{
+	pthread_t threads[THREADS];
+	ctier_t *tier = NULL;
+	char what[64];
+	size_t i = 0;
+
+	made = 0;
+	released_keys = 0;
+	released_data = 0;
+	wrong = 0;
+
+	cache = CacheCreate(CAPACITY, Hash, Match);
+	if(NULL == cache || 0 != CacheSetPolicy(cache, config->policy))
+	{
+		Check(0, config->name);
+		return;
+	}
+	if(config->tier)
+	{
+		tier = CTierCreate(64 * 1024, Hash, Match, KeySize, ValueSize);
+		if(NULL == tier)
+		{
+			Check(0, config->name);
+			return;
+		}
+		CacheAttachTier(cache, CTierPut, CTierTake, tier);
+	}
+	CacheSetRelease(cache, Release, NULL);
+	CacheSetFrontCache(cache, config->front);
+	if(config->write_back &&
+					0 != CacheSetWriteBack(cache, Flush, 64, 5, NULL))
+	{
+		Check(0, config->name);
+		return;
+	}
+	CacheStartMaintenance(cache, 1);
+
+	for(i = 0 ; i < THREADS ; i++)
+	{
+		pthread_create(&threads[i], NULL, Worker, (void*)(i + 1));
+	}
+	for(i = 0 ; i < THREADS ; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	CacheStopMaintenance(cache);
+	CacheDestroy(cache);
+	if(NULL != tier)
+	{
+		CTierDestroy(tier);
+	}
+
+	sprintf(what, "%s: values match their keys", config->name);
+	Check(0 == wrong, what);
+	/*copies the tier hands back are released too*/
+	sprintf(what, "%s: released once", config->name);
+	Check(config->tier ? made <= released_keys && made <= released_data :
+					made == released_keys && made == released_data, what);
+}
+
+
+int main(void)
+{
+	size_t i = 0;
+
+	for(i = 0 ; i < sizeof(configs) / sizeof(configs[0]) ; i++)
+	{
+		Run(&configs[i]);
+	}
+
+	return 0 == failures ? 0 : 1;
+}